@@ -0,0 +1,1033 @@
+/**
+ * Host benchmark for the image pipeline (BMP decode + Floyd-Steinberg dither)
+ *
+ * Build and run with PlatformIO:
+ *   pio run -e native
+ *   .pio/build/native/program [-n iterations] [image.bmp ...]
+ *
+ * Without arguments a synthetic corpus of panel-sized frames is generated.
+ * Reports ns/pixel and frames/s for each image and for the whole corpus, once
+ * with per-pixel drawPixel()-style writes and once with the packed PanelWriter.
+ * Both must produce the same framebuffer checksum.
+ *
+ * The packed writes are timed with both dither kernels (scalar reference and
+ * vector, see dither.h); the vector kernel must match the scalar checksum.
+ *
+ * The packed result is then RLE-encoded as a pre-quantized frame (.e6f) and the
+ * frame decode path is timed too; it must reproduce the same checksum.
+ *
+ * Each image is also gzip-compressed and decoded through StreamInflater, the
+ * way a Content-Encoding: gzip download is; it must give the scalar checksum.
+ * The compressed size is reported next to the BMP size.
+ *
+ * Buffers come from arenas sized like the device's (PIPELINE_ARENA_SIZE and
+ * PIPELINE_SRAM_ARENA_SIZE in config.h); their peak use is reported at the end.
+ *
+ * With --verify, the two dither kernels are instead compared row by row on a
+ * corpus of images of many widths, and PanelWriter is compared against a
+ * per-pixel reference for every rotation and pixel size, and ChunkedDecoder
+ * and StreamInflater are checked on bodies split at random points, and delta
+ * frames are applied to the frame they were made against. The exit
+ * status reports whether everything matched.
+ *
+ * Link with -lz (zlib stands in for the ESP32 ROM inflater on the host).
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "arena.h"
+#include "bmp_decoder.h"
+#include "chunked_decoder.h"
+#include "config.h"
+#include "dither.h"
+#include "frame_format.h"
+#include "inflater.h"
+#include "panel_traits.h"
+#include "panel_writer.h"
+
+// Network chunk size used by downloadImage() on the device
+static const size_t CHUNK_SIZE = 512;
+
+struct CorpusImage {
+    std::string name;
+    std::vector<uint8_t> data;
+};
+
+// Decoder rows and the panel band, and the dither error rows, as on the device
+alignas(16) static uint8_t pipelineMemory[PIPELINE_ARENA_SIZE];
+alignas(16) static uint8_t ditherMemory[PIPELINE_SRAM_ARENA_SIZE];
+static Arena pipelineArena;
+static Arena ditherArena;
+
+// Native 4-bit value per palette index used for the benchmark framebuffer
+static const uint8_t BENCH_NIBBLES[PALETTE_SIZE] = {0x0, 0x1, 0x2, 0x3, 0x4, 0x5};
+
+/**
+ * Stand-in for the generic GFX pixel API: a virtual drawPixel() with a bounds
+ * check and a nibble read-modify-write, like TFT_eSprite on a 4-bit buffer
+ */
+class PixelCanvas {
+public:
+    explicit PixelCanvas(uint8_t* framebuffer) : _framebuffer(framebuffer) {}
+    virtual ~PixelCanvas() {}
+
+    virtual void drawPixel(int32_t x, int32_t y, uint8_t color) {
+        if (x < 0 || x >= DISPLAY_WIDTH || y < 0 || y >= DISPLAY_HEIGHT) return;
+        uint8_t* p = _framebuffer + y * Panel::STRIDE + x / 2;
+        if ((x & 1) == 0) {
+            *p = (uint8_t)((color << 4) | (*p & 0x0F));
+        } else {
+            *p = (uint8_t)((*p & 0xF0) | color);
+        }
+    }
+
+private:
+    uint8_t* _framebuffer;
+};
+
+// How decoded rows reach the framebuffer
+enum WriteMode { WRITE_PIXEL, WRITE_PACKED };
+
+struct BenchMode {
+    const char* name;
+    WriteMode write;
+    DitherKernel kernel;
+};
+
+/**
+ * Dithers rows into a packed panel framebuffer the same way the firmware does
+ */
+class BenchRowSink : public BmpRowSink {
+public:
+    explicit BenchRowSink(WriteMode mode, DitherKernel kernel = DITHER_KERNEL_SCALAR)
+        : _mode(mode), _kernel(kernel), _framebuffer(Panel::FRAMEBUFFER_SIZE), _canvas(_framebuffer.data()) {}
+
+    bool beginImage(const BmpInfo& info) override {
+        _info = info;
+        _indices.resize(info.width);
+        if (_mode == WRITE_PACKED &&
+            !_writer.begin(_framebuffer.data(), info.width, info.height, BENCH_NIBBLES, &pipelineArena)) {
+            return false;
+        }
+        return _dither.begin(info.width, _kernel, &ditherArena);
+    }
+
+    void writeRow(const uint8_t* bgr, uint32_t y, uint32_t fileRow) override {
+        _dither.ditherRow(bgr, _indices.data());
+
+        if (_mode == WRITE_PACKED) {
+            _writer.writeRow(_indices.data(), y);
+            if (fileRow == _info.height - 1) _writer.flush();
+            return;
+        }
+
+        // Rotate 90 degrees clockwise: BMP(x,y) -> Display(height-1-y, x)
+        int32_t displayX = _info.height - 1 - y;
+        for (int32_t x = 0; x < (int32_t)_info.width; x++) {
+            _canvas.drawPixel(displayX, x, BENCH_NIBBLES[_indices[x]]);
+        }
+    }
+
+    uint32_t checksum() const {
+        uint32_t hash = 2166136261u;
+        for (uint8_t value : _framebuffer) {
+            hash = (hash ^ value) * 16777619u;
+        }
+        return hash;
+    }
+
+    const std::vector<uint8_t>& framebuffer() const { return _framebuffer; }
+
+private:
+    WriteMode _mode;
+    DitherKernel _kernel;
+    BmpInfo _info;
+    FloydSteinbergDither _dither;
+    PanelWriter<Panel> _writer;
+    std::vector<uint8_t> _indices;
+    std::vector<uint8_t> _framebuffer;
+    PixelCanvas _canvas;
+};
+
+/**
+ * Copies decoded frame rows into a packed panel framebuffer, like the firmware
+ */
+class BenchFrameSink : public FrameRowSink {
+public:
+    BenchFrameSink() : _framebuffer(Panel::FRAMEBUFFER_SIZE) {}
+
+    bool beginFrame(const FrameHeader& header) override {
+        _delta = (header.flags & FRAME_FLAG_DELTA) != 0;
+        return _writer.begin(_framebuffer.data(), 0, 0, BENCH_NIBBLES);
+    }
+
+    void writeFrameRow(const uint8_t* indices, uint32_t y) override {
+        if (_delta) {
+            _writer.patchPanelRow(indices, y, FRAME_COLOR_KEEP);
+        } else {
+            _writer.writePanelRow(indices, y);
+        }
+    }
+
+    uint32_t checksum() const {
+        uint32_t hash = 2166136261u;
+        for (uint8_t value : _framebuffer) {
+            hash = (hash ^ value) * 16777619u;
+        }
+        return hash;
+    }
+
+    std::vector<uint8_t>& framebuffer() { return _framebuffer; }
+
+private:
+    PanelWriter<Panel> _writer;
+    std::vector<uint8_t> _framebuffer;
+    bool _delta = false;
+};
+
+static void writeLE16(std::vector<uint8_t>& out, size_t offset, uint16_t value) {
+    out[offset] = value & 0xFF;
+    out[offset + 1] = value >> 8;
+}
+
+static void writeLE32(std::vector<uint8_t>& out, size_t offset, uint32_t value) {
+    for (int i = 0; i < 4; i++) out[offset + i] = (value >> (i * 8)) & 0xFF;
+}
+
+/**
+ * Build a 24-bit BMP from a pixel generator returning 0xRRGGBB for (x, y)
+ */
+template <typename Generator>
+static std::vector<uint8_t> makeBmp(uint32_t width, uint32_t height, bool topDown, Generator pixel) {
+    uint32_t rowSize = ((width * 3 + 3) / 4) * 4;
+    std::vector<uint8_t> out(BmpDecoder::HEADER_SIZE + rowSize * height, 0);
+
+    out[0] = 'B';
+    out[1] = 'M';
+    writeLE32(out, 2, out.size());
+    writeLE32(out, 10, BmpDecoder::HEADER_SIZE);
+    writeLE32(out, 14, 40);
+    writeLE32(out, 18, width);
+    writeLE32(out, 22, topDown ? (uint32_t)(-(int32_t)height) : height);
+    writeLE16(out, 26, 1);
+    writeLE16(out, 28, 24);
+    writeLE32(out, 34, rowSize * height);
+
+    for (uint32_t fileRow = 0; fileRow < height; fileRow++) {
+        uint32_t y = topDown ? fileRow : height - 1 - fileRow;
+        uint8_t* row = out.data() + BmpDecoder::HEADER_SIZE + fileRow * rowSize;
+        for (uint32_t x = 0; x < width; x++) {
+            uint32_t rgb = pixel(x, y);
+            row[x * 3] = rgb & 0xFF;
+            row[x * 3 + 1] = (rgb >> 8) & 0xFF;
+            row[x * 3 + 2] = (rgb >> 16) & 0xFF;
+        }
+    }
+    return out;
+}
+
+/**
+ * Synthetic corpus - the generator renders portrait frames that the firmware
+ * rotates onto the 800x480 panel
+ */
+static std::vector<CorpusImage> syntheticCorpus() {
+    const uint32_t width = DISPLAY_HEIGHT;
+    const uint32_t height = DISPLAY_WIDTH;
+    std::vector<CorpusImage> corpus;
+
+    // Smooth gradients - worst case for error diffusion
+    corpus.push_back({"synthetic-gradient", makeBmp(width, height, false, [&](uint32_t x, uint32_t y) {
+        uint32_t r = x * 255 / (width - 1);
+        uint32_t g = y * 255 / (height - 1);
+        uint32_t b = 255 - (x + y) * 255 / (width + height - 2);
+        return (r << 16) | (g << 8) | b;
+    })});
+
+    // Flat UI blocks with text-like stripes, similar to the metro board
+    corpus.push_back({"synthetic-board", makeBmp(width, height, false, [&](uint32_t x, uint32_t y) {
+        if (y < 120) return 0x0072CEu;                            // Header bar
+        if ((y / 100) % 2 == 1 && x > 40 && x < 440) {
+            return ((x / 6 + y / 9) % 3 == 0) ? 0x000000u : 0xFFFFFFu;  // Text rows
+        }
+        if (y > 700) return (x < 240) ? 0xFFD100u : 0x00A651u;  // Status boxes
+        return 0xFFFFFFu;
+    })});
+
+    // Photographic-like noise, stored top-down
+    uint32_t seed = 12345;
+    corpus.push_back({"synthetic-noise-topdown", makeBmp(width, height, true, [&](uint32_t, uint32_t) {
+        seed = seed * 1664525u + 1013904223u;
+        return seed >> 8;
+    })});
+
+    return corpus;
+}
+
+/**
+ * Encode panel-raster palette indices as an RLE frame, using the same token rules
+ * as the service's frame encoder
+ */
+static std::vector<uint8_t> encodeFramePixels(const std::vector<uint8_t>& pixels, uint8_t flags) {
+    const size_t count = pixels.size();
+
+    auto runLength = [&](size_t i) {
+        size_t end = i;
+        while (end < count && pixels[end] == pixels[i]) end++;
+        return end - i;
+    };
+
+    std::vector<uint8_t> payload;
+    size_t i = 0;
+    while (i < count) {
+        size_t run = runLength(i);
+        if (run >= 3) {
+            if (run < 16) {
+                payload.push_back((uint8_t)(((run - 1) << 3) | pixels[i]));
+            } else {
+                payload.push_back((uint8_t)(0x78 | pixels[i]));
+                for (size_t extra = run - 16;; extra >>= 7) {
+                    payload.push_back((uint8_t)((extra & 0x7F) | (extra >= 0x80 ? 0x80 : 0)));
+                    if (extra < 0x80) break;
+                }
+            }
+            i += run;
+            continue;
+        }
+
+        // Literal until the next run worth encoding
+        size_t start = i;
+        while (i < count && i - start < 128 && runLength(i) < 3) i++;
+        size_t literal = i - start;
+        payload.push_back((uint8_t)(0x80 | (literal - 1)));
+        for (size_t k = 0; k < literal; k += 2) {
+            uint8_t low = k + 1 < literal ? pixels[start + k + 1] : 0;
+            payload.push_back((uint8_t)((pixels[start + k] << 4) | low));
+        }
+    }
+
+    std::vector<uint8_t> out(FRAME_HEADER_SIZE, 0);
+    out[0] = FRAME_MAGIC_0;
+    out[1] = FRAME_MAGIC_1;
+    out[2] = FRAME_MAGIC_2;
+    out[3] = FRAME_MAGIC_3;
+    out[4] = FRAME_VERSION;
+    out[5] = flags;
+    writeLE16(out, 6, DISPLAY_WIDTH);
+    writeLE16(out, 8, DISPLAY_HEIGHT);
+    out[10] = 1;
+    out[11] = FRAME_PALETTE_VERSION;
+    writeLE32(out, 12, payload.size());
+    writeLE32(out, 16, crc32Update(0, payload.data(), payload.size()));
+    out.insert(out.end(), payload.begin(), payload.end());
+    return out;
+}
+
+// Palette index of every pixel of a benchmark framebuffer (BENCH_NIBBLES are the indices)
+static std::vector<uint8_t> framebufferPixels(const std::vector<uint8_t>& framebuffer) {
+    const size_t count = (size_t)DISPLAY_WIDTH * DISPLAY_HEIGHT;
+    std::vector<uint8_t> pixels(count);
+    for (size_t i = 0; i < count; i++) {
+        pixels[i] = (i & 1) ? framebuffer[i / 2] & 0x0F : framebuffer[i / 2] >> 4;
+    }
+    return pixels;
+}
+
+static std::vector<uint8_t> encodeFrame(const std::vector<uint8_t>& framebuffer) {
+    return encodeFramePixels(framebufferPixels(framebuffer), FRAME_FLAG_RLE);
+}
+
+/**
+ * Encode target as a delta frame against base, like the service's encodeDeltaFrame()
+ */
+static std::vector<uint8_t> encodeDeltaFrame(const std::vector<uint8_t>& base, const std::vector<uint8_t>& target) {
+    std::vector<uint8_t> basePixels = framebufferPixels(base);
+    std::vector<uint8_t> pixels = framebufferPixels(target);
+    for (size_t i = 0; i < pixels.size(); i++) {
+        if (pixels[i] == basePixels[i]) pixels[i] = FRAME_COLOR_KEEP;
+    }
+    return encodeFramePixels(pixels, FRAME_FLAG_RLE | FRAME_FLAG_DELTA);
+}
+
+/**
+ * Dither the same rows with both kernels and compare every palette index
+ * Widths cover whole vectors, partial ones and single pixels; content covers flat
+ * colors, gradients (long error chains) and noise (large errors of both signs)
+ */
+static bool verifyKernels() {
+    const uint32_t widths[] = {1, 2, 3, 7, 8, 9, 15, 16, 17, 31, 33, 100, 479, 480, 481};
+    const uint32_t height = 64;
+    uint32_t seed = 2024;
+    uint64_t pixels = 0;
+    int failures = 0;
+
+    for (uint32_t width : widths) {
+        for (int pattern = 0; pattern < 4; pattern++) {
+            FloydSteinbergDither scalar;
+            FloydSteinbergDither vector;
+            if (!scalar.begin(width, DITHER_KERNEL_SCALAR) || !vector.begin(width, DITHER_KERNEL_VECTOR)) {
+                fprintf(stderr, "width %u: allocation failed\n", width);
+                return false;
+            }
+
+            std::vector<uint8_t> bgr(width * 3);
+            std::vector<uint8_t> expected(width);
+            std::vector<uint8_t> actual(width);
+            for (uint32_t y = 0; y < height; y++) {
+                for (uint32_t x = 0; x < width * 3; x++) {
+                    seed = seed * 1664525u + 1013904223u;
+                    switch (pattern) {
+                        case 0: bgr[x] = (uint8_t)(seed >> 24); break;                          // Noise
+                        case 1: bgr[x] = (uint8_t)((x / 3) * 255 / width + y * (x % 3)); break;  // Gradients
+                        case 2: bgr[x] = (x % 3 == 0) ? 0x80 : 0x7F; break;                     // Flat mid-gray
+                        default: bgr[x] = (seed >> 31) ? 0xFF : 0x00; break;                    // Black/white
+                    }
+                }
+
+                scalar.ditherRow(bgr.data(), expected.data());
+                vector.ditherRow(bgr.data(), actual.data());
+                pixels += width;
+
+                for (uint32_t x = 0; x < width; x++) {
+                    if (expected[x] != actual[x]) {
+                        fprintf(stderr, "width %u pattern %d: row %u pixel %u is %u, scalar %u\n", width, pattern, y,
+                                x, actual[x], expected[x]);
+                        failures++;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+    printf("dither kernels (%s): %llu pixels compared, %d mismatching rows\n",
+           DITHER_PIE ? "PIE" : "lane model", (unsigned long long)pixels, failures);
+    return failures == 0;
+}
+
+/**
+ * Reference for PanelWriter: every pixel of rows yBegin .. yEnd-1 mapped and packed
+ * on its own. With panelRows the image is already in panel orientation
+ */
+template <class Layout>
+static void referenceWrite(std::vector<uint8_t>& framebuffer, const std::vector<uint8_t>& image, uint32_t width,
+                           uint32_t height, uint32_t yBegin, uint32_t yEnd, const uint8_t* nibbles, bool panelRows) {
+    for (uint32_t y = yBegin; y < yEnd; y++) {
+        for (uint32_t x = 0; x < width; x++) {
+            int32_t panelX = panelRows ? x : Layout::panelX(x, y, width, height);
+            int32_t panelY = panelRows ? y : Layout::panelY(x, y, width, height);
+            if (!Layout::contains(panelX, panelY)) continue;
+
+            uint8_t& byte = framebuffer[panelY * Layout::STRIDE + panelX / Layout::PIXELS_PER_BYTE];
+            uint8_t shift = Layout::pixelShift(panelX);
+            uint8_t mask = (uint8_t)(((1u << Layout::PIXEL_BITS) - 1) << shift);
+            byte = (uint8_t)((byte & ~mask) | (nibbles[image[y * width + x]] << shift));
+        }
+    }
+}
+
+/**
+ * Write random images through PanelWriter<Layout> and compare with the reference
+ * Covers images matching the panel, smaller and larger ones, both row orders,
+ * downloads that stop half way, and pre-rotated panel rows
+ */
+template <class Layout>
+static int verifyPanelWriter(uint32_t& seed) {
+    uint8_t nibbles[Layout::COLORS];
+    for (uint8_t i = 0; i < Layout::COLORS; i++) nibbles[i] = Layout::COLORS - 1 - i;
+
+    const uint32_t sizes[][2] = {
+        {Layout::IMAGE_WIDTH, Layout::IMAGE_HEIGHT},
+        {Layout::IMAGE_WIDTH - 3u, Layout::IMAGE_HEIGHT - 5u},
+        {Layout::IMAGE_WIDTH + 5u, Layout::IMAGE_HEIGHT + 3u},
+    };
+    int failures = 0;
+
+    for (int test = 0; test < 4 * 3 + 1; test++) {
+        bool panelRows = test == 4 * 3;
+        uint32_t width = panelRows ? Layout::WIDTH : sizes[test / 4][0];
+        uint32_t height = panelRows ? Layout::HEIGHT : sizes[test / 4][1];
+        bool bottomUp = test & 1;
+        uint32_t rows = (test & 2) ? height / 2 : height;
+
+        std::vector<uint8_t> image(width * height);
+        for (uint8_t& index : image) {
+            seed = seed * 1664525u + 1013904223u;
+            index = (uint8_t)((seed >> 24) % Layout::COLORS);
+        }
+
+        std::vector<uint8_t> expected(Layout::FRAMEBUFFER_SIZE, 0xA5);
+        std::vector<uint8_t> actual(Layout::FRAMEBUFFER_SIZE, 0xA5);
+        PanelWriter<Layout> writer;
+        if (!writer.begin(actual.data(), panelRows ? 0 : width, panelRows ? 0 : height, nibbles)) {
+            fprintf(stderr, "PanelWriter: allocation failed\n");
+            return failures + 1;
+        }
+
+        // Rows in arrival order; a bottom-up BMP delivers the last image row first
+        for (uint32_t i = 0; i < rows; i++) {
+            uint32_t y = bottomUp ? height - 1 - i : i;
+            if (panelRows) {
+                writer.writePanelRow(image.data() + y * width, y);
+            } else {
+                writer.writeRow(image.data() + y * width, y);
+            }
+        }
+        writer.flush();
+
+        uint32_t yBegin = bottomUp ? height - rows : 0;
+        referenceWrite<Layout>(expected, image, width, height, yBegin, yBegin + rows, nibbles, panelRows);
+
+        if (expected != actual) {
+            fprintf(stderr, "PanelWriter %ux%u rotation %d, %u-bit: %ux%u image, %s, %u of %u rows%s differs\n",
+                    Layout::WIDTH, Layout::HEIGHT, Layout::ROTATION * 90, Layout::PIXEL_BITS, width, height,
+                    bottomUp ? "bottom-up" : "top-down", rows, height, panelRows ? " (panel rows)" : "");
+            failures++;
+        }
+    }
+    return failures;
+}
+
+template <PanelRotation Rotation, uint8_t PixelBits>
+static int verifyPanelLayouts(uint32_t& seed) {
+    static constexpr uint8_t colors = PixelBits == 1 ? 2 : (PixelBits == 2 ? 4 : PALETTE_SIZE);
+    return verifyPanelWriter<PanelLayout<40, 24, Rotation, PixelBits, colors>>(seed) +
+           verifyPanelWriter<PanelLayout<37, 21, Rotation, PixelBits, colors>>(seed);
+}
+
+template <PanelRotation Rotation>
+static int verifyPanelRotation(uint32_t& seed) {
+    return verifyPanelLayouts<Rotation, 1>(seed) + verifyPanelLayouts<Rotation, 2>(seed) +
+           verifyPanelLayouts<Rotation, 4>(seed) + verifyPanelLayouts<Rotation, 8>(seed);
+}
+
+static bool verifyPanelWriters() {
+    uint32_t seed = 7;
+    int failures = verifyPanelWriter<Panel>(seed) + verifyPanelRotation<PANEL_ROTATE_0>(seed) +
+                   verifyPanelRotation<PANEL_ROTATE_90>(seed) + verifyPanelRotation<PANEL_ROTATE_180>(seed) +
+                   verifyPanelRotation<PANEL_ROTATE_270>(seed);
+
+    printf("panel writers: %d layouts, %d mismatching images\n", 1 + 4 * 4 * 2, failures);
+    return failures == 0;
+}
+
+/**
+ * Chunk-encode random bodies (random chunk sizes, extensions, trailers, bare LF
+ * line ends), feed them in random pieces and compare the payload; a body cut
+ * short must come out as an unfinished prefix
+ */
+static bool verifyChunkedDecoder() {
+    const size_t sizes[] = {0, 1, 100, 4096, 70000};
+    uint32_t seed = 99;
+    int bodies = 0;
+    int failures = 0;
+
+    auto next = [&seed](uint32_t range) {
+        seed = seed * 1664525u + 1013904223u;
+        return (seed >> 8) % range;
+    };
+
+    for (size_t size : sizes) {
+        for (int variant = 0; variant < 8; variant++) {
+            std::vector<uint8_t> body(size);
+            for (uint8_t& value : body) value = (uint8_t)next(256);
+
+            const char* eol = variant & 1 ? "\n" : "\r\n";
+            std::string encoded;
+            for (size_t offset = 0; offset < size;) {
+                size_t chunk = 1 + next(variant & 2 ? 16 : 5000);
+                if (chunk > size - offset) chunk = size - offset;
+                char line[32];
+                snprintf(line, sizeof(line), variant & 4 ? "%zX;ext=1%s" : "%zx%s", chunk, eol);
+                encoded += line;
+                encoded.append((const char*)body.data() + offset, chunk);
+                encoded += eol;
+                offset += chunk;
+            }
+            encoded += std::string("0") + eol;
+            if (variant & 4) encoded += std::string("X-Trailer: 1") + eol;
+            encoded += eol;
+
+            for (int truncated = 0; truncated < 2; truncated++) {
+                size_t length = truncated ? encoded.size() / 2 : encoded.size();
+                std::vector<uint8_t> raw(encoded.begin(), encoded.begin() + length);
+                std::vector<uint8_t> payload;
+                ChunkedDecoder decoder;
+
+                for (size_t offset = 0; offset < length;) {
+                    size_t piece = 1 + next(3000);
+                    if (piece > length - offset) piece = length - offset;
+                    size_t count = decoder.decode(raw.data() + offset, piece);
+                    payload.insert(payload.end(), raw.data() + offset, raw.data() + offset + count);
+                    offset += piece;
+                }
+
+                bool prefix = payload.size() <= body.size() && std::equal(payload.begin(), payload.end(), body.begin());
+                bool ok = !decoder.failed() && prefix && decoder.payloadBytes() == payload.size() &&
+                          (truncated ? !decoder.finished() : decoder.finished() && payload.size() == body.size());
+                bodies++;
+                if (!ok) {
+                    failures++;
+                    fprintf(stderr, "chunked: %zu bytes, variant %d%s: decoded %zu bytes, finished %d, failed %d\n", size,
+                            variant, truncated ? " (truncated)" : "", payload.size(), decoder.finished(),
+                            decoder.failed());
+                }
+            }
+        }
+    }
+
+    printf("chunked decoder: %d bodies, %d mismatching\n", bodies, failures);
+    return failures == 0;
+}
+
+/**
+ * Compress with zlib; windowBits picks the wrapper (31 gzip, 15 zlib, -15 raw deflate)
+ * A gzip header can carry the optional fields in header
+ */
+static std::vector<uint8_t> compressBody(const std::vector<uint8_t>& data, int windowBits,
+                                         gz_header* header = nullptr) {
+    z_stream stream = {};
+    deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, windowBits, 9, Z_DEFAULT_STRATEGY);
+    if (header != nullptr) deflateSetHeader(&stream, header);
+
+    std::vector<uint8_t> out(deflateBound(&stream, data.size()) + 256);
+    stream.next_in = (Bytef*)data.data();
+    stream.avail_in = data.size();
+    stream.next_out = out.data();
+    stream.avail_out = out.size();
+    deflate(&stream, Z_FINISH);
+    out.resize(stream.total_out);
+    deflateEnd(&stream);
+    return out;
+}
+
+class CollectingSink : public ByteSink {
+public:
+    void write(const uint8_t* data, size_t length) override { bytes.insert(bytes.end(), data, data + length); }
+    std::vector<uint8_t> bytes;
+};
+
+/**
+ * Compress random bodies as gzip (with and without the optional header fields),
+ * zlib and raw deflate, inflate them fed in random pieces and compare. A body cut
+ * short must come out as an unfinished prefix, and a corrupted trailer must be
+ * reported as a checksum error
+ */
+static bool verifyInflater() {
+    const size_t sizes[] = {0, 1, 100, 4096, 70000, 300000};
+    uint32_t seed = 7;
+    int bodies = 0;
+    int failures = 0;
+
+    auto next = [&seed](uint32_t range) {
+        seed = seed * 1664525u + 1013904223u;
+        return (seed >> 8) % range;
+    };
+
+    char name[] = "image.bmp";
+    char comment[] = "bench";
+    uint8_t extra[] = {'B', 'N', 2, 0, 1, 2};
+    gz_header header = {};
+    header.name = (Bytef*)name;
+    header.comment = (Bytef*)comment;
+    header.extra = extra;
+    header.extra_len = sizeof(extra);
+    header.hcrc = 1;
+
+    struct Variant {
+        const char* name;
+        ContentEncoding encoding;
+        int windowBits;
+        gz_header* header;
+    };
+    const Variant variants[] = {
+        {"gzip", CONTENT_ENCODING_GZIP, 31, nullptr},
+        {"gzip+fields", CONTENT_ENCODING_GZIP, 31, &header},
+        {"zlib", CONTENT_ENCODING_DEFLATE, 15, nullptr},
+        {"raw", CONTENT_ENCODING_DEFLATE, -15, nullptr},
+    };
+
+    for (size_t size : sizes) {
+        // Runs of repeated bytes, so there are matches to copy
+        std::vector<uint8_t> body(size);
+        for (size_t i = 0; i < size;) {
+            uint8_t value = (uint8_t)next(256);
+            for (size_t run = 1 + next(40); run > 0 && i < size; run--) body[i++] = value;
+        }
+
+        for (const Variant& variant : variants) {
+            std::vector<uint8_t> encoded = compressBody(body, variant.windowBits, variant.header);
+
+            // 0: whole, 1: cut short, 2: last trailer byte flipped (no trailer on raw deflate)
+            for (int damage = 0; damage < (variant.windowBits < 0 ? 2 : 3); damage++) {
+                std::vector<uint8_t> raw = encoded;
+                if (damage == 1) raw.resize(raw.size() / 2);
+                if (damage == 2) raw.back() ^= 0x01;
+
+                CollectingSink sink;
+                StreamInflater inflater;
+                inflater.begin(variant.encoding, &sink);
+                for (size_t offset = 0; offset < raw.size();) {
+                    size_t piece = 1 + next(3000);
+                    if (piece > raw.size() - offset) piece = raw.size() - offset;
+                    inflater.feed(raw.data() + offset, piece);
+                    offset += piece;
+                }
+
+                const std::vector<uint8_t>& out = sink.bytes;
+                bool prefix = out.size() <= body.size() && std::equal(out.begin(), out.end(), body.begin());
+                bool ok = prefix && inflater.bytesOut() == out.size();
+                if (damage == 0) {
+                    ok = ok && inflater.finished() && !inflater.failed() && out.size() == body.size() &&
+                         inflater.bytesIn() == raw.size();
+                } else if (damage == 1) {
+                    ok = ok && !inflater.finished() && !inflater.failed();
+                } else {
+                    ok = ok && inflater.error() == INFLATE_ERROR_CHECKSUM;
+                }
+
+                bodies++;
+                if (!ok) {
+                    failures++;
+                    fprintf(stderr, "inflate: %zu bytes, %s, damage %d: inflated %zu bytes, finished %d, %s\n", size,
+                            variant.name, damage, out.size(), inflater.finished(),
+                            inflateErrorToString(inflater.error()));
+                }
+            }
+        }
+    }
+
+    // Not deflate at all
+    const uint8_t garbage[] = {'B', 'M', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+    CollectingSink sink;
+    StreamInflater inflater;
+    inflater.begin(CONTENT_ENCODING_GZIP, &sink);
+    inflater.feed(garbage, sizeof(garbage));
+    bodies++;
+    if (inflater.error() != INFLATE_ERROR_HEADER) {
+        failures++;
+        fprintf(stderr, "inflate: BMP accepted as gzip\n");
+    }
+
+    printf("inflater: %d bodies, %d mismatching\n", bodies, failures);
+    return failures == 0;
+}
+
+/**
+ * Change a few digit-sized tiles of a board-like frame, send the change as a delta
+ * frame and apply it to the previous frame; the result must match the new frame.
+ * Reports how big the deltas are next to the full frame
+ */
+static bool verifyDeltaFrames() {
+    uint32_t seed = 5;
+    auto next = [&seed](uint32_t range) {
+        seed = seed * 1664525u + 1013904223u;
+        return (seed >> 8) % range;
+    };
+
+    // Flat panels with text-like noise, like a departure board
+    std::vector<uint8_t> previous(Panel::FRAMEBUFFER_SIZE);
+    for (uint32_t y = 0; y < DISPLAY_HEIGHT; y++) {
+        for (uint32_t x = 0; x < DISPLAY_WIDTH; x += 2) {
+            uint8_t background = (y / 60) % 2 ? 0x11 : 0x33;
+            previous[y * Panel::STRIDE + x / 2] = next(8) == 0 ? (uint8_t)next(PALETTE_SIZE) * 0x11 : background;
+        }
+    }
+
+    int patches = 0;
+    int failures = 0;
+    size_t deltaBytes = 0;
+    size_t fullBytes = 0;
+
+    for (int update = 0; update < 20; update++) {
+        // A handful of departure times and status boxes change
+        std::vector<uint8_t> target = previous;
+        for (uint32_t tile = 1 + next(6); tile > 0; tile--) {
+            uint32_t left = next(DISPLAY_WIDTH - 40);
+            uint32_t top = next(DISPLAY_HEIGHT - 24);
+            for (uint32_t y = top; y < top + 24; y++) {
+                for (uint32_t x = left; x < left + 40; x++) {
+                    uint8_t& byte = target[y * Panel::STRIDE + x / 2];
+                    uint8_t color = (uint8_t)next(PALETTE_SIZE);
+                    byte = x & 1 ? (byte & 0xF0) | color : (byte & 0x0F) | (color << 4);
+                }
+            }
+        }
+
+        std::vector<uint8_t> delta = encodeDeltaFrame(previous, target);
+        deltaBytes += delta.size();
+        fullBytes += encodeFrame(target).size();
+
+        BenchFrameSink sink;
+        sink.framebuffer() = previous;
+        FrameDecoder decoder;
+        decoder.begin(&sink, DISPLAY_WIDTH, DISPLAY_HEIGHT);
+        decoder.feed(delta.data(), delta.size());
+        bool ok = decoder.finish() == FRAME_OK && sink.framebuffer() == target;
+
+        patches++;
+        if (!ok) {
+            failures++;
+            fprintf(stderr, "delta: update %d doesn't reproduce the frame (%s)\n", update,
+                    frameErrorToString(decoder.error()));
+        }
+        previous = target;
+    }
+
+    printf("delta frames: %d patches, %d mismatching (%zu bytes on average, full frames %zu)\n", patches, failures,
+           deltaBytes / patches, fullBytes / patches);
+    return failures == 0;
+}
+
+static bool loadFile(const char* path, std::vector<uint8_t>& data) {
+    FILE* file = fopen(path, "rb");
+    if (file == nullptr) return false;
+
+    uint8_t buffer[4096];
+    size_t count;
+    while ((count = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        data.insert(data.end(), buffer, buffer + count);
+    }
+    fclose(file);
+    return true;
+}
+
+/**
+ * Decode one image the way the firmware does - in network-sized chunks
+ */
+static bool decodeImage(const std::vector<uint8_t>& data, BenchRowSink& sink, BmpDecoder& decoder) {
+    pipelineArena.reset();
+    ditherArena.reset();
+    decoder.begin(&sink, &pipelineArena);
+    for (size_t offset = 0; offset < data.size() && !decoder.failed(); offset += CHUNK_SIZE) {
+        size_t count = data.size() - offset < CHUNK_SIZE ? data.size() - offset : CHUNK_SIZE;
+        decoder.feed(data.data() + offset, count);
+    }
+    bool ok = decoder.complete();
+    decoder.end();
+    return ok;
+}
+
+/**
+ * Decode one pre-quantized frame in network-sized chunks
+ */
+static bool decodeFrame(const std::vector<uint8_t>& data, BenchFrameSink& sink, FrameDecoder& decoder) {
+    pipelineArena.reset();
+    decoder.begin(&sink, DISPLAY_WIDTH, DISPLAY_HEIGHT, &pipelineArena);
+    for (size_t offset = 0; offset < data.size() && !decoder.failed(); offset += CHUNK_SIZE) {
+        size_t count = data.size() - offset < CHUNK_SIZE ? data.size() - offset : CHUNK_SIZE;
+        decoder.feed(data.data() + offset, count);
+    }
+    bool ok = decoder.finish() == FRAME_OK;
+    decoder.end();
+    return ok;
+}
+
+/**
+ * Passes inflated bytes to the BMP decoder, as the firmware's image stream does
+ */
+class DecoderByteSink : public ByteSink {
+public:
+    explicit DecoderByteSink(BmpDecoder& decoder) : _decoder(decoder) {}
+    void write(const uint8_t* data, size_t length) override { _decoder.feed(data, length); }
+
+private:
+    BmpDecoder& _decoder;
+};
+
+/**
+ * Decode one gzip-compressed image in network-sized chunks
+ */
+static bool decodeGzipImage(const std::vector<uint8_t>& data, BenchRowSink& sink, BmpDecoder& decoder,
+                            StreamInflater& inflater) {
+    pipelineArena.reset();
+    ditherArena.reset();
+    DecoderByteSink bytes(decoder);
+    decoder.begin(&sink, &pipelineArena);
+    inflater.begin(CONTENT_ENCODING_GZIP, &bytes, &pipelineArena);
+    for (size_t offset = 0; offset < data.size() && !decoder.failed() && !inflater.failed(); offset += CHUNK_SIZE) {
+        size_t count = data.size() - offset < CHUNK_SIZE ? data.size() - offset : CHUNK_SIZE;
+        inflater.feed(data.data() + offset, count);
+    }
+    bool ok = decoder.complete() && inflater.finished();
+    inflater.end();
+    decoder.end();
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    int iterations = 10;
+    std::vector<CorpusImage> corpus;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            iterations = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--verify") == 0) {
+            bool kernelsMatch = verifyKernels();
+            bool writersMatch = verifyPanelWriters();
+            bool chunkedMatch = verifyChunkedDecoder();
+            bool inflaterMatch = verifyInflater();
+            bool deltaMatch = verifyDeltaFrames();
+            return kernelsMatch && writersMatch && chunkedMatch && inflaterMatch && deltaMatch ? 0 : 1;
+        } else {
+            CorpusImage image = {argv[i], {}};
+            if (!loadFile(argv[i], image.data)) {
+                fprintf(stderr, "Can't read %s\n", argv[i]);
+                return 1;
+            }
+            corpus.push_back(image);
+        }
+    }
+    if (corpus.empty()) {
+        corpus = syntheticCorpus();
+    }
+    if (iterations < 1) iterations = 1;
+
+    pipelineArena.begin(pipelineMemory, sizeof(pipelineMemory));
+    ditherArena.begin(ditherMemory, sizeof(ditherMemory));
+
+    printf("%-28s %-7s %10s %10s %10s %10s\n", "image", "write", "pixels", "ms/frame", "ns/pixel", "frames/s");
+
+    const BenchMode modes[] = {
+        {"pixel", WRITE_PIXEL, DITHER_KERNEL_SCALAR},
+        {"packed", WRITE_PACKED, DITHER_KERNEL_SCALAR},
+        {"vector", WRITE_PACKED, DITHER_KERNEL_VECTOR},
+    };
+    std::vector<uint32_t> scalarChecksums(corpus.size());
+
+    for (const BenchMode& mode : modes) {
+        double totalSeconds = 0;
+        uint64_t totalPixels = 0;
+
+        for (size_t index = 0; index < corpus.size(); index++) {
+            const CorpusImage& image = corpus[index];
+            BenchRowSink sink(mode.write, mode.kernel);
+            BmpDecoder decoder;
+
+            // Warm-up run, also validates the image
+            if (!decodeImage(image.data, sink, decoder)) {
+                fprintf(stderr, "%s: decode failed (%s)\n", image.name.c_str(), bmpErrorToString(decoder.error()));
+                return 1;
+            }
+            uint64_t pixels = (uint64_t)decoder.info().width * decoder.info().height;
+
+            auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < iterations; i++) {
+                decodeImage(image.data, sink, decoder);
+            }
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            printf("%-28s %-7s %10llu %10.2f %10.2f %10.1f   checksum %08x\n", image.name.c_str(), mode.name,
+                   (unsigned long long)pixels, seconds * 1e3 / iterations, seconds * 1e9 / (pixels * iterations),
+                   iterations / seconds, sink.checksum());
+
+            if (mode.kernel == DITHER_KERNEL_SCALAR) {
+                scalarChecksums[index] = sink.checksum();
+            } else if (sink.checksum() != scalarChecksums[index]) {
+                fprintf(stderr, "%s: vector kernel checksum %08x doesn't match scalar %08x\n", image.name.c_str(),
+                        sink.checksum(), scalarChecksums[index]);
+                return 1;
+            }
+
+            totalSeconds += seconds;
+            totalPixels += pixels * iterations;
+        }
+
+        printf("%-28s %-7s %10s %10.2f %10.2f %10.1f\n", "corpus", mode.name, "",
+               totalSeconds * 1e3 / (iterations * corpus.size()), totalSeconds * 1e9 / totalPixels,
+               iterations * corpus.size() / totalSeconds);
+    }
+
+    // gzip Content-Encoding: compress each BMP once, then time inflating and decoding it
+    double totalSeconds = 0;
+    uint64_t totalPixels = 0;
+
+    for (size_t index = 0; index < corpus.size(); index++) {
+        const CorpusImage& image = corpus[index];
+        std::vector<uint8_t> compressed = compressBody(image.data, 31);
+
+        BenchRowSink sink(WRITE_PACKED);
+        BmpDecoder decoder;
+        StreamInflater inflater;
+        if (!decodeGzipImage(compressed, sink, decoder, inflater)) {
+            fprintf(stderr, "%s: gzip decode failed (%s, %s)\n", image.name.c_str(), bmpErrorToString(decoder.error()),
+                    inflateErrorToString(inflater.error()));
+            return 1;
+        }
+        if (sink.checksum() != scalarChecksums[index]) {
+            fprintf(stderr, "%s: gzip checksum %08x doesn't match scalar %08x\n", image.name.c_str(), sink.checksum(),
+                    scalarChecksums[index]);
+            return 1;
+        }
+        uint64_t pixels = (uint64_t)decoder.info().width * decoder.info().height;
+
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; i++) {
+            decodeGzipImage(compressed, sink, decoder, inflater);
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        printf("%-28s %-7s %10llu %10.2f %10.2f %10.1f   checksum %08x  %zu bytes (bmp %zu, %.1fx)\n",
+               image.name.c_str(), "gzip", (unsigned long long)pixels, seconds * 1e3 / iterations,
+               seconds * 1e9 / (pixels * iterations), iterations / seconds, sink.checksum(), compressed.size(),
+               image.data.size(), (double)image.data.size() / compressed.size());
+
+        totalSeconds += seconds;
+        totalPixels += pixels * iterations;
+    }
+
+    printf("%-28s %-7s %10s %10.2f %10.2f %10.1f\n", "corpus", "gzip", "",
+           totalSeconds * 1e3 / (iterations * corpus.size()), totalSeconds * 1e9 / totalPixels,
+           iterations * corpus.size() / totalSeconds);
+
+    // Pre-quantized frames: encode the packed result once, then time decoding it
+    totalSeconds = 0;
+    totalPixels = 0;
+
+    for (const CorpusImage& image : corpus) {
+        BenchRowSink packedSink(WRITE_PACKED);
+        BmpDecoder bmpDecoder;
+        decodeImage(image.data, packedSink, bmpDecoder);
+        std::vector<uint8_t> frame = encodeFrame(packedSink.framebuffer());
+
+        BenchFrameSink sink;
+        FrameDecoder decoder;
+        if (!decodeFrame(frame, sink, decoder)) {
+            fprintf(stderr, "%s: frame decode failed (%s)\n", image.name.c_str(), frameErrorToString(decoder.error()));
+            return 1;
+        }
+        if (sink.checksum() != packedSink.checksum()) {
+            fprintf(stderr, "%s: frame checksum %08x doesn't match packed %08x\n", image.name.c_str(),
+                    sink.checksum(), packedSink.checksum());
+            return 1;
+        }
+        uint64_t pixels = (uint64_t)DISPLAY_WIDTH * DISPLAY_HEIGHT;
+
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; i++) {
+            decodeFrame(frame, sink, decoder);
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        printf("%-28s %-7s %10llu %10.2f %10.2f %10.1f   checksum %08x  %zu bytes (bmp %zu)\n", image.name.c_str(),
+               "frame", (unsigned long long)pixels, seconds * 1e3 / iterations, seconds * 1e9 / (pixels * iterations),
+               iterations / seconds, sink.checksum(), frame.size(), image.data.size());
+
+        totalSeconds += seconds;
+        totalPixels += pixels * iterations;
+    }
+
+    printf("%-28s %-7s %10s %10.2f %10.2f %10.1f\n", "corpus", "frame", "",
+           totalSeconds * 1e3 / (iterations * corpus.size()), totalSeconds * 1e9 / totalPixels,
+           iterations * corpus.size() / totalSeconds);
+
+    printf("arena peak: pipeline %zu of %zu bytes, dither errors %zu of %zu bytes\n", pipelineArena.peak(),
+           pipelineArena.capacity(), ditherArena.peak(), ditherArena.capacity());
+    return 0;
+}
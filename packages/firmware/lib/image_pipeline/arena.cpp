@@ -0,0 +1,55 @@
+#include "arena.h"
+
+#include <stdlib.h>
+
+Arena::Arena() : _memory(nullptr), _size(0), _used(0), _peak(0), _failures(0) {}
+
+void Arena::begin(void* memory, size_t size) {
+    _memory = (uint8_t*)memory;
+    _size = memory != nullptr ? size : 0;
+    _used = 0;
+    _peak = 0;
+    _failures = 0;
+}
+
+/**
+ * Bump the offset up to the alignment (a power of two) and hand out the block
+ */
+void* Arena::allocate(size_t size, size_t align) {
+    uintptr_t base = (uintptr_t)_memory;
+    uintptr_t start = (base + _used + align - 1) & ~(uintptr_t)(align - 1);
+    size_t offset = start - base;
+
+    if (_memory == nullptr || offset > _size || size > _size - offset) {
+        _failures++;
+        return nullptr;
+    }
+
+    _used = offset + size;
+    if (_used > _peak) {
+        _peak = _used;
+    }
+    return _memory + offset;
+}
+
+void Arena::reset() {
+    _used = 0;
+}
+
+void* arenaAllocate(Arena* arena, size_t size, size_t align) {
+    if (arena != nullptr) {
+        return arena->allocate(size, align);
+    }
+    // The heap only guarantees 4-byte alignment on the ESP32, so over-aligned
+    // requests go through aligned_alloc (size must be a multiple of align)
+    if (align > 4) {
+        return aligned_alloc(align, (size + align - 1) & ~(align - 1));
+    }
+    return malloc(size);
+}
+
+void arenaRelease(Arena* arena, void* memory) {
+    if (arena == nullptr) {
+        free(memory);
+    }
+}
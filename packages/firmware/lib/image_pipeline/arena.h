@@ -0,0 +1,46 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Bump allocator over one block of memory
+ * The pipeline's buffers (download ring, decoder rows, dither error rows, panel
+ * band) all live for exactly one image, so they are carved from an arena that is
+ * reset between images instead of being malloc'd and freed one by one. Nothing is
+ * freed individually; reset() drops every allocation at once.
+ */
+class Arena {
+public:
+    Arena();
+
+    // Serve allocations from memory (not owned by the arena)
+    void begin(void* memory, size_t size);
+
+    // Aligned block of at least size bytes, or nullptr when the arena is full
+    void* allocate(size_t size, size_t align = 4);
+
+    // Drop all allocations
+    void reset();
+
+    size_t capacity() const { return _size; }
+    size_t used() const { return _used; }
+    size_t peak() const { return _peak; }            // Highest use since begin()
+    uint32_t failures() const { return _failures; }  // Allocations that didn't fit
+
+private:
+    uint8_t* _memory;
+    size_t _size;
+    size_t _used;
+    size_t _peak;
+    uint32_t _failures;
+};
+
+// Allocate from arena, or from the heap when arena is nullptr
+void* arenaAllocate(Arena* arena, size_t size, size_t align = 4);
+
+// Release a block from arenaAllocate(); arena memory is only released by reset()
+void arenaRelease(Arena* arena, void* memory);
+
+#endif  // ARENA_H
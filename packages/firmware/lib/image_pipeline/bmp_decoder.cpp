@@ -0,0 +1,152 @@
+#include "bmp_decoder.h"
+
+#include <string.h>
+
+#include "config.h"
+
+// Largest accepted width/height - anything bigger can't be meant for the panel
+#define BMP_MAX_DIMENSION (DISPLAY_WIDTH * 2)
+
+static uint32_t readLE32(const uint8_t* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+BmpDecoder::BmpDecoder() : _arena(nullptr), _row(nullptr) {
+    begin(nullptr);
+}
+
+BmpDecoder::~BmpDecoder() {
+    end();
+}
+
+/**
+ * Reset the decoder for a new image
+ */
+void BmpDecoder::begin(BmpRowSink* sink, Arena* arena) {
+    end();
+    _sink = sink;
+    _arena = arena;
+    _format = IMAGE_FORMAT_UNKNOWN;
+    _error = BMP_OK;
+    memset(&_info, 0, sizeof(_info));
+    _headerParsed = false;
+    _headerBytes = 0;
+    _bytesConsumed = 0;
+    _rowBytes = 0;
+    _rowsDecoded = 0;
+}
+
+/**
+ * Feed the next chunk of the file
+ * Header bytes are collected first, then every complete row is passed to the sink
+ */
+void BmpDecoder::feed(const uint8_t* data, size_t length) {
+    while (length > 0 && _error == BMP_OK) {
+        size_t count;
+
+        if (_headerBytes < HEADER_SIZE) {
+            // Collect the file header
+            count = HEADER_SIZE - _headerBytes;
+            if (count > length) count = length;
+            memcpy(_header + _headerBytes, data, count);
+            _headerBytes += count;
+
+            if (_headerBytes == HEADER_SIZE) {
+                _error = parseHeader();
+            }
+        } else if (_bytesConsumed < _info.pixelDataOffset) {
+            // Skip extended header fields / color table up to the pixel data
+            count = _info.pixelDataOffset - _bytesConsumed;
+            if (count > length) count = length;
+        } else if (_rowsDecoded < _info.height) {
+            // Assemble the next row
+            count = _info.rowSize - _rowBytes;
+            if (count > length) count = length;
+            memcpy(_row + _rowBytes, data, count);
+            _rowBytes += count;
+
+            if (_rowBytes == _info.rowSize) {
+                // Top-down: first row in file is y=0 (top of image)
+                // Bottom-up (standard): first row in file is y=height-1 (bottom of image)
+                uint32_t y = _info.topDown ? _rowsDecoded : _info.height - 1 - _rowsDecoded;
+                _sink->writeRow(_row, y, _rowsDecoded);
+                _rowsDecoded++;
+                _rowBytes = 0;
+            }
+        } else {
+            // Trailing bytes after the last row are ignored
+            count = length;
+        }
+
+        _bytesConsumed += count;
+        data += count;
+        length -= count;
+    }
+}
+
+/**
+ * Release the row buffer
+ */
+void BmpDecoder::end() {
+    if (_row != nullptr) {
+        arenaRelease(_arena, _row);
+        _row = nullptr;
+    }
+}
+
+/**
+ * Parse the header once it has been received and prepare for row decoding
+ */
+BmpError BmpDecoder::parseHeader() {
+    // Check image format
+    _format = detectImageFormat(_header, _headerBytes);
+    if (_format != IMAGE_FORMAT_BMP) {
+        return BMP_ERROR_FORMAT;
+    }
+
+    _info.pixelDataOffset = readLE32(_header + 10);
+    _info.width = readLE32(_header + 18);
+
+    // Height can be negative in BMP (indicates top-down pixel order)
+    int32_t heightSigned = (int32_t)readLE32(_header + 22);
+    _info.topDown = heightSigned < 0;
+    _info.height = _info.topDown ? -heightSigned : heightSigned;
+
+    _info.bitsPerPixel = _header[28] | (_header[29] << 8);
+
+    if (_info.bitsPerPixel != 24) {
+        return BMP_ERROR_DEPTH;
+    }
+
+    if (_info.width == 0 || _info.height == 0 || _info.width > BMP_MAX_DIMENSION ||
+        _info.height > BMP_MAX_DIMENSION || _info.pixelDataOffset < HEADER_SIZE) {
+        return BMP_ERROR_HEADER;
+    }
+
+    // BMP rows are padded to 4-byte boundaries
+    _info.rowSize = ((_info.width * 3 + 3) / 4) * 4;
+
+    _row = (uint8_t*)arenaAllocate(_arena, _info.rowSize);
+    if (_row == nullptr) {
+        return BMP_ERROR_MEMORY;
+    }
+
+    if (!_sink->beginImage(_info)) {
+        return BMP_ERROR_REJECTED;
+    }
+
+    _headerParsed = true;
+    return BMP_OK;
+}
+
+const char* bmpErrorToString(BmpError error) {
+    switch (error) {
+        case BMP_OK: return "OK";
+        case BMP_ERROR_FORMAT: return "not a BMP file";
+        case BMP_ERROR_DEPTH: return "only 24-bit BMP supported";
+        case BMP_ERROR_HEADER: return "invalid BMP dimensions or pixel data offset";
+        case BMP_ERROR_MEMORY: return "failed to allocate row buffer";
+        case BMP_ERROR_REJECTED: return "image rejected by display";
+    }
+    return "unknown error";
+}
@@ -0,0 +1,94 @@
+#ifndef BMP_DECODER_H
+#define BMP_DECODER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "arena.h"
+#include "image_format.h"
+
+// Reasons a BMP stream can't be decoded
+enum BmpError {
+    BMP_OK,
+    BMP_ERROR_FORMAT,    // Not a BMP file (see BmpDecoder::format())
+    BMP_ERROR_DEPTH,     // Only 24-bit BMP is supported
+    BMP_ERROR_HEADER,    // Invalid dimensions or pixel data offset
+    BMP_ERROR_MEMORY,    // Row buffer allocation failed
+    BMP_ERROR_REJECTED,  // Row sink refused the image
+};
+
+// BMP header info
+struct BmpInfo {
+    uint32_t pixelDataOffset;
+    uint32_t width;
+    uint32_t height;
+    bool topDown;           // Height is negative in the file (rows stored top to bottom)
+    uint16_t bitsPerPixel;
+    uint32_t rowSize;       // Bytes per row including padding to a 4-byte boundary
+};
+
+/**
+ * Receives rows from BmpDecoder as soon as they are complete
+ */
+class BmpRowSink {
+public:
+    virtual ~BmpRowSink() {}
+
+    // Called once the header has been parsed - return false to abort decoding
+    virtual bool beginImage(const BmpInfo& info) = 0;
+
+    // Called for every row in file order
+    // y is the image row (0 = top), fileRow is the index of the row in the file
+    virtual void writeRow(const uint8_t* bgr, uint32_t y, uint32_t fileRow) = 0;
+};
+
+/**
+ * Streaming 24-bit BMP decoder
+ * Bytes can be fed in chunks of any size; only the header and a single padded
+ * row are buffered, so the image never has to be held in memory. The row comes
+ * from arena when one is given, otherwise from the heap
+ */
+class BmpDecoder {
+public:
+    static const size_t HEADER_SIZE = 54;  // BMP file header + BITMAPINFOHEADER
+
+    BmpDecoder();
+    ~BmpDecoder();
+
+    void begin(BmpRowSink* sink, Arena* arena = nullptr);
+    void feed(const uint8_t* data, size_t length);
+    void end();
+
+    ImageFormat format() const { return _format; }
+    BmpError error() const { return _error; }
+    bool failed() const { return _error != BMP_OK; }
+    bool complete() const { return _headerParsed && _rowsDecoded == _info.height; }
+
+    const BmpInfo& info() const { return _info; }
+    const uint8_t* header() const { return _header; }
+    size_t headerBytes() const { return _headerBytes; }
+    size_t bytesConsumed() const { return _bytesConsumed; }
+    uint32_t rowsDecoded() const { return _rowsDecoded; }
+
+private:
+    BmpError parseHeader();
+
+    BmpRowSink* _sink;
+    Arena* _arena;
+    ImageFormat _format;
+    BmpError _error;
+    BmpInfo _info;
+    bool _headerParsed;
+
+    uint8_t _header[HEADER_SIZE];
+    size_t _headerBytes;
+    size_t _bytesConsumed;
+
+    uint8_t* _row;
+    size_t _rowBytes;
+    uint32_t _rowsDecoded;
+};
+
+const char* bmpErrorToString(BmpError error);
+
+#endif  // BMP_DECODER_H
@@ -0,0 +1,82 @@
+#include "byte_ring.h"
+
+ByteRing::ByteRing() : _buffer(nullptr), _arena(nullptr), _capacity(0), _head(0), _tail(0), _closed(false) {}
+
+ByteRing::~ByteRing() {
+    end();
+}
+
+bool ByteRing::begin(size_t capacity, Arena* arena) {
+    end();
+
+    if (capacity == 0 || (capacity & (capacity - 1)) != 0) {
+        return false;
+    }
+
+    _buffer = (uint8_t*)arenaAllocate(arena, capacity);
+    if (_buffer == nullptr) {
+        return false;
+    }
+    _arena = arena;
+
+    _capacity = capacity;
+    reset();
+    return true;
+}
+
+void ByteRing::reset() {
+    _head.store(0);
+    _tail.store(0);
+    _closed.store(false);
+}
+
+void ByteRing::end() {
+    if (_buffer != nullptr) {
+        arenaRelease(_arena, _buffer);
+        _buffer = nullptr;
+        _arena = nullptr;
+    }
+    _capacity = 0;
+}
+
+uint8_t* ByteRing::writePointer(size_t* length) {
+    size_t head = _head.load(std::memory_order_relaxed);
+    size_t tail = _tail.load(std::memory_order_acquire);
+
+    size_t free = _capacity - (head - tail);
+    size_t offset = head & (_capacity - 1);
+    size_t untilWrap = _capacity - offset;
+
+    *length = free < untilWrap ? free : untilWrap;
+    return _buffer + offset;
+}
+
+void ByteRing::commit(size_t length) {
+    _head.store(_head.load(std::memory_order_relaxed) + length, std::memory_order_release);
+}
+
+void ByteRing::close() {
+    _closed.store(true, std::memory_order_release);
+}
+
+const uint8_t* ByteRing::readPointer(size_t* length) {
+    size_t tail = _tail.load(std::memory_order_relaxed);
+    size_t head = _head.load(std::memory_order_acquire);
+
+    size_t used = head - tail;
+    size_t offset = tail & (_capacity - 1);
+    size_t untilWrap = _capacity - offset;
+
+    *length = used < untilWrap ? used : untilWrap;
+    return _buffer + offset;
+}
+
+void ByteRing::consume(size_t length) {
+    _tail.store(_tail.load(std::memory_order_relaxed) + length, std::memory_order_release);
+}
+
+bool ByteRing::finished() const {
+    // Check closed before head so a final commit isn't missed
+    bool closed = _closed.load(std::memory_order_acquire);
+    return closed && _head.load(std::memory_order_acquire) == _tail.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,56 @@
+#ifndef BYTE_RING_H
+#define BYTE_RING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+
+#include "arena.h"
+
+/**
+ * Lock-free single-producer / single-consumer byte ring
+ *
+ * One task writes (e.g. the network reader) and another reads (the decoder),
+ * each on its own core. Both sides work on contiguous regions inside the ring
+ * so data is read from the socket and fed to the decoder without extra copies.
+ * Capacity must be a power of two. The buffer comes from arena when one is
+ * given, otherwise from the heap.
+ */
+class ByteRing {
+public:
+    ByteRing();
+    ~ByteRing();
+
+    bool begin(size_t capacity, Arena* arena = nullptr);
+    void end();
+
+    // Empty the ring and reopen it, keeping the buffer
+    void reset();
+
+    // Producer: contiguous free space, then commit what was written into it
+    uint8_t* writePointer(size_t* length);
+    void commit(size_t length);
+
+    // Producer: no more data will be written
+    void close();
+
+    // Consumer: contiguous readable data, then consume what was processed
+    const uint8_t* readPointer(size_t* length);
+    void consume(size_t length);
+
+    // Consumer: true once the producer has closed the ring and all data has been read
+    bool finished() const;
+
+    size_t capacity() const { return _capacity; }
+
+private:
+    uint8_t* _buffer;
+    Arena* _arena;
+    size_t _capacity;
+    std::atomic<size_t> _head;  // Total bytes written (producer owned)
+    std::atomic<size_t> _tail;  // Total bytes read (consumer owned)
+    std::atomic<bool> _closed;
+};
+
+#endif  // BYTE_RING_H
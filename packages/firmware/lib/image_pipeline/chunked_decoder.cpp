@@ -0,0 +1,120 @@
+#include "chunked_decoder.h"
+
+#include <string.h>
+
+// Longest chunk size accepted, in hex digits (sizes up to 256 MB)
+#define CHUNK_SIZE_MAX_DIGITS 7
+
+static int hexValue(uint8_t c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+ChunkedDecoder::ChunkedDecoder() {
+    begin();
+}
+
+/**
+ * Reset the decoder for a new response body
+ */
+void ChunkedDecoder::begin() {
+    _state = STATE_SIZE;
+    _remaining = 0;
+    _digits = 0;
+    _lineLength = 0;
+    _payloadBytes = 0;
+}
+
+/**
+ * Parse bytes in place; data[0..return value) holds the payload afterwards
+ * CRLF line ends are expected, a bare LF is accepted too
+ */
+size_t ChunkedDecoder::decode(uint8_t* data, size_t length) {
+    size_t out = 0;
+    size_t i = 0;
+
+    while (i < length && _state != STATE_DONE && _state != STATE_ERROR) {
+        uint8_t c = data[i];
+
+        switch (_state) {
+            case STATE_SIZE: {
+                int digit = hexValue(c);
+                if (digit >= 0 && _digits < CHUNK_SIZE_MAX_DIGITS) {
+                    _remaining = _remaining * 16 + digit;
+                    _digits++;
+                } else if (c == ';' || c == ' ' || c == '\t') {
+                    _state = STATE_EXTENSION;
+                } else if (c == '\n') {
+                    endSizeLine();
+                } else if (c != '\r') {
+                    _state = STATE_ERROR;
+                }
+                i++;
+                break;
+            }
+
+            case STATE_EXTENSION:
+                if (c == '\n') {
+                    endSizeLine();
+                }
+                i++;
+                break;
+
+            case STATE_DATA: {
+                size_t count = length - i < _remaining ? length - i : _remaining;
+                memmove(data + out, data + i, count);
+                out += count;
+                i += count;
+                _remaining -= count;
+                _payloadBytes += count;
+                if (_remaining == 0) {
+                    _state = STATE_DATA_END;
+                }
+                break;
+            }
+
+            case STATE_DATA_END:
+                if (c == '\n') {
+                    _state = STATE_SIZE;
+                    _digits = 0;
+                } else if (c != '\r') {
+                    _state = STATE_ERROR;
+                }
+                i++;
+                break;
+
+            case STATE_TRAILER:
+                if (c == '\n') {
+                    if (_lineLength == 0) {
+                        _state = STATE_DONE;
+                    }
+                    _lineLength = 0;
+                } else if (c != '\r') {
+                    _lineLength++;
+                }
+                i++;
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    return out;
+}
+
+/**
+ * A size line has ended: start the chunk, or the trailers after the last one
+ */
+void ChunkedDecoder::endSizeLine() {
+    if (_digits == 0) {
+        _state = STATE_ERROR;
+    } else if (_remaining == 0) {
+        _state = STATE_TRAILER;
+        _lineLength = 0;
+    } else {
+        _state = STATE_DATA;
+    }
+}
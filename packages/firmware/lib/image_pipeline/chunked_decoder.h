@@ -0,0 +1,50 @@
+#ifndef CHUNKED_DECODER_H
+#define CHUNKED_DECODER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Streaming decoder for HTTP/1.1 chunked transfer encoding
+ * Raw body bytes can be passed in pieces of any size; the chunk framing is
+ * stripped in place so the payload can go on to the image decoder without a
+ * second buffer. Chunk extensions and trailers are skipped.
+ */
+class ChunkedDecoder {
+public:
+    ChunkedDecoder();
+
+    void begin();
+
+    // Strip the framing from data, moving the payload to its start
+    // Returns the payload length; bytes after the last chunk are dropped
+    size_t decode(uint8_t* data, size_t length);
+
+    // The last (zero-length) chunk and the trailers have been received
+    bool finished() const { return _state == STATE_DONE; }
+    bool failed() const { return _state == STATE_ERROR; }
+
+    // Payload bytes decoded so far
+    size_t payloadBytes() const { return _payloadBytes; }
+
+private:
+    enum State {
+        STATE_SIZE,       // Hex chunk size
+        STATE_EXTENSION,  // ;name=value up to the end of the size line
+        STATE_DATA,       // Chunk payload
+        STATE_DATA_END,   // CRLF after the payload
+        STATE_TRAILER,    // Trailer lines after the last chunk, up to an empty line
+        STATE_DONE,
+        STATE_ERROR
+    };
+
+    void endSizeLine();
+
+    State _state;
+    size_t _remaining;  // Chunk size while parsing it, then payload bytes left in the chunk
+    uint8_t _digits;
+    size_t _lineLength;
+    size_t _payloadBytes;
+};
+
+#endif  // CHUNKED_DECODER_H
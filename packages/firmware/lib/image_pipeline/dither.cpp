@@ -0,0 +1,317 @@
+#include "dither.h"
+
+#include <string.h>
+
+#include "palette.h"
+
+static inline int16_t clampChannel(int16_t value) {
+    return value < 0 ? 0 : (value > 255 ? 255 : value);
+}
+
+// Next-row taps of the vector kernel: left neighbor, the pixel itself, right neighbor
+static const int16_t DIFFUSE_TAPS[3] = {1, 5, 3};
+
+#if DITHER_PIE
+
+/**
+ * errorIn = (left * 1 >> 4) + (mid * 5 >> 4) + (right * 3 >> 4), 8 pixels per step
+ * EE.VMUL.S16 shifts each product right by SAR, so every tap is rounded on its own
+ * exactly like the scalar kernel's accumulation. The sums stay far from saturating
+ */
+static void diffuseRow(int16_t* errorIn, const int16_t* left, const int16_t* mid, const int16_t* right,
+                       uint32_t blocks) {
+    if (blocks == 0) {
+        return;
+    }
+    asm volatile(
+        "ssai 4\n"
+        "ee.vldbc.16 q5, %[tapLeft]\n"
+        "ee.vldbc.16 q6, %[tapMid]\n"
+        "ee.vldbc.16 q7, %[tapRight]\n"
+        "1:\n"
+        "ee.vld.128.ip q0, %[left], 16\n"
+        "ee.vld.128.ip q1, %[mid], 16\n"
+        "ee.vld.128.ip q2, %[right], 16\n"
+        "ee.vmul.s16 q0, q0, q5\n"
+        "ee.vmul.s16 q1, q1, q6\n"
+        "ee.vmul.s16 q2, q2, q7\n"
+        "ee.vadds.s16 q0, q0, q1\n"
+        "ee.vadds.s16 q0, q0, q2\n"
+        "ee.vst.128.ip q0, %[out], 16\n"
+        "addi %[blocks], %[blocks], -1\n"
+        "bnez %[blocks], 1b\n"
+        : [left] "+r"(left), [mid] "+r"(mid), [right] "+r"(right), [out] "+r"(errorIn), [blocks] "+r"(blocks)
+        : [tapLeft] "r"(&DIFFUSE_TAPS[0]), [tapMid] "r"(&DIFFUSE_TAPS[1]), [tapRight] "r"(&DIFFUSE_TAPS[2])
+        : "sar", "memory");
+}
+
+#else
+
+// Lane model of the PIE instructions diffuseRow() uses: a q register holds
+// DITHER_LANES int16 lanes, and every step below is one instruction
+struct VectorQ {
+    int16_t lane[DITHER_LANES];
+};
+
+// ee.vld.128.ip
+static inline VectorQ vld128(const int16_t*& address) {
+    VectorQ q;
+    memcpy(q.lane, address, sizeof(q.lane));
+    address += DITHER_LANES;
+    return q;
+}
+
+// ee.vst.128.ip
+static inline void vst128(const VectorQ& q, int16_t*& address) {
+    memcpy(address, q.lane, sizeof(q.lane));
+    address += DITHER_LANES;
+}
+
+// ee.vldbc.16
+static inline VectorQ vldbc16(const int16_t* address) {
+    VectorQ q;
+    for (int i = 0; i < DITHER_LANES; i++) q.lane[i] = *address;
+    return q;
+}
+
+// ee.vmul.s16: product shifted right by SAR, low 16 bits kept
+static inline VectorQ vmulS16(const VectorQ& x, const VectorQ& y, uint8_t sar) {
+    VectorQ q;
+    for (int i = 0; i < DITHER_LANES; i++) q.lane[i] = (int16_t)(((int32_t)x.lane[i] * y.lane[i]) >> sar);
+    return q;
+}
+
+// ee.vadds.s16: saturating add
+static inline VectorQ vaddsS16(const VectorQ& x, const VectorQ& y) {
+    VectorQ q;
+    for (int i = 0; i < DITHER_LANES; i++) {
+        int32_t sum = (int32_t)x.lane[i] + y.lane[i];
+        q.lane[i] = (int16_t)(sum < INT16_MIN ? INT16_MIN : (sum > INT16_MAX ? INT16_MAX : sum));
+    }
+    return q;
+}
+
+static void diffuseRow(int16_t* errorIn, const int16_t* left, const int16_t* mid, const int16_t* right,
+                       uint32_t blocks) {
+    const uint8_t sar = 4;
+    VectorQ tapLeft = vldbc16(&DIFFUSE_TAPS[0]);
+    VectorQ tapMid = vldbc16(&DIFFUSE_TAPS[1]);
+    VectorQ tapRight = vldbc16(&DIFFUSE_TAPS[2]);
+
+    for (; blocks > 0; blocks--) {
+        VectorQ q0 = vld128(left);
+        VectorQ q1 = vld128(mid);
+        VectorQ q2 = vld128(right);
+        q0 = vmulS16(q0, tapLeft, sar);
+        q1 = vmulS16(q1, tapMid, sar);
+        q2 = vmulS16(q2, tapRight, sar);
+        q0 = vaddsS16(q0, q1);
+        q0 = vaddsS16(q0, q2);
+        vst128(q0, errorIn);
+    }
+}
+
+#endif  // DITHER_PIE
+
+FloydSteinbergDither::FloydSteinbergDither()
+    : _width(0),
+      _kernel(DITHER_KERNEL_DEFAULT),
+      _arena(nullptr),
+      _allocation(nullptr),
+      _error(nullptr),
+      _nextError(nullptr) {}
+
+FloydSteinbergDither::~FloydSteinbergDither() {
+    end();
+}
+
+/**
+ * Allocate and clear the error rows for an image of the given width
+ */
+bool FloydSteinbergDither::begin(uint32_t width, DitherKernel kernel, Arena* arena) {
+    end();
+
+    if (kernel == DITHER_KERNEL_VECTOR) {
+        // 12 rows (4 x 3 channels), each padded by a full vector on both sides so
+        // neighbor writes at -1 and width stay in bounds and every row is aligned
+        size_t blocks = (width + DITHER_LANES - 1) / DITHER_LANES;
+        size_t stride = (blocks + 2) * DITHER_LANES;
+        size_t bytes = stride * 12 * sizeof(int16_t);
+        _allocation = arenaAllocate(arena, bytes, 16);
+        if (_allocation == nullptr) {
+            return false;
+        }
+        memset(_allocation, 0, bytes);
+
+        int16_t* row = (int16_t*)_allocation + DITHER_LANES;
+        for (int c = 0; c < 3; c++) {
+            _errorIn[c] = row;
+            _errorLeft[c] = row + stride;
+            _errorMid[c] = row + stride * 2;
+            _errorRight[c] = row + stride * 3;
+            row += stride * 4;
+        }
+    } else {
+        // We need 2 rows for error propagation, padded by one pixel each side
+        size_t bytes = (width + 2) * 2 * sizeof(DitherError);
+        _allocation = arenaAllocate(arena, bytes);
+        if (_allocation == nullptr) {
+            return false;
+        }
+        memset(_allocation, 0, bytes);
+
+        _error = (DitherError*)_allocation;
+        _nextError = _error + width + 2;
+    }
+
+    _arena = arena;
+    _width = width;
+    _kernel = kernel;
+    return true;
+}
+
+void FloydSteinbergDither::end() {
+    if (_allocation != nullptr) {
+        arenaRelease(_arena, _allocation);
+        _allocation = nullptr;
+        _error = nullptr;
+        _nextError = nullptr;
+    }
+    _arena = nullptr;
+    _width = 0;
+}
+
+void FloydSteinbergDither::ditherRow(const uint8_t* bgr, uint8_t* indices) {
+    if (_kernel == DITHER_KERNEL_VECTOR) {
+        ditherRowVector(bgr, indices);
+    } else {
+        ditherRowScalar(bgr, indices);
+    }
+}
+
+/**
+ * Scalar reference kernel
+ */
+void FloydSteinbergDither::ditherRowScalar(const uint8_t* bgr, uint8_t* indices) {
+    // Swap error buffers for next row
+    DitherError* temp = _error;
+    _error = _nextError;
+    _nextError = temp;
+    memset(_nextError, 0, sizeof(DitherError) * (_width + 2));
+
+    DitherError* error = _error;
+    DitherError* nextError = _nextError;
+
+    for (uint32_t x = 0; x < _width; x++) {
+        // BMP stores as BGR
+        uint8_t b = bgr[x * 3];
+        uint8_t g = bgr[x * 3 + 1];
+        uint8_t r = bgr[x * 3 + 2];
+
+        // Apply error diffusion from previous pixels
+        const DitherError& in = error[x + 1];
+        int16_t newR = clampChannel((int16_t)r + in.r);
+        int16_t newG = clampChannel((int16_t)g + in.g);
+        int16_t newB = clampChannel((int16_t)b + in.b);
+
+        // Map to nearest 6-color palette (single table load)
+        const PaletteEntry& target = mapToPalette(newR, newG, newB);
+        indices[x] = target.index;
+
+        // Calculate error (Floyd-Steinberg dithering)
+        int16_t errR = newR - target.r;
+        int16_t errG = newG - target.g;
+        int16_t errB = newB - target.b;
+
+        // Distribute error to neighboring pixels:
+        //     X   7/16
+        // 3/16 5/16 1/16
+        DitherError& right = error[x + 2];
+        right.r += (errR * 7) >> 4;
+        right.g += (errG * 7) >> 4;
+        right.b += (errB * 7) >> 4;
+
+        DitherError& bottomLeft = nextError[x];
+        bottomLeft.r += (errR * 3) >> 4;
+        bottomLeft.g += (errG * 3) >> 4;
+        bottomLeft.b += (errB * 3) >> 4;
+
+        DitherError& bottom = nextError[x + 1];
+        bottom.r += (errR * 5) >> 4;
+        bottom.g += (errG * 5) >> 4;
+        bottom.b += (errB * 5) >> 4;
+
+        DitherError& bottomRight = nextError[x + 2];
+        bottomRight.r += errR >> 4;
+        bottomRight.g += errG >> 4;
+        bottomRight.b += errB >> 4;
+    }
+}
+
+/**
+ * Vector kernel
+ * The right-hand error is carried in a register and each pixel's error is stored
+ * once per neighbor; the next row's incoming error is then computed from those in
+ * one vector pass, replacing the clear and the per-pixel read-modify-writes.
+ * Quantization stays scalar: each pixel depends on the error of the one before.
+ */
+void FloydSteinbergDither::ditherRowVector(const uint8_t* bgr, uint8_t* indices) {
+    const int16_t* inR = _errorIn[0];
+    const int16_t* inG = _errorIn[1];
+    const int16_t* inB = _errorIn[2];
+    int16_t* leftR = _errorLeft[0];
+    int16_t* leftG = _errorLeft[1];
+    int16_t* leftB = _errorLeft[2];
+    int16_t* midR = _errorMid[0];
+    int16_t* midG = _errorMid[1];
+    int16_t* midB = _errorMid[2];
+    int16_t* rightR = _errorRight[0];
+    int16_t* rightG = _errorRight[1];
+    int16_t* rightB = _errorRight[2];
+
+    int16_t carryR = 0;
+    int16_t carryG = 0;
+    int16_t carryB = 0;
+
+    for (uint32_t x = 0; x < _width; x++) {
+        // BMP stores as BGR
+        uint8_t b = bgr[x * 3];
+        uint8_t g = bgr[x * 3 + 1];
+        uint8_t r = bgr[x * 3 + 2];
+
+        // Error from the row above plus 7/16 of the pixel to the left
+        int16_t newR = clampChannel((int16_t)r + (int16_t)(inR[x] + carryR));
+        int16_t newG = clampChannel((int16_t)g + (int16_t)(inG[x] + carryG));
+        int16_t newB = clampChannel((int16_t)b + (int16_t)(inB[x] + carryB));
+
+        const PaletteEntry& target = mapToPalette(newR, newG, newB);
+        indices[x] = target.index;
+
+        int16_t errR = newR - target.r;
+        int16_t errG = newG - target.g;
+        int16_t errB = newB - target.b;
+
+        carryR = (errR * 7) >> 4;
+        carryG = (errG * 7) >> 4;
+        carryB = (errB * 7) >> 4;
+
+        // Seen from pixel x+1 (its left neighbor), x itself and x-1 (its right neighbor)
+        leftR[x + 1] = errR;
+        midR[x] = errR;
+        rightR[(int32_t)x - 1] = errR;
+
+        leftG[x + 1] = errG;
+        midG[x] = errG;
+        rightG[(int32_t)x - 1] = errG;
+
+        leftB[x + 1] = errB;
+        midB[x] = errB;
+        rightB[(int32_t)x - 1] = errB;
+    }
+
+    // 3/16 5/16 1/16 below, gathered per pixel from its right, own and left errors
+    uint32_t blocks = (_width + DITHER_LANES - 1) / DITHER_LANES;
+    for (int c = 0; c < 3; c++) {
+        diffuseRow(_errorIn[c], _errorLeft[c], _errorMid[c], _errorRight[c], blocks);
+    }
+}
@@ -0,0 +1,86 @@
+#ifndef DITHER_H
+#define DITHER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "arena.h"
+
+#if __has_include(<sdkconfig.h>)
+#include <sdkconfig.h>
+#endif
+
+// The vector kernel uses the ESP32-S3's 128-bit PIE SIMD instructions. Elsewhere the
+// same instruction sequence runs on a lane model, so the host benchmark can check it
+// against the scalar reference (bench --verify)
+#if defined(CONFIG_IDF_TARGET_ESP32S3)
+#define DITHER_PIE 1
+#else
+#define DITHER_PIE 0
+#endif
+
+// Pixels per 128-bit vector of int16 lanes
+#define DITHER_LANES 8
+
+enum DitherKernel {
+    DITHER_KERNEL_SCALAR,  // Reference: error diffused pixel by pixel into both rows
+    DITHER_KERNEL_VECTOR   // Errors kept per pixel, next row computed 8 pixels at a time
+};
+
+#if DITHER_PIE
+#define DITHER_KERNEL_DEFAULT DITHER_KERNEL_VECTOR
+#else
+#define DITHER_KERNEL_DEFAULT DITHER_KERNEL_SCALAR
+#endif
+
+// Quantization error carried to one pixel, channels side by side so the scalar
+// kernel's read-modify-writes for a pixel hit one 6-byte slot instead of three rows
+struct DitherError {
+    int16_t r;
+    int16_t g;
+    int16_t b;
+};
+
+/**
+ * Floyd-Steinberg ditherer mapping 24-bit rows to the 6-color palette
+ * Rows are dithered one at a time in the order they are passed in; only the
+ * current and next error rows are kept. They are touched for every pixel, so on
+ * the device they come from an arena in internal SRAM (see PIPELINE_SRAM_ARENA_SIZE)
+ */
+class FloydSteinbergDither {
+public:
+    FloydSteinbergDither();
+    ~FloydSteinbergDither();
+
+    // Error rows come from arena when one is given, otherwise from the heap
+    bool begin(uint32_t width, DitherKernel kernel = DITHER_KERNEL_DEFAULT, Arena* arena = nullptr);
+    void end();
+
+    // Dither one BGR row, writing a palette index (COLOR_*) per pixel
+    // Both kernels produce identical indices
+    void ditherRow(const uint8_t* bgr, uint8_t* indices);
+
+private:
+    void ditherRowScalar(const uint8_t* bgr, uint8_t* indices);
+    void ditherRowVector(const uint8_t* bgr, uint8_t* indices);
+
+    uint32_t _width;
+    DitherKernel _kernel;
+    Arena* _arena;
+    void* _allocation;
+
+    // Scalar kernel: current and next error rows, padded by one pixel each side
+    DitherError* _error;
+    DitherError* _nextError;
+
+    // Vector kernel, per channel as each PIE lane holds one channel of one pixel
+    // (16-byte aligned, DITHER_LANES-padded): the error each pixel receives from the
+    // row above, and this row's quantization error of each pixel's left neighbor,
+    // itself and right neighbor
+    int16_t* _errorIn[3];
+    int16_t* _errorLeft[3];
+    int16_t* _errorMid[3];
+    int16_t* _errorRight[3];
+};
+
+#endif  // DITHER_H
@@ -0,0 +1,263 @@
+#include "frame_format.h"
+
+#include <string.h>
+
+#include "config.h"
+
+static_assert(FRAME_COLOR_KEEP >= PALETTE_SIZE && FRAME_COLOR_KEEP <= 7,
+              "FRAME_COLOR_KEEP must be a 3-bit token color outside the palette");
+
+// RLE token parser states
+enum {
+    TOKEN_START,    // Expecting a token byte
+    TOKEN_VARINT,   // Reading the extended run length
+    TOKEN_LITERAL,  // Reading packed literal pixels
+};
+
+static uint16_t readLE16(const uint8_t* p) {
+    return p[0] | (p[1] << 8);
+}
+
+static uint32_t readLE32(const uint8_t* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+FrameDecoder::FrameDecoder() : _arena(nullptr), _row(nullptr) {
+    begin(nullptr, 0, 0);
+}
+
+FrameDecoder::~FrameDecoder() {
+    end();
+}
+
+/**
+ * Reset the decoder for a new frame
+ */
+void FrameDecoder::begin(FrameRowSink* sink, uint16_t expectedWidth, uint16_t expectedHeight, Arena* arena) {
+    end();
+    _sink = sink;
+    _arena = arena;
+    _error = FRAME_OK;
+    memset(&_header, 0, sizeof(_header));
+    _headerParsed = false;
+    _expectedWidth = expectedWidth;
+    _expectedHeight = expectedHeight;
+    _headerFill = 0;
+    _bytesConsumed = 0;
+    _payloadBytes = 0;
+    _crc = 0;
+    _tokenState = TOKEN_START;
+    _runLength = 0;
+    _literalRemaining = 0;
+    _rowFill = 0;
+    _rowsDecoded = 0;
+}
+
+void FrameDecoder::feed(const uint8_t* data, size_t length) {
+    while (length > 0 && _error == FRAME_OK) {
+        size_t count;
+
+        if (_headerFill < FRAME_HEADER_SIZE) {
+            count = FRAME_HEADER_SIZE - _headerFill;
+            if (count > length) count = length;
+            memcpy(_headerBytes + _headerFill, data, count);
+            _headerFill += count;
+
+            if (_headerFill == FRAME_HEADER_SIZE) {
+                _error = parseHeader();
+            }
+        } else if (_payloadBytes < _header.payloadLength) {
+            count = _header.payloadLength - _payloadBytes;
+            if (count > length) count = length;
+            _crc = crc32Update(_crc, data, count);
+            decodePayload(data, count);
+            _payloadBytes += count;
+        } else {
+            // Trailing bytes after the payload are ignored
+            count = length;
+        }
+
+        _bytesConsumed += count;
+        data += count;
+        length -= count;
+    }
+}
+
+void FrameDecoder::end() {
+    if (_row != nullptr) {
+        arenaRelease(_arena, _row);
+        _row = nullptr;
+    }
+}
+
+FrameError FrameDecoder::finish() {
+    if (_error != FRAME_OK) {
+        return _error;
+    }
+    if (!complete()) {
+        _error = FRAME_ERROR_LENGTH;
+    } else if (_crc != _header.crc) {
+        _error = FRAME_ERROR_CRC;
+    }
+    return _error;
+}
+
+FrameError FrameDecoder::parseHeader() {
+    const uint8_t* h = _headerBytes;
+    if (h[0] != FRAME_MAGIC_0 || h[1] != FRAME_MAGIC_1 || h[2] != FRAME_MAGIC_2 || h[3] != FRAME_MAGIC_3) {
+        return FRAME_ERROR_FORMAT;
+    }
+
+    _header.version = h[4];
+    _header.flags = h[5];
+    _header.width = readLE16(h + 6);
+    _header.height = readLE16(h + 8);
+    _header.orientation = h[10];
+    _header.paletteVersion = h[11];
+    _header.payloadLength = readLE32(h + 12);
+    _header.crc = readLE32(h + 16);
+
+    if (_header.version != FRAME_VERSION || (_header.flags & ~(FRAME_FLAG_RLE | FRAME_FLAG_DELTA)) != 0) {
+        return FRAME_ERROR_FORMAT;
+    }
+    if (_header.width != _expectedWidth || _header.height != _expectedHeight) {
+        return FRAME_ERROR_SIZE;
+    }
+
+    _row = (uint8_t*)arenaAllocate(_arena, _header.width);
+    if (_row == nullptr) {
+        return FRAME_ERROR_MEMORY;
+    }
+
+    if (!_sink->beginFrame(_header)) {
+        return FRAME_ERROR_REJECTED;
+    }
+
+    _headerParsed = true;
+    return FRAME_OK;
+}
+
+void FrameDecoder::decodePayload(const uint8_t* data, size_t length) {
+    if ((_header.flags & FRAME_FLAG_RLE) == 0) {
+        // Raw packed indices
+        for (size_t i = 0; i < length && _error == FRAME_OK; i++) {
+            emitPixel(data[i] >> 4);
+            emitPixel(data[i] & 0x0F);
+        }
+        return;
+    }
+
+    for (size_t i = 0; i < length && _error == FRAME_OK; i++) {
+        uint8_t byte = data[i];
+
+        switch (_tokenState) {
+            case TOKEN_START:
+                if (byte & 0x80) {
+                    _literalRemaining = (byte & 0x7F) + 1;
+                    _tokenState = TOKEN_LITERAL;
+                } else if (((byte >> 3) & 0x0F) == 0x0F) {
+                    _runColor = byte & 0x07;
+                    _runLength = 0;
+                    _varintShift = 0;
+                    _tokenState = TOKEN_VARINT;
+                } else {
+                    emitPixels(byte & 0x07, ((byte >> 3) & 0x0F) + 1);
+                }
+                break;
+
+            case TOKEN_VARINT:
+                if (_varintShift > 21) {
+                    _error = FRAME_ERROR_DATA;
+                    break;
+                }
+                _runLength |= (uint32_t)(byte & 0x7F) << _varintShift;
+                _varintShift += 7;
+                if ((byte & 0x80) == 0) {
+                    emitPixels(_runColor, 16 + _runLength);
+                    _tokenState = TOKEN_START;
+                }
+                break;
+
+            case TOKEN_LITERAL:
+                emitPixel(byte >> 4);
+                if (--_literalRemaining > 0) {
+                    emitPixel(byte & 0x0F);
+                    _literalRemaining--;
+                }
+                if (_literalRemaining == 0) {
+                    _tokenState = TOKEN_START;
+                }
+                break;
+        }
+    }
+}
+
+void FrameDecoder::emitPixels(uint8_t color, uint32_t count) {
+    if (color >= PALETTE_SIZE && !(color == FRAME_COLOR_KEEP && (_header.flags & FRAME_FLAG_DELTA))) {
+        _error = FRAME_ERROR_DATA;
+        return;
+    }
+
+    while (count > 0 && _error == FRAME_OK) {
+        if (_rowsDecoded >= _header.height) {
+            _error = FRAME_ERROR_DATA;
+            return;
+        }
+
+        uint32_t span = _header.width - _rowFill;
+        if (span > count) span = count;
+        memset(_row + _rowFill, color, span);
+        _rowFill += span;
+        count -= span;
+
+        if (_rowFill == _header.width) {
+            _sink->writeFrameRow(_row, _rowsDecoded);
+            _rowsDecoded++;
+            _rowFill = 0;
+        }
+    }
+}
+
+void FrameDecoder::emitPixel(uint8_t color) {
+    // Padding nibble after the last pixel of an odd-sized raw frame
+    if (_rowsDecoded == _header.height && (_header.flags & FRAME_FLAG_RLE) == 0) {
+        return;
+    }
+    emitPixels(color, 1);
+}
+
+uint32_t crc32Update(uint32_t crc, const uint8_t* data, size_t length) {
+    static uint32_t table[256];
+    static bool tableReady = false;
+
+    if (!tableReady) {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            table[i] = c;
+        }
+        tableReady = true;
+    }
+
+    crc = ~crc;
+    for (size_t i = 0; i < length; i++) {
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+const char* frameErrorToString(FrameError error) {
+    switch (error) {
+        case FRAME_OK: return "OK";
+        case FRAME_ERROR_FORMAT: return "not a supported frame";
+        case FRAME_ERROR_SIZE: return "frame size doesn't match the display";
+        case FRAME_ERROR_DATA: return "corrupt frame data";
+        case FRAME_ERROR_LENGTH: return "frame incomplete";
+        case FRAME_ERROR_CRC: return "frame checksum mismatch";
+        case FRAME_ERROR_MEMORY: return "failed to allocate row buffer";
+        case FRAME_ERROR_REJECTED: return "frame rejected by display";
+    }
+    return "unknown error";
+}
@@ -0,0 +1,158 @@
+#ifndef FRAME_FORMAT_H
+#define FRAME_FORMAT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "arena.h"
+
+/*
+ * Pre-quantized panel frame (.e6f)
+ *
+ * Produced by the service (packages/service/src/services/frame-encoder.ts) so the
+ * device can copy palette indices straight into the panel buffer without dithering.
+ *
+ * Header (20 bytes, little-endian):
+ *   0  char[4] magic "E6FR"
+ *   4  u8      format version (FRAME_VERSION)
+ *   5  u8      flags (FRAME_FLAG_*)
+ *   6  u16     width  (panel orientation)
+ *   8  u16     height (panel orientation)
+ *   10 u8      orientation - quarter turns clockwise the encoder applied to the source image
+ *   11 u8      palette version (FRAME_PALETTE_VERSION)
+ *   12 u32     payload length in bytes
+ *   16 u32     CRC-32 (IEEE) of the payload
+ *
+ * Payload: palette indices (COLOR_*) in panel raster order, either packed two per
+ * byte (high nibble first) or, with FRAME_FLAG_RLE, as a sequence of tokens:
+ *   0CCCCPPP  run of color PPP: CCCC < 15 -> CCCC + 1 pixels,
+ *             CCCC == 15 -> 16 + following LEB128 varint pixels
+ *   1NNNNNNN  literal of NNNNNNN + 1 pixels, followed by the pixels packed two per byte
+ * Runs and literals may cross row boundaries.
+ *
+ * Delta frames (FRAME_FLAG_DELTA) patch the frame the device already holds: the
+ * payload is coded the same way, but FRAME_COLOR_KEEP marks pixels that stay as
+ * they are in the base frame, so unchanged stretches collapse into long runs.
+ * The base is agreed over HTTP (X-Frame-Base, see the service README); rows are
+ * still delivered whole, with FRAME_COLOR_KEEP for the pixels to leave alone.
+ */
+
+#define FRAME_MAGIC_0 'E'
+#define FRAME_MAGIC_1 '6'
+#define FRAME_MAGIC_2 'F'
+#define FRAME_MAGIC_3 'R'
+#define FRAME_HEADER_SIZE 20
+#define FRAME_VERSION 1
+#define FRAME_PALETTE_VERSION 1
+
+#define FRAME_FLAG_RLE 0x01
+#define FRAME_FLAG_DELTA 0x02
+
+// Pixel index in a delta frame for "unchanged from the base frame"
+#define FRAME_COLOR_KEEP 7
+
+struct FrameHeader {
+    uint8_t version;
+    uint8_t flags;
+    uint16_t width;
+    uint16_t height;
+    uint8_t orientation;
+    uint8_t paletteVersion;
+    uint32_t payloadLength;
+    uint32_t crc;
+};
+
+// Reasons a frame can't be decoded
+enum FrameError {
+    FRAME_OK,
+    FRAME_ERROR_FORMAT,    // Bad magic or unsupported version/flags
+    FRAME_ERROR_SIZE,      // Dimensions don't match the panel
+    FRAME_ERROR_DATA,      // Invalid token or too many pixels
+    FRAME_ERROR_LENGTH,    // Payload ended before the frame was complete
+    FRAME_ERROR_CRC,       // Payload checksum mismatch
+    FRAME_ERROR_MEMORY,    // Row buffer allocation failed
+    FRAME_ERROR_REJECTED,  // Row sink refused the frame
+};
+
+/**
+ * Receives complete panel rows of palette indices from FrameDecoder
+ */
+class FrameRowSink {
+public:
+    virtual ~FrameRowSink() {}
+
+    // Called once the header has been parsed - return false to abort decoding
+    virtual bool beginFrame(const FrameHeader& header) = 0;
+
+    // Called for every panel row, top to bottom; rows of a delta frame hold
+    // FRAME_COLOR_KEEP for the pixels that don't change
+    virtual void writeFrameRow(const uint8_t* indices, uint32_t y) = 0;
+};
+
+/**
+ * Streaming frame decoder
+ * Bytes can be fed in chunks of any size; only the header and one row of
+ * palette indices are buffered. The row comes from arena when one is given,
+ * otherwise from the heap
+ */
+class FrameDecoder {
+public:
+    FrameDecoder();
+    ~FrameDecoder();
+
+    // The frame must be expectedWidth x expectedHeight (the panel size)
+    void begin(FrameRowSink* sink, uint16_t expectedWidth, uint16_t expectedHeight, Arena* arena = nullptr);
+    void feed(const uint8_t* data, size_t length);
+    void end();
+
+    // Check the payload length and CRC once all data has been fed
+    FrameError finish();
+
+    FrameError error() const { return _error; }
+    bool failed() const { return _error != FRAME_OK; }
+    bool complete() const { return _headerParsed && _rowsDecoded == _header.height && _payloadBytes == _header.payloadLength; }
+
+    const FrameHeader& header() const { return _header; }
+    size_t bytesConsumed() const { return _bytesConsumed; }
+    uint32_t rowsDecoded() const { return _rowsDecoded; }
+
+private:
+    FrameError parseHeader();
+    void decodePayload(const uint8_t* data, size_t length);
+    void emitPixels(uint8_t color, uint32_t count);
+    void emitPixel(uint8_t color);
+
+    FrameRowSink* _sink;
+    Arena* _arena;
+    FrameError _error;
+    FrameHeader _header;
+    bool _headerParsed;
+    uint16_t _expectedWidth;
+    uint16_t _expectedHeight;
+
+    uint8_t _headerBytes[FRAME_HEADER_SIZE];
+    size_t _headerFill;
+    size_t _bytesConsumed;
+    size_t _payloadBytes;
+    uint32_t _crc;
+
+    // RLE token state carried across chunks
+    uint8_t _tokenState;
+    uint8_t _runColor;
+    uint32_t _runLength;
+    uint8_t _varintShift;
+    uint32_t _literalRemaining;
+
+    uint8_t* _row;
+    uint32_t _rowFill;
+    uint32_t _rowsDecoded;
+};
+
+/**
+ * Update a running CRC-32 (IEEE 802.3) - start with crc = 0
+ */
+uint32_t crc32Update(uint32_t crc, const uint8_t* data, size_t length);
+
+const char* frameErrorToString(FrameError error);
+
+#endif  // FRAME_FORMAT_H
@@ -0,0 +1,46 @@
+#include "frame_hash.h"
+
+#include <string.h>
+
+// FNV-1a, applied to 32-bit words - the framebuffer is hashed on every
+// refresh so it's mixed a word at a time rather than a byte at a time
+static const uint32_t FNV_OFFSET = 2166136261u;
+static const uint32_t FNV_PRIME = 16777619u;
+
+static uint32_t hashBytes(uint32_t hash, const uint8_t* data, size_t length) {
+    size_t words = length / 4;
+    for (size_t i = 0; i < words; i++) {
+        uint32_t word;
+        memcpy(&word, data + i * 4, 4);
+        hash = (hash ^ word) * FNV_PRIME;
+    }
+    for (size_t i = words * 4; i < length; i++) {
+        hash = (hash ^ data[i]) * FNV_PRIME;
+    }
+    return hash;
+}
+
+void hashFramebuffer(const uint8_t* framebuffer, uint32_t stride, uint32_t height, FrameHash* hash) {
+    hash->frame = FNV_OFFSET;
+    for (uint32_t band = 0; band < FRAME_HASH_BANDS; band++) {
+        uint32_t start = bandStart(band, height);
+        uint32_t end = bandStart(band + 1, height);
+
+        hash->bands[band] = hashBytes(FNV_OFFSET, framebuffer + (size_t)start * stride, (size_t)(end - start) * stride);
+        hash->frame = (hash->frame ^ hash->bands[band]) * FNV_PRIME;
+    }
+}
+
+uint32_t changedBands(const FrameHash& a, const FrameHash& b) {
+    uint32_t mask = 0;
+    for (uint32_t band = 0; band < FRAME_HASH_BANDS; band++) {
+        if (a.bands[band] != b.bands[band]) {
+            mask |= 1u << band;
+        }
+    }
+    return mask;
+}
+
+uint32_t bandStart(uint32_t band, uint32_t height) {
+    return band * height / FRAME_HASH_BANDS;
+}
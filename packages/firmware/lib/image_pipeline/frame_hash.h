@@ -0,0 +1,37 @@
+#ifndef FRAME_HASH_H
+#define FRAME_HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Horizontal bands the panel is split into for change reporting
+#define FRAME_HASH_BANDS 16
+
+/**
+ * Content hash of a packed panel framebuffer
+ *
+ * The framebuffer holds the final quantized palette indices, so two downloads
+ * that render to the same pixels hash the same even if the files differ.
+ * One hash per band shows which part of the panel changed.
+ */
+struct FrameHash {
+    uint32_t frame;
+    uint32_t bands[FRAME_HASH_BANDS];
+};
+
+/**
+ * Hash a framebuffer of height rows, stride bytes each
+ */
+void hashFramebuffer(const uint8_t* framebuffer, uint32_t stride, uint32_t height, FrameHash* hash);
+
+/**
+ * Bit n is set when band n differs between the two hashes
+ */
+uint32_t changedBands(const FrameHash& a, const FrameHash& b);
+
+/**
+ * First panel row of a band (bands cover rows [bandStart(n), bandStart(n + 1)))
+ */
+uint32_t bandStart(uint32_t band, uint32_t height);
+
+#endif  // FRAME_HASH_H
@@ -0,0 +1,17 @@
+#include "image_format.h"
+
+#include "frame_format.h"
+
+ImageFormat detectImageFormat(const uint8_t* data, size_t length) {
+    if (length >= 4 && data[0] == FRAME_MAGIC_0 && data[1] == FRAME_MAGIC_1 && data[2] == FRAME_MAGIC_2 &&
+        data[3] == FRAME_MAGIC_3) {
+        return IMAGE_FORMAT_FRAME;
+    }
+    if (length >= 4 && data[0] == 0x89 && data[1] == 'P' && data[2] == 'N' && data[3] == 'G') {
+        return IMAGE_FORMAT_PNG;
+    }
+    if (length >= 2 && data[0] == 'B' && data[1] == 'M') {
+        return IMAGE_FORMAT_BMP;
+    }
+    return IMAGE_FORMAT_UNKNOWN;
+}
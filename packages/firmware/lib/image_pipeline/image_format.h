@@ -0,0 +1,23 @@
+#ifndef IMAGE_FORMAT_H
+#define IMAGE_FORMAT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Detected format of a streamed image
+enum ImageFormat {
+    IMAGE_FORMAT_UNKNOWN,
+    IMAGE_FORMAT_BMP,    // 24-bit BMP, dithered on the device
+    IMAGE_FORMAT_PNG,    // Not supported, detected to report a useful error
+    IMAGE_FORMAT_FRAME,  // Pre-quantized panel frame (see frame_format.h)
+};
+
+// Bytes needed to tell the formats apart
+#define IMAGE_FORMAT_SNIFF_SIZE 4
+
+/**
+ * Detect the image format from the first IMAGE_FORMAT_SNIFF_SIZE bytes
+ */
+ImageFormat detectImageFormat(const uint8_t* data, size_t length);
+
+#endif  // IMAGE_FORMAT_H
@@ -0,0 +1,405 @@
+#include "inflater.h"
+
+#include <string.h>
+#include <strings.h>
+
+#include "frame_format.h"
+
+// gzip header flags (RFC 1952)
+#define GZIP_FLAG_HEADER_CRC 0x02
+#define GZIP_FLAG_EXTRA 0x04
+#define GZIP_FLAG_NAME 0x08
+#define GZIP_FLAG_COMMENT 0x10
+#define GZIP_FLAG_RESERVED 0xE0
+
+// Adler-32 modulus, and the most bytes that can be summed before reducing
+#define ADLER_MOD 65521
+#define ADLER_BLOCK 5552
+
+ContentEncoding parseContentEncoding(const char* value) {
+    while (*value == ' ') value++;
+    if (*value == '\0' || strcasecmp(value, "identity") == 0) {
+        return CONTENT_ENCODING_IDENTITY;
+    }
+    if (strcasecmp(value, "gzip") == 0 || strcasecmp(value, "x-gzip") == 0) {
+        return CONTENT_ENCODING_GZIP;
+    }
+    if (strcasecmp(value, "deflate") == 0) {
+        return CONTENT_ENCODING_DEFLATE;
+    }
+    return CONTENT_ENCODING_UNSUPPORTED;
+}
+
+#if !INFLATE_ROM
+// zlib's state comes from the same arena as the window
+static voidpf zlibAllocate(voidpf opaque, uInt items, uInt size) {
+    return arenaAllocate((Arena*)opaque, (size_t)items * size, 8);
+}
+
+static void zlibRelease(voidpf opaque, voidpf address) {
+    arenaRelease((Arena*)opaque, address);
+}
+#endif
+
+StreamInflater::StreamInflater()
+    : _sink(nullptr),
+      _arena(nullptr),
+      _encoding(CONTENT_ENCODING_IDENTITY),
+      _state(STATE_DONE),
+      _error(INFLATE_OK),
+      _bytesIn(0),
+      _bytesOut(0),
+      _window(nullptr)
+#if INFLATE_ROM
+      ,
+      _tinfl(nullptr)
+#else
+      ,
+      _zstreamReady(false)
+#endif
+{
+}
+
+StreamInflater::~StreamInflater() {
+    end();
+}
+
+/**
+ * Allocate the window and decompressor and get ready for a new body
+ */
+bool StreamInflater::begin(ContentEncoding encoding, ByteSink* sink, Arena* arena) {
+    end();
+
+    _sink = sink;
+    _arena = arena;
+    _encoding = encoding;
+    _error = INFLATE_OK;
+    _headerFill = 0;
+    _gzipFlags = 0;
+    _skip = 0;
+    _trailerFill = 0;
+    _trailerSize = 0;
+    _crc = 0;
+    _adlerA = 1;
+    _adlerB = 0;
+    _bytesIn = 0;
+    _bytesOut = 0;
+
+    if (encoding == CONTENT_ENCODING_GZIP) {
+        _state = STATE_GZIP_HEADER;
+    } else if (encoding == CONTENT_ENCODING_DEFLATE) {
+        _state = STATE_ZLIB_HEADER;
+    } else {
+        _state = STATE_DONE;
+        _error = INFLATE_ERROR_HEADER;
+        return false;
+    }
+
+    _window = (uint8_t*)arenaAllocate(arena, INFLATE_WINDOW_SIZE);
+#if INFLATE_ROM
+    _tinfl = (tinfl_decompressor*)arenaAllocate(arena, sizeof(tinfl_decompressor), 8);
+    if (_window == nullptr || _tinfl == nullptr) {
+        _error = INFLATE_ERROR_MEMORY;
+        return false;
+    }
+    tinfl_init(_tinfl);
+    _windowPos = 0;
+#else
+    memset(&_zstream, 0, sizeof(_zstream));
+    _zstream.zalloc = zlibAllocate;
+    _zstream.zfree = zlibRelease;
+    _zstream.opaque = arena;
+    if (_window == nullptr || inflateInit2(&_zstream, -15) != Z_OK) {
+        _error = INFLATE_ERROR_MEMORY;
+        return false;
+    }
+    _zstreamReady = true;
+#endif
+    return true;
+}
+
+void StreamInflater::end() {
+#if INFLATE_ROM
+    if (_tinfl != nullptr) {
+        arenaRelease(_arena, _tinfl);
+        _tinfl = nullptr;
+    }
+#else
+    if (_zstreamReady) {
+        inflateEnd(&_zstream);
+        _zstreamReady = false;
+    }
+#endif
+    if (_window != nullptr) {
+        arenaRelease(_arena, _window);
+        _window = nullptr;
+    }
+}
+
+/**
+ * Feed the next chunk of the compressed body
+ * Header bytes are parsed first, then the deflate data is inflated into the sink,
+ * then the trailer is checked. Bytes after the trailer are ignored.
+ */
+void StreamInflater::feed(const uint8_t* data, size_t length) {
+    while (length > 0 && _error == INFLATE_OK && _state != STATE_DONE) {
+        size_t count;
+        if (_state == STATE_DATA) {
+            count = inflateData(data, length);
+        } else if (_state == STATE_TRAILER) {
+            count = parseTrailer(data, length);
+        } else {
+            count = parseHeader(data, length);
+        }
+
+        _bytesIn += count;
+        data += count;
+        length -= count;
+    }
+}
+
+/**
+ * Move on to the next optional gzip header field, or the deflate data
+ */
+void StreamInflater::nextGzipField() {
+    _headerFill = 0;
+    if (_gzipFlags & GZIP_FLAG_EXTRA) {
+        _gzipFlags &= ~GZIP_FLAG_EXTRA;
+        _state = STATE_GZIP_EXTRA_LENGTH;
+    } else if (_gzipFlags & GZIP_FLAG_NAME) {
+        _gzipFlags &= ~GZIP_FLAG_NAME;
+        _state = STATE_GZIP_NAME;
+    } else if (_gzipFlags & GZIP_FLAG_COMMENT) {
+        _gzipFlags &= ~GZIP_FLAG_COMMENT;
+        _state = STATE_GZIP_COMMENT;
+    } else if (_gzipFlags & GZIP_FLAG_HEADER_CRC) {
+        _gzipFlags &= ~GZIP_FLAG_HEADER_CRC;
+        _skip = 2;
+        _state = STATE_GZIP_HEADER_CRC;
+    } else {
+        _trailerSize = 8;
+        _state = STATE_DATA;
+    }
+}
+
+/**
+ * Parse the gzip header or zlib wrapper, returning the bytes consumed
+ */
+size_t StreamInflater::parseHeader(const uint8_t* data, size_t length) {
+    switch (_state) {
+        case STATE_GZIP_HEADER:
+        case STATE_GZIP_EXTRA_LENGTH:
+        case STATE_ZLIB_HEADER: {
+            size_t size = _state == STATE_GZIP_HEADER ? 10 : 2;
+            size_t count = size - _headerFill < length ? size - _headerFill : length;
+            memcpy(_header + _headerFill, data, count);
+            _headerFill += count;
+            if (_headerFill < size) {
+                return count;
+            }
+
+            if (_state == STATE_GZIP_HEADER) {
+                // ID1 ID2 CM FLG MTIME(4) XFL OS
+                if (_header[0] != 0x1f || _header[1] != 0x8b || _header[2] != 8 ||
+                    (_header[3] & GZIP_FLAG_RESERVED) != 0) {
+                    _error = INFLATE_ERROR_HEADER;
+                    return count;
+                }
+                _gzipFlags = _header[3];
+                nextGzipField();
+            } else if (_state == STATE_GZIP_EXTRA_LENGTH) {
+                _skip = _header[0] | (_header[1] << 8);
+                _state = STATE_GZIP_EXTRA;
+            } else {
+                // CMF FLG: deflate, window up to 32K, header check, no preset dictionary
+                uint8_t cmf = _header[0];
+                uint8_t flg = _header[1];
+                bool zlib = (cmf & 0x0F) == 8 && (cmf >> 4) <= 7 && ((cmf << 8) | flg) % 31 == 0;
+                if (zlib && (flg & 0x20) != 0) {
+                    _error = INFLATE_ERROR_HEADER;
+                    return count;
+                }
+
+                _state = STATE_DATA;
+                if (zlib) {
+                    _trailerSize = 4;
+                } else {
+                    // Raw deflate without a wrapper - the two bytes were already data
+                    _trailerSize = 0;
+                    inflateData(_header, 2);
+                }
+            }
+            return count;
+        }
+
+        case STATE_GZIP_EXTRA:
+        case STATE_GZIP_HEADER_CRC: {
+            size_t count = _skip < length ? _skip : length;
+            _skip -= count;
+            if (_skip == 0) {
+                nextGzipField();
+            }
+            return count;
+        }
+
+        case STATE_GZIP_NAME:
+        case STATE_GZIP_COMMENT: {
+            // Zero-terminated
+            const uint8_t* end = (const uint8_t*)memchr(data, 0, length);
+            if (end == nullptr) {
+                return length;
+            }
+            nextGzipField();
+            return end - data + 1;
+        }
+
+        default:
+            return length;
+    }
+}
+
+#if INFLATE_ROM
+
+/**
+ * Inflate into the window with the ROM tinfl, returning the input consumed
+ * tinfl writes straight into the window ring and refers back into it for matches
+ */
+size_t StreamInflater::inflateData(const uint8_t* data, size_t length) {
+    size_t consumed = 0;
+
+    for (;;) {
+        size_t inSize = length - consumed;
+        size_t outSize = INFLATE_WINDOW_SIZE - _windowPos;
+        tinfl_status status = tinfl_decompress(_tinfl, data + consumed, &inSize, _window, _window + _windowPos,
+                                               &outSize, TINFL_FLAG_HAS_MORE_INPUT);
+        consumed += inSize;
+
+        output(_window + _windowPos, outSize);
+        _windowPos = (_windowPos + outSize) & (INFLATE_WINDOW_SIZE - 1);
+
+        if (status == TINFL_STATUS_DONE) {
+            _state = _trailerSize > 0 ? STATE_TRAILER : STATE_DONE;
+            break;
+        }
+        if (status < 0) {
+            _error = INFLATE_ERROR_DATA;
+            break;
+        }
+        if (status != TINFL_STATUS_HAS_MORE_OUTPUT) {
+            // All input taken; the rest of the output needs more of it
+            break;
+        }
+    }
+    return consumed;
+}
+
+#else
+
+/**
+ * Inflate with zlib (host builds), returning the input consumed
+ * zlib keeps its own window, so _window is only the output buffer here
+ */
+size_t StreamInflater::inflateData(const uint8_t* data, size_t length) {
+    _zstream.next_in = (Bytef*)data;
+    _zstream.avail_in = length;
+
+    for (;;) {
+        _zstream.next_out = _window;
+        _zstream.avail_out = INFLATE_WINDOW_SIZE;
+        int status = inflate(&_zstream, Z_NO_FLUSH);
+
+        size_t produced = INFLATE_WINDOW_SIZE - _zstream.avail_out;
+        output(_window, produced);
+
+        if (status == Z_STREAM_END) {
+            _state = _trailerSize > 0 ? STATE_TRAILER : STATE_DONE;
+            break;
+        }
+        if (status != Z_OK && status != Z_BUF_ERROR) {
+            _error = INFLATE_ERROR_DATA;
+            break;
+        }
+        if (_zstream.avail_out != 0 || produced == 0) {
+            // All input taken; the rest of the output needs more of it
+            break;
+        }
+    }
+    return length - _zstream.avail_in;
+}
+
+#endif  // INFLATE_ROM
+
+/**
+ * Check the gzip CRC-32 and length, or the zlib Adler-32
+ */
+size_t StreamInflater::parseTrailer(const uint8_t* data, size_t length) {
+    size_t count = _trailerSize - _trailerFill < length ? _trailerSize - _trailerFill : length;
+    memcpy(_trailer + _trailerFill, data, count);
+    _trailerFill += count;
+    if (_trailerFill < _trailerSize) {
+        return count;
+    }
+
+    bool match;
+    if (_encoding == CONTENT_ENCODING_GZIP) {
+        uint32_t crc = _trailer[0] | (_trailer[1] << 8) | (_trailer[2] << 16) | ((uint32_t)_trailer[3] << 24);
+        uint32_t size = _trailer[4] | (_trailer[5] << 8) | (_trailer[6] << 16) | ((uint32_t)_trailer[7] << 24);
+        match = crc == _crc && size == (uint32_t)_bytesOut;
+    } else {
+        uint32_t adler = ((uint32_t)_trailer[0] << 24) | (_trailer[1] << 16) | (_trailer[2] << 8) | _trailer[3];
+        match = adler == ((_adlerB << 16) | _adlerA);
+    }
+
+    if (match) {
+        _state = STATE_DONE;
+    } else {
+        _error = INFLATE_ERROR_CHECKSUM;
+    }
+    return count;
+}
+
+/**
+ * Pass inflated bytes on, keeping the checksum the trailer is checked against
+ */
+void StreamInflater::output(const uint8_t* data, size_t length) {
+    if (length == 0) {
+        return;
+    }
+
+    if (_encoding == CONTENT_ENCODING_GZIP) {
+        _crc = crc32Update(_crc, data, length);
+    } else {
+        const uint8_t* p = data;
+        size_t remaining = length;
+        while (remaining > 0) {
+            size_t block = remaining < ADLER_BLOCK ? remaining : ADLER_BLOCK;
+            remaining -= block;
+            while (block-- > 0) {
+                _adlerA += *p++;
+                _adlerB += _adlerA;
+            }
+            _adlerA %= ADLER_MOD;
+            _adlerB %= ADLER_MOD;
+        }
+    }
+
+    _bytesOut += length;
+    _sink->write(data, length);
+}
+
+const char* inflateErrorToString(InflateError error) {
+    switch (error) {
+        case INFLATE_OK:
+            return "OK";
+        case INFLATE_ERROR_HEADER:
+            return "Not a supported gzip/deflate stream";
+        case INFLATE_ERROR_DATA:
+            return "Corrupt compressed data";
+        case INFLATE_ERROR_CHECKSUM:
+            return "Checksum mismatch";
+        case INFLATE_ERROR_MEMORY:
+            return "Out of memory";
+        default:
+            return "Unknown error";
+    }
+}
@@ -0,0 +1,141 @@
+#ifndef INFLATER_H
+#define INFLATER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "arena.h"
+
+#if __has_include(<sdkconfig.h>)
+#include <sdkconfig.h>
+#endif
+
+// On the ESP32 the inflater is the miniz tinfl that ships in ROM. Elsewhere zlib's
+// raw inflate stands in for it, so the host benchmark can run compressed images
+// through the same wrapper parsing and checks (link with -lz)
+#if defined(ESP_PLATFORM)
+#define INFLATE_ROM 1
+#else
+#define INFLATE_ROM 0
+#endif
+
+#if INFLATE_ROM && defined(CONFIG_IDF_TARGET_ESP32S3)
+#include <esp32s3/rom/miniz.h>
+#elif INFLATE_ROM
+#include <esp32/rom/miniz.h>
+#else
+#include <zlib.h>
+#endif
+
+// Largest distance a deflate match can reach back, and so the output window needed
+#define INFLATE_WINDOW_SIZE 32768
+
+// HTTP Content-Encoding of a response body
+enum ContentEncoding {
+    CONTENT_ENCODING_IDENTITY,
+    CONTENT_ENCODING_GZIP,     // RFC 1952: header, deflate data, CRC-32 and length
+    CONTENT_ENCODING_DEFLATE,  // RFC 1950 zlib wrapper (or, from some servers, raw deflate)
+    CONTENT_ENCODING_UNSUPPORTED
+};
+
+// Content-Encoding header value to ContentEncoding ("" is identity)
+ContentEncoding parseContentEncoding(const char* value);
+
+enum InflateError {
+    INFLATE_OK = 0,
+    INFLATE_ERROR_HEADER,    // Not a gzip/zlib stream, or options that aren't supported
+    INFLATE_ERROR_DATA,      // Corrupt deflate data
+    INFLATE_ERROR_CHECKSUM,  // Trailer CRC-32 / Adler-32 or length doesn't match
+    INFLATE_ERROR_MEMORY     // Window or decompressor couldn't be allocated
+};
+
+/**
+ * Receives inflated bytes as they are produced
+ */
+class ByteSink {
+public:
+    virtual ~ByteSink() {}
+    virtual void write(const uint8_t* data, size_t length) = 0;
+};
+
+/**
+ * Streaming gzip / deflate decoder
+ * Compressed bytes can be fed in chunks of any size. Output is produced into a
+ * INFLATE_WINDOW_SIZE ring (the window deflate refers back into) and passed on to
+ * the sink as it appears, so neither the compressed nor the inflated body is ever
+ * held whole. The window and decompressor come from arena when one is given,
+ * otherwise from the heap. The trailer checksum and length are verified at the end.
+ */
+class StreamInflater {
+public:
+    StreamInflater();
+    ~StreamInflater();
+
+    bool begin(ContentEncoding encoding, ByteSink* sink, Arena* arena = nullptr);
+    void feed(const uint8_t* data, size_t length);
+    void end();
+
+    InflateError error() const { return _error; }
+    bool failed() const { return _error != INFLATE_OK; }
+
+    // The end of the deflate data has been reached and the trailer matched
+    bool finished() const { return _state == STATE_DONE; }
+
+    size_t bytesIn() const { return _bytesIn; }
+    size_t bytesOut() const { return _bytesOut; }
+
+private:
+    enum State {
+        STATE_GZIP_HEADER,  // Fixed 10 bytes
+        STATE_GZIP_EXTRA_LENGTH,
+        STATE_GZIP_EXTRA,
+        STATE_GZIP_NAME,
+        STATE_GZIP_COMMENT,
+        STATE_GZIP_HEADER_CRC,
+        STATE_ZLIB_HEADER,  // 2 bytes, or the start of raw deflate data
+        STATE_DATA,
+        STATE_TRAILER,
+        STATE_DONE
+    };
+
+    void nextGzipField();
+    size_t parseHeader(const uint8_t* data, size_t length);
+    size_t inflateData(const uint8_t* data, size_t length);
+    size_t parseTrailer(const uint8_t* data, size_t length);
+    void output(const uint8_t* data, size_t length);
+
+    ByteSink* _sink;
+    Arena* _arena;
+    ContentEncoding _encoding;
+    State _state;
+    InflateError _error;
+
+    uint8_t _header[10];
+    size_t _headerFill;
+    uint8_t _gzipFlags;
+    size_t _skip;  // Bytes left in a gzip header field
+
+    uint8_t _trailer[8];
+    size_t _trailerFill;
+    size_t _trailerSize;
+
+    uint32_t _crc;     // gzip CRC-32 of the output
+    uint32_t _adlerA;  // zlib Adler-32 of the output
+    uint32_t _adlerB;
+
+    size_t _bytesIn;
+    size_t _bytesOut;
+
+    uint8_t* _window;  // INFLATE_WINDOW_SIZE bytes of output
+#if INFLATE_ROM
+    tinfl_decompressor* _tinfl;
+    size_t _windowPos;  // Where the next output goes in the window
+#else
+    z_stream _zstream;
+    bool _zstreamReady;
+#endif
+};
+
+const char* inflateErrorToString(InflateError error);
+
+#endif  // INFLATER_H
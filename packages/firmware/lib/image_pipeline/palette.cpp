@@ -0,0 +1,7 @@
+#include "palette.h"
+
+constexpr PaletteLut PALETTE_LUT = buildPaletteLut();
+
+// Sanity checks on the generated table
+static_assert(PALETTE_LUT.entries[0].index == COLOR_BLACK, "black must map to COLOR_BLACK");
+static_assert(PALETTE_LUT.entries[PALETTE_LUT_SIZE - 1].index == COLOR_WHITE, "white must map to COLOR_WHITE");
@@ -0,0 +1,74 @@
+#ifndef PALETTE_H
+#define PALETTE_H
+
+#include <stdint.h>
+
+#include "config.h"
+
+// Bits per channel used to index the lookup table (32 x 32 x 32 cells)
+#define PALETTE_LUT_BITS 5
+#define PALETTE_LUT_SIZE (1 << (PALETTE_LUT_BITS * 3))
+
+// Palette color (COLOR_*) and its reference RGB, packed so one load gets both
+struct PaletteEntry {
+    uint8_t index;
+    uint8_t r;
+    uint8_t g;
+    uint8_t b;
+};
+
+struct PaletteLut {
+    PaletteEntry entries[PALETTE_LUT_SIZE];
+};
+
+/**
+ * Squared distance between two colors, weighted for perceived brightness
+ * (green differences matter most, blue least)
+ */
+constexpr int32_t paletteDistance(int32_t r1, int32_t g1, int32_t b1, int32_t r2, int32_t g2, int32_t b2) {
+    return 2 * (r1 - r2) * (r1 - r2) + 4 * (g1 - g2) * (g1 - g2) + 3 * (b1 - b2) * (b1 - b2);
+}
+
+/**
+ * Build the RGB -> nearest palette color table at compile time
+ * Each cell is matched using its center color against PALETTE_RGB from config.h
+ */
+constexpr PaletteLut buildPaletteLut() {
+    constexpr uint8_t palette[PALETTE_SIZE][3] = PALETTE_RGB;
+    constexpr int32_t cells = 1 << PALETTE_LUT_BITS;
+    constexpr int32_t shift = 8 - PALETTE_LUT_BITS;
+
+    PaletteLut lut = {};
+    for (int32_t i = 0; i < PALETTE_LUT_SIZE; i++) {
+        int32_t r = ((i / (cells * cells)) << shift) + (1 << (shift - 1));
+        int32_t g = (((i / cells) % cells) << shift) + (1 << (shift - 1));
+        int32_t b = ((i % cells) << shift) + (1 << (shift - 1));
+
+        uint8_t best = 0;
+        int32_t bestDistance = paletteDistance(r, g, b, palette[0][0], palette[0][1], palette[0][2]);
+        for (uint8_t color = 1; color < PALETTE_SIZE; color++) {
+            int32_t distance = paletteDistance(r, g, b, palette[color][0], palette[color][1], palette[color][2]);
+            if (distance < bestDistance) {
+                best = color;
+                bestDistance = distance;
+            }
+        }
+
+        lut.entries[i] = {best, palette[best][0], palette[best][1], palette[best][2]};
+    }
+    return lut;
+}
+
+// Generated at compile time in palette.cpp (stored in flash on the device)
+extern const PaletteLut PALETTE_LUT;
+
+/**
+ * Map a color (0-255 per channel) to the nearest palette entry
+ */
+static inline const PaletteEntry& mapToPalette(int16_t r, int16_t g, int16_t b) {
+    const int shift = 8 - PALETTE_LUT_BITS;
+    return PALETTE_LUT.entries[((r >> shift) << (PALETTE_LUT_BITS * 2)) | ((g >> shift) << PALETTE_LUT_BITS) |
+                               (b >> shift)];
+}
+
+#endif  // PALETTE_H
@@ -0,0 +1,82 @@
+#ifndef PANEL_TRAITS_H
+#define PANEL_TRAITS_H
+
+#include <stdint.h>
+
+#include "config.h"
+
+// How images are turned to fit the panel, clockwise
+enum PanelRotation { PANEL_ROTATE_0, PANEL_ROTATE_90, PANEL_ROTATE_180, PANEL_ROTATE_270 };
+
+/**
+ * Compile-time layout of a panel framebuffer
+ * Pixels are packed PIXELS_PER_BYTE to a byte, leftmost pixel in the high bits,
+ * rows STRIDE bytes apart. Images are IMAGE_WIDTH x IMAGE_HEIGHT before rotation
+ */
+template <uint16_t Width, uint16_t Height, PanelRotation Rotation, uint8_t PixelBits, uint8_t Colors>
+struct PanelLayout {
+    static_assert(PixelBits == 1 || PixelBits == 2 || PixelBits == 4 || PixelBits == 8,
+                  "pixels must pack evenly into bytes");
+    static_assert(Colors >= 2 && Colors <= (1 << PixelBits), "palette doesn't fit the pixel size");
+
+    static constexpr uint16_t WIDTH = Width;
+    static constexpr uint16_t HEIGHT = Height;
+    static constexpr PanelRotation ROTATION = Rotation;
+    static constexpr uint8_t PIXEL_BITS = PixelBits;
+    static constexpr uint8_t COLORS = Colors;
+
+    static constexpr uint32_t PIXELS_PER_BYTE = 8 / PixelBits;
+    static constexpr uint32_t STRIDE = (Width + PIXELS_PER_BYTE - 1) / PIXELS_PER_BYTE;
+    static constexpr uint32_t FRAMEBUFFER_SIZE = STRIDE * Height;
+
+    // Image rows become panel columns
+    static constexpr bool ROTATED = Rotation == PANEL_ROTATE_90 || Rotation == PANEL_ROTATE_270;
+    static constexpr uint16_t IMAGE_WIDTH = ROTATED ? Height : Width;
+    static constexpr uint16_t IMAGE_HEIGHT = ROTATED ? Width : Height;
+
+    // Panel position of pixel (x, y) of an imageWidth x imageHeight image
+    static constexpr int32_t panelX(int32_t x, int32_t y, int32_t imageWidth, int32_t imageHeight) {
+        return Rotation == PANEL_ROTATE_0    ? x
+               : Rotation == PANEL_ROTATE_90 ? imageHeight - 1 - y
+               : Rotation == PANEL_ROTATE_180 ? imageWidth - 1 - x
+                                              : y;
+    }
+
+    static constexpr int32_t panelY(int32_t x, int32_t y, int32_t imageWidth, int32_t imageHeight) {
+        return Rotation == PANEL_ROTATE_0    ? y
+               : Rotation == PANEL_ROTATE_90 ? x
+               : Rotation == PANEL_ROTATE_180 ? imageHeight - 1 - y
+                                              : imageWidth - 1 - x;
+    }
+
+    static constexpr bool contains(int32_t x, int32_t y) { return x >= 0 && x < Width && y >= 0 && y < Height; }
+
+    // Bit position of panel column x within its byte
+    static constexpr uint8_t pixelShift(uint32_t x) {
+        return (uint8_t)((PIXELS_PER_BYTE - 1 - x % PIXELS_PER_BYTE) * PixelBits);
+    }
+};
+
+/**
+ * Panel traits per Seeed GFX BOARD_SCREEN_COMBO
+ * Add a specialization to support another panel; the image pipeline is compiled
+ * for the one selected in platformio.ini
+ */
+template <int Combo>
+struct PanelTraits {
+    static_assert(Combo != Combo, "no PanelTraits for this BOARD_SCREEN_COMBO - add one in panel_traits.h");
+};
+
+// 7.3" Spectra 6 (ED2208) on the XIAO EE04: 800x480, 4-bit framebuffer, portrait
+// images turned clockwise
+template <>
+struct PanelTraits<509> : PanelLayout<800, 480, PANEL_ROTATE_90, 4, 6> {};
+
+// The panel this firmware is built for
+typedef PanelTraits<BOARD_SCREEN_COMBO> Panel;
+
+static_assert(Panel::WIDTH == DISPLAY_WIDTH && Panel::HEIGHT == DISPLAY_HEIGHT,
+              "DISPLAY_WIDTH/DISPLAY_HEIGHT in config.h don't match the panel");
+static_assert(Panel::COLORS == PALETTE_SIZE, "PALETTE_SIZE in config.h doesn't match the panel");
+
+#endif  // PANEL_TRAITS_H
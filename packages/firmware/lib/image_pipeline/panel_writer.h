@@ -0,0 +1,262 @@
+#ifndef PANEL_WRITER_H
+#define PANEL_WRITER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "arena.h"
+#include "panel_traits.h"
+
+/**
+ * Writes dithered palette-index rows straight into a panel's packed framebuffer
+ * Resolution, rotation and pixel packing come from Traits (see panel_traits.h),
+ * so the coordinate mapping and packing are resolved at compile time.
+ *
+ * With a 90/270 degree rotation every image row becomes a panel column. Instead of
+ * writing one pixel per byte down a column, rows are collected into bands of
+ * BAND_ROWS and written as whole bytes per panel row, keeping both reads and
+ * writes sequential. With 0/180 degrees image rows are packed straight into panel
+ * rows. Bounds are checked per band or row; only images that don't match the panel
+ * size (and incomplete bands) fall back to clipped per-pixel writes.
+ *
+ * Frames that are already in panel orientation are written row by row with
+ * writePanelRow() and need no band buffer. The band comes from arena when one is
+ * given, otherwise from the heap.
+ */
+template <class Traits>
+class PanelWriter {
+public:
+    static const uint32_t BAND_ROWS = 8;
+    static_assert(BAND_ROWS % Traits::PIXELS_PER_BYTE == 0, "a band must fill whole bytes");
+
+    PanelWriter()
+        : _framebuffer(nullptr),
+          _imageWidth(0),
+          _imageHeight(0),
+          _arena(nullptr),
+          _band(nullptr),
+          _bandIndex(0),
+          _bandMask(0) {}
+    ~PanelWriter() { end(); }
+
+    // nibbles maps each palette index (COLOR_*) to the panel's native pixel value
+    // imageWidth/imageHeight are the image size before rotation, or 0 if only writePanelRow() is used
+    bool begin(uint8_t* framebuffer, uint32_t imageWidth, uint32_t imageHeight, const uint8_t nibbles[Traits::COLORS],
+               Arena* arena = nullptr) {
+        end();
+
+        if (Traits::ROTATED && imageWidth > 0) {
+            _band = (uint8_t*)arenaAllocate(arena, BAND_ROWS * imageWidth);
+            if (_band == nullptr) {
+                return false;
+            }
+            _arena = arena;
+        }
+
+        _framebuffer = framebuffer;
+        _imageWidth = imageWidth;
+        _imageHeight = imageHeight;
+        _bandMask = 0;
+
+        memcpy(_nibbles, nibbles, Traits::COLORS);
+        if (Traits::PIXELS_PER_BYTE == 2) {
+            for (uint8_t left = 0; left < Traits::COLORS; left++) {
+                for (uint8_t right = 0; right < Traits::COLORS; right++) {
+                    _pairs[left * Traits::COLORS + right] = (uint8_t)((nibbles[left] << 4) | nibbles[right]);
+                }
+            }
+        }
+        return true;
+    }
+
+    void end() {
+        if (_band != nullptr) {
+            arenaRelease(_arena, _band);
+            _band = nullptr;
+        }
+        _arena = nullptr;
+        _framebuffer = nullptr;
+    }
+
+    // Write one image row (y = image row, 0 = top); with 90/270 degree rotation rows
+    // are queued and must arrive in ascending or descending order
+    void writeRow(const uint8_t* indices, uint32_t y) {
+        if (Traits::ROTATED) {
+            queueRow(indices, y);
+            return;
+        }
+
+        int32_t panelY = Traits::panelY(0, y, _imageWidth, _imageHeight);
+        if (_imageWidth == Traits::WIDTH && panelY >= 0 && panelY < Traits::HEIGHT) {
+            if (Traits::ROTATION == PANEL_ROTATE_0) {
+                packRow(indices, 1, panelY);
+            } else {
+                packRow(indices + _imageWidth - 1, -1, panelY);
+            }
+            return;
+        }
+
+        for (uint32_t x = 0; x < _imageWidth; x++) {
+            writePixel(Traits::panelX(x, y, _imageWidth, _imageHeight), Traits::panelY(x, y, _imageWidth, _imageHeight),
+                       indices[x]);
+        }
+    }
+
+    // Write out any partially filled band
+    void flush() {
+        if (!Traits::ROTATED || _bandMask == 0) {
+            return;
+        }
+
+        const bool clockwise = Traits::ROTATION == PANEL_ROTATE_90;
+        uint32_t bandStart = _bandIndex * BAND_ROWS;
+
+        // Panel columns covered by the band; with 90 degrees the leftmost comes from the last band row
+        int32_t left = Traits::panelX(0, bandStart, _imageWidth, _imageHeight) - (clockwise ? BAND_ROWS - 1 : 0);
+
+        // Image columns that land on a panel row
+        uint32_t overhang = _imageWidth > Traits::HEIGHT ? _imageWidth - Traits::HEIGHT : 0;
+        uint32_t xBegin = clockwise ? 0 : overhang;
+        uint32_t xEnd = clockwise ? _imageWidth - overhang : _imageWidth;
+
+        bool fastPath = _bandMask == FULL_BAND_MASK && left >= 0 && left % Traits::PIXELS_PER_BYTE == 0 &&
+                        left + (int32_t)BAND_ROWS <= (int32_t)Traits::WIDTH;
+
+        if (fastPath) {
+            // Whole band in range and byte aligned: each panel row gets
+            // BAND_ROWS / PIXELS_PER_BYTE bytes, read across the band rows
+            const uint8_t* first = _band + (clockwise ? (BAND_ROWS - 1) * _imageWidth : 0);
+            ptrdiff_t step = clockwise ? -(ptrdiff_t)_imageWidth : (ptrdiff_t)_imageWidth;
+
+            for (uint32_t x = xBegin; x < xEnd; x++) {
+                int32_t panelY = Traits::panelY(x, bandStart, _imageWidth, _imageHeight);
+                uint8_t* out = _framebuffer + panelY * Traits::STRIDE + left / Traits::PIXELS_PER_BYTE;
+                const uint8_t* column = first + x;
+                for (uint32_t i = 0; i < BAND_ROWS / Traits::PIXELS_PER_BYTE; i++) {
+                    out[i] = packPixels(column + (ptrdiff_t)(i * Traits::PIXELS_PER_BYTE) * step, step);
+                }
+            }
+        } else {
+            // Partial or unaligned band (image edges, incomplete downloads)
+            for (uint32_t row = 0; row < BAND_ROWS; row++) {
+                if ((_bandMask & (1u << row)) == 0) continue;
+
+                uint32_t y = bandStart + row;
+                const uint8_t* indices = _band + row * _imageWidth;
+                for (uint32_t x = xBegin; x < xEnd; x++) {
+                    writePixel(Traits::panelX(x, y, _imageWidth, _imageHeight),
+                               Traits::panelY(x, y, _imageWidth, _imageHeight), indices[x]);
+                }
+            }
+        }
+
+        _bandMask = 0;
+    }
+
+    // Write one row that is already in panel orientation (y = panel row)
+    void writePanelRow(const uint8_t* indices, uint32_t y) {
+        if (y < Traits::HEIGHT) {
+            packRow(indices, 1, y);
+        }
+    }
+
+    // Write the pixels of a panel row that aren't keep, leaving the rest as they are
+    // (delta frames patching the frame already in the buffer)
+    void patchPanelRow(const uint8_t* indices, uint32_t y, uint8_t keep) {
+        if (y >= Traits::HEIGHT) {
+            return;
+        }
+
+        uint32_t x = 0;
+        while (x < Traits::WIDTH) {
+            // Skip what stays, then write the changed span
+            while (x < Traits::WIDTH && indices[x] == keep) x++;
+            uint32_t start = x;
+            while (x < Traits::WIDTH && indices[x] != keep) x++;
+            patchSpan(indices, start, x, y);
+        }
+    }
+
+private:
+    static const uint32_t FULL_BAND_MASK = (1u << BAND_ROWS) - 1;
+
+    void queueRow(const uint8_t* indices, uint32_t y) {
+        uint32_t bandIndex = y / BAND_ROWS;
+        if (_bandMask != 0 && bandIndex != _bandIndex) {
+            flush();
+        }
+
+        _bandIndex = bandIndex;
+        _bandMask |= 1u << (y % BAND_ROWS);
+        memcpy(_band + (y % BAND_ROWS) * _imageWidth, indices, _imageWidth);
+
+        if (_bandMask == FULL_BAND_MASK) {
+            flush();
+        }
+    }
+
+    // One framebuffer byte from PIXELS_PER_BYTE palette indices, step apart
+    uint8_t packPixels(const uint8_t* pixels, ptrdiff_t step) const {
+        if (Traits::PIXELS_PER_BYTE == 2) {
+            return _pairs[pixels[0] * Traits::COLORS + pixels[step]];
+        }
+        uint8_t value = 0;
+        for (uint32_t k = 0; k < Traits::PIXELS_PER_BYTE; k++) {
+            value |= (uint8_t)(_nibbles[pixels[(ptrdiff_t)k * step]] << Traits::pixelShift(k));
+        }
+        return value;
+    }
+
+    // A full panel row, pixel x read from first[x * step]
+    void packRow(const uint8_t* first, ptrdiff_t step, uint32_t y) {
+        uint8_t* out = _framebuffer + y * Traits::STRIDE;
+        const uint32_t bytes = Traits::WIDTH / Traits::PIXELS_PER_BYTE;
+        for (uint32_t i = 0; i < bytes; i++) {
+            out[i] = packPixels(first + (ptrdiff_t)(i * Traits::PIXELS_PER_BYTE) * step, step);
+        }
+        for (uint32_t x = bytes * Traits::PIXELS_PER_BYTE; x < Traits::WIDTH; x++) {
+            writePixel(x, y, first[(ptrdiff_t)x * step]);
+        }
+    }
+
+    // Pixels [start, end) of panel row y, whole bytes packed directly
+    void patchSpan(const uint8_t* indices, uint32_t start, uint32_t end, uint32_t y) {
+        uint32_t x = start;
+        for (; x < end && x % Traits::PIXELS_PER_BYTE != 0; x++) {
+            writePixel(x, y, indices[x]);
+        }
+        uint8_t* out = _framebuffer + y * Traits::STRIDE;
+        for (; x + Traits::PIXELS_PER_BYTE <= end; x += Traits::PIXELS_PER_BYTE) {
+            out[x / Traits::PIXELS_PER_BYTE] = packPixels(indices + x, 1);
+        }
+        for (; x < end; x++) {
+            writePixel(x, y, indices[x]);
+        }
+    }
+
+    void writePixel(int32_t x, int32_t y, uint8_t index) {
+        if (!Traits::contains(x, y)) {
+            return;
+        }
+
+        uint8_t* p = _framebuffer + y * Traits::STRIDE + x / Traits::PIXELS_PER_BYTE;
+        uint8_t shift = Traits::pixelShift(x);
+        uint8_t mask = (uint8_t)(((1u << Traits::PIXEL_BITS) - 1) << shift);
+        *p = (uint8_t)((*p & ~mask) | (_nibbles[index] << shift));
+    }
+
+    uint8_t* _framebuffer;
+    uint32_t _imageWidth;
+    uint32_t _imageHeight;
+
+    uint8_t _nibbles[Traits::COLORS];
+    uint8_t _pairs[Traits::COLORS * Traits::COLORS];  // Packed byte for two adjacent 4-bit pixels
+
+    Arena* _arena;
+    uint8_t* _band;       // BAND_ROWS image rows of palette indices
+    uint32_t _bandIndex;  // y / BAND_ROWS of the rows currently in _band
+    uint32_t _bandMask;   // Bit per band row that has been filled
+};
+
+#endif  // PANEL_WRITER_H
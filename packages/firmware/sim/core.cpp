@@ -0,0 +1,545 @@
+// Arduino-ESP32 core, FreeRTOS and ESP-IDF calls used by the firmware
+
+#include <stdarg.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <random>
+#include <thread>
+
+#include "Arduino.h"
+#include "config.h"
+#include "driver/gpio.h"
+#include "esp_heap_caps.h"
+#include "esp_sntp.h"
+#include "esp_system.h"
+#include "sim.h"
+
+HardwareSerial Serial;
+
+// ---- String ----
+
+String::String(double value, unsigned int decimals) {
+    char text[64];
+    snprintf(text, sizeof(text), "%.*f", (int)decimals, value);
+    _text = text;
+}
+
+std::string String::format(long long value, unsigned char base) {
+    if (value < 0 && base == DEC) {
+        return "-" + format((unsigned long long)-value, base);
+    }
+    return format((unsigned long long)value, base);
+}
+
+std::string String::format(unsigned long long value, unsigned char base) {
+    if (base < 2 || base > 36) base = DEC;
+    std::string digits;
+    do {
+        int digit = value % base;
+        digits.insert(digits.begin(), (char)(digit < 10 ? '0' + digit : 'A' + digit - 10));
+        value /= base;
+    } while (value > 0);
+    return digits;
+}
+
+bool String::equalsIgnoreCase(const String& other) const {
+    if (_text.size() != other._text.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < _text.size(); i++) {
+        if (tolower((unsigned char)_text[i]) != tolower((unsigned char)other._text[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool String::endsWith(const String& suffix) const {
+    return _text.size() >= suffix._text.size() &&
+           _text.compare(_text.size() - suffix._text.size(), suffix._text.size(), suffix._text) == 0;
+}
+
+String String::substring(unsigned int from, unsigned int to) const {
+    if (from > to) std::swap(from, to);
+    if (from >= _text.size()) return String();
+    return String(_text.substr(from, to - from));
+}
+
+void String::replace(const String& from, const String& to) {
+    if (from._text.empty()) return;
+    for (size_t i = _text.find(from._text); i != std::string::npos; i = _text.find(from._text, i + to._text.size())) {
+        _text.replace(i, from._text.size(), to._text);
+    }
+}
+
+void String::toLowerCase() {
+    for (char& c : _text) c = tolower((unsigned char)c);
+}
+
+void String::toUpperCase() {
+    for (char& c : _text) c = toupper((unsigned char)c);
+}
+
+void String::trim() {
+    size_t begin = _text.find_first_not_of(" \t\r\n");
+    size_t end = _text.find_last_not_of(" \t\r\n");
+    _text = begin == std::string::npos ? std::string() : _text.substr(begin, end - begin + 1);
+}
+
+String operator+(const String& left, const String& right) {
+    String result(left);
+    result.concat(right);
+    return result;
+}
+
+String operator+(const String& left, const char* right) {
+    String result(left);
+    result.concat(right);
+    return result;
+}
+
+String operator+(const char* left, const String& right) {
+    String result(left);
+    result.concat(right);
+    return result;
+}
+
+// ---- Print and Serial ----
+
+size_t Print::write(const uint8_t* data, size_t length) {
+    size_t written = 0;
+    while (written < length && write(data[written])) written++;
+    return written;
+}
+
+size_t Print::printf(const char* format, ...) {
+    char text[256];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(text, sizeof(text), format, args);
+    va_end(args);
+    return length > 0 ? write((const uint8_t*)text, std::min((size_t)length, sizeof(text) - 1)) : 0;
+}
+
+bool IPAddress::fromString(const char* text) {
+    unsigned a, b, c, d;
+    if (sscanf(text, "%u.%u.%u.%u", &a, &b, &c, &d) != 4 || a > 255 || b > 255 || c > 255 || d > 255) {
+        return false;
+    }
+    *this = IPAddress(a, b, c, d);
+    return true;
+}
+
+String IPAddress::toString() const {
+    char text[16];
+    snprintf(text, sizeof(text), "%u.%u.%u.%u", (*this)[0], (*this)[1], (*this)[2], (*this)[3]);
+    return String(text);
+}
+
+// The wake log is the process's stdout
+size_t HardwareSerial::write(uint8_t c) {
+    return fwrite(&c, 1, 1, stdout);
+}
+
+size_t HardwareSerial::write(const uint8_t* data, size_t length) {
+    return fwrite(data, 1, length, stdout);
+}
+
+void HardwareSerial::flush() {
+    fflush(stdout);
+}
+
+// ---- Time ----
+
+unsigned long millis() {
+    return (unsigned long)(sim::nowMicros() / 1000);
+}
+
+unsigned long micros() {
+    return (unsigned long)sim::nowMicros();
+}
+
+int64_t esp_timer_get_time() {
+    return sim::nowMicros();
+}
+
+// Waiting costs no host time: the virtual clock moves on and other threads get a turn
+void delay(uint32_t ms) {
+    sim::advance(ms);
+    std::this_thread::yield();
+}
+
+void delayMicroseconds(uint32_t us) {
+    sim::advance(us / 1000.0);
+}
+
+void yield() {
+    std::this_thread::yield();
+}
+
+uint32_t getCpuFrequencyMhz() {
+    return 240;
+}
+
+const char* esp_err_to_name(esp_err_t code) {
+    switch (code) {
+        case ESP_OK:
+            return "ESP_OK";
+        case ESP_ERR_INVALID_ARG:
+            return "ESP_ERR_INVALID_ARG";
+        case ESP_ERR_INVALID_STATE:
+            return "ESP_ERR_INVALID_STATE";
+        case ESP_ERR_NOT_SUPPORTED:
+            return "ESP_ERR_NOT_SUPPORTED";
+        default:
+            return "ESP_FAIL";
+    }
+}
+
+// ---- GPIO ----
+
+void pinMode(uint8_t pin, uint8_t mode) {
+    (void)pin, (void)mode;
+}
+
+// Buttons read as pressed while the one that woke the chip is held down, and the
+// panel's BUSY pin at its busy level while a refresh is in progress
+int digitalRead(uint8_t pin) {
+    if (pin == EPD_BUSY_PIN) {
+        bool idle = !sim::panelBusy();
+        return idle == (EPD_BUSY_IDLE_LEVEL == HIGH) ? HIGH : LOW;
+    }
+    bool pressed = sim::wake->pressedPin == pin;
+    return pressed == BUTTON_ACTIVE_LOW ? LOW : HIGH;
+}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+    (void)pin, (void)value;
+}
+
+// ---- SNTP ----
+
+namespace {
+sntp_sync_status_t sntpStatus = SNTP_SYNC_STATUS_RESET;
+int64_t sntpStartMicros = -1;  // When configTime() was called, -1 if it wasn't
+}  // namespace
+
+void configTime(long gmtOffsetSec, int daylightOffsetSec, const char* server1, const char* server2,
+                const char* server3) {
+    (void)gmtOffsetSec, (void)daylightOffsetSec, (void)server1, (void)server2, (void)server3;
+    sntpStartMicros = sim::nowMicros();
+    sntpStatus = SNTP_SYNC_STATUS_IN_PROGRESS;
+}
+
+sntp_sync_status_t sntp_get_sync_status() {
+    if (sntpStatus == SNTP_SYNC_STATUS_IN_PROGRESS && sim::radioOn() &&
+        sim::nowMicros() >= sntpStartMicros + (int64_t)(sim::model.ntp_ms * 1000)) {
+        sim::setDeviceTimeMicros(sim::trueTimeMicros());
+        sim::countSent(48);
+        sim::countReceived(48);
+        sntpStatus = SNTP_SYNC_STATUS_COMPLETED;
+    }
+    return sntpStatus;
+}
+
+void sntp_set_sync_status(sntp_sync_status_t status) {
+    sntpStatus = status;
+}
+
+// ---- Deep sleep ----
+
+esp_sleep_wakeup_cause_t esp_sleep_get_wakeup_cause() {
+    return sim::wake->cause;
+}
+
+uint64_t esp_sleep_get_ext1_wakeup_status() {
+    return sim::wake->cause == ESP_SLEEP_WAKEUP_EXT1 && sim::wake->pressedPin >= 0 ? 1ULL << sim::wake->pressedPin
+                                                                                     : 0;
+}
+
+esp_err_t esp_sleep_enable_timer_wakeup(uint64_t timeMicros) {
+    sim::wake->timerMicros = timeMicros;
+    return ESP_OK;
+}
+
+esp_err_t esp_sleep_enable_ext1_wakeup(uint64_t mask, esp_sleep_ext1_wakeup_mode_t mode) {
+    sim::wake->ext1Mask = mask;
+    sim::wake->ext1Mode = mode;
+    return ESP_OK;
+}
+
+void esp_deep_sleep_start() {
+    sim::endWake();
+}
+
+// ---- Light sleep ----
+
+namespace {
+bool gpioWakeEnabled = false;
+int busyWakeType = GPIO_INTR_DISABLE;  // Wake condition armed on EPD_BUSY_PIN
+
+// Refresh time left with BUSY at its busy level
+std::mutex panelMutex;
+std::condition_variable panelProgress;
+int64_t busyMicros = 0;
+}  // namespace
+
+esp_err_t gpio_wakeup_enable(gpio_num_t pin, gpio_int_type_t type) {
+    if (type != GPIO_INTR_LOW_LEVEL && type != GPIO_INTR_HIGH_LEVEL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (pin == EPD_BUSY_PIN) busyWakeType = type;
+    return ESP_OK;
+}
+
+esp_err_t gpio_wakeup_disable(gpio_num_t pin) {
+    if (pin == EPD_BUSY_PIN) busyWakeType = GPIO_INTR_DISABLE;
+    return ESP_OK;
+}
+
+esp_err_t esp_sleep_enable_gpio_wakeup() {
+    gpioWakeEnabled = true;
+    return ESP_OK;
+}
+
+esp_err_t esp_sleep_disable_wakeup_source(esp_sleep_wakeup_cause_t source) {
+    if (source == ESP_SLEEP_WAKEUP_GPIO || source == ESP_SLEEP_WAKEUP_ALL) gpioWakeEnabled = false;
+    if (source == ESP_SLEEP_WAKEUP_TIMER || source == ESP_SLEEP_WAKEUP_ALL) sim::wake->timerMicros = 0;
+    return ESP_OK;
+}
+
+// Sleeps until BUSY is at the level armed as a wake source or the timer runs out;
+// with neither the chip would sleep for good, so it's refused
+esp_err_t esp_light_sleep_start() {
+    std::lock_guard<std::mutex> lock(panelMutex);
+    int64_t sleepMicros = INT64_MAX;
+    if (gpioWakeEnabled && busyWakeType != GPIO_INTR_DISABLE) {
+        int idleType = EPD_BUSY_IDLE_LEVEL == HIGH ? GPIO_INTR_HIGH_LEVEL : GPIO_INTR_LOW_LEVEL;
+        if (busyWakeType == idleType) {
+            sleepMicros = busyMicros;
+        } else if (busyMicros > 0) {
+            sleepMicros = 0;
+        }
+    }
+    if (sim::wake->timerMicros != 0 && (int64_t)sim::wake->timerMicros < sleepMicros) {
+        sleepMicros = sim::wake->timerMicros;
+    }
+    if (sleepMicros == INT64_MAX) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    sim::setLightSleep(true);
+    sim::advance(sleepMicros / 1000.0);
+    sim::setLightSleep(false);
+    busyMicros -= std::min(busyMicros, sleepMicros);
+    panelProgress.notify_all();
+    return ESP_OK;
+}
+
+namespace sim {
+
+bool panelBusy() {
+    std::lock_guard<std::mutex> lock(panelMutex);
+    return busyMicros > 0;
+}
+
+// What light sleep doesn't take of the refresh passes awake, once no sleep has
+// shortened it for a while (host time; a task sleeping through it polls every 10 ms)
+void holdPanelBusy() {
+    std::unique_lock<std::mutex> lock(panelMutex);
+    busyMicros = (int64_t)(model.refresh_ms * 1000);
+    while (busyMicros > 0) {
+        int64_t left = busyMicros;
+        if (!panelProgress.wait_for(lock, std::chrono::milliseconds(100), [left] { return busyMicros != left; })) {
+            advance(busyMicros / 1000.0);
+            busyMicros = 0;
+        }
+    }
+}
+
+}  // namespace sim
+
+// ---- Heap ----
+
+void* heap_caps_malloc(size_t size, uint32_t caps) {
+    (void)caps;
+    return malloc(size);
+}
+
+void heap_caps_free(void* pointer) {
+    free(pointer);
+}
+
+size_t heap_caps_get_free_size(uint32_t caps) {
+    return caps & MALLOC_CAP_SPIRAM ? 8 * 1024 * 1024 - 512 * 1024 : 280 * 1024;
+}
+
+size_t heap_caps_get_total_size(uint32_t caps) {
+    return caps & MALLOC_CAP_SPIRAM ? 8 * 1024 * 1024 : 320 * 1024;
+}
+
+size_t heap_caps_get_minimum_free_size(uint32_t caps) {
+    return heap_caps_get_free_size(caps);
+}
+
+size_t heap_caps_get_largest_free_block(uint32_t caps) {
+    return heap_caps_get_free_size(caps) / 2;
+}
+
+void esp_fill_random(void* buffer, size_t length) {
+    static std::mt19937 generator(std::random_device{}());
+    uint8_t* bytes = (uint8_t*)buffer;
+    for (size_t i = 0; i < length; i++) bytes[i] = (uint8_t)generator();
+}
+
+esp_reset_reason_t esp_reset_reason() {
+    return sim::wake->index == 1 ? ESP_RST_POWERON : ESP_RST_DEEPSLEEP;
+}
+
+// ---- FreeRTOS ----
+
+namespace {
+
+struct Task {
+    std::mutex mutex;
+    std::condition_variable changed;
+    uint32_t notifications = 0;
+};
+
+struct EventGroup {
+    std::mutex mutex;
+    std::condition_variable changed;
+    EventBits_t bits = 0;
+};
+
+thread_local Task* currentTask = nullptr;
+
+Task* taskOf(TaskHandle_t handle) {
+    return handle != nullptr ? (Task*)handle : (Task*)xTaskGetCurrentTaskHandle();
+}
+
+// Waits up to ticks ms of host time (forever with portMAX_DELAY) for done()
+template <class Lock, class Done>
+bool waitFor(std::condition_variable& changed, Lock& lock, TickType_t ticks, Done done) {
+    if (ticks == portMAX_DELAY) {
+        changed.wait(lock, done);
+        return true;
+    }
+    return changed.wait_for(lock, std::chrono::milliseconds(ticks), done);
+}
+
+}  // namespace
+
+// Tasks are never freed: the wake's process ends at deep sleep anyway
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char* name, uint32_t stackDepth, void* parameter,
+                                   UBaseType_t priority, TaskHandle_t* handle, BaseType_t core) {
+    (void)name, (void)stackDepth, (void)priority, (void)core;
+    Task* task = new Task();
+    if (handle != nullptr) {
+        *handle = task;
+    }
+    std::thread([task, function, parameter]() {
+        currentTask = task;
+        function(parameter);
+    }).detach();
+    return pdPASS;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+    if (currentTask == nullptr) {
+        currentTask = new Task();
+    }
+    return currentTask;
+}
+
+// Arduino code runs on core 1
+BaseType_t xPortGetCoreID() {
+    return 1;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticks) {
+    Task* task = taskOf(nullptr);
+    std::unique_lock<std::mutex> lock(task->mutex);
+    waitFor(task->changed, lock, ticks, [task]() { return task->notifications > 0; });
+
+    uint32_t count = task->notifications;
+    if (count > 0) {
+        task->notifications = clearOnExit ? 0 : count - 1;
+    }
+    return count;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t handle) {
+    Task* task = taskOf(handle);
+    std::lock_guard<std::mutex> lock(task->mutex);
+    task->notifications++;
+    task->changed.notify_all();
+    return pdPASS;
+}
+
+// A task deleting itself returns from its function right after, ending the thread
+void vTaskDelete(TaskHandle_t handle) {
+    (void)handle;
+}
+
+void vTaskDelay(TickType_t ticks) {
+    delay(ticks);
+}
+
+void vPortEnterCritical(portMUX_TYPE* mux) {
+    while (__atomic_exchange_n(&mux->locked, 1, __ATOMIC_ACQUIRE)) {
+        std::this_thread::yield();
+    }
+}
+
+void vPortExitCritical(portMUX_TYPE* mux) {
+    __atomic_store_n(&mux->locked, 0, __ATOMIC_RELEASE);
+}
+
+EventGroupHandle_t xEventGroupCreate() {
+    return new EventGroup();
+}
+
+void vEventGroupDelete(EventGroupHandle_t group) {
+    delete (EventGroup*)group;
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t handle, EventBits_t bits) {
+    EventGroup* group = (EventGroup*)handle;
+    std::lock_guard<std::mutex> lock(group->mutex);
+    group->bits |= bits;
+    group->changed.notify_all();
+    return group->bits;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t handle, EventBits_t bits) {
+    EventGroup* group = (EventGroup*)handle;
+    std::lock_guard<std::mutex> lock(group->mutex);
+    EventBits_t previous = group->bits;
+    group->bits &= ~bits;
+    return previous;
+}
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t handle) {
+    EventGroup* group = (EventGroup*)handle;
+    std::lock_guard<std::mutex> lock(group->mutex);
+    return group->bits;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t handle, EventBits_t bits, BaseType_t clearOnExit,
+                                BaseType_t waitForAll, TickType_t ticks) {
+    EventGroup* group = (EventGroup*)handle;
+    std::unique_lock<std::mutex> lock(group->mutex);
+    auto done = [&]() { return waitForAll ? (group->bits & bits) == bits : (group->bits & bits) != 0; };
+    bool met = waitFor(group->changed, lock, ticks, done);
+
+    EventBits_t result = group->bits;
+    if (met && clearOnExit) {
+        group->bits &= ~bits;
+    }
+    return result;
+}
@@ -0,0 +1,259 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <sys/time.h>
+
+#include <atomic>
+#include <mutex>
+
+#include "sim.h"
+
+// Linker-provided bounds of the RTC_DATA_ATTR section
+extern uint8_t __start_sim_rtc_data[];
+extern uint8_t __stop_sim_rtc_data[];
+
+namespace sim {
+
+Model model;
+Wake* wake = nullptr;
+
+namespace {
+
+struct Field {
+    const char* key;
+    double Model::*value;
+    const char* unit;
+};
+
+const Field FIELDS[] = {
+    {"cpu_ma", &Model::cpu_ma, "mA"},
+    {"radio_ma", &Model::radio_ma, "mA"},
+    {"refresh_ma", &Model::refresh_ma, "mA"},
+    {"light_sleep_ma", &Model::light_sleep_ma, "mA"},
+    {"sleep_ua", &Model::sleep_ua, "uA"},
+    {"boot_ms", &Model::boot_ms, "ms"},
+    {"cpu_scale", &Model::cpu_scale, "x"},
+    {"wifi_fast_ms", &Model::wifi_fast_ms, "ms"},
+    {"wifi_scan_ms", &Model::wifi_scan_ms, "ms"},
+    {"dhcp_ms", &Model::dhcp_ms, "ms"},
+    {"dhcp_lease_s", &Model::dhcp_lease_s, "s"},
+    {"ntp_ms", &Model::ntp_ms, "ms"},
+    {"rtt_ms", &Model::rtt_ms, "ms"},
+    {"server_ms", &Model::server_ms, "ms"},
+    {"generate_ms", &Model::generate_ms, "ms"},
+    {"tls_full_ms", &Model::tls_full_ms, "ms"},
+    {"tls_resume_ms", &Model::tls_resume_ms, "ms"},
+    {"bandwidth_kbps", &Model::bandwidth_kbps, "kbit/s"},
+    {"refresh_ms", &Model::refresh_ms, "ms"},
+    {"rtc_drift_ppm", &Model::rtc_drift_ppm, "ppm"},
+    {"battery_mah", &Model::battery_mah, "mAh"},
+    {"battery_usable", &Model::battery_usable, ""},
+};
+
+// Power state and the charge drawn in it since the last change
+std::mutex stateMutex;
+std::atomic<int64_t> modeledMicros(0);
+int64_t accountedMicros = 0;
+bool radio = false;
+bool refreshing = false;
+bool lightSleep = false;
+
+int64_t cpuMicros() {
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// Charge the time since the last call at the current state (stateMutex held)
+void accrue() {
+    int64_t now = nowMicros();
+    int64_t elapsed = now - accountedMicros;
+    if (elapsed <= 0) {
+        return;
+    }
+    accountedMicros = now;
+
+    if (radio) {
+        wake->radioMicros += elapsed;
+        wake->radioCharge += model.radio_ma * elapsed;
+    } else if (lightSleep) {
+        wake->lightSleepMicros += elapsed;
+        wake->cpuCharge += model.light_sleep_ma * elapsed;
+    } else {
+        wake->cpuCharge += model.cpu_ma * elapsed;
+    }
+    if (refreshing) {
+        wake->refreshMicros += elapsed;
+        wake->refreshCharge += model.refresh_ma * elapsed;
+    }
+}
+
+}  // namespace
+
+bool Model::set(const char* key, const char* value) {
+    char* end;
+    double number = strtod(value, &end);
+    if (end == value) {
+        return false;
+    }
+    for (const Field& field : FIELDS) {
+        if (strcmp(field.key, key) == 0) {
+            this->*field.value = number;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Model::load(const char* path) {
+    FILE* file = fopen(path, "r");
+    if (file == nullptr) {
+        fprintf(stderr, "Can't read model %s\n", path);
+        return false;
+    }
+
+    char line[256];
+    int lineNumber = 0;
+    bool ok = true;
+    while (fgets(line, sizeof(line), file) != nullptr) {
+        lineNumber++;
+        char* comment = strchr(line, '#');
+        if (comment != nullptr) *comment = '\0';
+
+        char key[64], value[64];
+        int fields = sscanf(line, " %63[a-z_0-9] = %63s", key, value);
+        if (fields == EOF || fields == 0) {
+            continue;  // Blank or comment
+        }
+        if (fields != 2 || !set(key, value)) {
+            fprintf(stderr, "%s:%d: bad model line\n", path, lineNumber);
+            ok = false;
+        }
+    }
+    fclose(file);
+    return ok;
+}
+
+void Model::print() const {
+    for (const Field& field : FIELDS) {
+        printf("  %-15s %10g %s\n", field.key, this->*field.value, field.unit);
+    }
+}
+
+int64_t nowMicros() {
+    return (int64_t)(model.boot_ms * 1000) + modeledMicros.load() + (int64_t)(cpuMicros() * model.cpu_scale);
+}
+
+void advance(double ms) {
+    if (ms <= 0) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(stateMutex);
+    accrue();
+    modeledMicros += (int64_t)(ms * 1000);
+    accrue();
+}
+
+void setRadio(bool on) {
+    std::lock_guard<std::mutex> lock(stateMutex);
+    accrue();
+    radio = on;
+}
+
+void setRefreshing(bool on) {
+    std::lock_guard<std::mutex> lock(stateMutex);
+    accrue();
+    refreshing = on;
+}
+
+void setLightSleep(bool on) {
+    std::lock_guard<std::mutex> lock(stateMutex);
+    accrue();
+    lightSleep = on;
+}
+
+bool radioOn() {
+    return radio;
+}
+
+int64_t trueTimeMicros() {
+    return wake->worldMicros + nowMicros();
+}
+
+int64_t deviceTimeMicros() {
+    return trueTimeMicros() + wake->clockOffsetMicros;
+}
+
+void setDeviceTimeMicros(int64_t micros) {
+    wake->clockOffsetMicros = micros - trueTimeMicros();
+}
+
+void countSent(size_t bytes) {
+    wake->bytesSent += bytes;
+}
+
+void countReceived(size_t bytes) {
+    wake->bytesReceived += bytes;
+    advance(bytes * 8.0 / model.bandwidth_kbps);
+}
+
+bool saveRtc() {
+    size_t rtcSize = __stop_sim_rtc_data - __start_sim_rtc_data;
+    if (rtcSize > Wake::RTC_MAX) {
+        fprintf(stderr, "RTC data (%zu bytes) doesn't fit the simulator's copy\n", rtcSize);
+        return false;
+    }
+    memcpy(wake->rtc, __start_sim_rtc_data, rtcSize);
+    wake->rtcSize = rtcSize;
+    return true;
+}
+
+void loadRtc() {
+    memcpy(__start_sim_rtc_data, wake->rtc, wake->rtcSize);
+}
+
+void endWake() {
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        accrue();
+        wake->awakeMicros = accountedMicros;
+    }
+
+    if (!saveRtc()) {
+        _exit(3);
+    }
+    wake->slept = true;
+
+    fflush(stdout);
+    _exit(0);
+}
+
+}  // namespace sim
+
+// The firmware reads and sets the wall clock through libc; the sim build links
+// with --wrap so these see the device clock instead of the host's
+extern "C" {
+
+time_t __wrap_time(time_t* result) {
+    time_t now = (time_t)(sim::deviceTimeMicros() / 1000000);
+    if (result != nullptr) *result = now;
+    return now;
+}
+
+int __wrap_gettimeofday(struct timeval* tv, void* tz) {
+    (void)tz;
+    int64_t now = sim::deviceTimeMicros();
+    tv->tv_sec = now / 1000000;
+    tv->tv_usec = now % 1000000;
+    return 0;
+}
+
+int __wrap_settimeofday(const struct timeval* tv, const void* tz) {
+    (void)tz;
+    sim::setDeviceTimeMicros((int64_t)tv->tv_sec * 1000000 + tv->tv_usec);
+    return 0;
+}
+}
@@ -0,0 +1,265 @@
+// EPaper stand-in and PNG output of the panel
+
+#include <zlib.h>
+
+#include "TFT_eSPI.h"
+#include "config.h"
+#include "sim.h"
+
+// ---- TFT_eSPI ----
+
+void TFT_eSPI::fillRect(int32_t x, int32_t y, int32_t w, int32_t h, uint32_t color) {
+    for (int32_t row = y; row < y + h; row++) {
+        for (int32_t column = x; column < x + w; column++) {
+            drawPixel(column, row, color);
+        }
+    }
+}
+
+void TFT_eSPI::drawRect(int32_t x, int32_t y, int32_t w, int32_t h, uint32_t color) {
+    fillRect(x, y, w, 1, color);
+    fillRect(x, y + h - 1, w, 1, color);
+    fillRect(x, y, 1, h, color);
+    fillRect(x + w - 1, y, 1, h, color);
+}
+
+// Built-in fonts 1, 2, 4, 6, 7 and 8 are 8, 16, 26, 48, 48 and 75 pixels high
+int16_t TFT_eSPI::fontScale() {
+    switch (_textFont) {
+        case 2:
+            return 2;
+        case 4:
+            return 3;
+        case 6:
+        case 7:
+            return 6;
+        case 8:
+            return 9;
+        default:
+            return 1;
+    }
+}
+
+int16_t TFT_eSPI::textWidth(const char* text) {
+    return strlen(text) * charWidth();
+}
+
+int16_t TFT_eSPI::fontHeight() {
+    return 8 * fontScale() * _textSize;
+}
+
+// A 5 x 7 dot pattern hashed from the character, in a 6 x 8 cell scaled by the font:
+// not legible, but different text draws different pixels, as it would on the panel
+void TFT_eSPI::drawGlyph(char c, int32_t x, int32_t y) {
+    int16_t scale = fontScale() * _textSize;
+    if (_textBackground != _textColor) {
+        fillRect(x, y, 6 * scale, 8 * scale, _textBackground);
+    }
+    if (c == ' ') {
+        return;
+    }
+    uint64_t dots = ((uint8_t)c + 1) * 0x9E3779B97F4A7C15ull;
+    for (int row = 0; row < 7; row++) {
+        for (int column = 0; column < 5; column++) {
+            if (dots >> (row * 5 + column) & 1) {
+                fillRect(x + column * scale, y + row * scale, scale, scale, _textColor);
+            }
+        }
+    }
+}
+
+int16_t TFT_eSPI::drawString(const char* text, int32_t x, int32_t y) {
+    for (const char* c = text; *c != '\0'; c++) {
+        drawGlyph(*c, x, y);
+        x += charWidth();
+    }
+    return textWidth(text);
+}
+
+size_t TFT_eSPI::write(uint8_t c) {
+    if (c == '\n') {
+        _cursorX = _cursorLeft;
+        _cursorY += fontHeight();
+    } else if (c != '\r') {
+        drawGlyph(c, _cursorX, _cursorY);
+        _cursorX += charWidth();
+    }
+    return 1;
+}
+
+// ---- Sprites ----
+
+uint8_t epaperNibble(uint32_t color) {
+    switch (color) {
+        case TFT_BLACK:
+            return 0x0;
+        case TFT_WHITE:
+            return 0x1;
+        case TFT_YELLOW:
+            return 0x2;
+        case TFT_RED:
+            return 0x3;
+        case TFT_BLUE:
+            return 0x5;
+        case TFT_GREEN:
+            return 0x6;
+        default:
+            return 0x1;
+    }
+}
+
+static uint16_t epaperColor(uint8_t nibble) {
+    static const uint16_t COLORS[16] = {TFT_BLACK, TFT_WHITE, TFT_YELLOW, TFT_RED,   TFT_WHITE, TFT_BLUE,
+                                        TFT_GREEN, TFT_WHITE, TFT_WHITE,  TFT_WHITE, TFT_WHITE, TFT_WHITE,
+                                        TFT_WHITE, TFT_WHITE, TFT_WHITE,  TFT_WHITE};
+    return COLORS[nibble & 0xF];
+}
+
+size_t TFT_eSprite::stride() const {
+    return _bits == 1 ? (_width + 7) / 8 : (_bits == 4 ? (_width + 1) / 2 : _width * 2);
+}
+
+void* TFT_eSprite::createSprite(int16_t width, int16_t height, uint8_t frames) {
+    (void)frames;
+    _width = width;
+    _height = height;
+    _buffer.assign(stride() * height, 0);
+    return getPointer();
+}
+
+void TFT_eSprite::deleteSprite() {
+    _buffer.clear();
+    _width = _height = 0;
+}
+
+void TFT_eSprite::drawPixel(int32_t x, int32_t y, uint32_t color) {
+    if (x < 0 || y < 0 || x >= _width || y >= _height || _buffer.empty()) {
+        return;
+    }
+    uint8_t* row = &_buffer[y * stride()];
+    if (_bits == 1) {
+        uint8_t bit = 0x80 >> (x & 7);
+        row[x / 8] = color != TFT_BLACK ? row[x / 8] | bit : row[x / 8] & ~bit;
+    } else if (_bits == 4) {
+        // Even x in the high nibble, as in the EPaper buffer
+        uint8_t shift = x & 1 ? 0 : 4;
+        row[x / 2] = (row[x / 2] & ~(0xF << shift)) | epaperNibble(color) << shift;
+    } else {
+        row[x * 2] = color >> 8;
+        row[x * 2 + 1] = color;
+    }
+}
+
+void TFT_eSprite::fillRect(int32_t x, int32_t y, int32_t w, int32_t h, uint32_t color) {
+    int32_t left = std::max(x, (int32_t)0), right = std::min(x + w, (int32_t)_width);
+    int32_t top = std::max(y, (int32_t)0), bottom = std::min(y + h, (int32_t)_height);
+    for (int32_t row = top; row < bottom; row++) {
+        for (int32_t column = left; column < right; column++) {
+            drawPixel(column, row, color);
+        }
+    }
+}
+
+uint16_t TFT_eSprite::readPixel(int32_t x, int32_t y) {
+    if (x < 0 || y < 0 || x >= _width || y >= _height || _buffer.empty()) {
+        return 0;
+    }
+    const uint8_t* row = &_buffer[y * stride()];
+    if (_bits == 1) {
+        return row[x / 8] & (0x80 >> (x & 7)) ? TFT_WHITE : TFT_BLACK;
+    }
+    if (_bits == 4) {
+        return epaperColor(row[x / 2] >> (x & 1 ? 0 : 4));
+    }
+    return row[x * 2] << 8 | row[x * 2 + 1];
+}
+
+// ---- EPaper ----
+
+EPaper::EPaper() {
+    setColorDepth(4);
+    createSprite(DISPLAY_WIDTH, DISPLAY_HEIGHT);
+}
+
+void EPaper::begin() {
+    fillScreen(TFT_WHITE);
+}
+
+// The driver waits out the refresh on the BUSY pin; another task may light-sleep through it
+void EPaper::update() {
+    sim::setRefreshing(true);
+    sim::holdPanelBusy();
+    sim::setRefreshing(false);
+
+    sim::wake->refreshes++;
+    snprintf(sim::wake->panelImage, sizeof(sim::wake->panelImage), "panel-%04u.png", sim::wake->index);
+    std::string path = std::string(sim::wake->outDir) + "/" + sim::wake->panelImage;
+    sim::writePanelPng(path.c_str(), _buffer.data(), _width, _height);
+}
+
+// ---- PNG ----
+
+namespace {
+
+void appendChunk(std::string& png, const char* type, const std::string& data) {
+    uint8_t header[8] = {(uint8_t)(data.size() >> 24), (uint8_t)(data.size() >> 16), (uint8_t)(data.size() >> 8),
+                         (uint8_t)data.size(), (uint8_t)type[0], (uint8_t)type[1], (uint8_t)type[2], (uint8_t)type[3]};
+    png.append((const char*)header, sizeof(header));
+    png += data;
+
+    uint32_t crc = crc32(0, header + 4, 4);
+    crc = crc32(crc, (const uint8_t*)data.data(), data.size());
+    uint8_t trailer[4] = {(uint8_t)(crc >> 24), (uint8_t)(crc >> 16), (uint8_t)(crc >> 8), (uint8_t)crc};
+    png.append((const char*)trailer, sizeof(trailer));
+}
+
+}  // namespace
+
+namespace sim {
+
+// 4-bit palette PNG with the measured ink colors of config.h, so it looks like the panel
+bool writePanelPng(const char* path, const uint8_t* buffer, int width, int height) {
+    static const uint8_t INKS[PALETTE_SIZE][3] = PALETTE_RGB;
+    static const uint16_t PANEL_COLORS[PALETTE_SIZE] = {TFT_BLACK, TFT_WHITE, TFT_RED, TFT_YELLOW, TFT_BLUE, TFT_GREEN};
+
+    std::string palette(16 * 3, '\0');
+    for (int nibble = 0; nibble < 16; nibble++) {
+        const uint8_t* ink = INKS[COLOR_WHITE];
+        for (int i = 0; i < PALETTE_SIZE; i++) {
+            if (epaperNibble(PANEL_COLORS[i]) == nibble) ink = INKS[i];
+        }
+        palette.replace(nibble * 3, 3, (const char*)ink, 3);
+    }
+
+    // The buffer's nibble order (even x high) is PNG's as well, so rows copy straight
+    size_t stride = (width + 1) / 2;
+    std::string raw;
+    for (int y = 0; y < height; y++) {
+        raw += '\0';  // Filter: none
+        raw.append((const char*)buffer + y * stride, stride);
+    }
+    uLongf compressedSize = compressBound(raw.size());
+    std::string compressed(compressedSize, '\0');
+    if (compress2((Bytef*)&compressed[0], &compressedSize, (const Bytef*)raw.data(), raw.size(), 6) != Z_OK) {
+        return false;
+    }
+    compressed.resize(compressedSize);
+
+    const uint8_t ihdr[13] = {(uint8_t)(width >> 24), (uint8_t)(width >> 16), (uint8_t)(width >> 8), (uint8_t)width,
+                              (uint8_t)(height >> 24), (uint8_t)(height >> 16), (uint8_t)(height >> 8),
+                              (uint8_t)height, 4, 3, 0, 0, 0};  // 4-bit, indexed
+    std::string png("\x89PNG\r\n\x1a\n", 8);
+    appendChunk(png, "IHDR", std::string((const char*)ihdr, sizeof(ihdr)));
+    appendChunk(png, "PLTE", palette);
+    appendChunk(png, "IDAT", compressed);
+    appendChunk(png, "IEND", std::string());
+
+    FILE* file = fopen(path, "wb");
+    if (file == nullptr) {
+        return false;
+    }
+    bool written = fwrite(png.data(), 1, png.size(), file) == png.size();
+    return fclose(file) == 0 && written;
+}
+
+}  // namespace sim
@@ -0,0 +1,245 @@
+#ifndef SIM_ARDUINO_H
+#define SIM_ARDUINO_H
+
+// Host stand-in for the parts of the Arduino-ESP32 core the firmware uses
+// Time is the simulator's virtual clock (sim/sim.h); Serial goes to the wake log
+
+#include <ctype.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+
+#include "esp_err.h"
+#include "esp_sleep.h"
+#include "esp_timer.h"
+#include "freertos.h"
+
+#define ESP_IDF_VERSION_MAJOR 5  // Arduino-ESP32 3.x
+
+#define HEX 16
+#define DEC 10
+
+#define LOW 0
+#define HIGH 1
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define INPUT_PULLUP 0x05
+
+// RTC memory survives deep sleep: the simulator saves this section when a wake
+// ends and restores it into the next wake's process
+#define RTC_DATA_ATTR __attribute__((section("sim_rtc_data")))
+#define RTC_NOINIT_ATTR RTC_DATA_ATTR
+#define IRAM_ATTR
+#define DRAM_ATTR
+
+using std::max;
+using std::min;
+
+template <class T, class L, class H>
+T constrain(T value, L low, H high) {
+    return value < low ? low : (value > high ? high : value);
+}
+
+class String {
+public:
+    String() {}
+    String(const char* text) : _text(text != nullptr ? text : "") {}
+    String(const std::string& text) : _text(text) {}
+    explicit String(char c) : _text(1, c) {}
+    String(int value, unsigned char base = DEC) : _text(format((long long)value, base)) {}
+    String(unsigned int value, unsigned char base = DEC) : _text(format((unsigned long long)value, base)) {}
+    String(long value, unsigned char base = DEC) : _text(format((long long)value, base)) {}
+    String(unsigned long value, unsigned char base = DEC) : _text(format((unsigned long long)value, base)) {}
+    String(long long value, unsigned char base = DEC) : _text(format(value, base)) {}
+    String(unsigned long long value, unsigned char base = DEC) : _text(format(value, base)) {}
+    String(double value, unsigned int decimals = 2);
+
+    const char* c_str() const { return _text.c_str(); }
+    unsigned int length() const { return _text.size(); }
+    bool isEmpty() const { return _text.empty(); }
+    bool reserve(unsigned int size) {
+        _text.reserve(size);
+        return true;
+    }
+
+    char charAt(unsigned int index) const { return index < _text.size() ? _text[index] : 0; }
+    char operator[](unsigned int index) const { return charAt(index); }
+
+    bool concat(const String& other) {
+        _text += other._text;
+        return true;
+    }
+    bool concat(const char* text) {
+        if (text != nullptr) _text += text;
+        return true;
+    }
+    bool concat(const char* text, unsigned int length) {
+        if (text != nullptr) _text.append(text, length);
+        return true;
+    }
+    bool concat(char c) {
+        _text += c;
+        return true;
+    }
+    String& operator+=(const String& other) {
+        concat(other);
+        return *this;
+    }
+    String& operator+=(const char* text) {
+        concat(text);
+        return *this;
+    }
+    String& operator+=(char c) {
+        concat(c);
+        return *this;
+    }
+
+    // Lets ArduinoJson's generic writer serialize into a String
+    size_t write(uint8_t c) {
+        _text += (char)c;
+        return 1;
+    }
+    size_t write(const uint8_t* data, size_t length) {
+        _text.append((const char*)data, length);
+        return length;
+    }
+
+    bool equals(const String& other) const { return _text == other._text; }
+    bool equals(const char* text) const { return _text == (text != nullptr ? text : ""); }
+    bool equalsIgnoreCase(const String& other) const;
+    bool operator==(const String& other) const { return equals(other); }
+    bool operator==(const char* text) const { return equals(text); }
+    bool operator!=(const String& other) const { return !equals(other); }
+    bool operator!=(const char* text) const { return !equals(text); }
+    bool operator<(const String& other) const { return _text < other._text; }
+
+    bool startsWith(const String& prefix) const { return _text.compare(0, prefix._text.size(), prefix._text) == 0; }
+    bool endsWith(const String& suffix) const;
+    int indexOf(char c, unsigned int from = 0) const { return find(_text.find(c, from)); }
+    int indexOf(const String& text, unsigned int from = 0) const { return find(_text.find(text._text, from)); }
+    int lastIndexOf(char c) const { return find(_text.rfind(c)); }
+    String substring(unsigned int from) const { return from < _text.size() ? String(_text.substr(from)) : String(); }
+    String substring(unsigned int from, unsigned int to) const;
+
+    void remove(unsigned int index) {
+        if (index < _text.size()) _text.erase(index);
+    }
+    void remove(unsigned int index, unsigned int count) {
+        if (index < _text.size()) _text.erase(index, count);
+    }
+    void replace(const String& from, const String& to);
+    void toLowerCase();
+    void toUpperCase();
+    void trim();
+
+    long toInt() const { return strtol(_text.c_str(), nullptr, 10); }
+    float toFloat() const { return strtof(_text.c_str(), nullptr); }
+
+private:
+    static std::string format(long long value, unsigned char base);
+    static std::string format(unsigned long long value, unsigned char base);
+    static int find(size_t position) { return position == std::string::npos ? -1 : (int)position; }
+
+    std::string _text;
+};
+
+String operator+(const String& left, const String& right);
+String operator+(const String& left, const char* right);
+String operator+(const char* left, const String& right);
+
+class Print;
+
+class Printable {
+public:
+    virtual ~Printable() {}
+    virtual size_t printTo(Print& out) const = 0;
+};
+
+class Print {
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t* data, size_t length);
+    size_t write(const char* text) { return text != nullptr ? write((const uint8_t*)text, strlen(text)) : 0; }
+
+    size_t print(const char* text) { return write(text); }
+    size_t print(const String& text) { return write((const uint8_t*)text.c_str(), text.length()); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(unsigned char value, int base = DEC) { return print((unsigned long)value, base); }
+    size_t print(int value, int base = DEC) { return print((long)value, base); }
+    size_t print(unsigned int value, int base = DEC) { return print((unsigned long)value, base); }
+    size_t print(long value, int base = DEC) { return print(String(value, base)); }
+    size_t print(unsigned long value, int base = DEC) { return print(String(value, base)); }
+    size_t print(long long value, int base = DEC) { return print(String(value, base)); }
+    size_t print(unsigned long long value, int base = DEC) { return print(String(value, base)); }
+    size_t print(double value, int decimals = 2) { return print(String(value, decimals)); }
+    size_t print(const Printable& value) { return value.printTo(*this); }
+
+    template <class T>
+    size_t println(const T& value) {
+        size_t n = print(value);
+        return n + println();
+    }
+    template <class T>
+    size_t println(const T& value, int format) {
+        size_t n = print(value, format);
+        return n + println();
+    }
+    size_t println() { return write((const uint8_t*)"\r\n", 2); }
+
+    size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+};
+
+class IPAddress : public Printable {
+public:
+    IPAddress() : _address(0) {}
+    IPAddress(uint32_t address) : _address(address) {}
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : _address(a | b << 8 | c << 16 | (uint32_t)d << 24) {}
+
+    operator uint32_t() const { return _address; }
+    uint8_t operator[](int index) const { return (_address >> (index * 8)) & 0xFF; }
+    bool operator==(const IPAddress& other) const { return _address == other._address; }
+
+    bool fromString(const char* text);
+    String toString() const;
+    size_t printTo(Print& out) const override { return out.print(toString()); }
+
+private:
+    uint32_t _address;  // First octet in the low byte, as on the ESP32
+};
+
+class HardwareSerial : public Print {
+public:
+    void begin(unsigned long baud) { (void)baud; }
+    void end() {}
+    void flush();
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t* data, size_t length) override;
+    operator bool() const { return true; }
+    using Print::write;
+};
+
+extern HardwareSerial Serial;
+
+unsigned long millis();
+unsigned long micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+void yield();
+uint32_t getCpuFrequencyMhz();
+
+void pinMode(uint8_t pin, uint8_t mode);
+int digitalRead(uint8_t pin);
+void digitalWrite(uint8_t pin, uint8_t value);
+
+void configTime(long gmtOffsetSec, int daylightOffsetSec, const char* server1, const char* server2 = nullptr,
+                const char* server3 = nullptr);
+
+#endif  // SIM_ARDUINO_H
@@ -0,0 +1,84 @@
+#ifndef SIM_HTTP_CLIENT_H
+#define SIM_HTTP_CLIENT_H
+
+// HTTP/1.1 client with the interface of the Arduino-ESP32 HTTPClient
+// Requests keep their path but go to the stand-in server, with the simulated time
+// in X-Sim-Time so responses can change over the simulated day
+
+#include <vector>
+
+#include "WiFi.h"
+
+#define HTTP_CODE_OK 200
+#define HTTP_CODE_PARTIAL_CONTENT 206
+#define HTTP_CODE_NOT_MODIFIED 304
+#define HTTP_CODE_NOT_FOUND 404
+#define HTTP_CODE_RANGE_NOT_SATISFIABLE 416
+
+#define HTTPC_ERROR_CONNECTION_REFUSED (-1)
+#define HTTPC_ERROR_SEND_HEADER_FAILED (-2)
+#define HTTPC_ERROR_SEND_PAYLOAD_FAILED (-3)
+#define HTTPC_ERROR_NOT_CONNECTED (-4)
+#define HTTPC_ERROR_CONNECTION_LOST (-5)
+#define HTTPC_ERROR_NO_STREAM (-6)
+#define HTTPC_ERROR_NO_HTTP_SERVER (-7)
+#define HTTPC_ERROR_TOO_LESS_RAM (-8)
+#define HTTPC_ERROR_ENCODING (-9)
+#define HTTPC_ERROR_STREAM_WRITE (-10)
+#define HTTPC_ERROR_READ_TIMEOUT (-11)
+
+class HTTPClient {
+public:
+    HTTPClient() {}
+    ~HTTPClient() { end(); }
+
+    bool begin(const String& url);
+    bool begin(WiFiClient& client, const String& url);
+    void end();
+
+    void setTimeout(uint16_t timeoutMs) { _timeoutMs = timeoutMs; }
+    void setConnectTimeout(int32_t timeoutMs) { (void)timeoutMs; }
+    void setReuse(bool reuse) { (void)reuse; }
+    void useHTTP10(bool http10 = true) { _http10 = http10; }
+
+    void addHeader(const String& name, const String& value, bool first = false, bool replace = true);
+    void collectHeaders(const char* headerKeys[], const size_t headerKeysCount);
+    String header(const char* name);
+    bool hasHeader(const char* name);
+
+    int GET();
+    int POST(const String& payload);
+    int POST(const uint8_t* payload, size_t size);
+    int sendRequest(const char* method, const uint8_t* payload = nullptr, size_t size = 0);
+
+    int getSize() { return _size; }
+    WiFiClient* getStreamPtr() { return _connected ? _client : nullptr; }
+    WiFiClient& getStream() { return *_client; }
+    String getString();
+    bool connected() { return _client != nullptr && _client->connected(); }
+
+    static String errorToString(int error);
+
+private:
+    struct Header {
+        String name;
+        String value;
+    };
+
+    bool _secure = false;
+    String _host;
+    uint16_t _port = 80;
+    String _path;
+    WiFiClient* _client = nullptr;
+    WiFiClient _ownClient;
+    bool _connected = false;
+    bool _http10 = false;
+    uint16_t _timeoutMs = 5000;
+
+    std::vector<Header> _requestHeaders;
+    std::vector<Header> _responseHeaders;  // Collected ones only, as on the device
+    int _size = -1;
+    bool _chunked = false;
+};
+
+#endif  // SIM_HTTP_CLIENT_H
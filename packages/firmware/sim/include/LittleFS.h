@@ -0,0 +1,56 @@
+#ifndef SIM_LITTLEFS_H
+#define SIM_LITTLEFS_H
+
+// Flash file system kept in a host directory that persists across simulated wakes
+
+#include <stdio.h>
+
+#include "Arduino.h"
+
+class File {
+public:
+    File() {}
+    File(FILE* file, const String& path) : _file(file), _path(path) {}
+    File(const File&) = delete;
+    File& operator=(const File&) = delete;
+    File(File&& other) : _file(other._file), _path(other._path) { other._file = nullptr; }
+    File& operator=(File&& other);
+    ~File() { close(); }
+
+    operator bool() const { return _file != nullptr; }
+    size_t read(uint8_t* buffer, size_t length);
+    int read();
+    size_t write(const uint8_t* buffer, size_t length);
+    size_t write(uint8_t c) { return write(&c, 1); }
+    bool seek(uint32_t position);
+    size_t position();
+    size_t size();
+    int available();
+    void flush();
+    void close();
+    const char* path() const { return _path.c_str(); }
+
+private:
+    FILE* _file = nullptr;
+    String _path;
+};
+
+class LittleFSFS {
+public:
+    bool begin(bool formatOnFail = false, const char* basePath = "/littlefs", uint8_t maxOpenFiles = 10,
+               const char* partitionLabel = "spiffs");
+    void end() {}
+    bool format();
+    File open(const char* path, const char* mode = "r");
+    File open(const String& path, const char* mode = "r") { return open(path.c_str(), mode); }
+    bool exists(const char* path);
+    bool mkdir(const char* path);
+    bool rename(const char* from, const char* to);
+    bool remove(const char* path);
+    size_t totalBytes();
+    size_t usedBytes();
+};
+
+extern LittleFSFS LittleFS;
+
+#endif  // SIM_LITTLEFS_H
@@ -0,0 +1,113 @@
+#ifndef SIM_TFT_ESPI_H
+#define SIM_TFT_ESPI_H
+
+// Stand-in for the Seeed GFX library (TFT_eSPI with the EPaper extension)
+// Sprites keep real pixel buffers; EPaper's is the panel's packed 4-bit buffer,
+// written out as a PNG on every update(). Text is drawn as one filled box per
+// character, which is enough to see layout and to change the frame hash
+
+#include <vector>
+
+#include "Arduino.h"
+
+#define EPAPER_ENABLE 1
+
+#define TFT_BLACK 0x0000
+#define TFT_WHITE 0xFFFF
+#define TFT_RED 0xF800
+#define TFT_YELLOW 0xFFE0
+#define TFT_BLUE 0x001F
+#define TFT_GREEN 0x07E0
+
+#define TL_DATUM 0
+#define MC_DATUM 4
+
+class TFT_eSPI : public Print {
+public:
+    TFT_eSPI(int16_t width = 0, int16_t height = 0) : _width(width), _height(height) {}
+
+    virtual void drawPixel(int32_t x, int32_t y, uint32_t color) { (void)x, (void)y, (void)color; }
+    virtual void fillRect(int32_t x, int32_t y, int32_t w, int32_t h, uint32_t color);
+    void fillScreen(uint32_t color) { fillRect(0, 0, _width, _height, color); }
+    void drawRect(int32_t x, int32_t y, int32_t w, int32_t h, uint32_t color);
+    void drawFastHLine(int32_t x, int32_t y, int32_t w, uint32_t color) { fillRect(x, y, w, 1, color); }
+    void drawFastVLine(int32_t x, int32_t y, int32_t h, uint32_t color) { fillRect(x, y, 1, h, color); }
+
+    int16_t width() const { return _width; }
+    int16_t height() const { return _height; }
+
+    void setTextFont(uint8_t font) { _textFont = font; }
+    void setTextSize(uint8_t size) { _textSize = size > 0 ? size : 1; }
+    void setTextColor(uint16_t color) { _textColor = _textBackground = color; }
+    void setTextColor(uint16_t color, uint16_t background) {
+        _textColor = color;
+        _textBackground = background;
+    }
+    void setTextDatum(uint8_t datum) { (void)datum; }
+    void setCursor(int16_t x, int16_t y) {
+        _cursorX = _cursorLeft = x;
+        _cursorY = y;
+    }
+    void setFreeFont(const void* font) { (void)font; }
+
+    int16_t textWidth(const char* text);
+    int16_t textWidth(const String& text) { return textWidth(text.c_str()); }
+    int16_t fontHeight();
+    int16_t drawString(const char* text, int32_t x, int32_t y);
+    int16_t drawString(const String& text, int32_t x, int32_t y) { return drawString(text.c_str(), x, y); }
+
+    size_t write(uint8_t c) override;
+    using Print::write;
+
+protected:
+    int16_t charWidth() { return 6 * fontScale() * _textSize; }
+    int16_t fontScale();
+    void drawGlyph(char c, int32_t x, int32_t y);
+
+    int16_t _width;
+    int16_t _height;
+    uint8_t _textFont = 1;
+    uint8_t _textSize = 1;
+    uint16_t _textColor = TFT_WHITE;
+    uint16_t _textBackground = TFT_WHITE;
+    int32_t _cursorX = 0;
+    int32_t _cursorY = 0;
+    int32_t _cursorLeft = 0;
+};
+
+class TFT_eSprite : public TFT_eSPI {
+public:
+    explicit TFT_eSprite(TFT_eSPI* parent = nullptr) { (void)parent; }
+
+    void setColorDepth(int8_t bits) { _bits = bits; }
+    int8_t getColorDepth() const { return _bits; }
+    void* createSprite(int16_t width, int16_t height, uint8_t frames = 1);
+    void deleteSprite();
+    void fillSprite(uint32_t color) { fillScreen(color); }
+    void* getPointer() { return _buffer.empty() ? nullptr : _buffer.data(); }
+
+    void drawPixel(int32_t x, int32_t y, uint32_t color) override;
+    void fillRect(int32_t x, int32_t y, int32_t w, int32_t h, uint32_t color) override;
+    uint16_t readPixel(int32_t x, int32_t y);
+
+protected:
+    size_t stride() const;
+
+    int8_t _bits = 16;
+    std::vector<uint8_t> _buffer;
+};
+
+// Native 4-bit value of each ink in the EPaper buffer (ED2208 controller order)
+uint8_t epaperNibble(uint32_t color);
+
+class EPaper : public TFT_eSprite {
+public:
+    EPaper();
+
+    void begin();
+    void update();  // Charged as a panel refresh, then written out as a PNG
+    void sleep() {}
+    void wake() {}
+};
+
+#endif  // SIM_TFT_ESPI_H
@@ -0,0 +1,128 @@
+#ifndef SIM_WIFI_H
+#define SIM_WIFI_H
+
+// WiFi station and TCP client for the simulator
+// Connecting is instant in host time and charged to the latency model; every TCP
+// connection goes to the stand-in server (sim/server.py) whatever the host
+
+#include <string>
+
+#include "Arduino.h"
+
+typedef enum {
+    WL_IDLE_STATUS = 0,
+    WL_NO_SSID_AVAIL = 1,
+    WL_SCAN_COMPLETED = 2,
+    WL_CONNECTED = 3,
+    WL_CONNECT_FAILED = 4,
+    WL_CONNECTION_LOST = 5,
+    WL_DISCONNECTED = 6
+} wl_status_t;
+
+typedef enum { WIFI_OFF = 0, WIFI_STA = 1, WIFI_AP = 2, WIFI_AP_STA = 3 } wifi_mode_t;
+
+typedef enum {
+    ARDUINO_EVENT_WIFI_STA_START,
+    ARDUINO_EVENT_WIFI_STA_STOP,
+    ARDUINO_EVENT_WIFI_STA_CONNECTED,
+    ARDUINO_EVENT_WIFI_STA_DISCONNECTED,
+    ARDUINO_EVENT_WIFI_STA_GOT_IP,
+    ARDUINO_EVENT_MAX
+} arduino_event_id_t;
+
+typedef union {
+    struct {
+        uint8_t reason;
+    } wifi_sta_disconnected;
+} arduino_event_info_t;
+
+typedef void (*WiFiEventSysCb)(arduino_event_id_t event, arduino_event_info_t info);
+typedef size_t wifi_event_id_t;
+
+class WiFiClient : public Print {
+public:
+    WiFiClient() {}
+    ~WiFiClient() override;
+    WiFiClient(const WiFiClient&) = delete;
+    WiFiClient& operator=(const WiFiClient&) = delete;
+
+    virtual int connect(IPAddress ip, uint16_t port);
+    virtual int connect(IPAddress ip, uint16_t port, int32_t timeout);
+    virtual int connect(const char* host, uint16_t port);
+    virtual int connect(const char* host, uint16_t port, int32_t timeout);
+
+    size_t write(uint8_t data) override;
+    size_t write(const uint8_t* buf, size_t size) override;
+    virtual int available();
+    virtual int read();
+    virtual int read(uint8_t* buf, size_t size);
+    virtual size_t readBytes(char* buffer, size_t length);
+    size_t readBytes(uint8_t* buffer, size_t length) { return readBytes((char*)buffer, length); }
+    virtual int peek();
+    virtual void flush() {}
+    virtual void stop();
+    virtual uint8_t connected();
+    virtual operator bool() { return connected(); }
+
+    void setTimeout(unsigned long timeoutMs) { _timeoutMs = timeoutMs; }
+
+    // Reads up to and including '\n' (stripped, with any '\r'), for HTTP headers
+    String readStringUntil(char terminator);
+
+private:
+    bool fill(int waitMs);
+
+    int _socket = -1;
+    bool _eof = false;
+    uint8_t _buffer[4096];
+    size_t _bufferStart = 0;
+    size_t _bufferEnd = 0;
+    unsigned long _timeoutMs = 5000;
+};
+
+class WiFiClass {
+public:
+    bool mode(wifi_mode_t mode);
+    wifi_mode_t getMode() { return _mode; }
+    wl_status_t begin(const char* ssid, const char* passphrase = nullptr, int32_t channel = 0,
+                      const uint8_t* bssid = nullptr, bool connect = true);
+    bool config(IPAddress localIp, IPAddress gateway, IPAddress subnet, IPAddress dns1 = IPAddress(),
+                IPAddress dns2 = IPAddress());
+    bool disconnect(bool wifiOff = false, bool eraseAp = false);
+    wl_status_t status() { return _status; }
+
+    IPAddress localIP() { return _ip; }
+    IPAddress gatewayIP() { return _gateway; }
+    IPAddress subnetMask() { return _subnet; }
+    IPAddress dnsIP(uint8_t index = 0) { return index == 0 ? _dns : IPAddress(); }
+    uint8_t* BSSID() { return _bssid; }
+    String BSSIDstr();
+    int32_t channel() { return _status == WL_CONNECTED ? 6 : 0; }
+    int8_t RSSI() { return _status == WL_CONNECTED ? -61 : 0; }
+
+    wifi_event_id_t onEvent(WiFiEventSysCb callback, arduino_event_id_t event = ARDUINO_EVENT_MAX);
+    void removeEvent(wifi_event_id_t id);
+
+    void persistent(bool persistent) { (void)persistent; }
+    bool setAutoReconnect(bool autoReconnect) { return (void)autoReconnect, true; }
+    bool setSleep(bool enabled) { return (void)enabled, true; }
+    bool setTxPower(int power) { return (void)power, true; }
+
+private:
+    void emit(arduino_event_id_t event);
+
+    wifi_mode_t _mode = WIFI_OFF;
+    wl_status_t _status = WL_IDLE_STATUS;
+    bool _staticIp = false;  // config() was given an address, so there's no DHCP
+    IPAddress _ip, _gateway, _subnet, _dns;
+    uint8_t _bssid[6] = {0x24, 0x5A, 0x4C, 0x10, 0x20, 0x30};
+    struct Handler {
+        WiFiEventSysCb callback;
+        arduino_event_id_t event;
+    } _handlers[8];
+    size_t _handlerCount = 0;
+};
+
+extern WiFiClass WiFi;
+
+#endif  // SIM_WIFI_H
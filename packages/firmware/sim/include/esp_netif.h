@@ -0,0 +1,10 @@
+#ifndef SIM_ESP_NETIF_H
+#define SIM_ESP_NETIF_H
+
+// Only the station interface exists; its lwIP netif carries the DHCP lease
+
+typedef struct esp_netif_obj esp_netif_t;
+
+esp_netif_t* esp_netif_get_handle_from_ifkey(const char* if_key);
+
+#endif  // SIM_ESP_NETIF_H
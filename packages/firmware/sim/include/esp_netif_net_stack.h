@@ -0,0 +1,9 @@
+#ifndef SIM_ESP_NETIF_NET_STACK_H
+#define SIM_ESP_NETIF_NET_STACK_H
+
+#include "esp_netif.h"
+
+// The lwIP netif behind an esp_netif handle
+void* esp_netif_get_netif_impl(esp_netif_t* esp_netif);
+
+#endif  // SIM_ESP_NETIF_NET_STACK_H
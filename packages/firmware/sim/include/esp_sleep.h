@@ -0,0 +1,32 @@
+#ifndef SIM_ESP_SLEEP_H
+#define SIM_ESP_SLEEP_H
+
+#include <stdint.h>
+
+#include "esp_err.h"
+
+typedef enum {
+    ESP_SLEEP_WAKEUP_UNDEFINED,
+    ESP_SLEEP_WAKEUP_ALL,
+    ESP_SLEEP_WAKEUP_EXT0,
+    ESP_SLEEP_WAKEUP_EXT1,
+    ESP_SLEEP_WAKEUP_TIMER,
+    ESP_SLEEP_WAKEUP_TOUCHPAD,
+    ESP_SLEEP_WAKEUP_ULP,
+    ESP_SLEEP_WAKEUP_GPIO,
+} esp_sleep_wakeup_cause_t;
+
+typedef enum { ESP_EXT1_WAKEUP_ANY_LOW = 0, ESP_EXT1_WAKEUP_ANY_HIGH = 1 } esp_sleep_ext1_wakeup_mode_t;
+
+esp_sleep_wakeup_cause_t esp_sleep_get_wakeup_cause();
+uint64_t esp_sleep_get_ext1_wakeup_status();
+esp_err_t esp_sleep_enable_timer_wakeup(uint64_t timeMicros);
+esp_err_t esp_sleep_enable_ext1_wakeup(uint64_t mask, esp_sleep_ext1_wakeup_mode_t mode);
+esp_err_t esp_sleep_enable_gpio_wakeup();
+esp_err_t esp_sleep_disable_wakeup_source(esp_sleep_wakeup_cause_t source);
+esp_err_t esp_light_sleep_start();
+
+// Ends the wake: RTC memory and the wake sources are handed back to the simulator
+void esp_deep_sleep_start() __attribute__((noreturn));
+
+#endif  // SIM_ESP_SLEEP_H
@@ -0,0 +1,11 @@
+#ifndef SIM_ESP_SNTP_H
+#define SIM_ESP_SNTP_H
+
+// The sync completes ntp_ms of virtual time after configTime() while WiFi is up,
+// and sets the clock to the simulator's true time
+typedef enum { SNTP_SYNC_STATUS_RESET, SNTP_SYNC_STATUS_COMPLETED, SNTP_SYNC_STATUS_IN_PROGRESS } sntp_sync_status_t;
+
+sntp_sync_status_t sntp_get_sync_status();
+void sntp_set_sync_status(sntp_sync_status_t status);
+
+#endif  // SIM_ESP_SNTP_H
@@ -0,0 +1,11 @@
+#ifndef SIM_ESP_TASK_WDT_H
+#define SIM_ESP_TASK_WDT_H
+
+#include "esp_sleep.h"
+#include "freertos.h"
+
+inline esp_err_t esp_task_wdt_add(TaskHandle_t) { return ESP_OK; }
+inline esp_err_t esp_task_wdt_delete(TaskHandle_t) { return ESP_OK; }
+inline esp_err_t esp_task_wdt_reset() { return ESP_OK; }
+
+#endif  // SIM_ESP_TASK_WDT_H
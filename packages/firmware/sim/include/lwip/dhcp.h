@@ -0,0 +1,14 @@
+#ifndef SIM_LWIP_DHCP_H
+#define SIM_LWIP_DHCP_H
+
+#include <stdint.h>
+
+#include "lwip/netif.h"
+
+struct dhcp {
+    uint32_t offered_t0_lease;  // Lease time in seconds from the server's ACK
+};
+
+#define netif_dhcp_data(netif) ((netif)->dhcp)
+
+#endif  // SIM_LWIP_DHCP_H
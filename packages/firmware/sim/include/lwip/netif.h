@@ -0,0 +1,11 @@
+#ifndef SIM_LWIP_NETIF_H
+#define SIM_LWIP_NETIF_H
+
+struct dhcp;
+
+// Only the DHCP client data is modeled
+struct netif {
+    struct dhcp* dhcp;  // nullptr unless the address came from DHCP
+};
+
+#endif  // SIM_LWIP_NETIF_H
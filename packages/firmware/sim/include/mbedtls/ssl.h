@@ -0,0 +1,14 @@
+#ifndef SIM_MBEDTLS_SSL_H
+#define SIM_MBEDTLS_SSL_H
+
+// Only the types src/resumable_tls_client.h names; the simulator's TLS client is
+// plain TCP with the handshake charged to the latency model (sim/tls.cpp)
+typedef struct {
+    int unused;
+} mbedtls_ssl_context;
+
+typedef struct {
+    int unused;
+} mbedtls_ssl_config;
+
+#endif  // SIM_MBEDTLS_SSL_H
@@ -0,0 +1,136 @@
+// LittleFS on a host directory (the simulator's flash directory)
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "LittleFS.h"
+#include "sim.h"
+
+LittleFSFS LittleFS;
+
+namespace {
+
+const size_t FLASH_PARTITION_SIZE = 1536 * 1024;  // LittleFS partition of default.csv
+
+std::string hostPath(const char* path) {
+    return std::string(sim::wake->flashDir) + (path[0] == '/' ? "" : "/") + path;
+}
+
+size_t directorySize(const std::string& path) {
+    size_t total = 0;
+    DIR* dir = opendir(path.c_str());
+    if (dir == nullptr) {
+        return 0;
+    }
+    while (struct dirent* entry = readdir(dir)) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+        std::string child = path + "/" + entry->d_name;
+        struct stat info;
+        if (stat(child.c_str(), &info) == 0) {
+            total += S_ISDIR(info.st_mode) ? directorySize(child) : (size_t)info.st_size;
+        }
+    }
+    closedir(dir);
+    return total;
+}
+
+}  // namespace
+
+File& File::operator=(File&& other) {
+    if (this != &other) {
+        close();
+        _file = other._file;
+        _path = other._path;
+        other._file = nullptr;
+    }
+    return *this;
+}
+
+size_t File::read(uint8_t* buffer, size_t length) {
+    return _file != nullptr ? fread(buffer, 1, length, _file) : 0;
+}
+
+int File::read() {
+    uint8_t c;
+    return read(&c, 1) == 1 ? c : -1;
+}
+
+size_t File::write(const uint8_t* buffer, size_t length) {
+    return _file != nullptr ? fwrite(buffer, 1, length, _file) : 0;
+}
+
+bool File::seek(uint32_t position) {
+    return _file != nullptr && fseek(_file, position, SEEK_SET) == 0;
+}
+
+size_t File::position() {
+    return _file != nullptr ? (size_t)ftell(_file) : 0;
+}
+
+size_t File::size() {
+    if (_file == nullptr) {
+        return 0;
+    }
+    fflush(_file);
+    struct stat info;
+    return fstat(fileno(_file), &info) == 0 ? (size_t)info.st_size : 0;
+}
+
+int File::available() {
+    return _file != nullptr ? (int)(size() - position()) : 0;
+}
+
+void File::flush() {
+    if (_file != nullptr) fflush(_file);
+}
+
+void File::close() {
+    if (_file != nullptr) {
+        fclose(_file);
+        _file = nullptr;
+    }
+}
+
+bool LittleFSFS::begin(bool formatOnFail, const char* basePath, uint8_t maxOpenFiles, const char* partitionLabel) {
+    (void)basePath, (void)maxOpenFiles, (void)partitionLabel;
+    struct stat info;
+    if (stat(sim::wake->flashDir, &info) == 0) {
+        return S_ISDIR(info.st_mode);
+    }
+    return formatOnFail && format();
+}
+
+bool LittleFSFS::format() {
+    return ::mkdir(sim::wake->flashDir, 0755) == 0;
+}
+
+File LittleFSFS::open(const char* path, const char* mode) {
+    std::string binaryMode = std::string(mode) + "b";
+    FILE* file = fopen(hostPath(path).c_str(), binaryMode.c_str());
+    return file != nullptr ? File(file, path) : File();
+}
+
+bool LittleFSFS::exists(const char* path) {
+    struct stat info;
+    return stat(hostPath(path).c_str(), &info) == 0;
+}
+
+bool LittleFSFS::mkdir(const char* path) {
+    return ::mkdir(hostPath(path).c_str(), 0755) == 0;
+}
+
+bool LittleFSFS::rename(const char* from, const char* to) {
+    return ::rename(hostPath(from).c_str(), hostPath(to).c_str()) == 0;
+}
+
+bool LittleFSFS::remove(const char* path) {
+    return ::remove(hostPath(path).c_str()) == 0;
+}
+
+size_t LittleFSFS::totalBytes() {
+    return FLASH_PARTITION_SIZE;
+}
+
+size_t LittleFSFS::usedBytes() {
+    return directorySize(sim::wake->flashDir);
+}
@@ -0,0 +1,532 @@
+// WiFi station, TCP client and HTTP client for the simulator
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "HTTPClient.h"
+#include "WiFi.h"
+#include "config.h"
+#include "esp_netif_net_stack.h"
+#include "lwip/dhcp.h"
+#include "sim.h"
+
+WiFiClass WiFi;
+
+struct esp_netif_obj {
+    struct netif netif;
+    struct dhcp dhcp;
+};
+
+static esp_netif_obj stationNetif = {};
+
+// ---- WiFi ----
+
+bool WiFiClass::mode(wifi_mode_t mode) {
+    _mode = mode;
+    if (mode == WIFI_OFF) {
+        _status = WL_DISCONNECTED;
+    }
+    sim::setRadio(mode != WIFI_OFF);
+    return true;
+}
+
+bool WiFiClass::config(IPAddress localIp, IPAddress gateway, IPAddress subnet, IPAddress dns1, IPAddress dns2) {
+    (void)dns2;
+    _staticIp = (uint32_t)localIp != 0;
+    _ip = localIp;
+    _gateway = gateway;
+    _subnet = subnet;
+    _dns = dns1;
+    return true;
+}
+
+// Associates at once in host time; the model charges a directed connection when
+// the BSSID and channel are given, a scan otherwise, plus DHCP without a lease
+wl_status_t WiFiClass::begin(const char* ssid, const char* passphrase, int32_t channel, const uint8_t* bssid,
+                             bool connect) {
+    (void)ssid, (void)passphrase;
+    if (_mode == WIFI_OFF) {
+        mode(WIFI_STA);
+    }
+    if (!connect) {
+        return _status;
+    }
+
+    bool directed = channel > 0 && bssid != nullptr;
+    sim::advance(directed ? sim::model.wifi_fast_ms : sim::model.wifi_scan_ms);
+    emit(ARDUINO_EVENT_WIFI_STA_CONNECTED);
+
+    if (!_staticIp) {
+        sim::advance(sim::model.dhcp_ms);
+        stationNetif.dhcp.offered_t0_lease = (uint32_t)sim::model.dhcp_lease_s;
+        stationNetif.netif.dhcp = &stationNetif.dhcp;
+        _ip = IPAddress(192, 168, 1, 77);
+        _gateway = IPAddress(192, 168, 1, 1);
+        _subnet = IPAddress(255, 255, 255, 0);
+        _dns = _gateway;
+    }
+    _status = WL_CONNECTED;
+    emit(ARDUINO_EVENT_WIFI_STA_GOT_IP);
+    return _status;
+}
+
+esp_netif_t* esp_netif_get_handle_from_ifkey(const char* if_key) {
+    return strcmp(if_key, "WIFI_STA_DEF") == 0 ? &stationNetif : nullptr;
+}
+
+void* esp_netif_get_netif_impl(esp_netif_t* esp_netif) {
+    return &esp_netif->netif;
+}
+
+bool WiFiClass::disconnect(bool wifiOff, bool eraseAp) {
+    (void)eraseAp;
+    bool wasConnected = _status == WL_CONNECTED;
+    _status = WL_DISCONNECTED;
+    if (wasConnected) {
+        emit(ARDUINO_EVENT_WIFI_STA_DISCONNECTED);
+    }
+    if (wifiOff) {
+        mode(WIFI_OFF);
+    }
+    return true;
+}
+
+String WiFiClass::BSSIDstr() {
+    char text[18];
+    snprintf(text, sizeof(text), "%02X:%02X:%02X:%02X:%02X:%02X", _bssid[0], _bssid[1], _bssid[2], _bssid[3],
+             _bssid[4], _bssid[5]);
+    return String(text);
+}
+
+wifi_event_id_t WiFiClass::onEvent(WiFiEventSysCb callback, arduino_event_id_t event) {
+    if (_handlerCount == sizeof(_handlers) / sizeof(_handlers[0])) {
+        return 0;
+    }
+    _handlers[_handlerCount] = {callback, event};
+    return ++_handlerCount;
+}
+
+void WiFiClass::removeEvent(wifi_event_id_t id) {
+    if (id > 0 && id <= _handlerCount) {
+        _handlers[id - 1].callback = nullptr;
+    }
+}
+
+void WiFiClass::emit(arduino_event_id_t event) {
+    arduino_event_info_t info = {};
+    for (size_t i = 0; i < _handlerCount; i++) {
+        if (_handlers[i].callback != nullptr &&
+            (_handlers[i].event == ARDUINO_EVENT_MAX || _handlers[i].event == event)) {
+            _handlers[i].callback(event, info);
+        }
+    }
+}
+
+// ---- TCP ----
+
+WiFiClient::~WiFiClient() {
+    stop();
+}
+
+int WiFiClient::connect(IPAddress ip, uint16_t port) {
+    return connect(ip.toString().c_str(), port);
+}
+
+int WiFiClient::connect(IPAddress ip, uint16_t port, int32_t timeout) {
+    (void)timeout;
+    return connect(ip, port);
+}
+
+int WiFiClient::connect(const char* host, uint16_t port, int32_t timeout) {
+    (void)timeout;
+    return connect(host, port);
+}
+
+// Whatever the host, the connection goes to the stand-in server
+int WiFiClient::connect(const char* host, uint16_t port) {
+    (void)host, (void)port;
+    stop();
+    if (WiFi.status() != WL_CONNECTED) {
+        return 0;
+    }
+
+    struct addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo* addresses;
+    char service[8];
+    snprintf(service, sizeof(service), "%u", sim::wake->port);
+    if (getaddrinfo(sim::wake->host, service, &hints, &addresses) != 0) {
+        return 0;
+    }
+
+    for (struct addrinfo* address = addresses; address != nullptr && _socket < 0; address = address->ai_next) {
+        _socket = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+        if (_socket >= 0 && ::connect(_socket, address->ai_addr, address->ai_addrlen) != 0) {
+            close(_socket);
+            _socket = -1;
+        }
+    }
+    freeaddrinfo(addresses);
+    if (_socket < 0) {
+        return 0;
+    }
+
+    int noDelay = 1;
+    setsockopt(_socket, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+    _eof = false;
+    _bufferStart = _bufferEnd = 0;
+    sim::advance(sim::model.rtt_ms);  // SYN, SYN-ACK
+    return 1;
+}
+
+size_t WiFiClient::write(uint8_t data) {
+    return write(&data, 1);
+}
+
+size_t WiFiClient::write(const uint8_t* buf, size_t size) {
+    if (_socket < 0) {
+        return 0;
+    }
+    size_t sent = 0;
+    while (sent < size) {
+        ssize_t n = send(_socket, buf + sent, size - sent, MSG_NOSIGNAL);
+        if (n <= 0) {
+            break;
+        }
+        sent += n;
+    }
+    sim::countSent(sent);
+    return sent;
+}
+
+// Reads what the server has sent, waiting up to waitMs of host time for it.
+// Waiting for the local server is not network time on the device - transfers are
+// charged by size in countReceived() - so an empty buffer only means the end
+bool WiFiClient::fill(int waitMs) {
+    if (_bufferStart < _bufferEnd) {
+        return true;
+    }
+    if (_socket < 0 || _eof) {
+        return false;
+    }
+
+    struct pollfd pfd = {_socket, POLLIN, 0};
+    if (poll(&pfd, 1, waitMs) <= 0) {
+        return false;
+    }
+    ssize_t n = recv(_socket, _buffer, sizeof(_buffer), 0);
+    if (n <= 0) {
+        _eof = true;
+        return false;
+    }
+    _bufferStart = 0;
+    _bufferEnd = n;
+    sim::countReceived(n);
+    return true;
+}
+
+int WiFiClient::available() {
+    fill(_timeoutMs);
+    return _bufferEnd - _bufferStart;
+}
+
+int WiFiClient::read() {
+    uint8_t c;
+    return read(&c, 1) == 1 ? c : -1;
+}
+
+int WiFiClient::read(uint8_t* buf, size_t size) {
+    if (!fill(0)) {
+        return _eof || _socket < 0 ? -1 : 0;
+    }
+    size_t n = std::min(size, _bufferEnd - _bufferStart);
+    memcpy(buf, _buffer + _bufferStart, n);
+    _bufferStart += n;
+    return n;
+}
+
+size_t WiFiClient::readBytes(char* buffer, size_t length) {
+    size_t total = 0;
+    while (total < length && fill(_timeoutMs)) {
+        size_t n = std::min(length - total, _bufferEnd - _bufferStart);
+        memcpy(buffer + total, _buffer + _bufferStart, n);
+        _bufferStart += n;
+        total += n;
+    }
+    return total;
+}
+
+int WiFiClient::peek() {
+    return fill(_timeoutMs) ? _buffer[_bufferStart] : -1;
+}
+
+String WiFiClient::readStringUntil(char terminator) {
+    String line;
+    int c;
+    while (fill(_timeoutMs) && (c = _buffer[_bufferStart++]) != terminator) {
+        if (c != '\r') line.concat((char)c);
+    }
+    return line;
+}
+
+void WiFiClient::stop() {
+    if (_socket >= 0) {
+        close(_socket);
+        _socket = -1;
+    }
+    _bufferStart = _bufferEnd = 0;
+}
+
+uint8_t WiFiClient::connected() {
+    if (_bufferStart < _bufferEnd) {
+        return 1;
+    }
+    if (_socket < 0 || _eof) {
+        return 0;
+    }
+
+    // Still open unless the server has closed its end
+    struct pollfd pfd = {_socket, POLLIN, 0};
+    if (poll(&pfd, 1, 0) > 0) {
+        return fill(0) ? 1 : 0;
+    }
+    return 1;
+}
+
+// ---- HTTP ----
+
+bool HTTPClient::begin(const String& url) {
+    end();
+    const char* text = url.c_str();
+    const char* rest;
+    if (strncmp(text, "https://", 8) == 0) {
+        _secure = true;
+        _port = 443;
+        rest = text + 8;
+    } else if (strncmp(text, "http://", 7) == 0) {
+        _secure = false;
+        _port = 80;
+        rest = text + 7;
+    } else {
+        return false;
+    }
+
+    const char* slash = strchr(rest, '/');
+    String authority = slash != nullptr ? String(std::string(rest, slash - rest)) : String(rest);
+    _path = slash != nullptr ? String(slash) : String("/");
+
+    int colon = authority.indexOf(':');
+    if (colon >= 0) {
+        _port = authority.substring(colon + 1).toInt();
+        authority.remove(colon);
+    }
+    _host = authority;
+    _client = &_ownClient;
+    return true;
+}
+
+bool HTTPClient::begin(WiFiClient& client, const String& url) {
+    if (!begin(url)) {
+        return false;
+    }
+    _client = &client;
+    return true;
+}
+
+void HTTPClient::end() {
+    if (_client != nullptr) {
+        _client->stop();
+    }
+    _client = nullptr;
+    _connected = false;
+    _requestHeaders.clear();
+    _size = -1;
+    _chunked = false;
+}
+
+void HTTPClient::addHeader(const String& name, const String& value, bool first, bool replace) {
+    if (replace) {
+        for (Header& header : _requestHeaders) {
+            if (header.name.equalsIgnoreCase(name)) {
+                header.value = value;
+                return;
+            }
+        }
+    }
+    Header header = {name, value};
+    _requestHeaders.insert(first ? _requestHeaders.begin() : _requestHeaders.end(), header);
+}
+
+void HTTPClient::collectHeaders(const char* headerKeys[], const size_t headerKeysCount) {
+    _responseHeaders.clear();
+    for (size_t i = 0; i < headerKeysCount; i++) {
+        _responseHeaders.push_back({String(headerKeys[i]), String()});
+    }
+}
+
+String HTTPClient::header(const char* name) {
+    for (const Header& header : _responseHeaders) {
+        if (header.name.equalsIgnoreCase(name)) return header.value;
+    }
+    return String();
+}
+
+bool HTTPClient::hasHeader(const char* name) {
+    return header(name).length() > 0;
+}
+
+int HTTPClient::GET() {
+    return sendRequest("GET");
+}
+
+int HTTPClient::POST(const String& payload) {
+    return sendRequest("POST", (const uint8_t*)payload.c_str(), payload.length());
+}
+
+int HTTPClient::POST(const uint8_t* payload, size_t size) {
+    return sendRequest("POST", payload, size);
+}
+
+int HTTPClient::sendRequest(const char* method, const uint8_t* payload, size_t size) {
+    if (_client == nullptr) {
+        return HTTPC_ERROR_NOT_CONNECTED;
+    }
+    sim::wake->requests++;
+
+    // Plain HTTPClient.begin(url) with https would bring its own TLS client
+    if (_client == &_ownClient && _secure) {
+        sim::advance(sim::model.tls_full_ms);
+    }
+    if (!_client->connect(_host.c_str(), _port)) {
+        return HTTPC_ERROR_CONNECTION_REFUSED;
+    }
+    _client->setTimeout(_timeoutMs);
+
+    char simTime[32];
+    snprintf(simTime, sizeof(simTime), "%lld", (long long)(sim::trueTimeMicros() / 1000000));
+
+    String request = String(method) + " " + _path + (_http10 ? " HTTP/1.0\r\n" : " HTTP/1.1\r\n");
+    request += "Host: " + _host + "\r\n";
+    request += "User-Agent: ESP32HTTPClient\r\nConnection: close\r\n";
+    request += String("X-Sim-Time: ") + simTime + "\r\n";
+    for (const Header& header : _requestHeaders) {
+        request += header.name + ": " + header.value + "\r\n";
+    }
+    if (payload != nullptr || strcmp(method, "POST") == 0) {
+        request += "Content-Length: " + String((unsigned long)size) + "\r\n";
+    }
+    request += "\r\n";
+
+    if (_client->write((const uint8_t*)request.c_str(), request.length()) != request.length() ||
+        (size > 0 && _client->write(payload, size) != size)) {
+        return HTTPC_ERROR_SEND_HEADER_FAILED;
+    }
+
+    // Request out, first byte back
+    int query = _path.indexOf('?');
+    const char* servicePath = strchr(strstr(SERVICE_API_URL, "//") + 2, '/');
+    bool generate = servicePath != nullptr && (query >= 0 ? _path.substring(0, query) : _path) == servicePath;
+    sim::advance(sim::model.rtt_ms + (generate ? sim::model.generate_ms : sim::model.server_ms));
+
+    String status = _client->readStringUntil('\n');
+    int code;
+    if (sscanf(status.c_str(), "HTTP/%*d.%*d %d", &code) != 1) {
+        return HTTPC_ERROR_NO_HTTP_SERVER;
+    }
+
+    for (Header& header : _responseHeaders) {
+        header.value = String();
+    }
+    _size = -1;
+    _chunked = false;
+
+    for (;;) {
+        String line = _client->readStringUntil('\n');
+        if (line.length() == 0) {
+            break;
+        }
+        int colon = line.indexOf(':');
+        if (colon <= 0) {
+            continue;
+        }
+        String name = line.substring(0, colon);
+        String value = line.substring(colon + 1);
+        value.trim();
+
+        if (name.equalsIgnoreCase("Content-Length")) {
+            _size = value.toInt();
+        } else if (name.equalsIgnoreCase("Transfer-Encoding") && value.equalsIgnoreCase("chunked")) {
+            _chunked = true;
+        }
+        for (Header& header : _responseHeaders) {
+            if (header.name.equalsIgnoreCase(name.c_str())) header.value = value;
+        }
+    }
+
+    _connected = true;
+    return code;
+}
+
+// Whole body, with chunk framing removed
+String HTTPClient::getString() {
+    String body;
+    if (!_connected) {
+        return body;
+    }
+
+    char buffer[1024];
+    if (_chunked) {
+        for (;;) {
+            long chunk = strtol(_client->readStringUntil('\n').c_str(), nullptr, 16);
+            if (chunk <= 0) {
+                break;
+            }
+            while (chunk > 0) {
+                size_t n = _client->readBytes(buffer, std::min((size_t)chunk, sizeof(buffer)));
+                if (n == 0) return body;
+                body.concat(buffer, n);
+                chunk -= n;
+            }
+            _client->readStringUntil('\n');
+        }
+        return body;
+    }
+
+    size_t remaining = _size >= 0 ? (size_t)_size : SIZE_MAX;
+    while (remaining > 0) {
+        size_t n = _client->readBytes(buffer, std::min(remaining, sizeof(buffer)));
+        if (n == 0) break;
+        body.concat(buffer, n);
+        remaining -= n;
+    }
+    return body;
+}
+
+String HTTPClient::errorToString(int error) {
+    switch (error) {
+        case HTTPC_ERROR_CONNECTION_REFUSED:
+            return "connection refused";
+        case HTTPC_ERROR_SEND_HEADER_FAILED:
+            return "send header failed";
+        case HTTPC_ERROR_SEND_PAYLOAD_FAILED:
+            return "send payload failed";
+        case HTTPC_ERROR_NOT_CONNECTED:
+            return "not connected";
+        case HTTPC_ERROR_CONNECTION_LOST:
+            return "connection lost";
+        case HTTPC_ERROR_NO_STREAM:
+            return "no stream";
+        case HTTPC_ERROR_NO_HTTP_SERVER:
+            return "no HTTP server";
+        case HTTPC_ERROR_READ_TIMEOUT:
+            return "read Timeout";
+        default:
+            return String();
+    }
+}
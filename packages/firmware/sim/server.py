@@ -0,0 +1,316 @@
+#!/usr/bin/env python3
+"""Stand-in for the service and the image store, for the wake-cycle simulator.
+
+Every request from the simulated device arrives here with its original path,
+whatever host the firmware asked for, and with the simulated time in X-Sim-Time,
+so the content changes over the simulated day as it would in use:
+
+  POST /generate-image    JSON confirmation (the device falls back to METRO_IMAGE_URL);
+                          with ?inline=1 a panel frame (.e6f) that changes every
+                          --change-minutes, as a delta against X-Frame-Base when
+                          that is one of the recent frames
+  GET|POST /departures    departure board document, a train every --headway minutes;
+                          with --departures-every N only every Nth request is
+                          answered (503 otherwise), so the device falls back to
+                          the generated frame in between
+  GET /board-background   board chrome as a 480x800 BMP
+  GET <anything else>     a file under --content if there is one, otherwise a
+                          generated BMP: "screensaver" paths get fixed color bands,
+                          others a board that changes every --change-minutes
+
+Images carry an ETag and honour If-None-Match (304) and Range (206), and are
+gzipped for clients that accept it when --gzip is given.
+
+    python3 sim/server.py --port 8080
+"""
+
+import argparse
+import gzip
+import hashlib
+import json
+import os
+import struct
+import sys
+import time
+import zlib
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+WIDTH, HEIGHT = 480, 800  # Portrait, as the service renders
+
+# Measured inks from src/config.h (PALETTE_RGB)
+BLACK = (25, 30, 33)
+WHITE = (232, 232, 232)
+RED = (178, 19, 24)
+YELLOW = (239, 222, 68)
+BLUE = (33, 87, 186)
+GREEN = (18, 95, 32)
+
+# Board layout, from src/departure_board.h
+BOARD_MARGIN = 12
+BOARD_SECTION_HEIGHT = 392
+BOARD_HEADER_HEIGHT = 56
+BOARD_ROWS_OFFSET = 68
+BOARD_ROW_HEIGHT = 96
+BOARD_ROW_PITCH = 104
+
+# Panel frames (.e6f), from lib/image_pipeline/frame_format.h
+PANEL_WIDTH, PANEL_HEIGHT = 800, 480
+FRAME_FLAG_RLE = 0x01
+FRAME_FLAG_DELTA = 0x02
+FRAME_COLOR_KEEP = 7
+COLOR_BLACK, COLOR_WHITE, COLOR_RED, COLOR_YELLOW, COLOR_BLUE, COLOR_GREEN = range(6)
+RECENT_FRAMES = 8
+
+
+def row(background, spans=()):
+    """One BGR row: background with (x0, x1, color) spans painted over it."""
+    pixels = bytearray(bytes((background[2], background[1], background[0])) * WIDTH)
+    for x0, x1, color in spans:
+        pixels[x0 * 3 : x1 * 3] = bytes((color[2], color[1], color[0])) * (x1 - x0)
+    return bytes(pixels)
+
+
+def bmp(rows):
+    """24-bit bottom-up BMP from top-down rows (WIDTH * 3 bytes, already 4-aligned)."""
+    data = b"".join(reversed(rows))
+    header = struct.pack("<2sIHHI", b"BM", 54 + len(data), 0, 0, 54)
+    info = struct.pack("<IiiHHIIiiII", 40, WIDTH, HEIGHT, 1, 24, 0, len(data), 2835, 2835, 0, 0)
+    return header + info + data
+
+
+def screensaver():
+    bands = [BLACK, WHITE, RED, YELLOW, BLUE, GREEN]
+    return bmp([row(bands[y * len(bands) // HEIGHT]) for y in range(HEIGHT)])
+
+
+def background():
+    rows = []
+    for y in range(HEIGHT):
+        section_y = (y - BOARD_MARGIN) % BOARD_SECTION_HEIGHT
+        in_section = BOARD_MARGIN <= y < HEIGHT - BOARD_MARGIN
+        if in_section and section_y < BOARD_HEADER_HEIGHT:
+            rows.append(row(WHITE, [(BOARD_MARGIN, WIDTH - BOARD_MARGIN, BLACK)]))
+            continue
+        row_y = (section_y - BOARD_ROWS_OFFSET) % BOARD_ROW_PITCH
+        if in_section and section_y >= BOARD_ROWS_OFFSET and row_y in (0, 1, BOARD_ROW_HEIGHT - 2, BOARD_ROW_HEIGHT - 1):
+            rows.append(row(WHITE, [(BOARD_MARGIN, WIDTH - BOARD_MARGIN, BLUE)]))
+        else:
+            rows.append(row(WHITE))
+    return bmp(rows)
+
+
+def metro_image(slot):
+    """Board-like image whose rows of 'departures' move on every slot."""
+    rows = []
+    for y in range(HEIGHT):
+        if y < 80:
+            rows.append(row(WHITE, [(0, WIDTH, BLACK)]))
+            continue
+        line = (y - 80) // 120
+        width = 60 + ((slot * 7 + line * 13) % 12) * 30
+        color = [RED, BLUE, GREEN, YELLOW][line % 4]
+        inside = (y - 80) % 120 < 90
+        rows.append(row(WHITE, [(40, 40 + width, color)] if inside else []))
+    return bmp(rows)
+
+
+def metro_pixels(slot):
+    """Palette indices of a board-like panel frame whose 'departures' move on every slot."""
+    rows = []
+    for y in range(PANEL_HEIGHT):
+        if y < 60:
+            rows.append(bytes([COLOR_BLACK]) * PANEL_WIDTH)
+            continue
+        line = (y - 60) // 100
+        width = 80 + ((slot * 7 + line * 13) % 12) * 40
+        color = [COLOR_RED, COLOR_BLUE, COLOR_GREEN, COLOR_YELLOW][line % 4]
+        inside = (y - 60) % 100 < 80
+        span = width if inside else 0
+        # Station names: detail that stays the same from frame to frame
+        names = bytes(COLOR_BLACK if inside and (x // 3 + y // 3 * 7 + line) % 5 == 0 else COLOR_WHITE
+                      for x in range(620, PANEL_WIDTH))
+        rows.append(bytes([color]) * span + bytes([COLOR_WHITE]) * (620 - span) + names)
+    return b"".join(rows)
+
+
+def frame(pixels, flags):
+    """RLE frame of panel pixels, coded as runs only."""
+    payload = bytearray()
+    i = 0
+    while i < len(pixels):
+        color, start = pixels[i], i
+        while i < len(pixels) and pixels[i] == color:
+            i += 1
+        length = i - start
+        if length <= 15:
+            payload.append((length - 1) << 3 | color)
+        else:
+            payload.append(15 << 3 | color)
+            extra = length - 16
+            while extra >= 0x80:
+                payload.append(extra & 0x7F | 0x80)
+                extra >>= 7
+            payload.append(extra)
+    header = struct.pack("<4sBBHHBBII", b"E6FR", 1, flags | FRAME_FLAG_RLE, PANEL_WIDTH, PANEL_HEIGHT, 1, 1,
+                         len(payload), zlib.crc32(payload))
+    return header + bytes(payload)
+
+
+def delta(base, pixels):
+    return bytes(FRAME_COLOR_KEEP if a == b else b for a, b in zip(base, pixels))
+
+
+def departures(now, headway_minutes):
+    """Departure board document like the service's /departures, for time now."""
+    headway = headway_minutes * 60
+    directions = []
+    for index, (name, offset) in enumerate([("City", 0), ("Outbound", headway // 2)]):
+        first = ((now - offset) // headway + 1) * headway + offset
+        trains = []
+        for k in range(3):
+            scheduled = first + k * headway
+            delay = (scheduled // headway % 3) * 60
+            trains.append({"scheduled": scheduled, "estimated": scheduled + delay, "platform": str(index + 1)})
+        directions.append({"name": name, "departures": trains})
+
+    content = {"status": "Good service", "directions": directions}
+    version = "%08x" % zlib.crc32(json.dumps(content, separators=(",", ":")).encode())
+    valid_until = min(t["estimated"] for d in directions for t in d["departures"])
+    return {"version": version, **content, "validUntil": valid_until}
+
+
+class Handler(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+    images = {}  # (kind, slot) -> bytes
+    frames = {}  # version -> panel pixels, the last RECENT_FRAMES generated
+    departure_requests = 0
+
+    def sim_time(self):
+        return int(self.headers.get("X-Sim-Time") or time.time())
+
+    def send(self, code, body=b"", headers=None):
+        self.send_response(code)
+        for name, value in (headers or {}).items():
+            self.send_header(name, value)
+        self.send_header("Content-Length", str(len(body)))
+        self.send_header("Connection", "close")
+        self.end_headers()
+        if self.command != "HEAD":
+            self.wfile.write(body)
+        self.close_connection = True
+
+    def read_body(self):
+        length = int(self.headers.get("Content-Length") or 0)
+        return self.rfile.read(length) if length else b""
+
+    def image(self, kind, slot=0):
+        key = (kind, slot)
+        if key not in self.images:
+            self.images[key] = {"screensaver": screensaver, "background": background}.get(kind, lambda: metro_image(slot))()
+        return self.images[key]
+
+    def serve_image(self, data):
+        encoding = None
+        accept = self.headers.get("Accept-Encoding", "")
+        if self.server.options.gzip and "gzip" in accept:
+            data = gzip.compress(data, mtime=0)
+            encoding = "gzip"
+
+        etag = '"%s"' % hashlib.sha1(data).hexdigest()[:16]
+        headers = {"ETag": etag, "Content-Type": "image/bmp", "Accept-Ranges": "bytes"}
+        if encoding:
+            headers["Content-Encoding"] = encoding
+
+        if self.headers.get("If-None-Match") == etag:
+            self.send(304, headers={"ETag": etag})
+            return
+
+        range_header = self.headers.get("Range", "")
+        if range_header.startswith("bytes="):
+            start = int(range_header[6:].split("-")[0] or 0)
+            if start >= len(data):
+                self.send(416, headers={"Content-Range": "bytes */%d" % len(data)})
+                return
+            headers["Content-Range"] = "bytes %d-%d/%d" % (start, len(data) - 1, len(data))
+            self.send(206, data[start:], headers)
+            return
+
+        self.send(200, data, headers)
+
+    def serve_frame(self, slot):
+        version = "f%d" % slot
+        if version not in self.frames:
+            self.frames[version] = metro_pixels(slot)
+            while len(self.frames) > RECENT_FRAMES:
+                del self.frames[next(iter(self.frames))]
+        pixels = self.frames[version]
+
+        headers = {"Content-Type": "application/octet-stream", "X-Frame-Version": version}
+        data = frame(pixels, 0)
+        base = self.headers.get("X-Frame-Base")
+        if base in self.frames:
+            patch = frame(delta(self.frames[base], pixels), FRAME_FLAG_DELTA)
+            if len(patch) < len(data):
+                data = patch
+                headers["X-Frame-Base"] = base
+                if not self.server.options.quiet:
+                    sys.stderr.write("Sending frame %s as a %d byte delta against %s\n" % (version, len(data), base))
+        self.send(200, data, headers)
+
+    def do_GET(self):
+        path = self.path.split("?")[0]
+        options = self.server.options
+
+        if path == "/departures":
+            self.read_body()
+            Handler.departure_requests += 1
+            if Handler.departure_requests % options.departures_every != 0:
+                self.send(503, b"Departures unavailable", {"Content-Type": "text/plain"})
+                return
+            body = json.dumps(departures(self.sim_time(), options.headway)).encode()
+            self.send(200, body, {"Content-Type": "application/json"})
+        elif path == "/generate-image" and "inline=1" in self.path:
+            self.read_body()
+            self.serve_frame(self.sim_time() // (options.change_minutes * 60))
+        elif path == "/generate-image":
+            self.read_body()
+            body = json.dumps({"success": True, "message": "Image generated"}).encode()
+            self.send(200, body, {"Content-Type": "application/json"})
+        elif path == "/board-background":
+            self.serve_image(self.image("background"))
+        elif options.content and os.path.isfile(os.path.join(options.content, path.lstrip("/"))):
+            with open(os.path.join(options.content, path.lstrip("/")), "rb") as file:
+                self.serve_image(file.read())
+        elif "screensaver" in path:
+            self.serve_image(self.image("screensaver"))
+        else:
+            self.serve_image(self.image("metro", self.sim_time() // (options.change_minutes * 60)))
+
+    do_POST = do_GET
+
+    def log_message(self, format, *args):
+        if not self.server.options.quiet:
+            sys.stderr.write("%s %s\n" % (time.strftime("%H:%M:%S"), format % args))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Stand-in server for the wake-cycle simulator")
+    parser.add_argument("--host", default="127.0.0.1")
+    parser.add_argument("--port", type=int, default=8080)
+    parser.add_argument("--content", help="serve files under this directory by path")
+    parser.add_argument("--headway", type=int, default=8, help="minutes between trains")
+    parser.add_argument("--change-minutes", type=int, default=15, help="how often generated images change")
+    parser.add_argument("--departures-every", type=int, default=1, metavar="N",
+                        help="answer only every Nth departures request")
+    parser.add_argument("--gzip", action="store_true", help="gzip images for clients that accept it")
+    parser.add_argument("--quiet", action="store_true")
+    options = parser.parse_args()
+
+    server = ThreadingHTTPServer((options.host, options.port), Handler)
+    server.options = options
+    print("Serving on %s:%d" % (options.host, options.port), file=sys.stderr)
+    server.serve_forever()
+
+
+if __name__ == "__main__":
+    main()
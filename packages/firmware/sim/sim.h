@@ -0,0 +1,135 @@
+#ifndef SIM_H
+#define SIM_H
+
+// Wake-cycle simulator internals shared by the stand-ins in sim/
+//
+// Each wake runs setup() in a forked process, so everything outside RTC memory
+// starts from scratch as it does after deep sleep. The parent (simulator.cpp)
+// owns the simulated world: true time, button presses and the energy totals.
+//
+// Time on the device is virtual. It advances with the latencies of the model for
+// things the host does instantly (WiFi association, round trips, transfers, the
+// panel refresh, delay()) and with the process CPU time scaled by cpu_scale for the
+// code that really runs (decoding, dithering, drawing).
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_sleep.h"
+
+namespace sim {
+
+// Current and latency model, read from key = value files (sim/model.conf)
+struct Model {
+    // Supply current in mA while awake: CPU with the radio off, or with it on;
+    // refresh_ma is drawn by the panel on top of either during a refresh
+    double cpu_ma = 45;
+    double radio_ma = 110;
+    double refresh_ma = 30;
+    double light_sleep_ma = 2;  // Light sleep with the radio off (PSRAM kept)
+    double sleep_ua = 40;       // Whole board in deep sleep
+
+    double boot_ms = 320;       // ROM bootloader and app start before setup()
+    double cpu_scale = 20;      // Device CPU time per unit of host CPU time
+    double wifi_fast_ms = 350;  // Association with a known BSSID and channel
+    double wifi_scan_ms = 2400;
+    double dhcp_ms = 700;  // Skipped when a cached or static lease is applied
+    double dhcp_lease_s = 86400;  // Lease time the DHCP server grants
+    double ntp_ms = 120;
+    double rtt_ms = 35;        // One network round trip (TCP connect, request)
+    double server_ms = 150;    // Server time before the first byte
+    double generate_ms = 2500; // Instead of server_ms for the generate endpoint
+    double tls_full_ms = 900;  // Full handshake (round trips and the public key maths)
+    double tls_resume_ms = 180;
+    double bandwidth_kbps = 4000;
+    double refresh_ms = 22000;  // Full refresh of the six-color panel
+
+    double rtc_drift_ppm = 1500;  // RTC slow clock error (positive: it runs fast)
+    double battery_mah = 2000;
+    double battery_usable = 0.85;  // Fraction of the rated capacity before brown-out
+
+    bool set(const char* key, const char* value);
+    bool load(const char* path);
+    void print() const;
+};
+
+// One wake, shared between the simulator and the wake's process
+struct Wake {
+    static const size_t RTC_MAX = 16384;
+
+    // Set by the simulator before the wake
+    uint32_t index;
+    int64_t worldMicros;        // True time when the chip woke
+    int64_t clockOffsetMicros;  // Device system time minus true time
+    esp_sleep_wakeup_cause_t cause;
+    int pressedPin;  // Button held down at wake, -1 for none
+    char host[64];   // Stand-in server
+    uint16_t port;
+    char flashDir[256];
+    char outDir[256];
+
+    // Set by the device
+    bool slept;  // Reached esp_deep_sleep_start()
+    uint64_t timerMicros;
+    uint64_t ext1Mask;
+    esp_sleep_ext1_wakeup_mode_t ext1Mode;
+    int64_t awakeMicros;
+    int64_t radioMicros;
+    int64_t refreshMicros;
+    int64_t lightSleepMicros;
+    double cpuCharge;  // mA x µs, light sleep included
+    double radioCharge;
+    double refreshCharge;
+    uint32_t requests;
+    uint32_t refreshes;
+    uint64_t bytesReceived;
+    uint64_t bytesSent;
+    char panelImage[64];  // PNG written by the last refresh, "" if none
+
+    size_t rtcSize;
+    uint8_t rtc[RTC_MAX];
+};
+
+extern Model model;
+extern Wake* wake;  // Valid in a wake's process
+
+// Virtual time since the chip woke
+int64_t nowMicros();
+
+// Let modeled time pass at the current power state
+void advance(double ms);
+
+void setRadio(bool on);
+void setRefreshing(bool on);
+bool radioOn();
+
+// Time passes in light sleep (esp_light_sleep_start())
+void setLightSleep(bool on);
+
+// The panel's BUSY pin is held at its busy level for refresh_ms from the start of
+// holdPanelBusy(), which returns once it's released
+bool panelBusy();
+void holdPanelBusy();
+
+// Wall clock of the device (what gettimeofday() returns) and the true time
+int64_t deviceTimeMicros();
+void setDeviceTimeMicros(int64_t micros);
+int64_t trueTimeMicros();
+
+// Traffic for the report; received bytes are also charged at bandwidth_kbps
+void countSent(size_t bytes);
+void countReceived(size_t bytes);
+
+// Copy RTC memory to and from the wake record
+bool saveRtc();
+void loadRtc();
+
+// Close the books on this wake and hand RTC memory back to the simulator
+void endWake() __attribute__((noreturn));
+
+// Write the packed 4-bit panel buffer as a PNG in the output directory
+bool writePanelPng(const char* path, const uint8_t* buffer, int width, int height);
+
+}  // namespace sim
+
+#endif  // SIM_H
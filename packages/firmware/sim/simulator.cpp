@@ -0,0 +1,365 @@
+/**
+ * Wake-cycle simulator
+ *
+ * Runs the firmware's setup() once per wake on the host, against the stand-in
+ * server in sim/server.py, over a simulated stretch of time: timer wakes as the
+ * firmware schedules them and button presses from the command line. Every wake
+ * is charged against the current and latency model (sim/model.conf) and the
+ * report gives mAh per wake, per day and the projected battery life.
+ *
+ * Usage: sim [--hours 24] [--start 2026-10-19T00:00] [--press metro@07:40 ...]
+ *            [--model sim/model.conf] [--set key=value ...]
+ *            [--server 127.0.0.1:8080] [--out .pio/sim-out] [--verbose]
+ */
+
+#include <signal.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <vector>
+
+#include "Arduino.h"
+#include "config.h"
+#include "sim.h"
+
+// From src/main.cpp
+void setup();
+void loop();
+void applyTimeZone();
+
+namespace {
+
+const int WAKE_TIMEOUT_SECONDS = 300;  // Host time before a wake is considered hung
+
+struct Press {
+    int64_t micros;  // True time
+    int pin;
+};
+
+struct Totals {
+    uint32_t wakes = 0;
+    uint32_t timerWakes = 0;
+    uint32_t buttonWakes = 0;
+    uint32_t refreshes = 0;
+    uint32_t missedPresses = 0;
+    int64_t awakeMicros = 0;
+    int64_t radioMicros = 0;
+    int64_t refreshMicros = 0;
+    int64_t lightSleepMicros = 0;
+    double sleepSeconds = 0;
+    double cpuCharge = 0;  // mA x µs
+    double radioCharge = 0;
+    double refreshCharge = 0;
+    double sleepCharge = 0;
+    uint64_t bytesReceived = 0;
+};
+
+double toMah(double charge) {
+    return charge / 3.6e9;
+}
+
+const char* causeName(esp_sleep_wakeup_cause_t cause, int pin) {
+    if (cause == ESP_SLEEP_WAKEUP_TIMER) return "timer";
+    if (cause == ESP_SLEEP_WAKEUP_EXT1) return pin == METRO_BUTTON_PIN ? "KEY1" : "KEY2";
+    return "power-on";
+}
+
+String formatTime(int64_t micros) {
+    time_t seconds = micros / 1000000;
+    struct tm local;
+    localtime_r(&seconds, &local);
+    char text[32];
+    strftime(text, sizeof(text), "%m-%d %H:%M:%S", &local);
+    return String(text);
+}
+
+bool parseStart(const char* text, int64_t* micros) {
+    struct tm local = {};
+    if (sscanf(text, "%d-%d-%dT%d:%d", &local.tm_year, &local.tm_mon, &local.tm_mday, &local.tm_hour,
+               &local.tm_min) != 5) {
+        return false;
+    }
+    local.tm_year -= 1900;
+    local.tm_mon -= 1;
+    local.tm_isdst = -1;
+    *micros = (int64_t)mktime(&local) * 1000000;
+    return true;
+}
+
+// KEY@HH:MM, pressed every day at that local time
+bool parsePress(const char* text, int64_t start, int64_t end, std::vector<Press>* presses) {
+    char key[16];
+    int hour, minute;
+    if (sscanf(text, "%15[a-z]@%d:%d", key, &hour, &minute) != 3) {
+        return false;
+    }
+    int pin;
+    if (strcmp(key, "metro") == 0) {
+        pin = METRO_BUTTON_PIN;
+    } else if (strcmp(key, "screensaver") == 0) {
+        pin = SCREENSAVER_BUTTON_PIN;
+    } else {
+        return false;
+    }
+
+    time_t day = start / 1000000;
+    struct tm local;
+    localtime_r(&day, &local);
+    for (;; local.tm_mday++) {
+        local.tm_hour = hour;
+        local.tm_min = minute;
+        local.tm_sec = 0;
+        local.tm_isdst = -1;
+        int64_t micros = (int64_t)mktime(&local) * 1000000;
+        if (micros >= end) break;
+        if (micros >= start) presses->push_back({micros, pin});
+    }
+    return true;
+}
+
+void usage() {
+    fprintf(stderr,
+            "usage: sim [--hours H] [--start YYYY-MM-DDTHH:MM] [--press metro|screensaver@HH:MM]...\n"
+            "           [--model FILE] [--set key=value]... [--server HOST:PORT] [--out DIR] [--verbose]\n");
+}
+
+// Run setup() in a child process until it enters deep sleep
+bool runWake(sim::Wake* wake, bool verbose) {
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        return false;
+    }
+
+    if (pid == 0) {
+        sim::wake = wake;
+        if (!verbose) {
+            char path[300];
+            snprintf(path, sizeof(path), "%s/wake-%04u.log", wake->outDir, wake->index);
+            if (freopen(path, "w", stdout) == nullptr) _exit(2);
+        }
+        sim::loadRtc();
+        alarm(WAKE_TIMEOUT_SECONDS);
+
+        setup();
+        loop();
+
+        fflush(stdout);
+        fprintf(stderr, "setup() returned without entering deep sleep\n");
+        _exit(4);
+    }
+
+    int status;
+    waitpid(pid, &status, 0);
+    if (wake->slept) {
+        return true;
+    }
+    if (WIFSIGNALED(status)) {
+        fprintf(stderr, "Wake %u ended by signal %d (%s)\n", wake->index, WTERMSIG(status),
+                WTERMSIG(status) == SIGALRM ? "hung" : strsignal(WTERMSIG(status)));
+    } else {
+        fprintf(stderr, "Wake %u exited with status %d\n", wake->index, WEXITSTATUS(status));
+    }
+    return false;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    double hours = 24;
+    const char* startText = "2026-10-19T00:00";
+    std::vector<const char*> pressTexts;
+    const char* server = "127.0.0.1:8080";
+    const char* outDir = ".pio/sim-out";  // Ignored by git with the rest of the build output
+    bool verbose = false;
+
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--hours") == 0 && hasValue) {
+            hours = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--start") == 0 && hasValue) {
+            startText = argv[++i];
+        } else if (strcmp(argv[i], "--press") == 0 && hasValue) {
+            pressTexts.push_back(argv[++i]);
+        } else if (strcmp(argv[i], "--model") == 0 && hasValue) {
+            if (!sim::model.load(argv[++i])) return 1;
+        } else if (strcmp(argv[i], "--set") == 0 && hasValue) {
+            char key[64];
+            const char* value = strchr(argv[++i], '=');
+            if (value == nullptr || value - argv[i] >= (int)sizeof(key)) {
+                usage();
+                return 1;
+            }
+            snprintf(key, sizeof(key), "%.*s", (int)(value - argv[i]), argv[i]);
+            if (!sim::model.set(key, value + 1)) {
+                fprintf(stderr, "Unknown model value: %s\n", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--server") == 0 && hasValue) {
+            server = argv[++i];
+        } else if (strcmp(argv[i], "--out") == 0 && hasValue) {
+            outDir = argv[++i];
+        } else if (strcmp(argv[i], "--verbose") == 0) {
+            verbose = true;
+        } else {
+            usage();
+            return 1;
+        }
+    }
+
+    // Local times are the device's, from the time zone in config.h
+    applyTimeZone();
+
+    int64_t start;
+    if (!parseStart(startText, &start) || hours <= 0) {
+        usage();
+        return 1;
+    }
+    int64_t end = start + (int64_t)(hours * 3600e6);
+
+    std::vector<Press> presses;
+    for (const char* text : pressTexts) {
+        if (!parsePress(text, start, end, &presses)) {
+            usage();
+            return 1;
+        }
+    }
+    std::sort(presses.begin(), presses.end(), [](const Press& a, const Press& b) { return a.micros < b.micros; });
+
+    // One wake record shared with each wake's process
+    sim::Wake* wake = (sim::Wake*)mmap(nullptr, sizeof(sim::Wake), PROT_READ | PROT_WRITE,
+                                       MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (wake == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+    memset(wake, 0, sizeof(*wake));
+    sim::wake = wake;
+
+    const char* colon = strrchr(server, ':');
+    if (colon == nullptr || colon - server >= (int)sizeof(wake->host)) {
+        usage();
+        return 1;
+    }
+    snprintf(wake->host, sizeof(wake->host), "%.*s", (int)(colon - server), server);
+    wake->port = atoi(colon + 1);
+
+    // Fresh flash, and RTC memory as it is at power-on
+    std::filesystem::remove_all(outDir);
+    std::filesystem::create_directories(outDir);
+    snprintf(wake->outDir, sizeof(wake->outDir), "%s", outDir);
+    snprintf(wake->flashDir, sizeof(wake->flashDir), "%s/flash", outDir);
+    if (!sim::saveRtc()) {
+        return 1;
+    }
+
+    printf("Model:\n");
+    sim::model.print();
+    printf("\nSimulating %.1f h from %s against %s\n\n", hours, formatTime(start).c_str(), server);
+    printf("%5s  %-14s  %-8s  %7s  %7s  %7s  %8s  %4s  %7s  %8s  %s\n", "wake", "time", "cause", "awake s", "radio s",
+           "refr s", "mAh", "reqs", "KB in", "sleep s", "panel");
+
+    Totals totals;
+    int64_t world = start;
+    int64_t clockOffset = -start;  // The system clock starts at the epoch
+    esp_sleep_wakeup_cause_t cause = ESP_SLEEP_WAKEUP_UNDEFINED;
+    int pressedPin = -1;
+    size_t nextPress = 0;
+    bool failed = false;
+
+    while (world < end) {
+        wake->index = totals.wakes + 1;
+        wake->worldMicros = world;
+        wake->clockOffsetMicros = clockOffset;
+        wake->cause = cause;
+        wake->pressedPin = pressedPin;
+        wake->slept = false;
+        wake->timerMicros = 0;
+        wake->ext1Mask = 0;
+        wake->awakeMicros = wake->radioMicros = wake->refreshMicros = wake->lightSleepMicros = 0;
+        wake->cpuCharge = wake->radioCharge = wake->refreshCharge = 0;
+        wake->requests = wake->refreshes = 0;
+        wake->bytesReceived = wake->bytesSent = 0;
+        wake->panelImage[0] = '\0';
+
+        fflush(stdout);
+        if (!runWake(wake, verbose)) {
+            failed = true;
+            break;
+        }
+
+        totals.wakes++;
+        totals.timerWakes += cause == ESP_SLEEP_WAKEUP_TIMER;
+        totals.buttonWakes += cause == ESP_SLEEP_WAKEUP_EXT1;
+        totals.refreshes += wake->refreshes;
+        totals.awakeMicros += wake->awakeMicros;
+        totals.radioMicros += wake->radioMicros;
+        totals.refreshMicros += wake->refreshMicros;
+        totals.lightSleepMicros += wake->lightSleepMicros;
+        totals.cpuCharge += wake->cpuCharge;
+        totals.radioCharge += wake->radioCharge;
+        totals.refreshCharge += wake->refreshCharge;
+        totals.bytesReceived += wake->bytesReceived;
+
+        // Presses while the chip is awake aren't wake sources
+        world += wake->awakeMicros;
+        for (; nextPress < presses.size() && presses[nextPress].micros < world; nextPress++) {
+            totals.missedPresses++;
+        }
+
+        // The timer counts the RTC's time, which runs fast by rtc_drift_ppm
+        double drift = sim::model.rtc_drift_ppm / 1e6;
+        int64_t wakeAt = world + (int64_t)(wake->timerMicros / (1 + drift));
+        cause = ESP_SLEEP_WAKEUP_TIMER;
+        pressedPin = -1;
+        if (nextPress < presses.size() && presses[nextPress].micros < wakeAt &&
+            (wake->ext1Mask & (1ULL << presses[nextPress].pin))) {
+            wakeAt = presses[nextPress].micros;
+            cause = ESP_SLEEP_WAKEUP_EXT1;
+            pressedPin = presses[nextPress].pin;
+            nextPress++;
+        }
+
+        double sleepSeconds = (std::min(wakeAt, end) - world) / 1e6;
+        totals.sleepSeconds += std::max(sleepSeconds, 0.0);
+        clockOffset = wake->clockOffsetMicros + (int64_t)((wakeAt - world) * drift);
+
+        double wakeCharge = wake->cpuCharge + wake->radioCharge + wake->refreshCharge;
+        printf("%5u  %-14s  %-8s  %7.2f  %7.2f  %7.2f  %8.4f  %4u  %7.1f  %8.0f  %s\n", wake->index,
+               formatTime(world - wake->awakeMicros).c_str(), causeName(wake->cause, wake->pressedPin),
+               wake->awakeMicros / 1e6, wake->radioMicros / 1e6, wake->refreshMicros / 1e6, toMah(wakeCharge),
+               wake->requests, wake->bytesReceived / 1024.0, (wakeAt - world) / 1e6, wake->panelImage);
+
+        world = wakeAt;
+    }
+
+    totals.sleepCharge = sim::model.sleep_ua / 1000 * totals.sleepSeconds * 1e6;
+    double awakeCharge = totals.cpuCharge + totals.radioCharge + totals.refreshCharge;
+    double total = awakeCharge + totals.sleepCharge;
+    double simulatedHours = (std::min(world, end) - start) / 3600e6;
+    double perDay = simulatedHours > 0 ? toMah(total) * 24 / simulatedHours : 0;
+
+    printf("\n%u wakes (%u timer, %u button), %u refreshes, %u presses missed while awake\n", totals.wakes,
+           totals.timerWakes, totals.buttonWakes, totals.refreshes, totals.missedPresses);
+    printf("Awake %.1f min, radio on %.1f min, panel refreshing %.1f min, light sleep %.1f min, %.0f KB received\n",
+           totals.awakeMicros / 60e6, totals.radioMicros / 60e6, totals.refreshMicros / 60e6,
+           totals.lightSleepMicros / 60e6, totals.bytesReceived / 1024.0);
+    printf("Charge: CPU %.2f + radio %.2f + refresh %.2f + deep sleep %.2f = %.2f mAh over %.1f h\n",
+           toMah(totals.cpuCharge), toMah(totals.radioCharge), toMah(totals.refreshCharge), toMah(totals.sleepCharge),
+           toMah(total), simulatedHours);
+    if (totals.wakes > 0) {
+        printf("Per wake %.3f mAh awake, per day %.1f mAh\n", toMah(awakeCharge) / totals.wakes, perDay);
+    }
+    if (perDay > 0) {
+        printf("Battery: %.0f mAh x %.2f usable -> %.0f days\n", sim::model.battery_mah, sim::model.battery_usable,
+               sim::model.battery_mah * sim::model.battery_usable / perDay);
+    }
+
+    munmap(wake, sizeof(*wake));
+    return failed ? 1 : 0;
+}
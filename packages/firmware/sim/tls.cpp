@@ -0,0 +1,110 @@
+// ResumableTlsClient for the simulator: plain TCP to the stand-in server, with the
+// handshake charged to the latency model. Sessions are remembered per host in RTC
+// memory like the real client's, so later wakes are charged a resumption instead
+
+#include "resumable_tls_client.h"
+
+#include "config.h"
+#include "sim.h"
+
+namespace {
+
+RTC_DATA_ATTR uint32_t tlsSessionHosts[TLS_SESSION_SLOTS];  // Hash of "host:port", 0 if free
+RTC_DATA_ATTR uint8_t tlsSessionNext = 0;
+
+uint32_t hostKey(const char* host, uint16_t port) {
+    uint32_t hash = 2166136261u;
+    for (const char* c = host; *c != '\0'; c++) {
+        hash = (hash ^ (uint8_t)*c) * 16777619u;
+    }
+    return (hash ^ port) * 16777619u | 1;
+}
+
+}  // namespace
+
+ResumableTlsClient::ResumableTlsClient() {}
+
+ResumableTlsClient::~ResumableTlsClient() {
+    stop();
+}
+
+int ResumableTlsClient::connect(IPAddress ip, uint16_t port) {
+    return connect(ip.toString().c_str(), port);
+}
+
+int ResumableTlsClient::connect(IPAddress ip, uint16_t port, int32_t timeout) {
+    (void)timeout;
+    return connect(ip, port);
+}
+
+int ResumableTlsClient::connect(const char* host, uint16_t port, int32_t timeout) {
+    (void)timeout;
+    return connect(host, port);
+}
+
+int ResumableTlsClient::connect(const char* host, uint16_t port) {
+    if (!WiFiClient::connect(host, port)) {
+        return 0;
+    }
+
+    uint32_t key = hostKey(host, port);
+    _sessionOffered = false;
+    for (uint32_t stored : tlsSessionHosts) {
+        _sessionOffered |= stored == key;
+    }
+    _sessionResumed = _sessionOffered;
+
+    unsigned long start = millis();
+    sim::advance(_sessionResumed ? sim::model.tls_resume_ms : sim::model.tls_full_ms);
+    _handshakeMillis = millis() - start;
+
+    if (!_sessionOffered) {
+        tlsSessionHosts[tlsSessionNext] = key;
+        tlsSessionNext = (tlsSessionNext + 1) % TLS_SESSION_SLOTS;
+    }
+    _connected = true;
+    return 1;
+}
+
+size_t ResumableTlsClient::write(uint8_t data) {
+    return WiFiClient::write(data);
+}
+
+size_t ResumableTlsClient::write(const uint8_t* buf, size_t size) {
+    return WiFiClient::write(buf, size);
+}
+
+int ResumableTlsClient::available() {
+    return WiFiClient::available();
+}
+
+int ResumableTlsClient::read() {
+    return WiFiClient::read();
+}
+
+int ResumableTlsClient::read(uint8_t* buf, size_t size) {
+    return WiFiClient::read(buf, size);
+}
+
+size_t ResumableTlsClient::readBytes(char* buffer, size_t length) {
+    return WiFiClient::readBytes(buffer, length);
+}
+
+int ResumableTlsClient::peek() {
+    return WiFiClient::peek();
+}
+
+void ResumableTlsClient::flush() {}
+
+void ResumableTlsClient::stop() {
+    _connected = false;
+    WiFiClient::stop();
+}
+
+uint8_t ResumableTlsClient::connected() {
+    return _connected && WiFiClient::connected();
+}
+
+void ResumableTlsClient::clearSessions() {
+    memset(tlsSessionHosts, 0, sizeof(tlsSessionHosts));
+}
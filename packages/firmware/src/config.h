@@ -7,20 +7,44 @@
 #define WIFI_SSID ""
 #define WIFI_PASSWORD ""
 
+// Fast reconnect: the access point (BSSID + channel) and IP lease of the last
+// connection are kept in RTC memory, so the next wake skips the scan and DHCP.
+// The IP is reused for half the lease time the DHCP server granted
+#define WIFI_CONNECT_TIMEOUT_MS 15000      // Full scan + DHCP
+#define WIFI_FAST_CONNECT_TIMEOUT_MS 3000  // Cached AP before falling back to a full scan
+
+// Optional static IP - uncomment to skip DHCP entirely
+// #define WIFI_STATIC_IP "192.168.1.50"
+// #define WIFI_STATIC_GATEWAY "192.168.1.1"
+// #define WIFI_STATIC_SUBNET "255.255.255.0"
+// #define WIFI_STATIC_DNS "192.168.1.1"
+
 // ========================================
 // Server Configuration
 // ========================================
 // Service API endpoint to trigger image generation
 #define SERVICE_API_URL "http://192.168.1.34:3001/generate-image"
 
-// Image URLs (must be BMP format for 7-color E-Ink display)
-#define METRO_IMAGE_URL "https://storage.hermes-lab.com/dev/eink/metroTable/display.bmp"
+// Image URLs - pre-quantized panel frames (.e6f, written by the service) or 24-bit BMP
+#define METRO_IMAGE_URL "https://storage.hermes-lab.com/dev/eink/metroTable/display.e6f"
 #define SCREENSAVER_IMAGE_URL "https://storage.hermes-lab.com/dev/eink/screensaver/display.bmp"
 
+// Departure board drawn on the device from a small JSON document instead of
+// downloading the image rendered by the service; the static chrome comes from a
+// background frame kept in the frame cache. Falls back to the image on errors
+#define DEPARTURE_BOARD_ON_DEVICE true
+#define DEPARTURES_URL "http://192.168.1.34:3001/departures"
+#define BOARD_BACKGROUND_URL "http://192.168.1.34:3001/board-background"
+
 // ========================================
 // Display Configuration
 // ========================================
 // 7.3" E-Ink Spectra 6 Display Specifications
+// Set by platformio.ini for the device; the image pipeline is specialized for it
+// (lib/image_pipeline/panel_traits.h)
+#ifndef BOARD_SCREEN_COMBO
+#define BOARD_SCREEN_COMBO 509
+#endif
 #define DISPLAY_WIDTH 800
 #define DISPLAY_HEIGHT 480
 
@@ -32,6 +56,20 @@
 #define COLOR_BLUE 0x4
 #define COLOR_GREEN 0x5
 
+// Measured appearance of each Spectra 6 ink in sRGB, indexed by the colors above
+// Dithering matches against these instead of pure primaries - the panel's
+// white is a light grey and its red/blue/green inks are much darker than
+// #FF0000/#0000FF/#00FF00, so matching the real inks keeps mid-tones accurate
+#define PALETTE_SIZE 6
+#define PALETTE_RGB {      \
+    {25, 30, 33},    /* COLOR_BLACK */  \
+    {232, 232, 232}, /* COLOR_WHITE */  \
+    {178, 19, 24},   /* COLOR_RED */    \
+    {239, 222, 68},  /* COLOR_YELLOW */ \
+    {33, 87, 186},   /* COLOR_BLUE */   \
+    {18, 95, 32},    /* COLOR_GREEN */  \
+}
+
 // ========================================
 // Power Management
 // ========================================
@@ -39,6 +77,24 @@
 #define ACTIVE_PERIOD_SLEEP_SECONDS 900      // 15 minutes during active periods
 #define INACTIVE_PERIOD_SLEEP_SECONDS 12600  // 3.5 hours during inactive periods
 
+// After a metro update the sleep is timed from the first departure shown, as
+// reported by the service: a little before it leaves so its estimate is fresh, or
+// just after it has left when that's too close. Every sleep also ends at the start
+// or end of an active period, so the display switches content on time
+#define ADAPTIVE_WAKE_ENABLED true
+#define DEPARTURE_WAKE_LEAD_SECONDS 120  // Wake this long before the departure
+#define DEPARTED_WAKE_DELAY_SECONDS 30   // Or this long after it
+#define MIN_SLEEP_SECONDS 120
+#define MAX_ACTIVE_SLEEP_SECONDS 1800  // Longest sleep in an active period with no departure due
+
+// The radio is switched off before the panel refresh, and the chip light-sleeps
+// while the panel holds EPD_BUSY_PIN at its busy level, woken when it goes idle.
+// Light sleep drops the USB serial connection - set to false to watch the refresh
+#define REFRESH_LIGHT_SLEEP true
+#define EPD_BUSY_IDLE_LEVEL HIGH   // BUSY is low while the panel is refreshing
+#define REFRESH_SLEEP_MAX_MS 1000  // Longest light sleep before BUSY is checked again
+#define REFRESH_TASK_STACK 4096    // Task running the driver's update while the chip sleeps
+
 // ========================================
 // Time Configuration
 // ========================================
@@ -47,6 +103,15 @@
 #define GMT_OFFSET_SEC 36000      // UTC+10 (adjust for your timezone)
 #define DAYLIGHT_OFFSET_SEC 3600  // DST offset (adjust as needed)
 
+// The wall clock is carried across deep sleep in RTC memory and corrected for the
+// measured drift of the RTC, so NTP is only needed every few wakes
+#define NTP_SYNC_INTERVAL_WAKES 24                // Re-sync at least this often
+#define NTP_MAX_ERROR_SECONDS 60                  // Re-sync early if the estimate may be off by more
+#define CLOCK_DRIFT_UNCERTAINTY_PPM 1000          // Residual error once drift has been measured
+#define CLOCK_UNCALIBRATED_UNCERTAINTY_PPM 20000  // Before the first drift measurement
+#define CLOCK_MAX_DRIFT_PPM 100000                // Ignore drift measurements beyond this
+#define CLOCK_MIN_DRIFT_INTERVAL_SECONDS 3600     // Shortest interval to measure drift over
+
 // Active time periods (24-hour format)
 // Morning period: 5:00 AM - 8:00 AM
 #define MORNING_START_HOUR 5
@@ -81,8 +146,19 @@
 // ========================================
 // Debug Configuration
 // ========================================
-// Enable verbose debug output
-#define DEBUG_MODE true
+// Log messages up to this level are compiled in (src/log.h):
+// LOG_LEVEL_NONE, LOG_LEVEL_ERROR, LOG_LEVEL_WARN, LOG_LEVEL_INFO or LOG_LEVEL_DEBUG
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+// LOG_OUTPUT_SERIAL prints messages as text. LOG_OUTPUT_BINARY keeps them as compact
+// records in an RTC memory ring instead, dumped over serial after a crash reset and
+// decoded with tools/decode_log.py
+#ifndef LOG_OUTPUT
+#define LOG_OUTPUT LOG_OUTPUT_SERIAL
+#endif
+#define LOG_RING_SIZE 1536  // RTC bytes for binary records (the oldest are dropped when full)
 
 // ========================================
 // HTTP Configuration
@@ -90,4 +166,52 @@
 #define HTTP_TIMEOUT 10000              // HTTP timeout in milliseconds
 #define MAX_IMAGE_SIZE (800 * 480 * 3)  // Maximum expected image size in bytes
 
+// Download pipeline: a network task on one core fills a ring buffer that the
+// decoder drains on the other core
+#define DOWNLOAD_RING_SIZE 16384  // Ring buffer size in bytes (power of two)
+#define NETWORK_TASK_CORE 0       // Core running the WiFi stack (Arduino code runs on core 1)
+#define NETWORK_TASK_STACK 8192   // Network task stack size in bytes
+
+// A download that breaks off is resumed with Range requests in the same wake
+#define DOWNLOAD_STALL_TIMEOUT_MS 10000  // No data for this long counts as a dropped connection
+#define DOWNLOAD_RESUME_ATTEMPTS 3       // Range requests for the missing bytes before giving up
+#define DOWNLOAD_RESUME_DELAY_MS 1000    // Pause before a resume, times the attempt number
+
+// Ask servers for gzip/deflate bodies; they are inflated on the way into the decoder
+// (with the ROM inflater and a 32 KB window from the pipeline arena)
+#define HTTP_ACCEPT_COMPRESSION true
+
+// Image pipeline memory, set aside once at boot and reset for every image
+// The download ring, inflate window, decoder rows and panel band come from PSRAM;
+// the dither error rows are read and written for every pixel, so they get their own
+// internal SRAM block (20 KB fits either kernel for panel-sized images in both orientations)
+#define PIPELINE_ARENA_SIZE 131072      // PSRAM bytes
+#define PIPELINE_SRAM_ARENA_SIZE 20480  // Internal SRAM bytes
+#define DITHER_ERRORS_IN_SRAM true      // false: error rows in PSRAM too, to compare decode times
+
+// Longest ETag / Last-Modified values kept in RTC memory for conditional GETs
+// Longer values are not stored, so the next wake downloads the image again
+#define IMAGE_ETAG_MAX 72
+#define IMAGE_LAST_MODIFIED_MAX 32
+
+// TLS sessions with the HTTPS image store are kept in RTC memory and resumed on
+// the next wake, skipping most of the handshake. Serialized sessions include the
+// server certificate - larger ones aren't stored and get a full handshake every wake
+#define TLS_SESSION_SLOTS 2             // Hosts remembered
+#define TLS_SESSION_MAX_SIZE 2048       // Bytes per stored session
+#define TLS_HANDSHAKE_TIMEOUT_MS 10000  // Abandon a stalled handshake after this long
+
+// Optional root certificate (PEM) to verify the image store against - without it
+// the connection is encrypted but the server isn't verified
+// #define TLS_CA_CERT "-----BEGIN CERTIFICATE-----\n...\n-----END CERTIFICATE-----\n"
+
+// Frame cache on flash (LittleFS): the last metro frame and the screensaver are
+// kept as panel-native buffers. Inactive wakes show the cached screensaver without
+// WiFi until it's this old, then confirm it with the server (a 304 when unchanged)
+#define FRAME_CACHE_MAX_AGE_SECONDS 43200  // 12 hours
+
+// Wake-cycle traces kept in RTC memory until they're uploaded with the next
+// generate request (oldest are overwritten when full)
+#define WAKE_TRACE_SLOTS 16
+
 #endif  // CONFIG_H
@@ -0,0 +1,189 @@
+#include "departure_board.h"
+
+#include <ArduinoJson.h>
+
+#include "config.h"
+
+enum TextAlign { ALIGN_LEFT, ALIGN_CENTER, ALIGN_RIGHT };
+
+bool parseDepartureBoard(const String& json, DepartureBoard* board) {
+    JsonDocument doc;
+    if (deserializeJson(doc, json)) {
+        return false;
+    }
+
+    JsonArray directions = doc["directions"];
+    if (directions.isNull()) {
+        return false;
+    }
+
+    memset(board, 0, sizeof(*board));
+    strncpy(board->version, doc["version"] | "", sizeof(board->version) - 1);
+    strncpy(board->status, doc["status"] | "", sizeof(board->status) - 1);
+    board->validUntil = (time_t)(doc["validUntil"] | 0L);
+
+    for (JsonObject direction : directions) {
+        if (board->directionCount == BOARD_MAX_DIRECTIONS) {
+            break;
+        }
+        BoardDirection& target = board->directions[board->directionCount++];
+
+        for (JsonObject departure : direction["departures"].as<JsonArray>()) {
+            long scheduled = departure["scheduled"] | 0L;
+            if (scheduled == 0) {
+                continue;
+            }
+            if (target.count == BOARD_MAX_DEPARTURES) {
+                break;
+            }
+            BoardDeparture& entry = target.departures[target.count++];
+            entry.scheduled = (time_t)scheduled;
+            entry.estimated = (time_t)(departure["estimated"] | 0L);
+            strncpy(entry.platform, departure["platform"] | "", sizeof(entry.platform) - 1);
+        }
+    }
+    return true;
+}
+
+/**
+ * Fill a rectangle given in portrait board coordinates
+ * Board (x, y) is panel (DISPLAY_WIDTH - 1 - y, x), the same rotation as the images
+ */
+static void fillBoardRect(TFT_eSPI& display, int32_t x, int32_t y, int32_t w, int32_t h, uint16_t color) {
+    display.fillRect(DISPLAY_WIDTH - y - h, x, h, w, color);
+}
+
+static void drawBoardFrame(TFT_eSPI& display, int32_t x, int32_t y, int32_t w, int32_t h, uint16_t color) {
+    fillBoardRect(display, x, y, w, 2, color);
+    fillBoardRect(display, x, y + h - 2, w, 2, color);
+    fillBoardRect(display, x, y, 2, h, color);
+    fillBoardRect(display, x + w - 2, y, 2, h, color);
+}
+
+/**
+ * Draw text in portrait board coordinates, vertically centered on y
+ * The panel buffer can't be drawn to rotated, so the text is rendered into a
+ * 1-bit sprite first and copied over a pixel at a time
+ */
+static void drawBoardText(TFT_eSPI& display, const char* text, int32_t x, int32_t y, TextAlign align, uint8_t font,
+                          uint8_t size, uint16_t color) {
+    TFT_eSprite label(&display);
+    label.setColorDepth(1);
+    label.setTextFont(font);
+    label.setTextSize(size);
+
+    int32_t width = label.textWidth(text);
+    int32_t height = label.fontHeight();
+    if (width <= 0 || label.createSprite(width, height) == nullptr) {
+        return;
+    }
+
+    label.fillSprite(TFT_BLACK);
+    label.setTextColor(TFT_WHITE, TFT_BLACK);
+    label.drawString(text, 0, 0);
+
+    int32_t left = align == ALIGN_LEFT ? x : (align == ALIGN_CENTER ? x - width / 2 : x - width);
+    int32_t top = y - height / 2;
+    for (int32_t row = 0; row < height; row++) {
+        for (int32_t column = 0; column < width; column++) {
+            if (label.readPixel(column, row) != TFT_BLACK) {
+                display.drawPixel(DISPLAY_WIDTH - 1 - (top + row), left + column, color);
+            }
+        }
+    }
+    label.deleteSprite();
+}
+
+/**
+ * Status box colors, matching StatusBoxPixel in the image generator
+ */
+static void statusColors(const char* status, uint16_t* fill, uint16_t* text) {
+    String lower = status;
+    lower.toLowerCase();
+
+    if (lower.indexOf("cancelled") >= 0 || lower.indexOf("suspended") >= 0) {
+        *fill = TFT_BLACK;
+        *text = TFT_WHITE;
+    } else if (lower.indexOf("major") >= 0) {
+        *fill = TFT_RED;
+        *text = TFT_WHITE;
+    } else if (lower.indexOf("minor") >= 0) {
+        *fill = TFT_YELLOW;
+        *text = TFT_BLACK;
+    } else {
+        *fill = TFT_BLUE;
+        *text = TFT_WHITE;
+    }
+}
+
+static void drawDeparture(TFT_eSPI& display, const BoardDeparture& departure, const char* status, int32_t rowTop,
+                          time_t now) {
+    // Scheduled time, as on the generated image (e.g. 07:42pm)
+    struct tm local;
+    localtime_r(&departure.scheduled, &local);
+    char scheduled[12];
+    strftime(scheduled, sizeof(scheduled), "%I:%M%p", &local);
+    for (char* c = scheduled; *c; c++) {
+        *c = tolower(*c);
+    }
+    drawBoardText(display, scheduled, BOARD_MARGIN + 16, rowTop + 40, ALIGN_LEFT, 4, 1, TFT_BLACK);
+
+    if (departure.platform[0] != '\0') {
+        char platform[16];
+        snprintf(platform, sizeof(platform), "Platform %s", departure.platform);
+        drawBoardText(display, platform, BOARD_MARGIN + 16, rowTop + 72, ALIGN_LEFT, 2, 1, TFT_BLACK);
+    }
+
+    // Route status, shortened until it fits the box
+    uint16_t fill, text;
+    statusColors(status, &fill, &text);
+    fillBoardRect(display, BOARD_STATUS_X, rowTop + BOARD_STATUS_Y, BOARD_STATUS_WIDTH, BOARD_STATUS_HEIGHT, fill);
+    drawBoardFrame(display, BOARD_STATUS_X, rowTop + BOARD_STATUS_Y, BOARD_STATUS_WIDTH, BOARD_STATUS_HEIGHT,
+                   TFT_BLACK);
+
+    String label = status;
+    label.toUpperCase();
+    display.setTextFont(2);
+    display.setTextSize(1);
+    while (label.length() > 0 && display.textWidth(label) > BOARD_STATUS_WIDTH - 12) {
+        label.remove(label.length() - 1);
+    }
+    drawBoardText(display, label.c_str(), BOARD_STATUS_X + BOARD_STATUS_WIDTH / 2,
+                  rowTop + BOARD_STATUS_Y + BOARD_STATUS_HEIGHT / 2, ALIGN_CENTER, 2, 1, text);
+
+    // Minutes until departure, from the real-time estimate when there is one
+    time_t departs = departure.estimated != 0 ? departure.estimated : departure.scheduled;
+    // More than three digits don't fit the box; a departure that far off is shown as 999m
+    long minutes = min((long)(departs - now) / 60, 999L);
+    char countdown[8];
+    if (minutes <= 0) {
+        strcpy(countdown, "NOW");
+    } else {
+        snprintf(countdown, sizeof(countdown), "%ldm", minutes);
+    }
+    drawBoardText(display, countdown, BOARD_MINUTES_X + BOARD_MINUTES_WIDTH / 2,
+                  rowTop + BOARD_MINUTES_Y + BOARD_MINUTES_HEIGHT / 2, ALIGN_CENTER, 4, minutes < 100 ? 2 : 1,
+                  TFT_BLACK);
+}
+
+void drawDepartureBoard(TFT_eSPI& display, const DepartureBoard& board, time_t now) {
+    for (uint8_t d = 0; d < board.directionCount; d++) {
+        const BoardDirection& direction = board.directions[d];
+        int32_t rowsTop = BOARD_MARGIN + d * BOARD_SECTION_HEIGHT + BOARD_ROWS_OFFSET;
+
+        if (direction.count == 0) {
+            drawBoardText(display, "NO DEPARTURES", BOARD_WIDTH / 2, rowsTop + BOARD_ROW_HEIGHT / 2, ALIGN_CENTER, 4,
+                          1, TFT_BLACK);
+        }
+        for (uint8_t i = 0; i < direction.count; i++) {
+            drawDeparture(display, direction.departures[i], board.status, rowsTop + i * BOARD_ROW_PITCH, now);
+        }
+    }
+
+    // When this was drawn, as the panel keeps showing it while the device sleeps
+    struct tm local;
+    localtime_r(&now, &local);
+    char updated[24];
+    strftime(updated, sizeof(updated), "Updated %I:%M%p", &local);
+    drawBoardText(display, updated, BOARD_WIDTH / 2, BOARD_FOOTER_Y, ALIGN_CENTER, 2, 1, TFT_BLACK);
+}
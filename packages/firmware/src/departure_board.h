@@ -0,0 +1,69 @@
+#ifndef DEPARTURE_BOARD_H
+#define DEPARTURE_BOARD_H
+
+#include <Arduino.h>
+#include <time.h>
+
+#include "TFT_eSPI.h"
+
+// Departure board drawn on the device from the service's /departures document
+// The static chrome (headers, row boxes) comes from the board background frame;
+// only the times, status and minutes are drawn here
+
+#define BOARD_MAX_DIRECTIONS 2
+#define BOARD_MAX_DEPARTURES 3
+#define BOARD_STATUS_MAX 48
+#define BOARD_VERSION_MAX 16
+
+// Board layout in portrait coordinates (480x800, rotated onto the panel like the
+// metro image). Must match packages/service/src/services/departure-board.ts
+#define BOARD_WIDTH 480
+#define BOARD_HEIGHT 800
+#define BOARD_MARGIN 12
+#define BOARD_SECTION_HEIGHT 392  // Header plus rows of one direction
+#define BOARD_HEADER_HEIGHT 56
+#define BOARD_ROWS_OFFSET 68  // First row, from the top of the section
+#define BOARD_ROW_HEIGHT 96
+#define BOARD_ROW_PITCH 104
+#define BOARD_STATUS_X 176
+#define BOARD_STATUS_Y 20  // From the top of the row
+#define BOARD_STATUS_WIDTH 160
+#define BOARD_STATUS_HEIGHT 56
+#define BOARD_MINUTES_X 352
+#define BOARD_MINUTES_Y 18
+#define BOARD_MINUTES_WIDTH 104
+#define BOARD_MINUTES_HEIGHT 60
+#define BOARD_FOOTER_Y 788  // Center of the "updated" line
+
+struct BoardDeparture {
+    time_t scheduled;
+    time_t estimated;  // 0 if there's no real-time estimate
+    char platform[4];
+};
+
+struct BoardDirection {
+    uint8_t count;
+    BoardDeparture departures[BOARD_MAX_DEPARTURES];
+};
+
+struct DepartureBoard {
+    char version[BOARD_VERSION_MAX];  // Changes whenever the departures or status do
+    char status[BOARD_STATUS_MAX];    // Route service status, e.g. "Good service"
+    time_t validUntil;                // When the first departure leaves, 0 if none is due
+    uint8_t directionCount;
+    BoardDirection directions[BOARD_MAX_DIRECTIONS];
+};
+
+/**
+ * Parse the /departures JSON document
+ * Extra directions or departures are ignored. Returns false if it isn't a board
+ */
+bool parseDepartureBoard(const String& json, DepartureBoard* board);
+
+/**
+ * Draw the departures over the background already in the display buffer
+ * Minutes to departure are counted from now, so the document can be reused
+ */
+void drawDepartureBoard(TFT_eSPI& display, const DepartureBoard& board, time_t now);
+
+#endif  // DEPARTURE_BOARD_H
@@ -0,0 +1,143 @@
+#include "log.h"
+
+#include <esp_system.h>
+
+#if LOG_OUTPUT == LOG_OUTPUT_BINARY
+
+namespace {
+
+const uint32_t LOG_RING_MAGIC = 0x4C4F4731;  // "LOG1"
+
+// Records back to back, oldest first from head - used; each starts with its length
+struct LogRing {
+    uint32_t magic;
+    uint16_t head;  // Where the next record goes
+    uint16_t used;  // Bytes held
+    uint8_t data[LOG_RING_SIZE];
+};
+
+// Not initialized at boot, so a crash reset leaves the trail in place
+RTC_NOINIT_ATTR LogRing logRing;
+
+// Both cores log (the network task through the TLS client), so records are
+// reserved and copied under a lock
+portMUX_TYPE logRingLock = portMUX_INITIALIZER_UNLOCKED;
+
+void resetRing() {
+    logRing.magic = LOG_RING_MAGIC;
+    logRing.head = 0;
+    logRing.used = 0;
+}
+
+uint16_t ringTail() {
+    return (logRing.head + LOG_RING_SIZE - logRing.used) % LOG_RING_SIZE;
+}
+
+// Records must add up to the bytes held, or the ring was cut off mid-write
+bool ringConsistent() {
+    if (logRing.magic != LOG_RING_MAGIC || logRing.head >= LOG_RING_SIZE || logRing.used > LOG_RING_SIZE) {
+        return false;
+    }
+    uint32_t offset = 0;
+    while (offset < logRing.used) {
+        offset += 1 + logRing.data[(ringTail() + offset) % LOG_RING_SIZE];
+    }
+    return offset == logRing.used;
+}
+
+}  // namespace
+
+LogRecord::LogRecord(uint32_t id) : _size(1) {
+    for (int shift = 0; shift < 32; shift += 8) {
+        addByte(id >> shift);
+    }
+    addVarint(millis());
+}
+
+void LogRecord::add(double value) {
+    float single = value;
+    uint8_t bytes[sizeof(single)];
+    memcpy(bytes, &single, sizeof(single));
+    for (uint8_t byte : bytes) {
+        addByte(byte);
+    }
+}
+
+void LogRecord::add(const char* text) {
+    size_t length = text != nullptr ? strnlen(text, LOG_STRING_MAX) : 0;
+    addByte(length);
+    for (size_t i = 0; i < length; i++) {
+        addByte(text[i]);
+    }
+}
+
+void LogRecord::addByte(uint8_t value) {
+    // A record that doesn't fit is cut short; the decoder prints what's there
+    if (_size < MAX_SIZE) {
+        _data[_size++] = value;
+    }
+}
+
+void LogRecord::addVarint(uint64_t value) {
+    while (value >= 0x80) {
+        addByte((value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    addByte(value);
+}
+
+void LogRecord::addInteger(int64_t value) {
+    addVarint(((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+}
+
+void logWrite(LogRecord& record) {
+    record._data[0] = record.size() - 1;
+
+    portENTER_CRITICAL(&logRingLock);
+    while ((size_t)(LOG_RING_SIZE - logRing.used) < record.size()) {
+        logRing.used -= 1 + logRing.data[ringTail()];
+    }
+    for (size_t i = 0; i < record.size(); i++) {
+        logRing.data[(logRing.head + i) % LOG_RING_SIZE] = record.data()[i];
+    }
+    logRing.head = (logRing.head + record.size()) % LOG_RING_SIZE;
+    logRing.used += record.size();
+    portEXIT_CRITICAL(&logRingLock);
+}
+
+void logBegin() {
+    esp_reset_reason_t reason = esp_reset_reason();
+    if (reason == ESP_RST_POWERON || !ringConsistent()) {
+        resetRing();
+        return;
+    }
+
+    bool crashed = reason == ESP_RST_PANIC || reason == ESP_RST_INT_WDT || reason == ESP_RST_TASK_WDT ||
+                   reason == ESP_RST_WDT || reason == ESP_RST_BROWNOUT;
+    if (crashed) {
+        Serial.printf("Reset by a crash (reason %d) - log ring of the previous run:\n", (int)reason);
+        logDump();
+    }
+}
+
+void logDump() {
+    Serial.printf("LOGRING begin %u bytes\n", (unsigned)logRing.used);
+    uint16_t tail = ringTail();
+    for (uint32_t offset = 0; offset < logRing.used; offset += 32) {
+        Serial.print("LOGRING ");
+        for (uint32_t i = offset; i < offset + 32 && i < logRing.used; i++) {
+            Serial.printf("%02X", logRing.data[(tail + i) % LOG_RING_SIZE]);
+        }
+        Serial.println();
+    }
+    Serial.println("LOGRING end");
+}
+
+#else
+
+// Messages go straight to serial; there's no ring to keep
+void logBegin() {}
+
+void logDump() {}
+
+#endif  // LOG_OUTPUT == LOG_OUTPUT_BINARY
@@ -0,0 +1,141 @@
+#ifndef LOG_H
+#define LOG_H
+
+// Leveled logging, fixed at compile time by LOG_LEVEL and LOG_OUTPUT in config.h
+//
+//   LOG_INFO("WiFi connected in %lu ms", millis() - startTime);
+//
+// Messages above LOG_LEVEL compile to nothing, arguments included; the format is
+// still checked against the arguments. LOG_ERROR and LOG_WARN prefix the message
+// with "ERROR: " and "WARNING: ".
+//
+// LOG_OUTPUT_SERIAL prints each message as a line. LOG_OUTPUT_BINARY formats
+// nothing on the device: a message becomes a compact record in a ring buffer in
+// RTC memory, which survives deep sleep and crash resets. A record holds a hash
+// of the format string, the milliseconds since boot and the arguments (integers
+// as zigzag varints, floats as 4 bytes, strings truncated to LOG_STRING_MAX).
+// The ring is printed as hex after a crash reset, and tools/decode_log.py turns
+// it back into text using the format strings in the sources.
+
+#include <Arduino.h>
+
+#include <type_traits>
+
+#include "config.h"
+
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_INFO 3
+#define LOG_LEVEL_DEBUG 4
+
+#define LOG_OUTPUT_SERIAL 0
+#define LOG_OUTPUT_BINARY 1
+
+#define LOG_ENABLED(level) (LOG_LEVEL >= (level))
+
+// Only type-checks the format; never called
+inline void logCheckFormat(const char* format, ...) __attribute__((format(printf, 1, 2)));
+inline void logCheckFormat(const char* format, ...) {
+    (void)format;
+}
+
+#define LOG_DISCARD(format, ...)                            \
+    do {                                                    \
+        if (false) logCheckFormat(format, ##__VA_ARGS__);   \
+    } while (0)
+
+#if LOG_OUTPUT == LOG_OUTPUT_BINARY
+#define LOG_EMIT(format, ...)                                                                        \
+    do {                                                                                             \
+        if (false) logCheckFormat(format, ##__VA_ARGS__);                                            \
+        logEvent(std::integral_constant<uint32_t, logFormatId(format)>::value, ##__VA_ARGS__);      \
+    } while (0)
+#define LOG_FLUSH() \
+    do {            \
+    } while (0)
+#else
+#define LOG_EMIT(format, ...) Serial.printf(format "\n", ##__VA_ARGS__)
+#define LOG_FLUSH() Serial.flush()
+#endif
+
+#if LOG_ENABLED(LOG_LEVEL_ERROR)
+#define LOG_ERROR(format, ...) LOG_EMIT("ERROR: " format, ##__VA_ARGS__)
+#else
+#define LOG_ERROR(format, ...) LOG_DISCARD(format, ##__VA_ARGS__)
+#endif
+
+#if LOG_ENABLED(LOG_LEVEL_WARN)
+#define LOG_WARN(format, ...) LOG_EMIT("WARNING: " format, ##__VA_ARGS__)
+#else
+#define LOG_WARN(format, ...) LOG_DISCARD(format, ##__VA_ARGS__)
+#endif
+
+#if LOG_ENABLED(LOG_LEVEL_INFO)
+#define LOG_INFO(format, ...) LOG_EMIT(format, ##__VA_ARGS__)
+#else
+#define LOG_INFO(format, ...) LOG_DISCARD(format, ##__VA_ARGS__)
+#endif
+
+#if LOG_ENABLED(LOG_LEVEL_DEBUG)
+#define LOG_DEBUG(format, ...) LOG_EMIT(format, ##__VA_ARGS__)
+#else
+#define LOG_DEBUG(format, ...) LOG_DISCARD(format, ##__VA_ARGS__)
+#endif
+
+// Longest string argument kept in a binary record
+#define LOG_STRING_MAX 24
+
+// Record id: FNV-1a of the full format string, as tools/decode_log.py computes it
+constexpr uint32_t logFormatId(const char* format, uint32_t hash = 2166136261u) {
+    return *format == '\0' ? hash : logFormatId(format + 1, (hash ^ (uint8_t)*format) * 16777619u);
+}
+
+/**
+ * One binary record being built: [length][id][ms since boot][arguments...]
+ */
+class LogRecord {
+public:
+    static const size_t MAX_SIZE = 128;
+
+    explicit LogRecord(uint32_t id);
+
+    template <typename T>
+    typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value>::type add(T value) {
+        addInteger((int64_t)value);
+    }
+    void add(double value);
+    void add(const char* text);
+
+    const uint8_t* data() const { return _data; }
+    size_t size() const { return _size; }
+
+private:
+    friend void logWrite(LogRecord& record);
+
+    void addByte(uint8_t value);
+    void addVarint(uint64_t value);
+    void addInteger(int64_t value);
+
+    uint8_t _data[MAX_SIZE];
+    size_t _size;
+};
+
+// Append a finished record to the RTC ring, dropping the oldest records to make room
+void logWrite(LogRecord& record);
+
+template <typename... Args>
+void logEvent(uint32_t id, Args... args) {
+    LogRecord record(id);
+    (record.add(args), ...);
+    logWrite(record);
+}
+
+// Check the RTC ring after boot; it's reset unless it survived deep sleep or a crash.
+// After a crash reset the ring is printed, as that's when it's needed
+void logBegin();
+
+// Print the ring as hex lines between "LOGRING begin" and "LOGRING end"
+void logDump();
+
+#endif  // LOG_H
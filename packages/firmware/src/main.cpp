@@ -1,8 +1,18 @@
 #include <Arduino.h>
 #include <ArduinoJson.h>
 #include <HTTPClient.h>
+#include <LittleFS.h>
 #include <WiFi.h>
+#include <driver/gpio.h>
+#include <esp_heap_caps.h>
+#include <esp_netif.h>
+#include <esp_netif_net_stack.h>
+#include <esp_sleep.h>
+#include <esp_sntp.h>
 #include <esp_task_wdt.h>
+#include <esp_timer.h>
+#include <lwip/dhcp.h>
+#include <sys/time.h>
 #include <time.h>
 
 // Seeed GFX Library (automatically includes EPaper extension)
@@ -11,6 +21,28 @@
 // Board and display configuration
 #include "config.h"
 
+// Leveled logging, text or binary records in RTC memory
+#include "log.h"
+
+// Hardware-independent image pipeline (lib/image_pipeline)
+#include "arena.h"
+#include "bmp_decoder.h"
+#include "byte_ring.h"
+#include "chunked_decoder.h"
+#include "dither.h"
+#include "frame_format.h"
+#include "frame_hash.h"
+#include "image_format.h"
+#include "inflater.h"
+#include "panel_traits.h"
+#include "panel_writer.h"
+
+// TLS client that resumes sessions across deep sleep
+#include "resumable_tls_client.h"
+
+// Departure board drawn on the device
+#include "departure_board.h"
+
 // 7.3" E-Ink Spectra 6 (6-color) Display for EE04 Board
 // Using Seeed GFX library with BOARD_SCREEN_COMBO 509
 #ifdef EPAPER_ENABLE
@@ -19,50 +51,333 @@ EPaper epaper;
 
 // Function prototypes
 void setupWiFi();
+void stopWiFi();
+bool waitForWiFi(uint32_t timeoutMs, bool failFast);
+bool cachedLeaseUsable();
+uint32_t dhcpLeaseSeconds();
+void onWiFiEvent(arduino_event_id_t event, arduino_event_info_t);
 void syncTime();
+void restoreClock();
+bool clockNeedsSync();
+void applyTimeZone();
+int64_t wallClockMicros();
+void setWallClockMicros(int64_t micros);
 bool isActivePeriod();
-void triggerImageGeneration();
+bool generateAndFetchImage();
+bool renderDepartureBoard();
+bool loadBoardBackground();
 void downloadImage(const char* imageUrl);
+void beginImageRequest(HTTPClient& http, ResumableTlsClient& tlsClient, const char* url);
+void rememberValidators(HTTPClient& http, uint32_t urlHash);
+void streamImage(HTTPClient& http);
+void streamBody(HTTPClient& http);
+bool resumeImage(const char* url, struct ImageValidators validators);
 void updateDisplay();
 void enterDeepSleep(uint32_t durationSeconds);
+uint32_t scheduleWake(uint32_t durationSeconds);
+uint32_t secondsToActiveWindowChange(time_t now);
 void initDisplay();
 void setupButtonWakeup();
 int getWakeButtonPressed();
 void displayTestPattern();
+void beginImageStream();
+void feedImageBody(const uint8_t* data, size_t length);
+void feedImageStream(const uint8_t* data, size_t length);
+void endImageStream();
+void initPipelineArenas();
+void printMemoryStats();
+bool imageStreamFailed();
+bool imageStreamComplete();
+bool imageStreamVerified();
+uint32_t hashString(const char* text);
+bool hashDisplayBuffer(FrameHash* hash);
+void printChangedBands(const FrameHash& previous, const FrameHash& current);
+void refreshPanel();
+bool updateWithLightSleep();
+void refreshTask(void* parameter);
+void frameCacheBegin();
+bool frameCacheRead(uint8_t slot, struct FrameCacheHeader* header);
+bool frameCacheFresh(uint8_t slot);
+uint8_t frameCacheSlot(uint32_t urlHash);
+bool loadCachedFrame(uint8_t slot);
+bool loadFrameBase(const String& version);
+bool readCachedFrame(uint8_t slot, struct FrameCacheHeader* header);
+void storeCachedFrame(const FrameHash& hash);
+bool calibratePanelBuffer();
+void networkTask(void* parameter);
+void traceBegin();
+void tracePhase(uint8_t phase);
+void traceEnd();
+String tracePayload();
+
+// Panel color for each palette index (COLOR_BLACK ... COLOR_GREEN)
+const uint16_t PANEL_COLORS[] = {TFT_BLACK, TFT_WHITE, TFT_RED, TFT_YELLOW, TFT_BLUE, TFT_GREEN};
+
+// Native 4-bit value of each palette color in the EPaper framebuffer
+// Only valid when panelBufferPacked is set by calibratePanelBuffer()
+uint8_t panelNibbles[PALETTE_SIZE];
+bool panelBufferPacked = false;
 
-// Image buffer - stores downloaded image data
-uint8_t* imageBuffer = nullptr;
-size_t imageBufferSize = 0;
+/**
+ * Draws decoded images to the display buffer
+ * BMP rows are dithered to the palette first, pre-quantized frame rows are copied as-is
+ */
+class DisplayRowSink : public BmpRowSink, public FrameRowSink {
+public:
+    bool beginImage(const BmpInfo& info) override;
+    void writeRow(const uint8_t* bgr, uint32_t y, uint32_t fileRow) override;
+    bool beginFrame(const FrameHeader& header) override;
+    void writeFrameRow(const uint8_t* indices, uint32_t y) override;
+    void finish();
+    void end();
+
+private:
+    BmpInfo _info;
+    FloydSteinbergDither _dither;
+    PanelWriter<Panel> _writer;
+    bool _packed = false;         // Writing straight into the packed framebuffer
+    bool _delta = false;          // Frame rows patch the base frame in the buffer
+    uint8_t* _indices = nullptr;  // Palette index per pixel of the current row
+};
+
+// Memory for the image being decoded, set aside by initPipelineArenas() at boot
+// and reset by beginImageStream(), so no buffers are allocated or freed per image.
+// The dither error rows are the only per-pixel read-modify-write data and live in
+// internal SRAM; everything else is in PSRAM
+Arena pipelineArena;
+Arena ditherArena;
+alignas(16) uint8_t ditherArenaMemory[PIPELINE_SRAM_ARENA_SIZE];
+
+// Streaming image decoders
+// The image is parsed, dithered and drawn while it downloads, so only one
+// BMP row and the dithering error rows are held in memory (not the whole file)
+// The format is sniffed from the first bytes and the stream handed to one decoder
+BmpDecoder imageDecoder;
+FrameDecoder frameDecoder;
+DisplayRowSink displaySink;
+ImageFormat streamFormat = IMAGE_FORMAT_UNKNOWN;
+uint8_t streamHead[16];    // First bytes of the stream, for format detection and debugging
+size_t streamHeadBytes = 0;
+size_t streamBytes = 0;
+unsigned long decodeMicros = 0;  // Time spent decoding, excluding network waits
+
+// Content-Encoding of the image body; compressed bodies pass through the inflater
+// before reaching feedImageStream()
+ContentEncoding streamEncoding = CONTENT_ENCODING_IDENTITY;
+unsigned long inflateMicros = 0;  // Time spent inflating, excluding decoding
+
+class ImageStreamSink : public ByteSink {
+public:
+    void write(const uint8_t* data, size_t length) override { feedImageStream(data, length); }
+};
+
+ImageStreamSink imageStreamSink;
+StreamInflater inflater;
+
+// Download of the image being decoded, across the Range requests that resume it
+// What has been received lives on in the decoder state and the display buffer
+struct DownloadProgress {
+    size_t received;  // Body bytes fed to the decoder
+    bool done;        // Nothing left to fetch: the body arrived in full, or it can't be resumed
+};
+
+DownloadProgress downloadProgress = {};
+ByteRing downloadRing;  // Allocated from the pipeline arena by beginImageStream()
+
+// Shared state between downloadImage() (decoder, Arduino core) and networkTask()
+struct DownloadJob {
+    HTTPClient* http;
+    WiFiClient* stream;
+    ChunkedDecoder* chunked;  // Strips the framing of a chunked body, nullptr otherwise
+    size_t contentLength;     // Body length, SIZE_MAX when the server didn't send one
+    ByteRing* ring;
+    TaskHandle_t decodeTask;
+    TaskHandle_t networkTask;
+    std::atomic<bool> abort;  // Set by the decoder when the image can't be decoded
+    size_t bytesRead;         // Payload bytes; written by the network task, read after the ring is finished
+    bool stalled;             // No data for DOWNLOAD_STALL_TIMEOUT_MS
+};
+
+// Per-stage stall counters for the last download
+// A stall is a wait on the other stage: the network waiting for ring space
+// means decoding is the bottleneck, the decoder waiting for data means the network is
+struct PipelineStats {
+    uint32_t networkStalls;
+    uint32_t networkStallMs;
+    uint32_t decodeStalls;
+    uint32_t decodeStallMs;
+};
+
+PipelineStats pipelineStats = {};
+
+// HTTP validators of an image, used for conditional GETs
+struct ImageValidators {
+    uint32_t urlHash;  // hashString() of the image URL, 0 if nothing is stored
+    char etag[IMAGE_ETAG_MAX];
+    char lastModified[IMAGE_LAST_MODIFIED_MAX];
+};
+
+// Validators of the image currently on the panel - kept in RTC memory across deep sleep
+// and only replaced once a new image has actually been displayed
+RTC_DATA_ATTR ImageValidators displayedImage = {};
+
+// Validators of the image being downloaded, committed by updateDisplay()
+ImageValidators downloadedImage = {};
+
+// Set when the server reports the displayed image hasn't changed (304)
+bool imageNotModified = false;
+
+// When the metro content fetched this wake goes stale - the first departure on it
+// leaves - as reported by the service. 0 if unknown
+time_t contentValidUntil = 0;
+
+// Content hash of the frame currently on the panel, kept in RTC memory across deep sleep
+// Catches downloads that differ byte-wise but quantize to the same pixels
+RTC_DATA_ATTR FrameHash displayedFrame = {};
+RTC_DATA_ATTR bool displayedFrameValid = false;
+
+// Frame cache on flash (LittleFS): the last metro frame, the screensaver and the
+// departure board background, stored as panel-native framebuffers with the
+// validators (server version) they came with. The drawn departure board isn't
+// cached: it's redrawn from the departures document, and must not replace the
+// metro frame that delta frames are made against
+enum FrameCacheSlot {
+    FRAME_CACHE_METRO,
+    FRAME_CACHE_SCREENSAVER,
+    FRAME_CACHE_BACKGROUND,
+    FRAME_CACHE_SLOTS,
+    FRAME_CACHE_NONE = FRAME_CACHE_SLOTS
+};
+const char* const FRAME_CACHE_PATHS[FRAME_CACHE_SLOTS] = {"/frames/metro.bin", "/frames/screensaver.bin",
+                                                          "/frames/background.bin"};
+
+struct FrameCacheHeader {
+    uint32_t magic;  // FRAME_CACHE_MAGIC
+    uint16_t width;
+    uint16_t height;
+    uint8_t nibbles[PALETTE_SIZE];  // panelNibbles when stored - the buffer is only valid with the same values
+    ImageValidators validators;
+    FrameHash hash;
+};
+
+#define FRAME_CACHE_MAGIC 0x43463645  // "E6FC"
+
+// Wall-clock time (seconds) each cache slot was last confirmed current by the server
+RTC_DATA_ATTR uint32_t frameCacheChecked[FRAME_CACHE_SLOTS] = {};
+
+bool frameCacheMounted = false;
+bool cachedFrameLoaded = false;  // Display buffer holds a cached frame rather than a download
+bool frameBaseLoaded = false;    // Display buffer holds the base frame a delta frame patches
+
+// Last successful WiFi connection, kept in RTC memory for fast reconnects
+struct WiFiCache {
+    bool valid;
+    uint8_t bssid[6];
+    int32_t channel;
+    uint32_t ip;  // DHCP lease - 0 if it shouldn't be reused
+    uint32_t gateway;
+    uint32_t subnet;
+    uint32_t dns;
+    uint32_t leaseStart;    // Wall-clock seconds when DHCP granted the lease - 0 if the clock wasn't set
+    uint32_t leaseSeconds;  // Lease time granted by the DHCP server
+};
+
+RTC_DATA_ATTR WiFiCache wifiCache = {};
+
+// Connection events, set from the WiFi event handler
+EventGroupHandle_t wifiEvents = nullptr;
+#define WIFI_CONNECTED_BIT (1 << 0)
+#define WIFI_DISCONNECTED_BIT (1 << 1)
+
+// Wall clock carried across deep sleep
+// The RTC keeps counting while asleep but drifts; the drift is measured at each NTP
+// sync and used to correct both the restored time and the programmed sleep
+struct ClockState {
+    bool valid;               // Synced with NTP at least once since power-on
+    int64_t syncMicros;       // NTP time at the last sync
+    int64_t sleepMicros;      // Wall-clock time when the device last went to sleep
+    uint32_t sleepSeconds;    // Sleep duration programmed into the timer
+    int32_t driftPpm;         // Real time = RTC time * (1 + drift) - positive means the RTC runs slow
+    bool driftMeasured;
+    uint16_t wakesSinceSync;
+};
+
+RTC_DATA_ATTR ClockState clockState = {};
+
+// Wake-cycle phases, in the order they happen
+// Each phase records when it ended (microseconds since boot); skipped phases stay 0
+enum WakePhase {
+    PHASE_BOOT,        // setup() entered
+    PHASE_WIFI,        // WiFi connected
+    PHASE_NTP,         // Clock ready (NTP sync or restored)
+    PHASE_GENERATE,    // Generate request answered
+    PHASE_FIRST_BYTE,  // First image byte received
+    PHASE_DOWNLOAD,    // Image download finished
+    PHASE_DECODE,      // Image decoded into the framebuffer
+    PHASE_REFRESH,     // Panel refresh finished
+    PHASE_SLEEP,       // Entering deep sleep
+    PHASE_COUNT
+};
+
+struct WakeTrace {
+    uint32_t sequence;  // Wake counter since power-on
+    uint8_t wakeReason;
+    int8_t rssi;
+    uint32_t bytes;  // Image bytes received
+    uint32_t phaseMicros[PHASE_COUNT];
+};
+
+// Ring of finished wake traces, uploaded with the next generate request
+RTC_DATA_ATTR WakeTrace wakeTraces[WAKE_TRACE_SLOTS];
+RTC_DATA_ATTR uint32_t wakeSequence = 0;
+RTC_DATA_ATTR uint32_t wakeTraceSent = 0;  // Sequence of the newest trace the service has
+
+// Trace of the current wake
+WakeTrace currentTrace = {};
 
 // Wake-up tracking
 esp_sleep_wakeup_cause_t wakeup_reason;
 
 void setup() {
+    traceBegin();
+
     Serial.begin(115200);
     delay(1000);
+    logBegin();
 
-    Serial.println("\n=================================");
-    Serial.println("E-Ink Display System Starting...");
-    Serial.println("=================================\n");
+    LOG_INFO("\n=================================");
+    LOG_INFO("E-Ink Display System Starting...");
+    LOG_INFO("=================================\n");
 
     // Check wake-up reason
     wakeup_reason = esp_sleep_get_wakeup_cause();
+    currentTrace.wakeReason = wakeup_reason;
     int buttonPressed = getWakeButtonPressed();
 
     if (buttonPressed == METRO_BUTTON_PIN) {
-        Serial.println("*** Woken by METRO BUTTON (Key 1) - Forcing metro update! ***");
+        LOG_INFO("*** Woken by METRO BUTTON (Key 1) - Forcing metro update! ***");
     } else if (buttonPressed == SCREENSAVER_BUTTON_PIN) {
-        Serial.println("*** Woken by SCREENSAVER BUTTON (Key 2) - Showing screensaver! ***");
+        LOG_INFO("*** Woken by SCREENSAVER BUTTON (Key 2) - Showing screensaver! ***");
     }
 
-    // Initialize WiFi
-    setupWiFi();
+    // Rebuild the wall clock from RTC memory (no network needed)
+    restoreClock();
+
+    // Mount the flash frame cache
+    frameCacheBegin();
 
-    // Synchronize time with NTP server
+    // WiFi only comes up when something needs the network - here the NTP sync,
+    // otherwise the image download below
+    if (clockNeedsSync()) {
+        setupWiFi();
+    }
+
+    // Synchronize time with NTP server when the estimate can't be trusted
     syncTime();
 
     // Initialize display
     initDisplay();
+    initPipelineArenas();
 
     // Determine what to display based on wake source
     bool showMetro = false;
@@ -70,39 +385,57 @@ void setup() {
 
     if (buttonPressed == METRO_BUTTON_PIN) {
         // Metro button pressed - force metro update
-        Serial.println("Manual metro update requested");
+        LOG_INFO("Manual metro update requested");
         showMetro = true;
         sleepDuration = ACTIVE_PERIOD_SLEEP_SECONDS;
     } else if (buttonPressed == SCREENSAVER_BUTTON_PIN) {
         // Screensaver button pressed - show screensaver
-        Serial.println("Manual screensaver display requested");
+        LOG_INFO("Manual screensaver display requested");
         showMetro = false;
         sleepDuration = INACTIVE_PERIOD_SLEEP_SECONDS;
     } else {
         // Timer wake - check if we're in active period
         if (isActivePeriod()) {
-            Serial.println("Active period detected - updating metro display");
+            LOG_INFO("Active period detected - updating metro display");
             showMetro = true;
             sleepDuration = ACTIVE_PERIOD_SLEEP_SECONDS;
         } else {
-            Serial.println("Inactive period - showing screensaver");
+            LOG_INFO("Inactive period - showing screensaver");
             showMetro = false;
             sleepDuration = INACTIVE_PERIOD_SLEEP_SECONDS;
         }
     }
 
     if (showMetro) {
-        // Trigger image generation
-        triggerImageGeneration();
+        if (WiFi.status() != WL_CONNECTED) {
+            setupWiFi();
+        }
 
-        // Download metro image
-        downloadImage(METRO_IMAGE_URL);
+        // Draw the board from the departures document, or fall back to the
+        // image rendered by the service
+        if (!DEPARTURE_BOARD_ON_DEVICE || !renderDepartureBoard()) {
+            // Generate a fresh image and receive it in the same request
+            if (!generateAndFetchImage()) {
+                // Download metro image
+                downloadImage(METRO_IMAGE_URL);
+            }
 
-        // Update display
-        updateDisplay();
+            // Update display
+            updateDisplay();
+        }
     } else {
-        // Download screensaver image
-        downloadImage(SCREENSAVER_IMAGE_URL);
+        // The screensaver is drawn straight from flash when the cached copy can be
+        // trusted: always for KEY2, and on timer wakes until it's due to be checked
+        // with the server again
+        bool trustCache = buttonPressed == SCREENSAVER_BUTTON_PIN || frameCacheFresh(FRAME_CACHE_SCREENSAVER);
+        if (!trustCache || !loadCachedFrame(FRAME_CACHE_SCREENSAVER)) {
+            if (WiFi.status() != WL_CONNECTED) {
+                setupWiFi();
+            }
+
+            // Download screensaver image
+            downloadImage(SCREENSAVER_IMAGE_URL);
+        }
 
         // Update display
         updateDisplay();
@@ -119,64 +452,314 @@ void loop() {
 
 /**
  * Connect to WiFi network
+ * Goes straight to the cached access point (no scan) and reuses the cached IP
+ * lease (no DHCP) for the first half of its lease time, falling back to a full
+ * scan if that fails
  */
 void setupWiFi() {
-    Serial.print("Connecting to WiFi: ");
-    Serial.println(WIFI_SSID);
+    LOG_INFO("Connecting to WiFi: %s", WIFI_SSID);
+
+    unsigned long startTime = millis();
 
+    // setup() may connect more than once per wake; the handler is registered once
+    if (!wifiEvents) {
+        wifiEvents = xEventGroupCreate();
+        WiFi.onEvent(onWiFiEvent);
+    }
+    WiFi.persistent(false);
     WiFi.mode(WIFI_STA);
-    WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
 
-    int attempts = 0;
-    while (WiFi.status() != WL_CONNECTED && attempts < 30) {
-        delay(500);
-        Serial.print(".");
-        attempts++;
+#ifdef WIFI_STATIC_IP
+    IPAddress staticIp, staticGateway, staticSubnet, staticDns;
+    staticIp.fromString(WIFI_STATIC_IP);
+    staticGateway.fromString(WIFI_STATIC_GATEWAY);
+    staticSubnet.fromString(WIFI_STATIC_SUBNET);
+    staticDns.fromString(WIFI_STATIC_DNS);
+    WiFi.config(staticIp, staticGateway, staticSubnet, staticDns);
+#endif
+
+    bool connected = false;
+    bool fastConnect = wifiCache.valid;
+
+    if (fastConnect) {
+        LOG_INFO("Fast connect to cached AP on channel %ld", (long)wifiCache.channel);
+
+#ifndef WIFI_STATIC_IP
+        if (cachedLeaseUsable()) {
+            WiFi.config(IPAddress(wifiCache.ip), IPAddress(wifiCache.gateway), IPAddress(wifiCache.subnet),
+                        IPAddress(wifiCache.dns));
+        } else {
+            wifiCache.ip = 0;
+        }
+#endif
+
+        xEventGroupClearBits(wifiEvents, WIFI_CONNECTED_BIT | WIFI_DISCONNECTED_BIT);
+        WiFi.begin(WIFI_SSID, WIFI_PASSWORD, wifiCache.channel, wifiCache.bssid);
+        connected = waitForWiFi(WIFI_FAST_CONNECT_TIMEOUT_MS, true);
+
+        if (!connected) {
+            LOG_INFO("Fast connect failed - falling back to a full scan");
+            wifiCache.valid = false;
+            WiFi.disconnect();
+        }
+    }
+
+    if (!connected) {
+#ifndef WIFI_STATIC_IP
+        // Back to DHCP in case a cached lease was applied
+        WiFi.config(IPAddress((uint32_t)0), IPAddress((uint32_t)0), IPAddress((uint32_t)0));
+        wifiCache.ip = 0;
+#endif
+        xEventGroupClearBits(wifiEvents, WIFI_CONNECTED_BIT | WIFI_DISCONNECTED_BIT);
+        WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
+        connected = waitForWiFi(WIFI_CONNECT_TIMEOUT_MS, false);
     }
 
-    if (WiFi.status() == WL_CONNECTED) {
-        Serial.println("\nWiFi connected!");
-        Serial.print("IP address: ");
-        Serial.println(WiFi.localIP());
-        Serial.print("Signal strength (RSSI): ");
-        Serial.print(WiFi.RSSI());
-        Serial.println(" dBm");
+    if (connected) {
+        LOG_INFO("WiFi connected in %lu ms (%s%s)", millis() - startTime,
+                 fastConnect && wifiCache.valid ? "fast reconnect" : "full scan",
+                 wifiCache.ip != 0 ? ", cached IP" : "");
+        LOG_INFO("IP address: %s", WiFi.localIP().toString().c_str());
+        LOG_INFO("Signal strength (RSSI): %d dBm", WiFi.RSSI());
+
+        tracePhase(PHASE_WIFI);
+        currentTrace.rssi = WiFi.RSSI();
+
+        // Remember this AP for the next wake
+        memcpy(wifiCache.bssid, WiFi.BSSID(), sizeof(wifiCache.bssid));
+        wifiCache.channel = WiFi.channel();
+        wifiCache.valid = true;
+
+#ifndef WIFI_STATIC_IP
+        if (wifiCache.ip == 0) {
+            // Fresh lease from DHCP
+            wifiCache.ip = WiFi.localIP();
+            wifiCache.gateway = WiFi.gatewayIP();
+            wifiCache.subnet = WiFi.subnetMask();
+            wifiCache.dns = WiFi.dnsIP();
+            wifiCache.leaseStart = clockState.valid ? (uint32_t)(wallClockMicros() / 1000000) : 0;
+            wifiCache.leaseSeconds = dhcpLeaseSeconds();
+            LOG_INFO("DHCP lease: %lu s", (unsigned long)wifiCache.leaseSeconds);
+        }
+#endif
     } else {
-        Serial.println("\nWiFi connection failed!");
-        Serial.println("Entering deep sleep and will retry after wake-up...");
+        LOG_INFO("WiFi connection failed!");
+        wifiCache.valid = false;
+        LOG_INFO("Entering deep sleep and will retry after wake-up...");
         enterDeepSleep(ACTIVE_PERIOD_SLEEP_SECONDS);
     }
 }
 
+/**
+ * Whether the cached DHCP address can be applied without asking the server
+ * A DHCP client renews at half the lease (T1), so past that point the address
+ * is requested again. Needs the wall clock, restored before setupWiFi()
+ */
+bool cachedLeaseUsable() {
+    if (wifiCache.ip == 0 || wifiCache.leaseStart == 0 || !clockState.valid) {
+        return false;
+    }
+    int64_t heldSeconds = wallClockMicros() / 1000000 - wifiCache.leaseStart;
+    return heldSeconds >= 0 && heldSeconds < wifiCache.leaseSeconds / 2;
+}
+
+/**
+ * Lease time the DHCP server granted for the station address, in seconds
+ * 0 if there's no DHCP lease on the interface
+ */
+uint32_t dhcpLeaseSeconds() {
+    esp_netif_t* netif = esp_netif_get_handle_from_ifkey("WIFI_STA_DEF");
+    if (netif == nullptr) {
+        return 0;
+    }
+    struct netif* lwipNetif = (struct netif*)esp_netif_get_netif_impl(netif);
+    struct dhcp* dhcp = lwipNetif != nullptr ? netif_dhcp_data(lwipNetif) : nullptr;
+    return dhcp != nullptr ? dhcp->offered_t0_lease : 0;
+}
+
+/**
+ * Power the radio down once the wake's network work is done
+ * Called before the panel refresh and again before deep sleep
+ */
+void stopWiFi() {
+    if (WiFi.getMode() == WIFI_OFF) {
+        return;
+    }
+    WiFi.disconnect(true);
+    WiFi.mode(WIFI_OFF);
+    LOG_INFO("WiFi off");
+}
+
+/**
+ * Wait for the WiFi event handler to report an IP address
+ * The event bits must be cleared before WiFi.begin() so early events aren't lost.
+ * With failFast a disconnect (e.g. the cached AP is gone) ends the wait early
+ */
+bool waitForWiFi(uint32_t timeoutMs, bool failFast) {
+    EventBits_t waitBits = WIFI_CONNECTED_BIT | (failFast ? WIFI_DISCONNECTED_BIT : 0);
+
+    EventBits_t bits = xEventGroupWaitBits(wifiEvents, waitBits, pdFALSE, pdFALSE, pdMS_TO_TICKS(timeoutMs));
+    return (bits & WIFI_CONNECTED_BIT) && WiFi.status() == WL_CONNECTED;
+}
+
+/**
+ * WiFi event handler (runs on the WiFi event task)
+ */
+void onWiFiEvent(arduino_event_id_t event, arduino_event_info_t) {
+    if (event == ARDUINO_EVENT_WIFI_STA_GOT_IP) {
+        xEventGroupSetBits(wifiEvents, WIFI_CONNECTED_BIT);
+    } else if (event == ARDUINO_EVENT_WIFI_STA_DISCONNECTED) {
+        xEventGroupSetBits(wifiEvents, WIFI_DISCONNECTED_BIT);
+    }
+}
+
 /**
  * Synchronize time with NTP server
+ * Skipped when the clock restored from RTC memory is still accurate enough;
+ * otherwise the error of the estimate is used to measure the RTC drift
  */
 void syncTime() {
-    Serial.println("\n--- Synchronizing Time ---");
-    Serial.print("NTP Server: ");
-    Serial.println(NTP_SERVER);
+    LOG_INFO("\n--- Synchronizing Time ---");
+
+    if (!clockNeedsSync()) {
+        clockState.wakesSinceSync++;
+        LOG_INFO("Using clock carried across deep sleep (%u wakes since NTP sync)", clockState.wakesSinceSync);
+        tracePhase(PHASE_NTP);
+        return;
+    }
+
+    LOG_INFO("NTP Server: %s", NTP_SERVER);
+
+    // Estimated time, advanced by the (crystal-accurate) time spent waiting for NTP
+    int64_t estimateMicros = wallClockMicros();
+    int64_t requestMicros = esp_timer_get_time();
 
+    // time() is already plausible when carried over, so wait for the sync itself
+    sntp_set_sync_status(SNTP_SYNC_STATUS_RESET);
     configTime(GMT_OFFSET_SEC, DAYLIGHT_OFFSET_SEC, NTP_SERVER);
 
-    Serial.print("Waiting for time sync");
+    LOG_INFO("Waiting for time sync");
     int attempts = 0;
-    while (time(nullptr) < 100000 && attempts < 30) {
-        Serial.print(".");
-        delay(500);
+    while (sntp_get_sync_status() != SNTP_SYNC_STATUS_COMPLETED && attempts < 150) {
+        delay(100);
         attempts++;
     }
-    Serial.println();
 
     time_t now = time(nullptr);
-    if (now > 100000) {
+    if (sntp_get_sync_status() == SNTP_SYNC_STATUS_COMPLETED) {
+        int64_t syncMicros = wallClockMicros();
+        estimateMicros += esp_timer_get_time() - requestMicros;
+
+        if (clockState.valid) {
+            int64_t errorMicros = syncMicros - estimateMicros;
+            int64_t intervalMicros = syncMicros - clockState.syncMicros;
+
+            LOG_INFO("Clock estimate was off by %ld ms after %ld s", (long)(errorMicros / 1000),
+                     (long)(intervalMicros / 1000000));
+
+            // The estimate already applied the old drift, so the error is the residual
+            if (intervalMicros >= (int64_t)CLOCK_MIN_DRIFT_INTERVAL_SECONDS * 1000000) {
+                int64_t driftPpm = clockState.driftPpm + errorMicros * 1000000 / intervalMicros;
+                if (driftPpm > -CLOCK_MAX_DRIFT_PPM && driftPpm < CLOCK_MAX_DRIFT_PPM) {
+                    clockState.driftPpm = driftPpm;
+                    clockState.driftMeasured = true;
+                    LOG_INFO("RTC drift: %ld ppm", (long)clockState.driftPpm);
+                }
+            }
+        }
+
+        clockState.valid = true;
+        clockState.syncMicros = syncMicros;
+        clockState.wakesSinceSync = 0;
+
         struct tm timeinfo;
         localtime_r(&now, &timeinfo);
-        Serial.print("Current time: ");
-        Serial.println(asctime(&timeinfo));
+        LOG_INFO("Current time: %.24s", asctime(&timeinfo));
+    } else {
+        LOG_WARN("Failed to sync time with NTP server");
+        LOG_INFO("Proceeding with system time...");
+    }
+
+    tracePhase(PHASE_NTP);
+}
+
+/**
+ * Rebuild the wall clock after deep sleep
+ * The system time kept by the RTC is corrected for the measured drift over the
+ * sleep. If it wasn't kept, the programmed sleep duration is used instead.
+ */
+void restoreClock() {
+    // The time zone isn't kept across deep sleep
+    applyTimeZone();
+
+    if (!clockState.valid || clockState.sleepMicros == 0) {
+        return;
+    }
+
+    int64_t elapsedMicros = wallClockMicros() - clockState.sleepMicros;
+    if (elapsedMicros <= 0) {
+        // RTC time was lost - assume the timer ran its full course
+        elapsedMicros = (int64_t)clockState.sleepSeconds * 1000000 + esp_timer_get_time();
+    }
+
+    elapsedMicros += elapsedMicros * clockState.driftPpm / 1000000;
+    setWallClockMicros(clockState.sleepMicros + elapsedMicros);
+    clockState.sleepMicros = 0;
+
+    time_t now = time(nullptr);
+    struct tm timeinfo;
+    localtime_r(&now, &timeinfo);
+    LOG_INFO("Clock restored from RTC memory: %.24s", asctime(&timeinfo));
+}
+
+/**
+ * Check whether the restored clock needs an NTP sync
+ */
+bool clockNeedsSync() {
+    if (!clockState.valid || clockState.wakesSinceSync + 1 >= NTP_SYNC_INTERVAL_WAKES) {
+        return true;
+    }
+
+    // Worst-case error accumulated since the last sync
+    int64_t sinceSyncSeconds = (wallClockMicros() - clockState.syncMicros) / 1000000;
+    int64_t uncertaintyPpm = clockState.driftMeasured ? CLOCK_DRIFT_UNCERTAINTY_PPM : CLOCK_UNCALIBRATED_UNCERTAINTY_PPM;
+    return sinceSyncSeconds * uncertaintyPpm / 1000000 > NTP_MAX_ERROR_SECONDS;
+}
+
+/**
+ * Set the TZ variable the same way configTime() does, without starting SNTP
+ */
+void applyTimeZone() {
+    long offset = -GMT_OFFSET_SEC;
+    char tz[40];
+
+    if (DAYLIGHT_OFFSET_SEC != 3600) {
+        long dstOffset = offset - DAYLIGHT_OFFSET_SEC;
+        snprintf(tz, sizeof(tz), "UTC%ld:%02u:%02uDST%ld:%02u:%02u", offset / 3600, (unsigned)abs((offset % 3600) / 60),
+                 (unsigned)abs(offset % 60), dstOffset / 3600, (unsigned)abs((dstOffset % 3600) / 60),
+                 (unsigned)abs(dstOffset % 60));
     } else {
-        Serial.println("WARNING: Failed to sync time with NTP server");
-        Serial.println("Proceeding with system time...");
+        snprintf(tz, sizeof(tz), "UTC%ld:%02u:%02uDST", offset / 3600, (unsigned)abs((offset % 3600) / 60),
+                 (unsigned)abs(offset % 60));
     }
+    setenv("TZ", tz, 1);
+    tzset();
+}
+
+/**
+ * Current wall-clock time in microseconds since the epoch
+ */
+int64_t wallClockMicros() {
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+void setWallClockMicros(int64_t micros) {
+    struct timeval tv;
+    tv.tv_sec = micros / 1000000;
+    tv.tv_usec = micros % 1000000;
+    settimeofday(&tv, nullptr);
 }
 
 /**
@@ -190,8 +773,7 @@ bool isActivePeriod() {
 
     int currentHour = timeinfo.tm_hour;
 
-    Serial.print("Current hour: ");
-    Serial.println(currentHour);
+    LOG_INFO("Current hour: %d", currentHour);
 
     // Check morning period (5:00 AM - 8:00 AM)
     bool morningPeriod = (currentHour >= MORNING_START_HOUR && currentHour < MORNING_END_HOUR);
@@ -203,489 +785,1473 @@ bool isActivePeriod() {
 }
 
 /**
- * Trigger image generation via service API
+ * Generate a fresh metro image via the service API and fetch it in the same round trip
+ * The service returns the finished frame inline, or JSON with a versioned frame URL
+ * and size, which is downloaded straight away. Returns false if nothing was fetched
+ * (e.g. an older service that only confirms generation), so the caller falls back
+ * to METRO_IMAGE_URL - generation has already finished by then.
  */
-void triggerImageGeneration() {
-    Serial.println("\n--- Triggering Image Generation ---");
-    Serial.print("API URL: ");
-    Serial.println(SERVICE_API_URL);
+bool generateAndFetchImage() {
+    LOG_INFO("\n--- Generating Image ---");
+    LOG_INFO("API URL: %s", SERVICE_API_URL);
 
     if (WiFi.status() != WL_CONNECTED) {
-        Serial.println("ERROR: WiFi not connected!");
-        return;
+        LOG_ERROR("WiFi not connected!");
+        return false;
     }
 
     HTTPClient http;
-    http.begin(SERVICE_API_URL);
+    http.begin(String(SERVICE_API_URL) + "?inline=1");
     http.setTimeout(30000);  // 30 second timeout for image generation
 
-    int httpCode = http.POST("");
-
-    if (httpCode == HTTP_CODE_OK) {
-        String response = http.getString();
-        Serial.println("Image generation triggered successfully");
-        Serial.print("Response: ");
-        Serial.println(response);
+    const char* responseHeaders[] = {"Content-Type",      "X-Frame-Version",  "X-Frame-Url", "X-Valid-Until",
+                                     "Transfer-Encoding", "Content-Encoding", "X-Frame-Base"};
+    http.collectHeaders(responseHeaders, 7);
+    if (HTTP_ACCEPT_COMPRESSION) {
+        http.addHeader("Accept-Encoding", "gzip, deflate");
+    }
 
-        // Wait a moment for image generation to complete
-        Serial.println("Waiting for image generation to complete...");
-        delay(5000);
-    } else {
-        Serial.print("API call failed, error: ");
-        Serial.println(http.errorToString(httpCode).c_str());
-        Serial.println("Proceeding with existing image...");
+    // The last metro frame from the service is kept in the frame cache; with its
+    // version the service can send just what changed since
+    FrameCacheHeader base;
+    String baseVersion;
+    if (frameCacheRead(FRAME_CACHE_METRO, &base) && base.validators.urlHash == hashString(SERVICE_API_URL)) {
+        baseVersion = base.validators.etag;
+    }
+    if (baseVersion.length() > 0) {
+        http.addHeader("X-Frame-Base", baseVersion);
     }
 
-    http.end();
-}
+    // Traces of earlier wakes ride along with the request
+    String traces = tracePayload();
+    http.addHeader("Content-Type", "application/json");
 
-/**
- * Download image from server
- */
-void downloadImage(const char* imageUrl) {
-    Serial.println("\n--- Downloading Image ---");
-    Serial.print("Image URL: ");
-    Serial.println(imageUrl);
+    int httpCode = http.POST(traces);
+    tracePhase(PHASE_GENERATE);
 
-    if (WiFi.status() != WL_CONNECTED) {
-        Serial.println("ERROR: WiFi not connected!");
-        return;
+    if (httpCode != HTTP_CODE_OK) {
+        LOG_INFO("API call failed, error: %s", http.errorToString(httpCode).c_str());
+        LOG_INFO("Proceeding with existing image...");
+        http.end();
+        return false;
     }
 
-    HTTPClient http;
-    http.begin(imageUrl);
-    http.setTimeout(30000);  // 30 second timeout
+    // The service has the traces now
+    wakeTraceSent = currentTrace.sequence - 1;
 
-    int httpCode = http.GET();
+    // Frame in the response body - decode it straight from this connection
+    if (http.header("Content-Type").startsWith("application/octet-stream")) {
+        contentValidUntil = (time_t)http.header("X-Valid-Until").toInt();
 
-    if (httpCode == HTTP_CODE_OK) {
-        int contentLength = http.getSize();
-        Serial.print("Image size: ");
-        Serial.print(contentLength);
-        Serial.println(" bytes");
+        LOG_INFO("Image generated, frame returned inline (version %s)", http.header("X-Frame-Version").c_str());
 
-        // Allocate buffer for image data
-        if (imageBuffer != nullptr) {
-            free(imageBuffer);
-        }
+        imageNotModified = false;
+        cachedFrameLoaded = false;
+        memset(&downloadedImage, 0, sizeof(downloadedImage));
 
-        imageBuffer = (uint8_t*)malloc(contentLength);
-        if (imageBuffer == nullptr) {
-            Serial.println("ERROR: Failed to allocate memory for image!");
-            http.end();
-            return;
+        // Keyed by its version so the frame cache knows which one it holds
+        String version = http.header("X-Frame-Version");
+        if (version.length() > 0 && version.length() < sizeof(downloadedImage.etag)) {
+            downloadedImage.urlHash = hashString(SERVICE_API_URL);
+            strcpy(downloadedImage.etag, version.c_str());
         }
 
-        imageBufferSize = contentLength;
-
-        // Get the image data
-        WiFiClient* stream = http.getStreamPtr();
+        // A delta frame patches the base, which has to be in the buffer before it streams
+        String deltaBase = http.header("X-Frame-Base");
+        if (deltaBase.length() > 0) {
+            LOG_INFO("Service sent a delta against frame %s", deltaBase.c_str());
+            if (deltaBase != baseVersion || !loadFrameBase(deltaBase)) {
+                LOG_ERROR("Base frame for the delta isn't available");
+                http.end();
+                memset(&downloadedImage, 0, sizeof(downloadedImage));
+                return false;
+            }
+        }
 
-        size_t bytesRead = 0;
-        uint8_t buffer[512];
+        String frameUrl = http.header("X-Frame-Url");
+        streamImage(http);
+        http.end();
+        frameBaseLoaded = false;
 
-        Serial.print("Downloading: ");
-        while (http.connected() && bytesRead < contentLength) {
-            size_t available = stream->available();
-            if (available) {
-                size_t toRead = min(available, sizeof(buffer));
-                toRead = min(toRead, contentLength - bytesRead);
+        // The frame is on the file store too, where the rest of it can be fetched
+        if (!downloadProgress.done && frameUrl.length() > 0) {
+            ImageValidators none = {};
+            resumeImage(frameUrl.c_str(), none);
+        }
+        return imageStreamComplete();
+    }
 
-                int read = stream->readBytes(buffer, toRead);
-                if (read > 0) {
-                    memcpy(imageBuffer + bytesRead, buffer, read);
-                    bytesRead += read;
+    String response = http.getString();
+    http.end();
 
-                    // Progress indicator
-                    if (bytesRead % 10240 == 0) {
-                        Serial.print(".");
-                    }
-                }
-            }
-            delay(1);
-        }
+    LOG_INFO("Image generation triggered successfully");
+    LOG_INFO("Response: %s", response.c_str());
 
-        Serial.println();
-        Serial.print("Downloaded ");
-        Serial.print(bytesRead);
-        Serial.print(" bytes (expected: ");
-        Serial.print(contentLength);
-        Serial.println(")");
+    JsonDocument doc;
+    if (deserializeJson(doc, response)) {
+        LOG_WARN("Response is not JSON");
+        return false;
+    }
 
-        if (bytesRead == contentLength) {
-            Serial.println("SUCCESS: All bytes downloaded");
-        } else {
-            Serial.println("WARNING: Downloaded bytes don't match expected size");
-        }
+    contentValidUntil = (time_t)(doc["validUntil"] | 0L);
 
-    } else {
-        Serial.print("HTTP GET failed, error code: ");
-        Serial.print(httpCode);
-        Serial.print(" - ");
-        Serial.println(http.errorToString(httpCode).c_str());
+    const char* frameUrl = doc["frame"]["url"];
+    if (frameUrl == nullptr) {
+        return false;
     }
 
-    http.end();
+    LOG_INFO("Frame ready: %ld bytes, version %s", doc["frame"]["size"] | 0L,
+             (const char*)(doc["frame"]["version"] | "unknown"));
+
+    downloadImage(frameUrl);
+    return streamBytes > 0 || imageNotModified;
 }
 
 /**
- * Initialize E-Ink display
+ * Draw the departure board on the device
+ * Fetches the departures document (about 1 KB) from the service, draws it over the
+ * cached board background and refreshes the panel. Returns false without touching
+ * the panel if either can't be fetched, so the caller can fall back to an image.
  */
-void initDisplay() {
-    Serial.println("\n--- Initializing Display ---");
-    Serial.println("Using Seeed GFX library for XIAO EE04 board");
-    Serial.println("Display: 7.3\" six-color ePaper (ED2208)");
-    Serial.println("BOARD_SCREEN_COMBO: 509");
+bool renderDepartureBoard() {
+    LOG_INFO("\n--- Rendering Departure Board ---");
+    LOG_INFO("Departures URL: %s", DEPARTURES_URL);
 
-    // Initialize the Seeed ePaper display
-    // The library reads driver.h and Setup509 automatically
-    epaper.begin();
+    HTTPClient http;
+    http.begin(DEPARTURES_URL);
+    http.setTimeout(HTTP_TIMEOUT);
 
-    Serial.println("Display initialized successfully");
-    Serial.println("NOTE: 6-color E-Ink display ready");
-}
+    // Traces of earlier wakes ride along with the request, as with image generation
+    String traces = tracePayload();
+    http.addHeader("Content-Type", "application/json");
 
-/**
- * Update the E-Ink display with the downloaded image
- */
-void updateDisplay() {
-    Serial.println("\n--- Updating Display ---");
+    int httpCode = http.POST(traces);
+    tracePhase(PHASE_GENERATE);
 
-    if (imageBuffer == nullptr || imageBufferSize == 0) {
-        Serial.println("ERROR: No image data to display!");
-        return;
+    if (httpCode != HTTP_CODE_OK) {
+        LOG_INFO("Departures request failed, error: %s", http.errorToString(httpCode).c_str());
+        http.end();
+        return false;
     }
 
-    Serial.print("Image buffer size: ");
-    Serial.print(imageBufferSize);
-    Serial.println(" bytes");
+    wakeTraceSent = currentTrace.sequence - 1;
+    String response = http.getString();
+    http.end();
+    currentTrace.bytes += response.length();
 
-    // Print first 16 bytes for debugging
-    Serial.print("First 16 bytes (hex): ");
-    for (int i = 0; i < min(16, (int)imageBufferSize); i++) {
-        if (imageBuffer[i] < 0x10) Serial.print("0");
-        Serial.print(imageBuffer[i], HEX);
-        Serial.print(" ");
+    DepartureBoard board;
+    if (!parseDepartureBoard(response, &board)) {
+        LOG_ERROR("Departures response is not a departure board");
+        return false;
     }
-    Serial.println();
 
-    // Check image format
-    bool isPNG = (imageBufferSize > 8 && imageBuffer[0] == 0x89 && imageBuffer[1] == 'P' &&
-                  imageBuffer[2] == 'N' && imageBuffer[3] == 'G');
-    bool isBMP = (imageBufferSize > 54 && imageBuffer[0] == 'B' && imageBuffer[1] == 'M');
+    LOG_INFO("Departures version %s (%u bytes), status: %s", board.version, (unsigned)response.length(), board.status);
+
+    if (!loadBoardBackground()) {
+        LOG_ERROR("No board background available");
+        return false;
+    }
 
-    Serial.print("Format detection - PNG: ");
-    Serial.print(isPNG ? "YES" : "NO");
-    Serial.print(", BMP: ");
-    Serial.println(isBMP ? "YES" : "NO");
+    unsigned long startTime = millis();
+    drawDepartureBoard(epaper, board, time(nullptr));
+    tracePhase(PHASE_DECODE);
 
-    if (isPNG) {
-        Serial.println("Detected PNG image format");
-        Serial.println("ERROR: PNG format not supported for 6-color display");
-        Serial.println("Please configure the server to generate BMP images");
-        Serial.println("Update IMAGE_OUTPUT_PATH to use .bmp extension");
+    LOG_INFO("Board drawn in %lu ms", millis() - startTime);
 
-        // Display error message
-        epaper.fillScreen(TFT_WHITE);
-        epaper.setTextSize(2);
-        epaper.setTextColor(TFT_BLACK);
-        epaper.setCursor(50, 200);
-        epaper.print("ERROR: PNG not supported");
-        epaper.setCursor(50, 230);
-        epaper.print("Server must generate BMP");
-        epaper.setCursor(50, 260);
-        epaper.print("Check image-generator config");
-        epaper.update();
+    // Keyed by the departures version, so the frame cache knows what it holds
+    imageNotModified = false;
+    cachedFrameLoaded = false;
+    memset(&downloadedImage, 0, sizeof(downloadedImage));
+    downloadedImage.urlHash = hashString(DEPARTURES_URL);
+    strncpy(downloadedImage.etag, board.version, sizeof(downloadedImage.etag) - 1);
 
-        // Free image buffer
-        if (imageBuffer != nullptr) {
-            free(imageBuffer);
-            imageBuffer = nullptr;
-            imageBufferSize = 0;
-        }
-        return;
+    refreshPanel();
+    contentValidUntil = board.validUntil;
+    return true;
+}
+
+/**
+ * Put the departure board background into the display buffer
+ * Comes from the frame cache while it's fresh; otherwise the server is asked
+ * whether it changed and a new one is downloaded and cached
+ */
+bool loadBoardBackground() {
+    FrameCacheHeader header;
+    if (frameCacheFresh(FRAME_CACHE_BACKGROUND) && readCachedFrame(FRAME_CACHE_BACKGROUND, &header)) {
+        return true;
     }
 
-    if (!isBMP) {
-        Serial.println("ERROR: Unknown image format");
-        Serial.println("Expected BMP format for 6-color display");
+    downloadImage(BOARD_BACKGROUND_URL);
+    if (cachedFrameLoaded) {
+        return true;
+    }
 
-        // Free image buffer
-        if (imageBuffer != nullptr) {
-            free(imageBuffer);
-            imageBuffer = nullptr;
-            imageBufferSize = 0;
+    // Only a complete background is drawn on, and cached
+    bool complete = imageStreamVerified();
+    if (complete) {
+        displaySink.finish();
+        FrameHash hash;
+        if (hashDisplayBuffer(&hash)) {
+            storeCachedFrame(hash);
         }
+    }
+    endImageStream();
+    return complete;
+}
+
+/**
+ * Download image from server
+ * Asks the server to confirm the image already on the panel, otherwise streams
+ * the new image into the decoder
+ */
+void downloadImage(const char* imageUrl) {
+    LOG_INFO("\n--- Downloading Image ---");
+    LOG_INFO("Image URL: %s", imageUrl);
+
+    if (WiFi.status() != WL_CONNECTED) {
+        LOG_ERROR("WiFi not connected!");
         return;
     }
 
-    Serial.println("Detected BMP image format - proceeding with display update");
-    Serial.println("NOTE: Display refresh may take 30+ seconds");
-    Serial.println("Device will appear unresponsive during refresh - this is normal");
+    imageNotModified = false;
+    cachedFrameLoaded = false;
+    memset(&downloadedImage, 0, sizeof(downloadedImage));
 
-    Serial.println("Starting display refresh...");
-    unsigned long startTime = millis();
+    // Declared before the HTTPClient so it outlives the connection
+    ResumableTlsClient tlsClient;
+    HTTPClient http;
+    beginImageRequest(http, tlsClient, imageUrl);
+
+    // Only ask the server to confirm the image if it's already on the panel or in
+    // the frame cache - either can be shown without downloading it again
+    uint32_t urlHash = hashString(imageUrl);
+    uint8_t cacheSlot = frameCacheSlot(urlHash);
+    FrameCacheHeader cached;
+    const ImageValidators* known = nullptr;
+    if (displayedImage.urlHash == urlHash) {
+        known = &displayedImage;
+    } else if (frameCacheRead(cacheSlot, &cached) && cached.validators.urlHash == urlHash) {
+        known = &cached.validators;
+    }
 
-    // Parse BMP header
-    if (imageBufferSize < 54) {
-        Serial.println("ERROR: BMP file too small (header incomplete)");
-        free(imageBuffer);
-        imageBuffer = nullptr;
-        imageBufferSize = 0;
-        return;
+    if (known != nullptr) {
+        if (known->etag[0] != '\0') {
+            http.addHeader("If-None-Match", known->etag);
+        }
+        if (known->lastModified[0] != '\0') {
+            http.addHeader("If-Modified-Since", known->lastModified);
+        }
+        LOG_INFO("Conditional request (%s) - ETag: %s, Last-Modified: %s",
+                 known == &displayedImage ? "panel" : "frame cache", known->etag[0] != '\0' ? known->etag : "(none)",
+                 known->lastModified[0] != '\0' ? known->lastModified : "(none)");
+    }
+
+    int httpCode = http.GET();
+
+    if (httpCode == HTTP_CODE_NOT_MODIFIED && known == &displayedImage) {
+        LOG_INFO("Image not modified since last display - skipping download");
+        imageNotModified = true;
+        frameCacheChecked[cacheSlot] = wallClockMicros() / 1000000;
+    } else if (httpCode == HTTP_CODE_NOT_MODIFIED) {
+        LOG_INFO("Image not modified - loading it from the frame cache");
+        frameCacheChecked[cacheSlot] = wallClockMicros() / 1000000;
+        if (readCachedFrame(cacheSlot, &cached)) {
+            downloadedImage = cached.validators;
+            cachedFrameLoaded = true;
+            tracePhase(PHASE_DECODE);
+        } else {
+            // The cached copy went bad since its header was read - fetch it in full
+            http.end();
+            LittleFS.remove(FRAME_CACHE_PATHS[cacheSlot]);
+            downloadImage(imageUrl);
+            return;
+        }
+    } else if (httpCode == HTTP_CODE_OK) {
+        // Remember the validators; they become the displayed image's once it's shown
+        rememberValidators(http, urlHash);
+        streamImage(http);
+    } else {
+        LOG_INFO("HTTP GET failed, error code: %d - %s", httpCode, http.errorToString(httpCode).c_str());
     }
 
-    // Read BMP header info
-    uint32_t pixelDataOffset = imageBuffer[10] | (imageBuffer[11] << 8) | (imageBuffer[12] << 16) | (imageBuffer[13] << 24);
-    uint32_t width = imageBuffer[18] | (imageBuffer[19] << 8) | (imageBuffer[20] << 16) | (imageBuffer[21] << 24);
+    http.end();
 
-    // Height can be negative in BMP (indicates top-down pixel order)
-    int32_t heightSigned = (int32_t)(imageBuffer[22] | (imageBuffer[23] << 8) | (imageBuffer[24] << 16) | (imageBuffer[25] << 24));
-    bool topDown = false;
-    uint32_t height;
+    if (httpCode == HTTP_CODE_OK && !downloadProgress.done) {
+        resumeImage(imageUrl, downloadedImage);
+    }
+}
 
-    if (heightSigned < 0) {
-        topDown = true;
-        height = -heightSigned;
-        Serial.println("BMP is stored top-down");
+/**
+ * Open an image URL, over TLS with a resumable session for https
+ */
+void beginImageRequest(HTTPClient& http, ResumableTlsClient& tlsClient, const char* url) {
+    if (strncmp(url, "https://", 8) == 0) {
+        http.begin(tlsClient, url);
     } else {
-        height = heightSigned;
-        Serial.println("BMP is stored bottom-up");
-    }
-
-    uint16_t bitsPerPixel = imageBuffer[28] | (imageBuffer[29] << 8);
-
-    Serial.print("BMP Info - Width: ");
-    Serial.print(width);
-    Serial.print(", Height: ");
-    Serial.print(height);
-    Serial.print(", BPP: ");
-    Serial.println(bitsPerPixel);
-
-    // Validate BMP dimensions
-    Serial.print("BMP dimensions: ");
-    Serial.print(width);
-    Serial.print("x");
-    Serial.println(height);
-
-    // Only support 24-bit BMP
-    if (bitsPerPixel != 24) {
-        Serial.print("ERROR: Only 24-bit BMP supported, got ");
-        Serial.print(bitsPerPixel);
-        Serial.println(" bits per pixel");
-        free(imageBuffer);
-        imageBuffer = nullptr;
-        imageBufferSize = 0;
-        return;
+        http.begin(url);
     }
+    http.setTimeout(30000);  // 30 second timeout
 
-    // Clear the display
-    epaper.fillScreen(TFT_WHITE);
+    const char* responseHeaders[] = {"ETag", "Last-Modified", "Content-Range", "Transfer-Encoding",
+                                     "Content-Encoding"};
+    http.collectHeaders(responseHeaders, 5);
+    if (HTTP_ACCEPT_COMPRESSION) {
+        http.addHeader("Accept-Encoding", "gzip, deflate");
+    }
+}
 
-    // BMP rows are padded to 4-byte boundaries
-    uint32_t rowSize = ((width * 3 + 3) / 4) * 4;
-
-    Serial.println("Decoding BMP with Floyd-Steinberg dithering for smoother gradients...");
-
-    // Dithering: Create error diffusion buffers for Floyd-Steinberg dithering
-    // We need 2 rows for error propagation
-    int16_t* errorR = (int16_t*)malloc(sizeof(int16_t) * (width + 2));
-    int16_t* errorG = (int16_t*)malloc(sizeof(int16_t) * (width + 2));
-    int16_t* errorB = (int16_t*)malloc(sizeof(int16_t) * (width + 2));
-    int16_t* nextErrorR = (int16_t*)malloc(sizeof(int16_t) * (width + 2));
-    int16_t* nextErrorG = (int16_t*)malloc(sizeof(int16_t) * (width + 2));
-    int16_t* nextErrorB = (int16_t*)malloc(sizeof(int16_t) * (width + 2));
-
-    if (!errorR || !errorG || !errorB || !nextErrorR || !nextErrorG || !nextErrorB) {
-        Serial.println("ERROR: Failed to allocate dithering buffers");
-        if (errorR) free(errorR);
-        if (errorG) free(errorG);
-        if (errorB) free(errorB);
-        if (nextErrorR) free(nextErrorR);
-        if (nextErrorG) free(nextErrorG);
-        if (nextErrorB) free(nextErrorB);
-        free(imageBuffer);
-        imageBuffer = nullptr;
-        imageBufferSize = 0;
-        return;
+/**
+ * Keep the validators of an image being downloaded in downloadedImage
+ * Validators that don't fit can't be sent back correctly, so they're dropped
+ */
+void rememberValidators(HTTPClient& http, uint32_t urlHash) {
+    downloadedImage.urlHash = urlHash;
+    String etag = http.header("ETag");
+    String lastModified = http.header("Last-Modified");
+    if (etag.length() < sizeof(downloadedImage.etag)) {
+        strcpy(downloadedImage.etag, etag.c_str());
+    }
+    if (lastModified.length() < sizeof(downloadedImage.lastModified)) {
+        strcpy(downloadedImage.lastModified, lastModified.c_str());
     }
+}
 
-    // Initialize error buffers
-    memset(errorR, 0, sizeof(int16_t) * (width + 2));
-    memset(errorG, 0, sizeof(int16_t) * (width + 2));
-    memset(errorB, 0, sizeof(int16_t) * (width + 2));
-    memset(nextErrorR, 0, sizeof(int16_t) * (width + 2));
-    memset(nextErrorG, 0, sizeof(int16_t) * (width + 2));
-    memset(nextErrorB, 0, sizeof(int16_t) * (width + 2));
-
-    // BMP pixels can be stored bottom-to-top or top-to-bottom
-    // Rotate 90 degrees clockwise: BMP(x,y) -> Display(height-1-y, x)
-    for (int32_t y = 0; y < (int32_t)height; y++) {
-        // Calculate row offset based on whether BMP is top-down or bottom-up
-        uint32_t rowOffset;
-        if (topDown) {
-            // Top-down: first row in file is y=0 (top of image)
-            rowOffset = pixelDataOffset + y * rowSize;
-        } else {
-            // Bottom-up (standard): first row in file is y=height-1 (bottom of image)
-            rowOffset = pixelDataOffset + (height - 1 - y) * rowSize;
+/**
+ * Fetch the rest of an image whose download broke off
+ * The decoders and the display buffer keep their place, so each Range request
+ * only asks for the missing bytes. If-Range has the server send the whole image
+ * instead if it changed meanwhile. Without a validator only frames are resumed,
+ * as their CRC catches a mix of two versions. Returns true once the body is complete.
+ */
+bool resumeImage(const char* url, ImageValidators validators) {
+    const char* ifRange = validators.etag[0] != '\0' ? validators.etag : validators.lastModified;
+
+    for (uint8_t attempt = 1; attempt <= DOWNLOAD_RESUME_ATTEMPTS; attempt++) {
+        if (downloadProgress.done || imageStreamFailed()) {
+            break;
+        }
+        if (ifRange[0] == '\0' && streamFormat != IMAGE_FORMAT_FRAME) {
+            LOG_INFO("Download can't be resumed - the server sent no ETag or Last-Modified");
+            return false;
         }
 
-        // Swap error buffers for next row
-        int16_t* temp;
-        temp = errorR; errorR = nextErrorR; nextErrorR = temp;
-        temp = errorG; errorG = nextErrorG; nextErrorG = temp;
-        temp = errorB; errorB = nextErrorB; nextErrorB = temp;
-        memset(nextErrorR, 0, sizeof(int16_t) * (width + 2));
-        memset(nextErrorG, 0, sizeof(int16_t) * (width + 2));
-        memset(nextErrorB, 0, sizeof(int16_t) * (width + 2));
+        LOG_INFO("\n--- Resuming Download (attempt %u of %d) from byte %lu ---", attempt, DOWNLOAD_RESUME_ATTEMPTS,
+                 (unsigned long)downloadProgress.received);
 
-        for (int32_t x = 0; x < (int32_t)width; x++) {
-            uint32_t pixelOffset = rowOffset + x * 3;
+        // WiFi reconnects on its own after a drop
+        delay(DOWNLOAD_RESUME_DELAY_MS * attempt);
+        unsigned long waitStart = millis();
+        while (WiFi.status() != WL_CONNECTED && millis() - waitStart < WIFI_CONNECT_TIMEOUT_MS) {
+            delay(100);
+        }
+        if (WiFi.status() != WL_CONNECTED) {
+            LOG_ERROR("WiFi not connected!");
+            continue;
+        }
 
-            if (pixelOffset + 2 >= imageBufferSize) {
-                continue; // Skip if out of bounds
-            }
+        ResumableTlsClient tlsClient;
+        HTTPClient http;
+        beginImageRequest(http, tlsClient, url);
+        http.addHeader("Range", "bytes=" + String((unsigned long)downloadProgress.received) + "-");
+        if (ifRange[0] != '\0') {
+            http.addHeader("If-Range", ifRange);
+        }
 
-            // BMP stores as BGR
-            uint8_t b = imageBuffer[pixelOffset];
-            uint8_t g = imageBuffer[pixelOffset + 1];
-            uint8_t r = imageBuffer[pixelOffset + 2];
-
-            // Apply error diffusion from previous pixels
-            int16_t newR = constrain((int16_t)r + errorR[x + 1], 0, 255);
-            int16_t newG = constrain((int16_t)g + errorG[x + 1], 0, 255);
-            int16_t newB = constrain((int16_t)b + errorB[x + 1], 0, 255);
-
-            // Map to nearest 6-color palette
-            uint16_t color;
-            uint8_t targetR, targetG, targetB;
-
-            // Enhanced color mapping with better thresholds
-            uint8_t maxVal = max(newR, max(newG, newB));
-            uint8_t minVal = min(newR, min(newG, newB));
-
-            if (maxVal < 85) {
-                // Black
-                color = TFT_BLACK;
-                targetR = targetG = targetB = 0;
-            } else if (minVal > 170) {
-                // White
-                color = TFT_WHITE;
-                targetR = targetG = targetB = 255;
-            } else if (newR > newG + 50 && newR > newB + 50) {
-                if (newG > 120 && newB < 100) {
-                    // Yellow (red + green)
-                    color = TFT_YELLOW;
-                    targetR = 255; targetG = 255; targetB = 0;
-                } else {
-                    // Red
-                    color = TFT_RED;
-                    targetR = 255; targetG = 0; targetB = 0;
-                }
-            } else if (newG > newR + 50 && newG > newB + 50) {
-                // Green
-                color = TFT_GREEN;
-                targetR = 0; targetG = 255; targetB = 0;
-            } else if (newB > newR + 50 && newB > newG + 50) {
-                // Blue
-                color = TFT_BLUE;
-                targetR = 0; targetG = 0; targetB = 255;
-            } else if (newR > 150 && newG > 150 && newB < 100) {
-                // Yellow
-                color = TFT_YELLOW;
-                targetR = 255; targetG = 255; targetB = 0;
-            } else if (newR + newG + newB > 384) {
-                // Bright -> White
-                color = TFT_WHITE;
-                targetR = targetG = targetB = 255;
-            } else {
-                // Dark -> Black
-                color = TFT_BLACK;
-                targetR = targetG = targetB = 0;
+        int httpCode = http.GET();
+        if (httpCode == HTTP_CODE_PARTIAL_CONTENT) {
+            // Content-Range: bytes <first>-<last>/<total>
+            String range = http.header("Content-Range");
+            if (!range.startsWith("bytes ") || strtoul(range.c_str() + 6, nullptr, 10) != downloadProgress.received) {
+                LOG_ERROR("Server resumed at the wrong place: %s", range.c_str());
+                http.end();
+                return false;
             }
-
-            // Calculate error (Floyd-Steinberg dithering)
-            int16_t errR = newR - targetR;
-            int16_t errG = newG - targetG;
-            int16_t errB = newB - targetB;
-
-            // Distribute error to neighboring pixels:
-            //     X   7/16
-            // 3/16 5/16 1/16
-            errorR[x + 2] += (errR * 7) >> 4;  // Right
-            nextErrorR[x] += (errR * 3) >> 4;  // Bottom-left
-            nextErrorR[x + 1] += (errR * 5) >> 4;  // Bottom
-            nextErrorR[x + 2] += errR >> 4;  // Bottom-right
-
-            errorG[x + 2] += (errG * 7) >> 4;
-            nextErrorG[x] += (errG * 3) >> 4;
-            nextErrorG[x + 1] += (errG * 5) >> 4;
-            nextErrorG[x + 2] += errG >> 4;
-
-            errorB[x + 2] += (errB * 7) >> 4;
-            nextErrorB[x] += (errB * 3) >> 4;
-            nextErrorB[x + 1] += (errB * 5) >> 4;
-            nextErrorB[x + 2] += errB >> 4;
-
-            // Rotate 90 degrees clockwise when drawing: BMP(x,y) -> Display(height-1-y, x)
-            int32_t displayX = height - 1 - y;
-            int32_t displayY = x;
-
-            if (displayX >= 0 && displayX < DISPLAY_WIDTH && displayY >= 0 && displayY < DISPLAY_HEIGHT) {
-                epaper.drawPixel(displayX, displayY, color);
+            // The missing bytes are a range of the encoded body, so it must be encoded the same way
+            if (parseContentEncoding(http.header("Content-Encoding").c_str()) != streamEncoding) {
+                LOG_ERROR("Server resumed with a different Content-Encoding: %s",
+                          http.header("Content-Encoding").c_str());
+                http.end();
+                return false;
             }
+            streamBody(http);
+        } else if (httpCode == HTTP_CODE_OK) {
+            // Changed since, or no Range support - this is a new download
+            LOG_INFO("Server sent the whole image - starting over");
+            memset(&downloadedImage, 0, sizeof(downloadedImage));
+            if (ifRange[0] != '\0') {
+                rememberValidators(http, validators.urlHash);
+            }
+            streamImage(http);
+        } else {
+            LOG_INFO("HTTP GET failed, error code: %d - %s", httpCode, http.errorToString(httpCode).c_str());
         }
-
-        // Print progress every 50 rows
-        if (y % 50 == 0) {
-            Serial.print("Processing row ");
-            Serial.print(y);
-            Serial.print(" of ");
-            Serial.println(height);
-        }
+        http.end();
     }
 
-    // Free dithering buffers
-    free(errorR);
-    free(errorG);
-    free(errorB);
-    free(nextErrorR);
-    free(nextErrorG);
-    free(nextErrorB);
-
-    Serial.println("BMP decoded, calling epaper.update() to refresh display...");
-    epaper.update();
-
-    unsigned long endTime = millis();
-    Serial.print("Display refresh completed in ");
-    Serial.print((endTime - startTime) / 1000);
-    Serial.println(" seconds");
-
-    Serial.println("Display update complete!");
+    return downloadProgress.done && !imageStreamFailed();
+}
 
-    // Free image buffer
-    if (imageBuffer != nullptr) {
-        free(imageBuffer);
-        imageBuffer = nullptr;
-        imageBufferSize = 0;
+/**
+ * Stream a full HTTP response body into a new image
+ * The caller owns (and ends) the connection; if it breaks off, resumeImage()
+ * can fetch the rest. gzip/deflate bodies are inflated on the way to the decoder.
+ */
+void streamImage(HTTPClient& http) {
+    beginImageStream();
+
+    String encoding = http.header("Content-Encoding");
+    streamEncoding = parseContentEncoding(encoding.c_str());
+    if (streamEncoding != CONTENT_ENCODING_IDENTITY) {
+        LOG_INFO("Content-Encoding: %s", encoding.c_str());
+        if (!inflater.begin(streamEncoding, &imageStreamSink, &pipelineArena)) {
+            LOG_ERROR("Can't inflate body - %s", inflateErrorToString(inflater.error()));
+            downloadProgress.done = true;
+            return;
+        }
     }
+
+    streamBody(http);
 }
 
 /**
- * Setup button wake-up configuration for multiple buttons
+ * Stream an HTTP response body into the image decoder, continuing the current image
+ * The body is read by a network task on NETWORK_TASK_CORE and handed to the
+ * decoder on this core through a ring buffer, so the image is decoded and
+ * drawn while it downloads. Chunked bodies are unframed on the way; other
+ * bodies are read up to their Content-Length, or until the server closes.
  */
-void setupButtonWakeup() {
-    // Configure both button pins as input with pull-up (if buttons are active LOW)
-    if (BUTTON_ACTIVE_LOW) {
-        pinMode(METRO_BUTTON_PIN, INPUT_PULLUP);
-        pinMode(SCREENSAVER_BUTTON_PIN, INPUT_PULLUP);
+void streamBody(HTTPClient& http) {
+    int contentLength = http.getSize();
+    bool chunked = http.header("Transfer-Encoding").equalsIgnoreCase("chunked");
+    if (chunked) {
+        LOG_INFO("Body size: chunked");
+    } else if (contentLength >= 0) {
+        LOG_INFO("Body size: %d bytes", contentLength);
     } else {
-        pinMode(METRO_BUTTON_PIN, INPUT);
-        pinMode(SCREENSAVER_BUTTON_PIN, INPUT);
+        LOG_INFO("Body size: unknown");
     }
 
-    // Create bitmask for ext1 wake-up (supports multiple pins)
+    if (downloadRing.capacity() == 0) {
+        LOG_ERROR("Failed to allocate download buffer!");
+        downloadProgress.done = true;
+        return;
+    }
+    downloadRing.reset();
+    memset(&pipelineStats, 0, sizeof(pipelineStats));
+
+    ChunkedDecoder chunkedDecoder;
+
+    DownloadJob job;
+    job.http = &http;
+    job.stream = http.getStreamPtr();
+    job.chunked = chunked ? &chunkedDecoder : nullptr;
+    job.contentLength = !chunked && contentLength >= 0 ? (size_t)contentLength : SIZE_MAX;
+    job.ring = &downloadRing;
+    job.decodeTask = xTaskGetCurrentTaskHandle();
+    job.networkTask = nullptr;
+    job.abort = false;
+    job.bytesRead = 0;
+    job.stalled = false;
+
+    LOG_INFO("Downloading");
+    if (xTaskCreatePinnedToCore(networkTask, "network", NETWORK_TASK_STACK, &job, 1, &job.networkTask,
+                                NETWORK_TASK_CORE) != pdPASS) {
+        LOG_ERROR("Failed to start network task!");
+        downloadProgress.done = true;
+        return;
+    }
+
+    // Decode whatever the network task has delivered until it closes the ring
+    while (!downloadRing.finished()) {
+        size_t length;
+        const uint8_t* data = downloadRing.readPointer(&length);
+
+        if (length == 0) {
+            unsigned long stallStart = millis();
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(10));
+            pipelineStats.decodeStalls++;
+            pipelineStats.decodeStallMs += millis() - stallStart;
+            continue;
+        }
+
+        if (!job.abort) {
+            feedImageBody(data, length);
+            if (imageStreamFailed()) {
+                job.abort = true;
+            }
+        }
+        downloadRing.consume(length);
+        xTaskNotifyGive(job.networkTask);
+    }
+
+    size_t bytesRead = job.bytesRead;
+    tracePhase(PHASE_DOWNLOAD);
+    currentTrace.bytes += bytesRead;
+    downloadProgress.received += bytesRead;
+
+    // Without a length or chunks a closed connection is the only end marker, so
+    // the decoder tells whether the image is whole
+    if (chunked) {
+        downloadProgress.done = chunkedDecoder.finished() || chunkedDecoder.failed();
+    } else if (contentLength >= 0) {
+        downloadProgress.done = bytesRead == (size_t)contentLength;
+    } else {
+        downloadProgress.done = imageStreamComplete();
+    }
+
+    if (chunked || contentLength < 0) {
+        LOG_INFO("Downloaded %lu bytes (expected: unknown)", (unsigned long)bytesRead);
+    } else {
+        LOG_INFO("Downloaded %lu bytes (expected: %d)", (unsigned long)bytesRead, contentLength);
+    }
+
+    if (streamEncoding != CONTENT_ENCODING_IDENTITY) {
+        LOG_INFO("Inflated %lu bytes to %lu in %lu ms", (unsigned long)inflater.bytesIn(),
+                 (unsigned long)inflater.bytesOut(), inflateMicros / 1000);
+    }
+
+    if (imageStreamFailed()) {
+        LOG_INFO("Download stopped early - image can't be decoded");
+        if (inflater.failed()) {
+            LOG_ERROR("%s", inflateErrorToString(inflater.error()));
+        }
+        downloadProgress.done = true;
+    } else if (chunked && chunkedDecoder.failed()) {
+        LOG_ERROR("Malformed chunked response");
+    } else if (downloadProgress.done) {
+        LOG_INFO("SUCCESS: All bytes downloaded");
+    } else if (job.stalled) {
+        LOG_WARN("Download stalled");
+    } else {
+        LOG_WARN("Connection closed before the end of the image");
+    }
+
+    LOG_INFO("Pipeline stalls - network waiting for decoder: %lu (%lu ms), decoder waiting for network: %lu (%lu ms)",
+             (unsigned long)pipelineStats.networkStalls, (unsigned long)pipelineStats.networkStallMs,
+             (unsigned long)pipelineStats.decodeStalls, (unsigned long)pipelineStats.decodeStallMs);
+}
+
+/**
+ * Network side of the download pipeline
+ * Reads the HTTP body straight into the ring buffer and wakes the decoder,
+ * then closes the ring and deletes itself
+ */
+void networkTask(void* parameter) {
+    DownloadJob* job = (DownloadJob*)parameter;
+    TaskHandle_t decodeTask = job->decodeTask;
+    ChunkedDecoder* chunked = job->chunked;
+    size_t bytesRead = 0;
+    unsigned long lastData = millis();
+
+    // A chunked body ends with its last chunk, any other after contentLength bytes
+    auto bodyEnded = [&]() {
+        return chunked != nullptr ? chunked->finished() || chunked->failed() : bytesRead >= job->contentLength;
+    };
+
+    while (job->http->connected() && !bodyEnded() && !job->abort) {
+        size_t space;
+        uint8_t* buffer = job->ring->writePointer(&space);
+
+        if (space == 0) {
+            // Ring full - the decoder is behind
+            unsigned long stallStart = millis();
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(10));
+            pipelineStats.networkStalls++;
+            pipelineStats.networkStallMs += millis() - stallStart;
+            continue;
+        }
+
+        size_t available = job->stream->available();
+        if (available == 0) {
+            if (millis() - lastData > DOWNLOAD_STALL_TIMEOUT_MS) {
+                job->stalled = true;
+                break;
+            }
+            delay(1);
+            continue;
+        }
+
+        size_t toRead = min(available, space);
+        if (chunked == nullptr) {
+            toRead = min(toRead, job->contentLength - bytesRead);
+        }
+
+        int read = job->stream->readBytes(buffer, toRead);
+        if (read > 0) {
+            lastData = millis();
+
+            // Chunk framing is stripped in place, leaving only image bytes
+            size_t payload = chunked != nullptr ? chunked->decode(buffer, read) : (size_t)read;
+            job->ring->commit(payload);
+            xTaskNotifyGive(decodeTask);
+
+            bytesRead += payload;
+        }
+    }
+
+    // The job lives on the decoder's stack - don't touch it after closing the ring
+    job->bytesRead = bytesRead;
+    job->ring->close();
+    xTaskNotifyGive(decodeTask);
+    vTaskDelete(nullptr);
+}
+
+/**
+ * Start decoding a new image into the display buffer
+ * Everything the previous image took from the arenas is dropped here
+ */
+void beginImageStream() {
+    endImageStream();
+    pipelineArena.reset();
+    ditherArena.reset();
+
+    downloadRing.begin(DOWNLOAD_RING_SIZE, &pipelineArena);
+    memset(&downloadProgress, 0, sizeof(downloadProgress));
+
+    imageDecoder.begin(&displaySink, &pipelineArena);
+    frameDecoder.begin(&displaySink, DISPLAY_WIDTH, DISPLAY_HEIGHT, &pipelineArena);
+    streamFormat = IMAGE_FORMAT_UNKNOWN;
+    streamHeadBytes = 0;
+    streamBytes = 0;
+    decodeMicros = 0;
+    streamEncoding = CONTENT_ENCODING_IDENTITY;
+    inflateMicros = 0;
+}
+
+/**
+ * Feed downloaded body bytes, inflating them first if the body is compressed
+ */
+void feedImageBody(const uint8_t* data, size_t length) {
+    if (streamEncoding == CONTENT_ENCODING_IDENTITY) {
+        feedImageStream(data, length);
+        return;
+    }
+
+    // Decoding happens inside feed() through the sink and is counted separately
+    unsigned long startMicros = micros();
+    unsigned long decodeBefore = decodeMicros;
+    inflater.feed(data, length);
+    inflateMicros += (micros() - startMicros) - (decodeMicros - decodeBefore);
+}
+
+/**
+ * Feed downloaded bytes into the streaming decoder
+ * Every complete BMP row is dithered and drawn immediately so decoding
+ * overlaps with the download. Frames go to the frame decoder; anything else
+ * goes to the BMP decoder, which reports the format error.
+ */
+void feedImageStream(const uint8_t* data, size_t length) {
+    unsigned long startMicros = micros();
+
+    if (streamBytes == 0) {
+        tracePhase(PHASE_FIRST_BYTE);
+    }
+
+    size_t head = min(length, sizeof(streamHead) - streamHeadBytes);
+    memcpy(streamHead + streamHeadBytes, data, head);
+    streamHeadBytes += head;
+    streamBytes += length;
+
+    if (streamFormat == IMAGE_FORMAT_UNKNOWN) {
+        if (streamBytes < IMAGE_FORMAT_SNIFF_SIZE) {
+            // Wait for enough bytes to tell the formats apart
+            decodeMicros += micros() - startMicros;
+            return;
+        }
+
+        streamFormat = detectImageFormat(streamHead, streamHeadBytes);
+
+        // Replay the bytes held back before the format was known
+        size_t held = streamBytes - length;
+        if (streamFormat == IMAGE_FORMAT_FRAME) {
+            frameDecoder.feed(streamHead, held);
+        } else {
+            imageDecoder.feed(streamHead, held);
+        }
+    }
+
+    if (streamFormat == IMAGE_FORMAT_FRAME) {
+        frameDecoder.feed(data, length);
+    } else {
+        imageDecoder.feed(data, length);
+    }
+
+    decodeMicros += micros() - startMicros;
+}
+
+/**
+ * Stop the streaming decoders
+ * Their buffers stay in the arenas until the next beginImageStream()
+ */
+void endImageStream() {
+    inflater.end();
+    imageDecoder.end();
+    frameDecoder.end();
+    displaySink.end();
+}
+
+/**
+ * Check whether the image being streamed can't be decoded
+ */
+bool imageStreamFailed() {
+    if (streamEncoding != CONTENT_ENCODING_IDENTITY && inflater.failed()) {
+        return true;
+    }
+    return streamFormat == IMAGE_FORMAT_FRAME ? frameDecoder.failed() : imageDecoder.failed();
+}
+
+/**
+ * Check whether the image being streamed has been decoded in full
+ */
+bool imageStreamComplete() {
+    // A compressed body is only whole once its trailer checksum has matched
+    if (streamEncoding != CONTENT_ENCODING_IDENTITY && !inflater.finished()) {
+        return false;
+    }
+    return streamFormat == IMAGE_FORMAT_FRAME ? frameDecoder.complete() : imageDecoder.complete();
+}
+
+/**
+ * Check an image stream that has ended: decoded in full, and for frames with the
+ * payload checksum matching. A frame that doesn't match is marked failed
+ */
+bool imageStreamVerified() {
+    if (streamBytes == 0 || !imageStreamComplete()) {
+        return false;
+    }
+    return streamFormat != IMAGE_FORMAT_FRAME || frameDecoder.finish() == FRAME_OK;
+}
+
+/**
+ * Prepare the display buffer once the BMP header has been parsed
+ */
+bool DisplayRowSink::beginImage(const BmpInfo& info) {
+    if (info.topDown) {
+        LOG_INFO("BMP is stored top-down");
+    } else {
+        LOG_INFO("BMP is stored bottom-up");
+    }
+
+    LOG_INFO("BMP Info - Width: %lu, Height: %lu, BPP: %u", (unsigned long)info.width, (unsigned long)info.height,
+             info.bitsPerPixel);
+
+    _info = info;
+    _indices = (uint8_t*)pipelineArena.allocate(info.width);
+
+    // Error rows too wide for the SRAM arena go to PSRAM with the rest
+    bool ditherReady = DITHER_ERRORS_IN_SRAM && _dither.begin(info.width, DITHER_KERNEL_DEFAULT, &ditherArena);
+    if (!ditherReady) {
+        ditherReady = _dither.begin(info.width, DITHER_KERNEL_DEFAULT, &pipelineArena);
+    }
+    if (ditherArena.used() > 0) {
+        LOG_INFO("Dither error rows in internal SRAM");
+    } else {
+        LOG_INFO("Dither error rows in PSRAM");
+    }
+
+    if (_indices == nullptr || !ditherReady) {
+        LOG_ERROR("Failed to allocate dithering buffers");
+        return false;
+    }
+
+    // Clear the display
+    epaper.fillScreen(TFT_WHITE);
+
+    // Write rows straight into the packed framebuffer when its layout is known,
+    // otherwise fall back to drawPixel()
+    _packed = panelBufferPacked &&
+              _writer.begin((uint8_t*)epaper.getPointer(), info.width, info.height, panelNibbles, &pipelineArena);
+    if (_packed) {
+        LOG_INFO("Writing directly to packed framebuffer");
+    } else {
+        LOG_INFO("Writing through drawPixel()");
+    }
+
+    LOG_INFO("Decoding BMP with Floyd-Steinberg dithering while downloading...");
+    return true;
+}
+
+/**
+ * Dither one BMP row to the 6-color palette and draw it
+ * Rows are dithered in the order they arrive, so a bottom-up BMP diffuses its
+ * error upwards - either direction works and no rows need to be buffered
+ */
+void DisplayRowSink::writeRow(const uint8_t* bgr, uint32_t y, uint32_t fileRow) {
+    _dither.ditherRow(bgr, _indices);
+
+    if (_packed) {
+        _writer.writeRow(_indices, y);
+        if (fileRow == _info.height - 1) {
+            _writer.flush();
+        }
+    } else {
+        // Rotated onto the panel as its traits say, e.g. BMP(x,y) -> Display(height-1-y, x)
+        for (int32_t x = 0; x < (int32_t)_info.width; x++) {
+            int32_t displayX = Panel::panelX(x, y, _info.width, _info.height);
+            int32_t displayY = Panel::panelY(x, y, _info.width, _info.height);
+
+            if (Panel::contains(displayX, displayY)) {
+                epaper.drawPixel(displayX, displayY, PANEL_COLORS[_indices[x]]);
+            }
+        }
+    }
+
+    // Print progress every 50 rows
+    if (fileRow % 50 == 0) {
+        LOG_DEBUG("Processing row %lu of %lu", (unsigned long)fileRow, (unsigned long)_info.height);
+    }
+}
+
+/**
+ * Prepare the display buffer once the frame header has been parsed
+ */
+bool DisplayRowSink::beginFrame(const FrameHeader& header) {
+    LOG_INFO("Frame Info - Width: %u, Height: %u, RLE: %s, Rotated: %d degrees", header.width, header.height,
+             (header.flags & FRAME_FLAG_RLE) ? "YES" : "NO", header.orientation * 90);
+
+    if (header.paletteVersion != FRAME_PALETTE_VERSION) {
+        LOG_WARN("Frame uses palette version %u, firmware expects %d", header.paletteVersion, FRAME_PALETTE_VERSION);
+    }
+
+    // A delta only makes sense on top of the frame it was made against
+    _delta = (header.flags & FRAME_FLAG_DELTA) != 0;
+    if (_delta && !frameBaseLoaded) {
+        LOG_ERROR("Delta frame without its base frame");
+        return false;
+    }
+
+    // Frames are already quantized and in panel orientation - no dithering or rotation
+    _packed = panelBufferPacked &&
+              _writer.begin((uint8_t*)epaper.getPointer(), 0, 0, panelNibbles);
+    if (_packed) {
+        LOG_INFO("Writing directly to packed framebuffer");
+    } else {
+        LOG_INFO("Writing through drawPixel()");
+    }
+
+    if (_delta) {
+        LOG_INFO("Patching the base frame while downloading...");
+    } else {
+        LOG_INFO("Decoding pre-quantized frame while downloading...");
+    }
+    return true;
+}
+
+/**
+ * Copy one panel row of palette indices to the display buffer
+ */
+void DisplayRowSink::writeFrameRow(const uint8_t* indices, uint32_t y) {
+    if (_packed && _delta) {
+        _writer.patchPanelRow(indices, y, FRAME_COLOR_KEEP);
+    } else if (_packed) {
+        _writer.writePanelRow(indices, y);
+    } else {
+        for (int32_t x = 0; x < DISPLAY_WIDTH; x++) {
+            if (indices[x] != FRAME_COLOR_KEEP) {
+                epaper.drawPixel(x, y, PANEL_COLORS[indices[x]]);
+            }
+        }
+    }
+
+    // Print progress every 50 rows
+    if (y % 50 == 0) {
+        LOG_DEBUG("Processing row %lu of %d", (unsigned long)y, DISPLAY_HEIGHT);
+    }
+}
+
+/**
+ * Write out rows still queued for the framebuffer (incomplete images)
+ */
+void DisplayRowSink::finish() {
+    if (_packed) {
+        _writer.flush();
+    }
+}
+
+/**
+ * Detach from the dithering buffers (they belong to the pipeline arenas)
+ */
+void DisplayRowSink::end() {
+    _dither.end();
+    _writer.end();
+    _packed = false;
+    _delta = false;
+    _indices = nullptr;
+}
+
+/**
+ * Set aside the image pipeline's memory for this wake
+ * Falls back to internal RAM for the PSRAM arena if there is no PSRAM
+ */
+void initPipelineArenas() {
+    void* memory = heap_caps_malloc(PIPELINE_ARENA_SIZE, MALLOC_CAP_SPIRAM);
+    if (memory == nullptr) {
+        LOG_WARN("No PSRAM for the image pipeline - using internal RAM");
+        memory = heap_caps_malloc(PIPELINE_ARENA_SIZE, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    }
+    if (memory == nullptr) {
+        LOG_ERROR("Failed to allocate image pipeline memory!");
+    }
+
+    pipelineArena.begin(memory, PIPELINE_ARENA_SIZE);
+    ditherArena.begin(ditherArenaMemory, sizeof(ditherArenaMemory));
+}
+
+/**
+ * Print heap and arena use for this wake
+ * Peak is measured from the lowest free heap since boot; fragmentation is the
+ * share of free internal RAM that isn't part of the largest free block
+ */
+void printMemoryStats() {
+    size_t totalInternal = heap_caps_get_total_size(MALLOC_CAP_INTERNAL);
+    size_t freeInternal = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    size_t largestInternal = heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL);
+    size_t minimumInternal = heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL);
+
+    LOG_INFO("Internal heap: %lu of %lu bytes free, peak use %lu bytes, largest block %lu bytes, fragmentation %lu%%",
+             (unsigned long)freeInternal, (unsigned long)totalInternal,
+             (unsigned long)(totalInternal - minimumInternal), (unsigned long)largestInternal,
+             (unsigned long)(freeInternal > 0 ? 100 - largestInternal * 100 / freeInternal : 0));
+
+    LOG_INFO("PSRAM: %lu of %lu bytes free", (unsigned long)heap_caps_get_free_size(MALLOC_CAP_SPIRAM),
+             (unsigned long)heap_caps_get_total_size(MALLOC_CAP_SPIRAM));
+
+    LOG_INFO("Pipeline arena peak: %lu of %lu bytes, SRAM arena peak: %lu of %lu bytes",
+             (unsigned long)pipelineArena.peak(), (unsigned long)pipelineArena.capacity(),
+             (unsigned long)ditherArena.peak(), (unsigned long)ditherArena.capacity());
+
+    if (pipelineArena.failures() > 0 || ditherArena.failures() > 0) {
+        LOG_WARN("Arena allocations that didn't fit: %lu pipeline, %lu SRAM", (unsigned long)pipelineArena.failures(),
+                 (unsigned long)ditherArena.failures());
+    }
+}
+
+/**
+ * Initialize E-Ink display
+ */
+void initDisplay() {
+    LOG_INFO("\n--- Initializing Display ---");
+    LOG_INFO("Using Seeed GFX library for XIAO EE04 board");
+    LOG_INFO("Display: 7.3\" six-color ePaper (ED2208)");
+    LOG_INFO("BOARD_SCREEN_COMBO: 509");
+
+    // Initialize the Seeed ePaper display
+    // The library reads driver.h and Setup509 automatically
+    epaper.begin();
+
+    panelBufferPacked = calibratePanelBuffer();
+    LOG_INFO("Framebuffer fast path: %s", panelBufferPacked ? "enabled (packed 4-bit)" : "disabled (using drawPixel)");
+
+    LOG_INFO("Display initialized successfully");
+    LOG_INFO("NOTE: 6-color E-Ink display ready");
+}
+
+/**
+ * Work out the EPaper framebuffer layout so decoded rows can be written to it directly
+ * Each palette color is drawn with drawPixel() and read back from the buffer, which
+ * confirms the packing described by the panel traits (e.g. 4-bit, even x in the
+ * high nibble, row-major) and gives the native value of every color. Returns false
+ * if the buffer doesn't match.
+ */
+bool calibratePanelBuffer() {
+    uint8_t* buffer = (uint8_t*)epaper.getPointer();
+    if (buffer == nullptr || epaper.getColorDepth() != Panel::PIXEL_BITS || epaper.width() != Panel::WIDTH ||
+        epaper.height() != Panel::HEIGHT) {
+        return false;
+    }
+
+    const uint8_t mask = (1 << Panel::PIXEL_BITS) - 1;
+    auto readPixel = [&](uint32_t x, uint32_t y) {
+        return (uint8_t)((buffer[y * Panel::STRIDE + x / Panel::PIXELS_PER_BYTE] >> Panel::pixelShift(x)) & mask);
+    };
+    bool seen[1 << Panel::PIXEL_BITS] = {};
+
+    for (uint8_t i = 0; i < PALETTE_SIZE; i++) {
+        epaper.drawPixel(0, 0, PANEL_COLORS[i]);
+        epaper.drawPixel(1, 0, PANEL_COLORS[i]);
+        epaper.drawPixel(0, 1, PANEL_COLORS[i]);
+
+        uint8_t nibble = readPixel(0, 0);
+        bool consistent = readPixel(1, 0) == nibble && readPixel(0, 1) == nibble;
+
+        // Every color needs its own value
+        if (!consistent || seen[nibble]) {
+            return false;
+        }
+        seen[nibble] = true;
+        panelNibbles[i] = nibble;
+    }
+
+    epaper.fillScreen(TFT_WHITE);
+    return true;
+}
+
+/**
+ * Update the E-Ink display with the downloaded image
+ * The image has already been decoded into the display buffer while downloading
+ */
+void updateDisplay() {
+    LOG_INFO("\n--- Updating Display ---");
+
+    if (imageNotModified) {
+        LOG_INFO("Panel already shows this image - skipping refresh");
+        return;
+    }
+
+    if (cachedFrameLoaded) {
+        LOG_INFO("Frame loaded from the flash cache");
+        refreshPanel();
+        return;
+    }
+
+    if (streamBytes == 0) {
+        LOG_ERROR("No image data to display!");
+        return;
+    }
+
+    LOG_INFO("Image bytes received: %lu bytes", (unsigned long)streamBytes);
+
+    // Print first 16 bytes for debugging, as big-endian words so a binary log keeps them whole
+    if (LOG_ENABLED(LOG_LEVEL_DEBUG)) {
+        uint8_t head[sizeof(streamHead)] = {};
+        memcpy(head, streamHead, streamHeadBytes);
+        auto word = [&head](size_t i) {
+            return (unsigned long)head[i] << 24 | head[i + 1] << 16 | head[i + 2] << 8 | head[i + 3];
+        };
+        LOG_DEBUG("First 16 bytes (hex): %08lX %08lX %08lX %08lX", word(0), word(4), word(8), word(12));
+    }
+
+    // Check image format
+    bool isPNG = (streamFormat == IMAGE_FORMAT_PNG);
+    bool isBMP = (streamFormat == IMAGE_FORMAT_BMP);
+    bool isFrame = (streamFormat == IMAGE_FORMAT_FRAME);
+
+    LOG_DEBUG("Format detection - PNG: %s, BMP: %s, Frame: %s", isPNG ? "YES" : "NO", isBMP ? "YES" : "NO",
+              isFrame ? "YES" : "NO");
+
+    if (isPNG) {
+        LOG_INFO("Detected PNG image format");
+        LOG_ERROR("PNG format not supported for 6-color display");
+        LOG_INFO("Please configure the server to generate BMP images");
+        LOG_INFO("Update IMAGE_OUTPUT_PATH to use .bmp extension");
+
+        // Display error message
+        epaper.fillScreen(TFT_WHITE);
+        epaper.setTextSize(2);
+        epaper.setTextColor(TFT_BLACK);
+        epaper.setCursor(50, 200);
+        epaper.print("ERROR: PNG not supported");
+        epaper.setCursor(50, 230);
+        epaper.print("Server must generate BMP");
+        epaper.setCursor(50, 260);
+        epaper.print("Check image-generator config");
+
+        // The panel won't show the downloaded image, and the error screen isn't cached
+        memset(&downloadedImage, 0, sizeof(downloadedImage));
+        refreshPanel();
+        return;
+    }
+
+    if (isFrame) {
+        // A frame is only shown if it arrived intact - otherwise keep the current image
+        FrameError error = frameDecoder.finish();
+        if (error != FRAME_OK) {
+            LOG_ERROR("Frame could not be decoded: %s", frameErrorToString(error));
+            LOG_INFO("Decoded %lu of %d rows - skipping refresh", (unsigned long)frameDecoder.rowsDecoded(),
+                     DISPLAY_HEIGHT);
+            return;
+        }
+
+        LOG_INFO("Frame decoded while downloading, decode time: %lu ms", decodeMicros / 1000);
+    } else if (!isBMP) {
+        LOG_ERROR("Unknown image format");
+        LOG_INFO("Expected BMP or frame format for 6-color display");
+        return;
+    } else if (imageDecoder.failed()) {
+        LOG_ERROR("BMP could not be decoded: %s", bmpErrorToString(imageDecoder.error()));
+        return;
+    } else if (!imageStreamComplete()) {
+        // Resuming didn't get the rest either, or the compressed body failed its
+        // checksum - keep the current image
+        LOG_ERROR("Image incomplete, decoded %lu of %lu rows - skipping refresh",
+                  (unsigned long)imageDecoder.rowsDecoded(), (unsigned long)imageDecoder.info().height);
+        return;
+    } else {
+        displaySink.finish();
+
+        LOG_INFO("BMP decoded while downloading, decode time: %lu ms", decodeMicros / 1000);
+    }
+
+    tracePhase(PHASE_DECODE);
+    refreshPanel();
+}
+
+// Shared state between updateWithLightSleep() and refreshTask()
+struct RefreshJob {
+    TaskHandle_t waitTask;
+    std::atomic<bool> done;
+};
+
+/**
+ * Update the panel, light-sleeping while it holds BUSY at its busy level
+ * The driver waits for BUSY inside epaper.update(), and automatic light sleep
+ * isn't available in the prebuilt Arduino core (no tickless idle), so the update
+ * runs in a refresh task while this task does the waiting: it light-sleeps with
+ * BUSY reaching its idle level as the wake source, so the chip is up as soon as
+ * the panel is, and yields so the driver can go on to its next command. The
+ * timer wake bounds each sleep in case BUSY doesn't settle once the panel sleeps.
+ * Returns false if the refresh ran awake.
+ */
+bool updateWithLightSleep() {
+    if (!REFRESH_LIGHT_SLEEP) {
+        epaper.update();
+        return false;
+    }
+
+    RefreshJob job;
+    job.waitTask = xTaskGetCurrentTaskHandle();
+    job.done = false;
+    if (xTaskCreatePinnedToCore(refreshTask, "refresh", REFRESH_TASK_STACK, &job, 1, nullptr, xPortGetCoreID()) !=
+        pdPASS) {
+        LOG_ERROR("Failed to start refresh task!");
+        epaper.update();
+        return false;
+    }
+
+    gpio_wakeup_enable((gpio_num_t)EPD_BUSY_PIN, EPD_BUSY_IDLE_LEVEL == HIGH ? GPIO_INTR_HIGH_LEVEL : GPIO_INTR_LOW_LEVEL);
+    esp_sleep_enable_gpio_wakeup();
+    esp_sleep_enable_timer_wakeup(REFRESH_SLEEP_MAX_MS * 1000ULL);
+
+    while (!job.done) {
+        if (digitalRead(EPD_BUSY_PIN) != EPD_BUSY_IDLE_LEVEL) {
+            esp_light_sleep_start();
+        }
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(10));
+    }
+
+    // enterDeepSleep() sets the timer again for the deep sleep
+    esp_sleep_disable_wakeup_source(ESP_SLEEP_WAKEUP_TIMER);
+    esp_sleep_disable_wakeup_source(ESP_SLEEP_WAKEUP_GPIO);
+    gpio_wakeup_disable((gpio_num_t)EPD_BUSY_PIN);
+    return true;
+}
+
+/**
+ * Panel side of updateWithLightSleep()
+ * Runs the driver's blocking update, wakes the waiting task and deletes itself
+ */
+void refreshTask(void* parameter) {
+    RefreshJob* job = (RefreshJob*)parameter;
+    TaskHandle_t waitTask = job->waitTask;  // The job is gone once done is seen
+    epaper.update();
+    job->done = true;
+    xTaskNotifyGive(waitTask);
+    vTaskDelete(nullptr);
+}
+
+/**
+ * Refresh the panel with the frame in the display buffer
+ * Skipped if it's identical to what the panel shows. Downloaded frames are also
+ * written to the frame cache so they can be shown again without the network.
+ */
+void refreshPanel() {
+    // Skip the refresh if the quantized frame is identical to what the panel shows
+    FrameHash frameHash;
+    bool hashed = hashDisplayBuffer(&frameHash);
+    if (hashed && displayedFrameValid) {
+        if (frameHash.frame == displayedFrame.frame) {
+            LOG_INFO("Frame is identical to the panel - skipping refresh");
+            displayedImage = downloadedImage;
+            storeCachedFrame(frameHash);
+            return;
+        }
+        printChangedBands(displayedFrame, frameHash);
+    }
+
+    LOG_INFO("NOTE: Display refresh may take 30+ seconds");
+    LOG_INFO("Device will appear unresponsive during refresh - this is normal");
+
+    // Everything from the network has arrived by now, and the refresh is most of the wake
+    stopWiFi();
+
+    LOG_INFO("Calling epaper.update() to refresh display...");
+    unsigned long startTime = millis();
+    bool lightSleep = updateWithLightSleep();
+    tracePhase(PHASE_REFRESH);
+
+    unsigned long endTime = millis();
+    LOG_INFO("Display refresh completed in %lu seconds%s", (endTime - startTime) / 1000,
+             lightSleep ? " (light sleep while busy)" : "");
+
+    LOG_INFO("Display update complete!");
+
+    // The panel now shows this image - the next wake can ask the server if it changed
+    displayedImage = downloadedImage;
+    displayedFrame = frameHash;
+    displayedFrameValid = hashed;
+
+    if (hashed) {
+        storeCachedFrame(frameHash);
+    }
+}
+
+/**
+ * 32-bit FNV-1a hash of a string, used to key RTC state by URL
+ */
+uint32_t hashString(const char* text) {
+    uint32_t hash = 2166136261u;
+    while (*text) {
+        hash = (hash ^ (uint8_t)*text++) * 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * Hash the packed display buffer per band and for the whole frame
+ * Returns false when the buffer layout is unknown (drawPixel fallback)
+ */
+bool hashDisplayBuffer(FrameHash* hash) {
+    if (!panelBufferPacked) {
+        return false;
+    }
+
+    unsigned long startMicros = micros();
+    hashFramebuffer((const uint8_t*)epaper.getPointer(), Panel::STRIDE, Panel::HEIGHT, hash);
+
+    LOG_INFO("Frame hash: 0x%lX (%lu us)", (unsigned long)hash->frame, micros() - startMicros);
+    return true;
+}
+
+/**
+ * Log which horizontal bands of the panel differ from the displayed frame
+ */
+void printChangedBands(const FrameHash& previous, const FrameHash& current) {
+    uint32_t changed = changedBands(previous, current);
+
+    LOG_INFO("Changed bands: 0x%04lX", (unsigned long)changed);
+    for (uint32_t band = 0; band < FRAME_HASH_BANDS; band++) {
+        if (changed & (1u << band)) {
+            LOG_DEBUG("Changed band %lu (rows %lu-%lu)", (unsigned long)band,
+                      (unsigned long)bandStart(band, DISPLAY_HEIGHT),
+                      (unsigned long)(bandStart(band + 1, DISPLAY_HEIGHT) - 1));
+        }
+    }
+}
+
+/**
+ * Mount the LittleFS partition holding the frame cache
+ * Formats it on first use; without it frames are simply always downloaded
+ */
+void frameCacheBegin() {
+    unsigned long startTime = millis();
+    frameCacheMounted = LittleFS.begin(true);
+    if (!frameCacheMounted) {
+        LOG_WARN("Frame cache unavailable (LittleFS mount failed)");
+        return;
+    }
+    if (!LittleFS.exists("/frames")) {
+        LittleFS.mkdir("/frames");
+    }
+
+    LOG_INFO("Frame cache mounted in %lu ms", millis() - startTime);
+}
+
+/**
+ * Cache slot for an image URL hash: the screensaver, the board background, or any metro frame
+ * FRAME_CACHE_NONE for the departure board drawn on the device
+ */
+uint8_t frameCacheSlot(uint32_t urlHash) {
+    if (urlHash == hashString(DEPARTURES_URL)) {
+        return FRAME_CACHE_NONE;
+    }
+    if (urlHash == hashString(SCREENSAVER_IMAGE_URL)) {
+        return FRAME_CACHE_SCREENSAVER;
+    }
+    if (urlHash == hashString(BOARD_BACKGROUND_URL)) {
+        return FRAME_CACHE_BACKGROUND;
+    }
+    return FRAME_CACHE_METRO;
+}
+
+/**
+ * Read the header of a cached frame
+ * Returns false if the slot is empty or was stored for a different buffer layout
+ */
+bool frameCacheRead(uint8_t slot, FrameCacheHeader* header) {
+    if (slot == FRAME_CACHE_NONE || !frameCacheMounted || !panelBufferPacked) {
+        return false;
+    }
+
+    File file = LittleFS.open(FRAME_CACHE_PATHS[slot], "r");
+    if (!file) {
+        return false;
+    }
+
+    const size_t frameBytes = Panel::FRAMEBUFFER_SIZE;
+    bool valid = file.read((uint8_t*)header, sizeof(*header)) == sizeof(*header) &&
+                 header->magic == FRAME_CACHE_MAGIC && header->width == DISPLAY_WIDTH &&
+                 header->height == DISPLAY_HEIGHT && memcmp(header->nibbles, panelNibbles, PALETTE_SIZE) == 0 &&
+                 file.size() == sizeof(*header) + frameBytes;
+    file.close();
+    return valid;
+}
+
+/**
+ * Check whether a cached frame was confirmed by the server recently enough to be
+ * shown without asking again
+ */
+bool frameCacheFresh(uint8_t slot) {
+    if (frameCacheChecked[slot] == 0 || !clockState.valid) {
+        return false;
+    }
+    int64_t ageSeconds = wallClockMicros() / 1000000 - frameCacheChecked[slot];
+    return ageSeconds >= 0 && ageSeconds < FRAME_CACHE_MAX_AGE_SECONDS;
+}
+
+/**
+ * Load a cached frame into the display buffer, for updateDisplay()
+ * When the panel already shows it, only the header is read and the refresh is
+ * skipped. Returns false if the slot is empty or damaged.
+ */
+bool loadCachedFrame(uint8_t slot) {
+    FrameCacheHeader header;
+    if (!frameCacheRead(slot, &header)) {
+        return false;
+    }
+
+    imageNotModified = false;
+    cachedFrameLoaded = false;
+    downloadedImage = header.validators;
+
+    if (displayedFrameValid && displayedFrame.frame == header.hash.frame) {
+        LOG_INFO("Panel already shows the cached frame");
+        displayedImage = downloadedImage;
+        imageNotModified = true;
+        return true;
+    }
+
+    if (!readCachedFrame(slot, &header)) {
+        memset(&downloadedImage, 0, sizeof(downloadedImage));
+        return false;
+    }
+
+    tracePhase(PHASE_DECODE);
+    cachedFrameLoaded = true;
+    return true;
+}
+
+/**
+ * Load the cached metro frame into the display buffer as the base of a delta frame
+ * Returns false unless the slot holds the service's frame with this version
+ */
+bool loadFrameBase(const String& version) {
+    frameBaseLoaded = false;
+
+    FrameCacheHeader header;
+    if (!frameCacheRead(FRAME_CACHE_METRO, &header) || header.validators.urlHash != hashString(SERVICE_API_URL) ||
+        version != header.validators.etag) {
+        return false;
+    }
+
+    frameBaseLoaded = readCachedFrame(FRAME_CACHE_METRO, &header);
+    return frameBaseLoaded;
+}
+
+/**
+ * Copy a cached frame into the display buffer and check it against its hash
+ * A damaged entry is deleted and the buffer cleared. Returns false if the slot
+ * is empty or damaged.
+ */
+bool readCachedFrame(uint8_t slot, FrameCacheHeader* header) {
+    if (!frameCacheRead(slot, header)) {
+        return false;
+    }
+
+    unsigned long startTime = millis();
+    uint8_t* buffer = (uint8_t*)epaper.getPointer();
+    const size_t frameBytes = Panel::FRAMEBUFFER_SIZE;
+
+    File file = LittleFS.open(FRAME_CACHE_PATHS[slot], "r");
+    bool loaded = file && file.seek(sizeof(*header)) && file.read(buffer, frameBytes) == frameBytes;
+    file.close();
+
+    // Catch flash corruption before it reaches the panel
+    FrameHash hash;
+    if (!loaded || !hashDisplayBuffer(&hash) || hash.frame != header->hash.frame) {
+        LOG_ERROR("Cached frame is damaged - discarding it");
+        LittleFS.remove(FRAME_CACHE_PATHS[slot]);
+        epaper.fillScreen(TFT_WHITE);
+        return false;
+    }
+
+    LOG_INFO("Loaded cached frame %s in %lu ms", FRAME_CACHE_PATHS[slot], millis() - startTime);
+    return true;
+}
+
+/**
+ * Write the downloaded frame in the display buffer to its cache slot
+ * Skipped for cached or incomplete frames and when the slot already holds it
+ */
+void storeCachedFrame(const FrameHash& hash) {
+    if (cachedFrameLoaded || downloadedImage.urlHash == 0 || !frameCacheMounted || !panelBufferPacked) {
+        return;
+    }
+
+    uint8_t slot = frameCacheSlot(downloadedImage.urlHash);
+    if (slot == FRAME_CACHE_NONE) {
+        return;
+    }
+
+    FrameCacheHeader header;
+    if (frameCacheRead(slot, &header) && header.hash.frame == hash.frame &&
+        memcmp(&header.validators, &downloadedImage, sizeof(downloadedImage)) == 0) {
+        frameCacheChecked[slot] = wallClockMicros() / 1000000;
+        return;
+    }
+
+    memset(&header, 0, sizeof(header));
+    header.magic = FRAME_CACHE_MAGIC;
+    header.width = DISPLAY_WIDTH;
+    header.height = DISPLAY_HEIGHT;
+    memcpy(header.nibbles, panelNibbles, PALETTE_SIZE);
+    header.validators = downloadedImage;
+    header.hash = hash;
+
+    unsigned long startTime = millis();
+    const size_t frameBytes = Panel::FRAMEBUFFER_SIZE;
+
+    // Written beside the old copy and renamed over it, so a reset mid-write
+    // never leaves a half-written frame in the slot
+    File file = LittleFS.open("/frames/pending.bin", "w");
+    bool written = file && file.write((const uint8_t*)&header, sizeof(header)) == sizeof(header) &&
+                   file.write((const uint8_t*)epaper.getPointer(), frameBytes) == frameBytes;
+    file.close();
+
+    if (!written || !LittleFS.rename("/frames/pending.bin", FRAME_CACHE_PATHS[slot])) {
+        LOG_WARN("Failed to write the frame cache");
+        LittleFS.remove("/frames/pending.bin");
+        return;
+    }
+
+    frameCacheChecked[slot] = wallClockMicros() / 1000000;
+
+    LOG_INFO("Cached frame in %s (%lu ms)", FRAME_CACHE_PATHS[slot], millis() - startTime);
+}
+
+/**
+ * Setup button wake-up configuration for multiple buttons
+ */
+void setupButtonWakeup() {
+    // Configure both button pins as input with pull-up (if buttons are active LOW)
+    if (BUTTON_ACTIVE_LOW) {
+        pinMode(METRO_BUTTON_PIN, INPUT_PULLUP);
+        pinMode(SCREENSAVER_BUTTON_PIN, INPUT_PULLUP);
+    } else {
+        pinMode(METRO_BUTTON_PIN, INPUT);
+        pinMode(SCREENSAVER_BUTTON_PIN, INPUT);
+    }
+
+    // Create bitmask for ext1 wake-up (supports multiple pins)
     uint64_t buttonMask = (1ULL << METRO_BUTTON_PIN) | (1ULL << SCREENSAVER_BUTTON_PIN);
 
     // Enable ext1 wake-up
@@ -699,11 +2265,9 @@ void setupButtonWakeup() {
         esp_sleep_enable_ext1_wakeup(buttonMask, ESP_EXT1_WAKEUP_ANY_HIGH);
     }
 
-    Serial.println("Button wake-up enabled:");
-    Serial.print("  - Metro button (Key 1) on GPIO ");
-    Serial.println(METRO_BUTTON_PIN);
-    Serial.print("  - Screensaver button (Key 2) on GPIO ");
-    Serial.println(SCREENSAVER_BUTTON_PIN);
+    LOG_INFO("Button wake-up enabled:");
+    LOG_INFO(" - Metro button (Key 1) on GPIO %d", METRO_BUTTON_PIN);
+    LOG_INFO(" - Screensaver button (Key 2) on GPIO %d", SCREENSAVER_BUTTON_PIN);
 }
 
 /**
@@ -712,7 +2276,7 @@ void setupButtonWakeup() {
  */
 int getWakeButtonPressed() {
     if (wakeup_reason == ESP_SLEEP_WAKEUP_EXT1) {
-        Serial.println("Wake-up caused by button press");
+        LOG_INFO("Wake-up caused by button press");
 
         // Check which button is currently pressed
         // Note: This checks the current state, not which button triggered the wake
@@ -734,14 +2298,14 @@ int getWakeButtonPressed() {
         }
 
         // If no button is currently pressed, default to metro button
-        Serial.println("WARNING: Button released before detection, defaulting to metro");
+        LOG_WARN("Button released before detection, defaulting to metro");
         return METRO_BUTTON_PIN;
 
     } else if (wakeup_reason == ESP_SLEEP_WAKEUP_TIMER) {
-        Serial.println("Wake-up caused by timer");
+        LOG_INFO("Wake-up caused by timer");
         return 0;
     } else {
-        Serial.println("Wake-up not caused by deep sleep (first boot or reset)");
+        LOG_INFO("Wake-up not caused by deep sleep (first boot or reset)");
         return 0;
     }
 }
@@ -750,8 +2314,8 @@ int getWakeButtonPressed() {
  * Display a test pattern to verify display is working
  */
 void displayTestPattern() {
-    Serial.println("\n--- Displaying Test Pattern ---");
-    Serial.println("This will show colored rectangles to verify display hardware");
+    LOG_INFO("\n--- Displaying Test Pattern ---");
+    LOG_INFO("This will show colored rectangles to verify display hardware");
 
     unsigned long startTime = millis();
 
@@ -780,49 +2344,199 @@ void displayTestPattern() {
     epaper.print("display is working!");
 
     // Refresh the display
-    Serial.println("Calling epaper.update() to refresh...");
+    LOG_INFO("Calling epaper.update() to refresh...");
     epaper.update();
 
     unsigned long endTime = millis();
-    Serial.print("Test pattern refresh completed in ");
-    Serial.print((endTime - startTime) / 1000);
-    Serial.println(" seconds");
+    LOG_INFO("Test pattern refresh completed in %lu seconds", (endTime - startTime) / 1000);
+
+    LOG_INFO("Test pattern sent to display");
+    LOG_INFO("NOTE: Display refresh may take 30+ seconds");
+    LOG_INFO("Watch the display for color changes...");
+}
+
+/**
+ * Start the trace of this wake cycle
+ */
+void traceBegin() {
+    memset(&currentTrace, 0, sizeof(currentTrace));
+    currentTrace.sequence = ++wakeSequence;
+    currentTrace.phaseMicros[PHASE_BOOT] = esp_timer_get_time();
+}
+
+/**
+ * Record the end of a wake-cycle phase
+ */
+void tracePhase(uint8_t phase) {
+    currentTrace.phaseMicros[phase] = esp_timer_get_time();
+}
+
+/**
+ * Finish this wake's trace and add it to the RTC ring
+ */
+void traceEnd() {
+    tracePhase(PHASE_SLEEP);
+    wakeTraces[currentTrace.sequence % WAKE_TRACE_SLOTS] = currentTrace;
+
+    // Time spent in each phase since the last one that ended before it; a restored
+    // clock is ready before WiFi comes up, so the order isn't always the enum's.
+    // Skipped phases show as 0
+    unsigned long phaseMs[PHASE_COUNT] = {};
+    for (uint8_t phase = 0; phase < PHASE_COUNT; phase++) {
+        uint32_t end = currentTrace.phaseMicros[phase];
+        if (end == 0) continue;
+        uint32_t previous = 0;
+        for (uint8_t other = 0; other < PHASE_COUNT; other++) {
+            uint32_t otherEnd = currentTrace.phaseMicros[other];
+            if (otherEnd < end && otherEnd > previous) previous = otherEnd;
+        }
+        phaseMs[phase] = (end - previous) / 1000;
+    }
+    LOG_INFO("Wake phases (ms): boot=%lu wifi=%lu ntp=%lu generate=%lu first byte=%lu download=%lu decode=%lu "
+             "refresh=%lu sleep=%lu",
+             phaseMs[PHASE_BOOT], phaseMs[PHASE_WIFI], phaseMs[PHASE_NTP], phaseMs[PHASE_GENERATE],
+             phaseMs[PHASE_FIRST_BYTE], phaseMs[PHASE_DOWNLOAD], phaseMs[PHASE_DECODE], phaseMs[PHASE_REFRESH],
+             phaseMs[PHASE_SLEEP]);
+}
+
+/**
+ * Unsent wake traces as compact JSON for the generate request:
+ * {"traces":[{"seq":N,"wake":N,"rssi":N,"bytes":N,"us":[boot, wifi, ..., sleep]}]}
+ * Slots are picked by the sequence they hold, oldest slot position first: a wake
+ * that never reached deep sleep (reset or crash) leaves a gap, and its slot still
+ * holds an older trace
+ */
+String tracePayload() {
+    JsonDocument doc;
+    JsonArray traces = doc["traces"].to<JsonArray>();
+
+    for (uint32_t i = 1; i <= WAKE_TRACE_SLOTS; i++) {
+        const WakeTrace& trace = wakeTraces[(currentTrace.sequence + i) % WAKE_TRACE_SLOTS];
+        if (trace.sequence <= wakeTraceSent || trace.sequence >= currentTrace.sequence) {
+            continue;  // Empty or already uploaded
+        }
+
+        JsonObject entry = traces.add<JsonObject>();
+        entry["seq"] = trace.sequence;
+        entry["wake"] = trace.wakeReason;
+        entry["rssi"] = trace.rssi;
+        entry["bytes"] = trace.bytes;
+        JsonArray phases = entry["us"].to<JsonArray>();
+        for (uint8_t phase = 0; phase < PHASE_COUNT; phase++) {
+            phases.add(trace.phaseMicros[phase]);
+        }
+    }
 
-    Serial.println("Test pattern sent to display");
-    Serial.println("NOTE: Display refresh may take 30+ seconds");
-    Serial.println("Watch the display for color changes...");
+    String payload;
+    serializeJson(doc, payload);
+    return payload;
 }
 
 /**
  * Enter deep sleep mode to conserve battery
  */
 void enterDeepSleep(uint32_t durationSeconds) {
-    Serial.println("\n--- Entering Deep Sleep ---");
-    Serial.print("Will wake up in ");
-    Serial.print(durationSeconds);
-    Serial.print(" seconds (");
-    Serial.print(durationSeconds / 60);
-    Serial.println(" minutes)");
+    LOG_INFO("\n--- Entering Deep Sleep ---");
+    durationSeconds = scheduleWake(durationSeconds);
+
+    LOG_INFO("Will wake up in %lu seconds (%lu minutes)", (unsigned long)durationSeconds,
+             (unsigned long)(durationSeconds / 60));
 
     // Setup button wake-up
     setupButtonWakeup();
 
-    // Disconnect WiFi to save power
-    WiFi.disconnect(true);
-    WiFi.mode(WIFI_OFF);
+    // Still on if nothing was refreshed
+    stopWiFi();
 
-    // Configure wake-up timer
-    esp_sleep_enable_timer_wakeup(durationSeconds * 1000000ULL);
+    // Configure wake-up timer, compensated for the RTC drift so the wake lands on time
+    uint64_t sleepMicros = durationSeconds * 1000000ULL;
+    if (clockState.driftMeasured) {
+        sleepMicros = sleepMicros * 1000000 / (1000000 + clockState.driftPpm);
+        LOG_INFO("Drift-compensated sleep: %lu ms", (unsigned long)(sleepMicros / 1000));
+    }
+    esp_sleep_enable_timer_wakeup(sleepMicros);
+
+    printMemoryStats();
+    traceEnd();
+
+    // Remember when we went to sleep so the clock can be rebuilt on wake
+    if (clockState.valid) {
+        clockState.sleepMicros = wallClockMicros();
+        clockState.sleepSeconds = durationSeconds;
+    }
 
-    Serial.println("Sleep wake sources:");
-    Serial.println("  - Timer (scheduled update)");
-    Serial.print("  - Metro button (Key 1) on GPIO ");
-    Serial.println(METRO_BUTTON_PIN);
-    Serial.print("  - Screensaver button (Key 2) on GPIO ");
-    Serial.println(SCREENSAVER_BUTTON_PIN);
-    Serial.println("Good night!");
-    Serial.flush();
+    LOG_INFO("Sleep wake sources:");
+    LOG_INFO(" - Timer (scheduled update)");
+    LOG_INFO(" - Metro button (Key 1) on GPIO %d", METRO_BUTTON_PIN);
+    LOG_INFO(" - Screensaver button (Key 2) on GPIO %d", SCREENSAVER_BUTTON_PIN);
+    LOG_INFO("Good night!");
+    LOG_FLUSH();
 
     // Enter deep sleep
     esp_deep_sleep_start();
 }
+
+/**
+ * Adjust a sleep to the departures and the active periods
+ * After a metro update the wake is timed from the first departure shown: shortly
+ * before it leaves, or just after when that's too close, within MIN_SLEEP_SECONDS
+ * and MAX_ACTIVE_SLEEP_SECONDS. Any sleep is cut short at the next start or end of
+ * an active period. Needs the wall clock, so it's left alone until that's set.
+ */
+uint32_t scheduleWake(uint32_t durationSeconds) {
+    if (!clockState.valid) {
+        return durationSeconds;
+    }
+    time_t now = time(nullptr);
+
+    if (ADAPTIVE_WAKE_ENABLED && contentValidUntil > now) {
+        time_t wakeAt = contentValidUntil - DEPARTURE_WAKE_LEAD_SECONDS;
+        if (wakeAt < now + MIN_SLEEP_SECONDS) {
+            wakeAt = contentValidUntil + DEPARTED_WAKE_DELAY_SECONDS;
+        }
+        durationSeconds = constrain((uint32_t)(wakeAt - now), (uint32_t)MIN_SLEEP_SECONDS,
+                                    (uint32_t)MAX_ACTIVE_SLEEP_SECONDS);
+
+        LOG_INFO("Next departure in %ld seconds", (long)(contentValidUntil - now));
+    }
+
+    // Wake a little past the boundary, so the clock's error can't land it just before
+    uint32_t windowChange = secondsToActiveWindowChange(now) + NTP_MAX_ERROR_SECONDS;
+    if (windowChange < durationSeconds) {
+        durationSeconds = max(windowChange, (uint32_t)MIN_SLEEP_SECONDS);
+        LOG_INFO("Sleep cut short at the active period boundary");
+    }
+    return durationSeconds;
+}
+
+/**
+ * Seconds until the next start or end of an active period
+ */
+uint32_t secondsToActiveWindowChange(time_t now) {
+    const int boundaries[] = {MORNING_START_HOUR, MORNING_END_HOUR, EVENING_START_HOUR, EVENING_END_HOUR};
+
+    struct tm today;
+    localtime_r(&now, &today);
+
+    time_t next = 0;
+    for (int hour : boundaries) {
+        // Today at that hour, or tomorrow if it's passed - mktime normalizes the day
+        for (int day = 0; day < 2; day++) {
+            struct tm boundary = today;
+            boundary.tm_mday += day;
+            boundary.tm_hour = hour;
+            boundary.tm_min = 0;
+            boundary.tm_sec = 0;
+            boundary.tm_isdst = -1;
+
+            time_t at = mktime(&boundary);
+            if (at > now) {
+                if (next == 0 || at < next) {
+                    next = at;
+                }
+                break;
+            }
+        }
+    }
+    return (uint32_t)(next - now);
+}
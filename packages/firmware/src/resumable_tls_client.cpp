@@ -0,0 +1,405 @@
+#include "resumable_tls_client.h"
+
+#include <esp_system.h>
+
+#include "config.h"
+#include "log.h"
+#include "mbedtls/error.h"
+#include "mbedtls/net_sockets.h"
+#include "mbedtls/version.h"
+#include "mbedtls/x509_crt.h"
+
+// Fields of the SSL context became private in mbedTLS 3
+#if MBEDTLS_VERSION_MAJOR >= 3
+#define SSL_STATE(ssl) ((ssl).MBEDTLS_PRIVATE(state))
+#else
+#define SSL_STATE(ssl) ((ssl).state)
+#endif
+
+// Serialized TLS session for one host, kept in RTC memory across deep sleep
+struct TlsSessionSlot {
+    uint32_t hostHash;  // FNV-1a of the host name, 0 if the slot is empty
+    uint16_t port;
+    uint16_t length;  // Bytes used in data, 0 if no session is stored
+    uint8_t data[TLS_SESSION_MAX_SIZE];
+};
+
+RTC_DATA_ATTR TlsSessionSlot tlsSessions[TLS_SESSION_SLOTS];
+RTC_DATA_ATTR uint8_t tlsSessionNext = 0;  // Slot replaced when all are in use
+
+#ifdef TLS_CA_CERT
+mbedtls_x509_crt tlsCaChain;
+bool tlsCaChainParsed = false;
+#endif
+
+static uint32_t hostHash(const char* host) {
+    uint32_t hash = 2166136261u;
+    for (const char* c = host; *c != '\0'; c++) {
+        hash = (hash ^ (uint8_t)tolower(*c)) * 16777619u;
+    }
+    return hash != 0 ? hash : 1;
+}
+
+static TlsSessionSlot* findSession(const char* host, uint16_t port) {
+    uint32_t hash = hostHash(host);
+    for (int i = 0; i < TLS_SESSION_SLOTS; i++) {
+        if (tlsSessions[i].hostHash == hash && tlsSessions[i].port == port) {
+            return &tlsSessions[i];
+        }
+    }
+    return nullptr;
+}
+
+static int randomCallback(void* context, unsigned char* output, size_t length) {
+    // Hardware RNG - a true random source while the radio is on
+    esp_fill_random(output, length);
+    return 0;
+}
+
+static void printTlsError(const char* action, int error) {
+    char message[96];
+    mbedtls_strerror(error, message, sizeof(message));
+    LOG_WARN("TLS %s failed (-0x%X): %s", action, -error, message);
+}
+
+ResumableTlsClient::ResumableTlsClient() {}
+
+ResumableTlsClient::~ResumableTlsClient() {
+    stop();
+}
+
+void ResumableTlsClient::clearSessions() {
+    memset(tlsSessions, 0, sizeof(tlsSessions));
+}
+
+int ResumableTlsClient::connect(IPAddress ip, uint16_t port) {
+    return connect(ip.toString().c_str(), port, TLS_HANDSHAKE_TIMEOUT_MS);
+}
+
+int ResumableTlsClient::connect(IPAddress ip, uint16_t port, int32_t timeout) {
+    return connect(ip.toString().c_str(), port, timeout);
+}
+
+int ResumableTlsClient::connect(const char* host, uint16_t port) {
+    return connect(host, port, TLS_HANDSHAKE_TIMEOUT_MS);
+}
+
+int ResumableTlsClient::connect(const char* host, uint16_t port, int32_t timeout) {
+    if (handshake(host, port, timeout, true)) {
+        return 1;
+    }
+
+    // Some servers abort instead of falling back to a full handshake
+    // when they can't resume, so the stored session is dropped and retried once
+    if (_sessionOffered) {
+        TlsSessionSlot* slot = findSession(host, port);
+        if (slot != nullptr) {
+            slot->length = 0;
+        }
+        LOG_INFO("TLS session not accepted - retrying with a full handshake");
+        return handshake(host, port, timeout, false);
+    }
+    return 0;
+}
+
+/**
+ * Open the TCP connection and run the TLS handshake
+ * Offers the stored session for host:port when offerSession is set
+ */
+int ResumableTlsClient::handshake(const char* host, uint16_t port, int32_t timeout, bool offerSession) {
+    stop();
+    _sessionOffered = false;
+    _sessionResumed = false;
+    _handshakeMillis = 0;
+
+    if (!WiFiClient::connect(host, port, timeout)) {
+        LOG_WARN("TLS: TCP connection to %s failed", host);
+        return 0;
+    }
+
+    mbedtls_ssl_init(&_ssl);
+    mbedtls_ssl_config_init(&_config);
+    _active = true;
+
+    int ret = mbedtls_ssl_config_defaults(&_config, MBEDTLS_SSL_IS_CLIENT, MBEDTLS_SSL_TRANSPORT_STREAM,
+                                          MBEDTLS_SSL_PRESET_DEFAULT);
+    if (ret == 0) {
+        mbedtls_ssl_conf_rng(&_config, randomCallback, nullptr);
+#if defined(MBEDTLS_SSL_SESSION_TICKETS)
+        mbedtls_ssl_conf_session_tickets(&_config, MBEDTLS_SSL_SESSION_TICKETS_ENABLED);
+#endif
+#ifdef TLS_CA_CERT
+        if (!tlsCaChainParsed) {
+            mbedtls_x509_crt_init(&tlsCaChain);
+            tlsCaChainParsed = mbedtls_x509_crt_parse(&tlsCaChain, (const unsigned char*)TLS_CA_CERT,
+                                                      strlen(TLS_CA_CERT) + 1) == 0;
+        }
+        mbedtls_ssl_conf_ca_chain(&_config, &tlsCaChain, nullptr);
+        mbedtls_ssl_conf_authmode(&_config, MBEDTLS_SSL_VERIFY_REQUIRED);
+#else
+        // Same as HTTPClient without a CA certificate: encrypted, but the server isn't verified
+        mbedtls_ssl_conf_authmode(&_config, MBEDTLS_SSL_VERIFY_NONE);
+#endif
+        ret = mbedtls_ssl_setup(&_ssl, &_config);
+    }
+    if (ret == 0) {
+        ret = mbedtls_ssl_set_hostname(&_ssl, host);
+    }
+    if (ret != 0) {
+        printTlsError("setup", ret);
+        stop();
+        return 0;
+    }
+    mbedtls_ssl_set_bio(&_ssl, this, sendCallback, recvCallback, nullptr);
+
+    TlsSessionSlot* slot = offerSession ? findSession(host, port) : nullptr;
+    if (slot != nullptr && slot->length > 0) {
+        mbedtls_ssl_session session;
+        mbedtls_ssl_session_init(&session);
+        if (mbedtls_ssl_session_load(&session, slot->data, slot->length) == 0 &&
+            mbedtls_ssl_set_session(&_ssl, &session) == 0) {
+            _sessionOffered = true;
+        } else {
+            // Stale or from a different mbedTLS build
+            slot->length = 0;
+        }
+        mbedtls_ssl_session_free(&session);
+    }
+
+    // Stepped by hand to see which messages the server sends: a resumed handshake
+    // goes straight from ServerHello to ChangeCipherSpec without a certificate
+    unsigned long start = millis();
+    bool certificateSent = false;
+    while (SSL_STATE(_ssl) != MBEDTLS_SSL_HANDSHAKE_OVER) {
+        if (SSL_STATE(_ssl) == MBEDTLS_SSL_SERVER_CERTIFICATE) {
+            certificateSent = true;
+        }
+
+        ret = mbedtls_ssl_handshake_step(&_ssl);
+        if (ret == MBEDTLS_ERR_SSL_WANT_READ || ret == MBEDTLS_ERR_SSL_WANT_WRITE) {
+            if (millis() - start > TLS_HANDSHAKE_TIMEOUT_MS) {
+                ret = MBEDTLS_ERR_SSL_TIMEOUT;
+                break;
+            }
+            delay(1);
+            continue;
+        }
+        if (ret != 0) {
+            break;
+        }
+    }
+
+    if (ret != 0) {
+        printTlsError("handshake", ret);
+        stop();
+        return 0;
+    }
+
+    _connected = true;
+    _sessionResumed = _sessionOffered && !certificateSent;
+    _handshakeMillis = millis() - start;
+
+    LOG_INFO("TLS handshake with %s: %lu ms, %s", host, (unsigned long)_handshakeMillis,
+             _sessionResumed   ? "session resumed"
+             : _sessionOffered ? "session rejected, full handshake"
+                               : "full handshake");
+
+    saveSession(host, port);
+    return 1;
+}
+
+/**
+ * Store the negotiated session for host:port in RTC memory
+ * Done after every handshake, as servers may issue a fresh ticket when resuming
+ */
+void ResumableTlsClient::saveSession(const char* host, uint16_t port) {
+    TlsSessionSlot* slot = findSession(host, port);
+    if (slot == nullptr) {
+        for (int i = 0; i < TLS_SESSION_SLOTS && slot == nullptr; i++) {
+            if (tlsSessions[i].hostHash == 0) {
+                slot = &tlsSessions[i];
+            }
+        }
+    }
+    if (slot == nullptr) {
+        slot = &tlsSessions[tlsSessionNext];
+        tlsSessionNext = (tlsSessionNext + 1) % TLS_SESSION_SLOTS;
+    }
+
+    slot->hostHash = hostHash(host);
+    slot->port = port;
+    slot->length = 0;
+
+    mbedtls_ssl_session session;
+    mbedtls_ssl_session_init(&session);
+    size_t length = 0;
+    int ret = mbedtls_ssl_get_session(&_ssl, &session);
+    if (ret == 0) {
+        ret = mbedtls_ssl_session_save(&session, slot->data, sizeof(slot->data), &length);
+    }
+    mbedtls_ssl_session_free(&session);
+
+    if (ret == MBEDTLS_ERR_SSL_BUFFER_TOO_SMALL) {
+        LOG_INFO("TLS session needs %lu bytes, more than TLS_SESSION_MAX_SIZE - not stored", (unsigned long)length);
+    } else if (ret != 0) {
+        printTlsError("session save", ret);
+    } else {
+        slot->length = length;
+    }
+}
+
+size_t ResumableTlsClient::write(uint8_t data) {
+    return write(&data, 1);
+}
+
+size_t ResumableTlsClient::write(const uint8_t* buf, size_t size) {
+    if (!_connected) {
+        return 0;
+    }
+
+    size_t written = 0;
+    unsigned long start = millis();
+    while (written < size) {
+        int ret = mbedtls_ssl_write(&_ssl, buf + written, size - written);
+        if (ret > 0) {
+            written += ret;
+        } else if ((ret == MBEDTLS_ERR_SSL_WANT_WRITE || ret == MBEDTLS_ERR_SSL_WANT_READ) &&
+                   millis() - start < _timeout) {
+            delay(1);
+        } else {
+            printTlsError("write", ret);
+            stop();
+            break;
+        }
+    }
+    return written;
+}
+
+int ResumableTlsClient::available() {
+    if (!_connected) {
+        return 0;
+    }
+
+    // A zero-length read processes the next record without consuming it
+    int ret = mbedtls_ssl_read(&_ssl, nullptr, 0);
+    if (ret < 0 && ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) {
+        if (ret != MBEDTLS_ERR_SSL_PEER_CLOSE_NOTIFY) {
+            printTlsError("read", ret);
+        }
+        int pending = mbedtls_ssl_get_bytes_avail(&_ssl) + (_peeked >= 0 ? 1 : 0);
+        if (pending == 0) {
+            stop();
+        }
+        return pending;
+    }
+    return mbedtls_ssl_get_bytes_avail(&_ssl) + (_peeked >= 0 ? 1 : 0);
+}
+
+int ResumableTlsClient::read() {
+    uint8_t data;
+    return read(&data, 1) == 1 ? data : -1;
+}
+
+int ResumableTlsClient::read(uint8_t* buf, size_t size) {
+    if (size == 0) {
+        return 0;
+    }
+
+    int count = 0;
+    if (_peeked >= 0) {
+        *buf++ = _peeked;
+        _peeked = -1;
+        size--;
+        count = 1;
+    }
+    if (size == 0 || !_connected) {
+        return count > 0 ? count : -1;
+    }
+
+    int ret = mbedtls_ssl_read(&_ssl, buf, size);
+    if (ret > 0) {
+        return count + ret;
+    }
+    if (ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) {
+        if (ret != 0 && ret != MBEDTLS_ERR_SSL_PEER_CLOSE_NOTIFY) {
+            printTlsError("read", ret);
+        }
+        stop();
+    }
+    return count > 0 ? count : -1;
+}
+
+size_t ResumableTlsClient::readBytes(char* buffer, size_t length) {
+    // Stream::readBytes() reads a byte at a time, which is one TLS read call each
+    size_t count = 0;
+    unsigned long start = millis();
+    while (count < length && millis() - start < _timeout) {
+        int ret = read((uint8_t*)buffer + count, length - count);
+        if (ret > 0) {
+            count += ret;
+        } else if (!_connected) {
+            break;
+        } else {
+            delay(1);
+        }
+    }
+    return count;
+}
+
+int ResumableTlsClient::peek() {
+    if (_peeked < 0) {
+        uint8_t data;
+        if (read(&data, 1) == 1) {
+            _peeked = data;
+        }
+    }
+    return _peeked;
+}
+
+void ResumableTlsClient::flush() {
+    // Records are sent as they're written - nothing is buffered here
+}
+
+void ResumableTlsClient::stop() {
+    if (_connected) {
+        mbedtls_ssl_close_notify(&_ssl);
+    }
+    release();
+    WiFiClient::stop();
+    _connected = false;
+    _peeked = -1;
+}
+
+uint8_t ResumableTlsClient::connected() {
+    if (!_connected) {
+        return 0;
+    }
+    // Decrypted data can still be read after the server has closed the socket
+    if (_peeked >= 0 || mbedtls_ssl_get_bytes_avail(&_ssl) > 0) {
+        return 1;
+    }
+    return WiFiClient::connected();
+}
+
+void ResumableTlsClient::release() {
+    if (_active) {
+        mbedtls_ssl_free(&_ssl);
+        mbedtls_ssl_config_free(&_config);
+        _active = false;
+    }
+}
+
+int ResumableTlsClient::sendCallback(void* context, const unsigned char* buf, size_t len) {
+    ResumableTlsClient* client = static_cast<ResumableTlsClient*>(context);
+    int written = client->WiFiClient::write(buf, len);
+    return written > 0 ? written : MBEDTLS_ERR_NET_SEND_FAILED;
+}
+
+int ResumableTlsClient::recvCallback(void* context, unsigned char* buf, size_t len) {
+    ResumableTlsClient* client = static_cast<ResumableTlsClient*>(context);
+    if (client->WiFiClient::available() <= 0) {
+        return client->WiFiClient::connected() ? MBEDTLS_ERR_SSL_WANT_READ : MBEDTLS_ERR_NET_CONN_RESET;
+    }
+    int count = client->WiFiClient::read(buf, len);
+    return count > 0 ? count : MBEDTLS_ERR_NET_RECV_FAILED;
+}
@@ -0,0 +1,72 @@
+#ifndef RESUMABLE_TLS_CLIENT_H
+#define RESUMABLE_TLS_CLIENT_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+
+#include "mbedtls/ssl.h"
+
+/**
+ * TLS client that resumes the previous session with a host across deep sleep
+ *
+ * A full TLS 1.2 handshake costs an extra round trip plus the ECDHE and RSA/ECDSA
+ * maths, which takes hundreds of milliseconds on the ESP32-S3. After every handshake
+ * the negotiated session (ticket or ID) is serialized into RTC memory, keyed by host
+ * and port, and offered again on the next connection. When the server doesn't
+ * accept it, the handshake simply continues as a full one; if the handshake fails
+ * outright with a stored session, the session is dropped and the connection retried.
+ *
+ * Hands the decrypted stream to HTTPClient like WiFiClientSecure:
+ *   ResumableTlsClient tls;
+ *   http.begin(tls, url);
+ */
+class ResumableTlsClient : public WiFiClient {
+public:
+    ResumableTlsClient();
+    ~ResumableTlsClient() override;
+
+    int connect(IPAddress ip, uint16_t port) override;
+    int connect(IPAddress ip, uint16_t port, int32_t timeout) override;
+    int connect(const char* host, uint16_t port) override;
+    int connect(const char* host, uint16_t port, int32_t timeout) override;
+
+    size_t write(uint8_t data) override;
+    size_t write(const uint8_t* buf, size_t size) override;
+    int available() override;
+    int read() override;
+    int read(uint8_t* buf, size_t size) override;
+    size_t readBytes(char* buffer, size_t length) override;
+    int peek() override;
+    void flush() override;
+    void stop() override;
+    uint8_t connected() override;
+    operator bool() override { return connected(); }
+
+    // Result of the last handshake, for logging and wake traces
+    bool sessionOffered() const { return _sessionOffered; }
+    bool sessionResumed() const { return _sessionResumed; }
+    uint32_t handshakeMillis() const { return _handshakeMillis; }
+
+    /** Forget every stored session (e.g. after changing TLS_CA_CERT) */
+    static void clearSessions();
+
+private:
+    int handshake(const char* host, uint16_t port, int32_t timeout, bool offerSession);
+    void release();
+    void saveSession(const char* host, uint16_t port);
+
+    static int sendCallback(void* context, const unsigned char* buf, size_t len);
+    static int recvCallback(void* context, unsigned char* buf, size_t len);
+
+    mbedtls_ssl_context _ssl;
+    mbedtls_ssl_config _config;
+    bool _active = false;  // _ssl and _config are initialized
+    bool _connected = false;
+    int _peeked = -1;  // Byte held back by peek(), -1 if none
+
+    bool _sessionOffered = false;
+    bool _sessionResumed = false;
+    uint32_t _handshakeMillis = 0;
+};
+
+#endif  // RESUMABLE_TLS_CLIENT_H
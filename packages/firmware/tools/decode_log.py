@@ -0,0 +1,187 @@
+#!/usr/bin/env python3
+"""Decode the binary log ring printed by the firmware (LOG_OUTPUT_BINARY).
+
+After a crash reset the device prints its RTC log ring over serial as hex lines
+between "LOGRING begin" and "LOGRING end" (src/log.cpp). Give this script a
+capture of the serial output, and it turns the records back into text using the
+format strings of the LOG_* calls in the sources:
+
+    python3 tools/decode_log.py serial-capture.txt
+    python3 tools/decode_log.py --raw ring.bin
+
+Each record is [length][format id, u32 LE][ms since boot, varint][arguments],
+where the format id is the FNV-1a hash of the full format string, prefix included.
+Integers are zigzag varints, floats 4 bytes, strings a length byte and the bytes.
+The sources must match the firmware that wrote the log.
+"""
+
+import argparse
+import glob
+import os
+import re
+import struct
+import sys
+
+PREFIXES = {"ERROR": "ERROR: ", "WARN": "WARNING: ", "INFO": "", "DEBUG": ""}
+
+LOG_CALL = re.compile(r'\bLOG_(ERROR|WARN|INFO|DEBUG)\(\s*((?:"(?:[^"\\]|\\.)*"\s*)+)')
+LITERAL = re.compile(r'"((?:[^"\\]|\\.)*)"')
+SPEC = re.compile(r"%(?:%|[-+ #0]*\d*(?:\.\d+)?(hh|h|ll|l|z|j|t)?([diouxXcsfFgGeEp]))")
+ESCAPES = {"n": "\n", "t": "\t", "r": "\r", '"': '"', "\\": "\\", "'": "'", "0": "\0"}
+
+
+def fnv1a(text):
+    value = 2166136261
+    for byte in text.encode():
+        value = ((value ^ byte) * 16777619) & 0xFFFFFFFF
+    return value
+
+
+def unescape(literal):
+    return re.sub(r"\\(.)", lambda m: ESCAPES.get(m.group(1), m.group(1)), literal)
+
+
+def load_formats(source_dir):
+    """Format id -> (level, format) for every LOG_* call under source_dir."""
+    formats = {}
+    for path in sorted(glob.glob(os.path.join(source_dir, "*.cpp")) + glob.glob(os.path.join(source_dir, "*.h"))):
+        with open(path, encoding="utf-8") as file:
+            text = file.read()
+        for match in LOG_CALL.finditer(text):
+            level = match.group(1)
+            body = "".join(unescape(part) for part in LITERAL.findall(match.group(2)))
+            format = PREFIXES[level] + body
+            known = formats.get(fnv1a(format))
+            if known and known[1] != format:
+                print("warning: format id collision: %r and %r" % (known[1], format), file=sys.stderr)
+            formats[fnv1a(format)] = (level, format)
+    return formats
+
+
+def read_capture(path):
+    """Ring contents from each LOGRING block in a serial capture."""
+    rings, current = [], None
+    with open(path, errors="replace") as file:
+        for line in file:
+            line = line.strip()
+            if line.startswith("LOGRING begin"):
+                current = bytearray()
+            elif line.startswith("LOGRING end"):
+                if current is not None:
+                    rings.append(bytes(current))
+                current = None
+            elif line.startswith("LOGRING ") and current is not None:
+                current += bytes.fromhex(line[len("LOGRING ") :])
+    return rings
+
+
+class Reader:
+    def __init__(self, data):
+        self.data, self.offset = data, 0
+
+    def byte(self):
+        if self.offset >= len(self.data):
+            raise EOFError
+        self.offset += 1
+        return self.data[self.offset - 1]
+
+    def bytes(self, count):
+        if self.offset + count > len(self.data):
+            raise EOFError
+        self.offset += count
+        return self.data[self.offset - count : self.offset]
+
+    def varint(self):
+        value, shift = 0, 0
+        while True:
+            byte = self.byte()
+            value |= (byte & 0x7F) << shift
+            shift += 7
+            if byte < 0x80:
+                return value
+
+    def integer(self):
+        value = self.varint()
+        return (value >> 1) ^ -(value & 1)
+
+
+def render(format, reader):
+    """Format with the arguments read from the record, as printf would."""
+    out, position = [], 0
+    for match in SPEC.finditer(format):
+        out.append(format[position : match.start()])
+        position = match.end()
+        spec = match.group(0)
+        if spec == "%%":
+            out.append("%")
+            continue
+
+        length, conversion = match.group(1) or "", match.group(2)
+        python_spec = spec.replace(length, "", 1) if length else spec
+        try:
+            if conversion == "s":
+                value = reader.bytes(reader.byte()).decode(errors="replace")
+            elif conversion in "fFgGeE":
+                value = struct.unpack("<f", reader.bytes(4))[0]
+            elif conversion == "p":
+                value, python_spec = reader.integer() & 0xFFFFFFFF, "0x%x"
+            else:
+                value = reader.integer()
+                if conversion in "ouxX":
+                    value &= 0xFFFFFFFFFFFFFFFF if length == "ll" else 0xFFFFFFFF
+                    python_spec = python_spec[:-1] + ("d" if conversion == "u" else conversion)
+                elif conversion == "c":
+                    value = chr(value & 0xFF)
+        except EOFError:
+            out.append("<truncated>")
+            return "".join(out)
+        out.append(python_spec % value)
+    out.append(format[position:])
+    return "".join(out)
+
+
+def decode(ring, formats):
+    reader = Reader(ring)
+    while reader.offset < len(ring):
+        length = reader.byte()
+        record = Reader(reader.bytes(min(length, len(ring) - reader.offset)))
+        try:
+            format_id = struct.unpack("<I", record.bytes(4))[0]
+            millis = record.varint()
+        except EOFError:
+            print("<truncated record>")
+            break
+
+        if format_id not in formats:
+            print("[%9d ms] <unknown format 0x%08x, %d argument bytes>" % (millis, format_id, length - record.offset))
+            continue
+        text = render(formats[format_id][1], record)
+        for line in text.strip("\n").split("\n"):
+            print("[%9d ms] %s" % (millis, line))
+
+
+def main():
+    default_source = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "src")
+    parser = argparse.ArgumentParser(description="Decode the firmware's binary log ring")
+    parser.add_argument("input", help="serial capture with LOGRING lines, or a raw ring with --raw")
+    parser.add_argument("--raw", action="store_true", help="input is the ring bytes, oldest record first")
+    parser.add_argument("--source", default=default_source, help="firmware sources with the LOG_* calls")
+    options = parser.parse_args()
+
+    formats = load_formats(options.source)
+    if options.raw:
+        with open(options.input, "rb") as file:
+            rings = [file.read()]
+    else:
+        rings = read_capture(options.input)
+        if not rings:
+            sys.exit("No LOGRING block in %s" % options.input)
+
+    for index, ring in enumerate(rings):
+        if len(rings) > 1:
+            print("--- Log ring %d of %d (%d bytes) ---" % (index + 1, len(rings), len(ring)))
+        decode(ring, formats)
+
+
+if __name__ == "__main__":
+    main()
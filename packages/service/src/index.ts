@@ -3,7 +3,10 @@ import { config } from './config';
 import { PtvApiService } from './services/ptv-api';
 import { DatabaseService } from './services/database';
 import { ImageGeneratorService } from './services/image-generator';
+import { DepartureBoardService } from './services/departure-board';
 import { Scheduler } from './scheduler';
+import { parseWakeTraces, summarizeWakeTraces } from './services/wake-stats';
+import { encodeDeltaFrame } from './services/frame-encoder';
 
 const app = express();
 app.use(express.json());
@@ -12,6 +15,7 @@ const ptvApi = new PtvApiService();
 const database = new DatabaseService();
 const imageGenerator = new ImageGeneratorService();
 const scheduler = new Scheduler(ptvApi, database, imageGenerator);
+const departureBoard = new DepartureBoardService(ptvApi);
 
 app.get('/health', (req, res) => {
   res.json({ status: 'ok', timestamp: new Date().toISOString() });
@@ -30,10 +34,65 @@ app.post('/collect-data', async (req, res) => {
   }
 });
 
+// Generates the image and tells the caller where the finished frame is.
+// With ?inline=1 the frame itself is returned, so a device can display it
+// without a second request. A device that names the frame it holds in
+// X-Frame-Base gets a delta against it when that is smaller.
 app.post('/generate-image', async (req, res) => {
   try {
-    await scheduler.generateImage();
-    res.json({ success: true, message: 'Image generation triggered' });
+    // The display attaches traces of its previous wake cycles
+    const traces = parseWakeTraces(req.body);
+    await database.saveWakeTraces(traces).catch((error) => {
+      console.error('Error saving wake traces:', error);
+    });
+
+    // The image shows the same departures as the board, so the board tells the
+    // display when it goes stale
+    const [frame, board] = await Promise.all([
+      scheduler.generateImage(),
+      departureBoard.getBoard().catch((error) => {
+        console.error('Error fetching departures for validUntil:', error);
+        return null;
+      }),
+    ]);
+    const validUntil = board?.validUntil ?? null;
+
+    if (req.query.inline === '1' && frame) {
+      const baseVersion = req.get('X-Frame-Base');
+      const base = baseVersion ? scheduler.getRecentFrame(baseVersion) : undefined;
+      const delta = base ? encodeDeltaFrame(base.data, frame.data) : null;
+
+      res.set({
+        'Content-Type': 'application/octet-stream',
+        'X-Frame-Version': frame.version,
+        Vary: 'X-Frame-Base',
+        ...(validUntil ? { 'X-Valid-Until': String(validUntil) } : {}),
+      });
+
+      if (base && delta && delta.length < frame.data.length) {
+        console.log(`Sending frame ${frame.version} as a ${delta.length} byte delta against ${base.version}`);
+        res.set({ 'X-Frame-Base': base.version, ETag: `"${frame.version}-${base.version}"` });
+        res.send(delta);
+        return;
+      }
+
+      res.set({
+        ETag: `"${frame.version}"`,
+        // Where the display can resume the frame if this response breaks off
+        ...(frame.url ? { 'X-Frame-Url': frame.url } : {}),
+      });
+      res.send(frame.data);
+      return;
+    }
+
+    res.json({
+      success: true,
+      message: 'Image generation triggered',
+      frame: frame
+        ? { url: frame.url ?? null, version: frame.version, size: frame.data.length }
+        : null,
+      validUntil,
+    });
   } catch (error) {
     console.error('Error in manual image generation:', error);
     res.status(500).json({
@@ -43,6 +102,64 @@ app.post('/generate-image', async (req, res) => {
   }
 });
 
+// Departures for a display that draws the board itself. The display POSTs
+// with its wake traces attached, as for /generate-image
+const sendDepartures = async (req: express.Request, res: express.Response) => {
+  try {
+    if (req.method === 'POST') {
+      const traces = parseWakeTraces(req.body);
+      await database.saveWakeTraces(traces).catch((error) => {
+        console.error('Error saving wake traces:', error);
+      });
+    }
+
+    res.json(await departureBoard.getBoard());
+  } catch (error) {
+    console.error('Error fetching departure board:', error);
+    res.status(500).json({
+      success: false,
+      error: error instanceof Error ? error.message : 'Unknown error',
+    });
+  }
+};
+app.get('/departures', sendDepartures);
+app.post('/departures', sendDepartures);
+
+// Static chrome the display draws the departures over. It's cached on the
+// display, and res.send answers a matching If-None-Match with a 304
+app.get('/board-background', async (req, res) => {
+  try {
+    const background = await departureBoard.getBackground();
+    res.set({
+      'Content-Type': 'application/octet-stream',
+      ETag: `"${background.version}"`,
+    });
+    res.send(background.data);
+  } catch (error) {
+    console.error('Error rendering board background:', error);
+    res.status(500).json({
+      success: false,
+      error: error instanceof Error ? error.message : 'Unknown error',
+    });
+  }
+});
+
+// p50/p95 time per wake-cycle phase over the last ?days (default 7)
+app.get('/wake-stats', async (req, res) => {
+  try {
+    const days = parseInt((req.query.days as string) || '7');
+    const since = new Date(Date.now() - days * 24 * 60 * 60 * 1000);
+    const traces = await database.getWakeTraces(since);
+    res.json({ since: since.toISOString(), wakes: traces.length, phases: summarizeWakeTraces(traces) });
+  } catch (error) {
+    console.error('Error computing wake stats:', error);
+    res.status(500).json({
+      success: false,
+      error: error instanceof Error ? error.message : 'Unknown error',
+    });
+  }
+});
+
 async function start() {
   try {
     console.log('Initializing database...');
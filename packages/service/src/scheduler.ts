@@ -2,13 +2,18 @@ import cron from 'node-cron';
 import { PtvApiService } from './services/ptv-api';
 import { DatabaseService } from './services/database';
 import { ImageGeneratorService } from './services/image-generator';
-import { DepartureRecord, RouteRecord } from './types';
+import { DepartureRecord, GeneratedFrame, RouteRecord } from './types';
 import { config } from './config';
 
+// Frames generated most recently, kept so a display holding one of them can be
+// sent a delta against it
+const RECENT_FRAMES = 8;
+
 export class Scheduler {
   private ptvApi: PtvApiService;
   private database: DatabaseService;
   private imageGenerator: ImageGeneratorService;
+  private recentFrames = new Map<string, GeneratedFrame>();
 
   constructor(
     ptvApi: PtvApiService,
@@ -79,17 +84,33 @@ export class Scheduler {
     }
   }
 
-  async generateImage(): Promise<void> {
+  async generateImage(): Promise<GeneratedFrame | null> {
     console.log('Starting image generation...');
 
     try {
-      await this.imageGenerator.triggerImageGeneration();
+      const frame = await this.imageGenerator.triggerImageGeneration();
       console.log('Image generation completed successfully');
+
+      // Oldest first: re-inserting moves a version to the end
+      this.recentFrames.delete(frame.version);
+      this.recentFrames.set(frame.version, frame);
+      if (this.recentFrames.size > RECENT_FRAMES) {
+        this.recentFrames.delete(this.recentFrames.keys().next().value as string);
+      }
+      return frame;
     } catch (error) {
       console.error('Error generating image:', error);
+      return null;
     }
   }
 
+  /**
+   * A recently generated frame by version, if it's still kept
+   */
+  getRecentFrame(version: string): GeneratedFrame | undefined {
+    return this.recentFrames.get(version);
+  }
+
   startDataCollectionCron(): void {
     const schedule = config.service.dataCollectionCron;
     console.log(`Starting PTV data collection cron with schedule: ${schedule}`);
@@ -1,6 +1,6 @@
 import { Pool, PoolClient } from 'pg';
 import { config } from '../config';
-import { DepartureRecord, RouteRecord } from '../types';
+import { DepartureRecord, RouteRecord, WakeTraceRecord } from '../types';
 
 export class DatabaseService {
   private pool: Pool;
@@ -67,6 +67,22 @@ export class DatabaseService {
         CREATE INDEX IF NOT EXISTS idx_routes_fetched_at ON routes(fetched_at)
       `);
 
+      await client.query(`
+        CREATE TABLE IF NOT EXISTS wake_traces (
+          id SERIAL PRIMARY KEY,
+          sequence INTEGER NOT NULL,
+          wake_reason INTEGER NOT NULL,
+          rssi INTEGER NOT NULL,
+          bytes INTEGER NOT NULL,
+          phase_us BIGINT[] NOT NULL,
+          received_at TIMESTAMP NOT NULL DEFAULT NOW()
+        )
+      `);
+
+      await client.query(`
+        CREATE INDEX IF NOT EXISTS idx_wake_traces_received_at ON wake_traces(received_at)
+      `);
+
       console.log('Database tables initialized successfully');
     } finally {
       client.release();
@@ -149,6 +165,54 @@ export class DatabaseService {
     }
   }
 
+  async saveWakeTraces(traces: WakeTraceRecord[]): Promise<void> {
+    if (traces.length === 0) {
+      return;
+    }
+
+    const client = await this.pool.connect();
+    try {
+      await client.query('BEGIN');
+
+      for (const trace of traces) {
+        await client.query(
+          `INSERT INTO wake_traces (
+            sequence,
+            wake_reason,
+            rssi,
+            bytes,
+            phase_us,
+            received_at
+          ) VALUES ($1, $2, $3, $4, $5, $6)`,
+          [trace.sequence, trace.wake_reason, trace.rssi, trace.bytes, trace.phase_us, trace.received_at]
+        );
+      }
+
+      await client.query('COMMIT');
+      console.log(`Saved ${traces.length} wake traces to database`);
+    } catch (error) {
+      await client.query('ROLLBACK');
+      throw error;
+    } finally {
+      client.release();
+    }
+  }
+
+  async getWakeTraces(since: Date): Promise<WakeTraceRecord[]> {
+    const result = await this.pool.query(
+      `SELECT sequence, wake_reason, rssi, bytes, phase_us, received_at
+       FROM wake_traces
+       WHERE received_at >= $1
+       ORDER BY received_at`,
+      [since]
+    );
+
+    return result.rows.map((row) => ({
+      ...row,
+      phase_us: row.phase_us.map((value: string) => Number(value)),
+    }));
+  }
+
   async close(): Promise<void> {
     await this.pool.end();
   }
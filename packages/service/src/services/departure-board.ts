@@ -0,0 +1,149 @@
+import sharp from 'sharp';
+import { PtvApiService } from './ptv-api';
+import { crc32, encodeFrame, PALETTE_RGB } from './frame-encoder';
+import { BoardDeparture, DepartureBoardDocument } from '../types';
+
+/**
+ * Departure board for the display to draw on the device
+ *
+ * Instead of a rendered image, the display fetches a ~1 KB JSON document with the
+ * departures and draws the times itself over a background frame holding the
+ * static chrome, which it keeps in its flash cache.
+ */
+
+// Stop, directions (in display order: to the city, then from it) and route shown
+const BOARD_STOP_ID = 1097;
+const BOARD_DIRECTIONS = [1, 16];
+const BOARD_ROUTE_ID = 16;
+const BOARD_MAX_DEPARTURES = 3;
+
+// Board layout in portrait pixels - must match packages/firmware/src/departure_board.h
+const BOARD_WIDTH = 480;
+const BOARD_HEIGHT = 800;
+const BOARD_MARGIN = 12;
+const BOARD_SECTION_HEIGHT = 392;
+const BOARD_HEADER_HEIGHT = 56;
+const BOARD_ROWS_OFFSET = 68;
+const BOARD_ROW_HEIGHT = 96;
+const BOARD_ROW_PITCH = 104;
+const BOARD_MINUTES_X = 352;
+const BOARD_MINUTES_Y = 18;
+const BOARD_MINUTES_WIDTH = 104;
+const BOARD_MINUTES_HEIGHT = 60;
+
+export interface BoardBackground {
+  data: Buffer; // Panel frame (.e6f)
+  version: string; // CRC-32 of the frame payload (hex)
+}
+
+export class DepartureBoardService {
+  private ptvApi: PtvApiService;
+  private background: BoardBackground | null = null;
+
+  constructor(ptvApi: PtvApiService) {
+    this.ptvApi = ptvApi;
+  }
+
+  async getBoard(): Promise<DepartureBoardDocument> {
+    const [directions, route] = await Promise.all([
+      Promise.all(
+        BOARD_DIRECTIONS.map(async (directionId) => {
+          const response = await this.ptvApi.getDepartures(0, BOARD_STOP_ID, directionId, BOARD_MAX_DEPARTURES);
+          const departures: BoardDeparture[] = response.departures.slice(0, BOARD_MAX_DEPARTURES).map((dep) => ({
+            scheduled: toUnixSeconds(dep.scheduled_departure_utc),
+            ...(dep.estimated_departure_utc ? { estimated: toUnixSeconds(dep.estimated_departure_utc) } : {}),
+            ...(dep.platform_number ? { platform: dep.platform_number } : {}),
+          }));
+          return { direction_id: directionId, departures };
+        })
+      ),
+      this.ptvApi.getRoute(BOARD_ROUTE_ID),
+    ]);
+
+    const status = route.route?.route_service_status?.description ?? '';
+    const content = { status, directions };
+    const version = crc32(Buffer.from(JSON.stringify(content))).toString(16).padStart(8, '0');
+    return { version, ...content, validUntil: nextDeparture(directions.flatMap((d) => d.departures)) };
+  }
+
+  /**
+   * Static chrome of the board as a panel frame, rendered once and kept in memory
+   */
+  async getBackground(): Promise<BoardBackground> {
+    if (!this.background) {
+      const { data, info } = await sharp(Buffer.from(buildBackgroundSvg()))
+        .ensureAlpha()
+        .raw()
+        .toBuffer({ resolveWithObject: true });
+
+      const frame = encodeFrame(data, info.width, info.height, info.channels);
+      this.background = { data: frame, version: frame.readUInt32LE(16).toString(16).padStart(8, '0') };
+      console.log(`Board background rendered: ${frame.length} bytes, version ${this.background.version}`);
+    }
+    return this.background;
+  }
+}
+
+/**
+ * When the first of these departures leaves (real-time estimate if there is one)
+ * The display times its next wake from this
+ */
+export function nextDeparture(departures: BoardDeparture[]): number | null {
+  const now = Date.now() / 1000;
+  const upcoming = departures
+    .map((dep) => dep.estimated ?? dep.scheduled)
+    .filter((time) => time > now);
+  return upcoming.length > 0 ? Math.min(...upcoming) : null;
+}
+
+function toUnixSeconds(utc: string): number {
+  return Math.floor(new Date(utc).getTime() / 1000);
+}
+
+/**
+ * Headers and row boxes of both directions, in the pixel style of MetroPixelStatus
+ * Colors are exact panel inks so nothing gets dithered
+ */
+function buildBackgroundSvg(): string {
+  const ink = (index: number) => `rgb(${PALETTE_RGB[index].join(',')})`;
+  const black = ink(0);
+  const white = ink(1);
+  const elements: string[] = [];
+
+  const pill = (x: number, y: number, label: string, dark: boolean) => {
+    elements.push(
+      `<rect x="${x + 1}" y="${y + 1}" width="148" height="46" fill="${dark ? black : white}" stroke="${black}" stroke-width="2"/>`,
+      `<text x="${x + 75}" y="${y + 32}" font-size="22" text-anchor="middle" fill="${dark ? white : black}">${label}</text>`
+    );
+  };
+
+  BOARD_DIRECTIONS.forEach((_, section) => {
+    const top = BOARD_MARGIN + section * BOARD_SECTION_HEIGHT;
+    const toCity = section === 0;
+
+    // Home -> Flinders, then Home <- Flinders
+    const headerY = top + (BOARD_HEADER_HEIGHT - 48) / 2;
+    pill(60, headerY, 'HOME', toCity);
+    pill(270, headerY, 'FLINDERS', !toCity);
+    const arrowY = top + BOARD_HEADER_HEIGHT / 2;
+    const arrow = toCity
+      ? `${BOARD_WIDTH / 2 - 10},${arrowY - 12} ${BOARD_WIDTH / 2 + 12},${arrowY} ${BOARD_WIDTH / 2 - 10},${arrowY + 12}`
+      : `${BOARD_WIDTH / 2 + 10},${arrowY - 12} ${BOARD_WIDTH / 2 - 12},${arrowY} ${BOARD_WIDTH / 2 + 10},${arrowY + 12}`;
+    elements.push(`<polygon points="${arrow}" fill="${black}"/>`);
+
+    for (let row = 0; row < BOARD_MAX_DEPARTURES; row++) {
+      const rowTop = top + BOARD_ROWS_OFFSET + row * BOARD_ROW_PITCH;
+      elements.push(
+        `<rect x="${BOARD_MARGIN + 1}" y="${rowTop + 1}" width="${BOARD_WIDTH - 2 * BOARD_MARGIN - 2}" height="${BOARD_ROW_HEIGHT - 2}" fill="none" stroke="${black}" stroke-width="2"/>`,
+        `<rect x="${BOARD_MINUTES_X + 1}" y="${rowTop + BOARD_MINUTES_Y + 1}" width="${BOARD_MINUTES_WIDTH - 2}" height="${BOARD_MINUTES_HEIGHT - 2}" fill="none" stroke="${black}" stroke-width="2"/>`
+      );
+    }
+  });
+
+  return [
+    `<svg xmlns="http://www.w3.org/2000/svg" width="${BOARD_WIDTH}" height="${BOARD_HEIGHT}" shape-rendering="crispEdges" font-family="DejaVu Sans Mono, monospace" font-weight="bold">`,
+    `<rect width="${BOARD_WIDTH}" height="${BOARD_HEIGHT}" fill="${white}"/>`,
+    ...elements,
+    '</svg>',
+  ].join('\n');
+}
@@ -0,0 +1,298 @@
+/**
+ * Encoder for the pre-quantized panel frame format (.e6f)
+ *
+ * The firmware copies these frames straight into the panel buffer, so all of the
+ * per-pixel work (palette mapping, dithering, rotation) happens here instead.
+ * The layout is documented in packages/firmware/lib/image_pipeline/frame_format.h
+ * and the palette must match PALETTE_RGB in packages/firmware/src/config.h.
+ */
+
+// Native panel size (DISPLAY_WIDTH x DISPLAY_HEIGHT in the firmware config)
+export const PANEL_WIDTH = 800;
+export const PANEL_HEIGHT = 480;
+
+const FRAME_MAGIC = 'E6FR';
+const FRAME_HEADER_SIZE = 20;
+const FRAME_VERSION = 1;
+const FRAME_FLAG_RLE = 0x01;
+const FRAME_FLAG_DELTA = 0x02;
+
+// Pixel index in a delta frame for "unchanged from the base frame" (FRAME_COLOR_KEEP)
+const FRAME_COLOR_KEEP = 7;
+
+// Bump together with FRAME_PALETTE_VERSION in the firmware when the palette changes
+export const FRAME_PALETTE_VERSION = 1;
+
+// Measured panel colors, indexed by palette index (COLOR_BLACK ... COLOR_GREEN)
+export const PALETTE_RGB: [number, number, number][] = [
+  [25, 30, 33], // Black
+  [232, 232, 232], // White
+  [178, 19, 24], // Red
+  [239, 222, 68], // Yellow
+  [33, 87, 186], // Blue
+  [18, 95, 32], // Green
+];
+
+// Same 32x32x32 nearest-color table the firmware builds at compile time
+const LUT_BITS = 5;
+const PALETTE_LUT = buildPaletteLut();
+
+function buildPaletteLut(): Uint8Array {
+  const cells = 1 << LUT_BITS;
+  const shift = 8 - LUT_BITS;
+  const lut = new Uint8Array(cells * cells * cells);
+
+  for (let i = 0; i < lut.length; i++) {
+    const r = (Math.floor(i / (cells * cells)) << shift) + (1 << (shift - 1));
+    const g = ((Math.floor(i / cells) % cells) << shift) + (1 << (shift - 1));
+    const b = ((i % cells) << shift) + (1 << (shift - 1));
+
+    let best = 0;
+    let bestDistance = Infinity;
+    PALETTE_RGB.forEach(([pr, pg, pb], color) => {
+      // Weighted for perceived brightness, like paletteDistance() in the firmware
+      const distance = 2 * (r - pr) ** 2 + 4 * (g - pg) ** 2 + 3 * (b - pb) ** 2;
+      if (distance < bestDistance) {
+        best = color;
+        bestDistance = distance;
+      }
+    });
+    lut[i] = best;
+  }
+  return lut;
+}
+
+/**
+ * Floyd-Steinberg dither raw pixels to palette indices
+ * Uses the same integer maths as the firmware's FloydSteinbergDither
+ */
+function ditherToPalette(data: Buffer, width: number, height: number, channels: number): Uint8Array {
+  const indices = new Uint8Array(width * height);
+  const shift = 8 - LUT_BITS;
+  const clamp = (value: number) => (value < 0 ? 0 : value > 255 ? 255 : value);
+
+  // Error rows per channel, padded by one pixel each side
+  let error = [0, 1, 2].map(() => new Int16Array(width + 2));
+  let nextError = [0, 1, 2].map(() => new Int16Array(width + 2));
+
+  for (let y = 0; y < height; y++) {
+    [error, nextError] = [nextError, error];
+    nextError.forEach((row) => row.fill(0));
+
+    for (let x = 0; x < width; x++) {
+      const offset = (y * width + x) * channels;
+      const r = clamp(data[offset] + error[0][x + 1]);
+      const g = clamp(data[offset + 1] + error[1][x + 1]);
+      const b = clamp(data[offset + 2] + error[2][x + 1]);
+
+      const color = PALETTE_LUT[((r >> shift) << (LUT_BITS * 2)) | ((g >> shift) << LUT_BITS) | (b >> shift)];
+      indices[y * width + x] = color;
+
+      const target = PALETTE_RGB[color];
+      [r - target[0], g - target[1], b - target[2]].forEach((err, channel) => {
+        error[channel][x + 2] += (err * 7) >> 4; // Right
+        nextError[channel][x] += (err * 3) >> 4; // Bottom-left
+        nextError[channel][x + 1] += (err * 5) >> 4; // Bottom
+        nextError[channel][x + 2] += err >> 4; // Bottom-right
+      });
+    }
+  }
+  return indices;
+}
+
+/**
+ * Rotate a portrait image 90 degrees clockwise onto the landscape panel
+ * Image(x, y) -> Panel(height - 1 - y, x), matching the firmware's BMP path
+ */
+function rotateClockwise(indices: Uint8Array, width: number, height: number): Uint8Array {
+  const rotated = new Uint8Array(width * height);
+  for (let y = 0; y < height; y++) {
+    const panelX = height - 1 - y;
+    for (let x = 0; x < width; x++) {
+      rotated[x * height + panelX] = indices[y * width + x];
+    }
+  }
+  return rotated;
+}
+
+/**
+ * Run-length encode palette indices (see frame_format.h for the token layout)
+ */
+function encodeRle(pixels: Uint8Array): Buffer {
+  const out: number[] = [];
+  const runLength = (start: number) => {
+    let end = start;
+    while (end < pixels.length && pixels[end] === pixels[start]) end++;
+    return end - start;
+  };
+
+  let i = 0;
+  while (i < pixels.length) {
+    const run = runLength(i);
+    if (run >= 3) {
+      if (run < 16) {
+        out.push(((run - 1) << 3) | pixels[i]);
+      } else {
+        // Extended run: the length beyond 16 follows as a LEB128 varint
+        out.push(0x78 | pixels[i]);
+        let extra = run - 16;
+        while (extra >= 0x80) {
+          out.push((extra & 0x7f) | 0x80);
+          extra >>>= 7;
+        }
+        out.push(extra);
+      }
+      i += run;
+      continue;
+    }
+
+    // Literal until the next run worth encoding
+    const start = i;
+    while (i < pixels.length && i - start < 128 && runLength(i) < 3) i++;
+    const count = i - start;
+    out.push(0x80 | (count - 1));
+    for (let k = 0; k < count; k += 2) {
+      const low = k + 1 < count ? pixels[start + k + 1] : 0;
+      out.push((pixels[start + k] << 4) | low);
+    }
+  }
+  return Buffer.from(out);
+}
+
+const CRC_TABLE = (() => {
+  const table = new Uint32Array(256);
+  for (let i = 0; i < 256; i++) {
+    let c = i;
+    for (let k = 0; k < 8; k++) {
+      c = c & 1 ? 0xedb88320 ^ (c >>> 1) : c >>> 1;
+    }
+    table[i] = c >>> 0;
+  }
+  return table;
+})();
+
+export function crc32(data: Buffer): number {
+  let crc = 0xffffffff;
+  for (let i = 0; i < data.length; i++) {
+    crc = CRC_TABLE[(crc ^ data[i]) & 0xff] ^ (crc >>> 8);
+  }
+  return (crc ^ 0xffffffff) >>> 0;
+}
+
+/**
+ * Encode raw RGB(A) pixels as a panel frame
+ * Accepts either a landscape image at panel size or a portrait image, which is
+ * rotated onto the panel like the firmware rotates BMPs
+ */
+export function encodeFrame(data: Buffer, width: number, height: number, channels: number): Buffer {
+  let orientation: number;
+  if (width === PANEL_WIDTH && height === PANEL_HEIGHT) {
+    orientation = 0;
+  } else if (width === PANEL_HEIGHT && height === PANEL_WIDTH) {
+    orientation = 1;
+  } else {
+    throw new Error(`Image is ${width}x${height}, panel frames must be ${PANEL_WIDTH}x${PANEL_HEIGHT} or rotated`);
+  }
+
+  let pixels = ditherToPalette(data, width, height, channels);
+  if (orientation === 1) {
+    pixels = rotateClockwise(pixels, width, height);
+  }
+
+  return buildFrame(encodeRle(pixels), FRAME_FLAG_RLE, orientation);
+}
+
+/**
+ * Encode target as a delta frame against base, both full frames from encodeFrame()
+ * Pixels that are the same in both are sent as FRAME_COLOR_KEEP, so a frame where
+ * only a few departure times changed shrinks to a few long runs and the changes.
+ * Returns null if the frames can't be compared (different size or orientation)
+ */
+export function encodeDeltaFrame(base: Buffer, target: Buffer): Buffer | null {
+  const basePixels = decodeFramePixels(base);
+  const pixels = decodeFramePixels(target);
+  const orientation = target.readUInt8(10);
+  if (!basePixels || !pixels || base.readUInt8(10) !== orientation) {
+    return null;
+  }
+
+  for (let i = 0; i < pixels.length; i++) {
+    if (pixels[i] === basePixels[i]) {
+      pixels[i] = FRAME_COLOR_KEEP;
+    }
+  }
+  return buildFrame(encodeRle(pixels), FRAME_FLAG_RLE | FRAME_FLAG_DELTA, orientation);
+}
+
+/**
+ * Palette index of every panel pixel of a full frame, or null if it isn't one
+ */
+function decodeFramePixels(frame: Buffer): Uint8Array | null {
+  if (
+    frame.length < FRAME_HEADER_SIZE ||
+    frame.toString('ascii', 0, 4) !== FRAME_MAGIC ||
+    (frame.readUInt8(5) & FRAME_FLAG_DELTA) !== 0 ||
+    frame.readUInt16LE(6) !== PANEL_WIDTH ||
+    frame.readUInt16LE(8) !== PANEL_HEIGHT
+  ) {
+    return null;
+  }
+
+  const pixels = new Uint8Array(PANEL_WIDTH * PANEL_HEIGHT);
+  const payload = frame.subarray(FRAME_HEADER_SIZE, FRAME_HEADER_SIZE + frame.readUInt32LE(12));
+  let count = 0;
+  const emit = (color: number, length: number) => {
+    pixels.fill(color, count, Math.min(count + length, pixels.length));
+    count += length;
+  };
+
+  if ((frame.readUInt8(5) & FRAME_FLAG_RLE) === 0) {
+    for (const byte of payload) {
+      emit(byte >> 4, 1);
+      emit(byte & 0x0f, 1);
+    }
+    return pixels;
+  }
+
+  let i = 0;
+  while (i < payload.length) {
+    const token = payload[i++];
+    if (token & 0x80) {
+      const literal = (token & 0x7f) + 1;
+      for (let k = 0; k < literal; k++) {
+        const byte = payload[i + (k >> 1)];
+        emit(k & 1 ? byte & 0x0f : byte >> 4, 1);
+      }
+      i += (literal + 1) >> 1;
+    } else if (((token >> 3) & 0x0f) === 0x0f) {
+      let extra = 0;
+      for (let shift = 0; ; shift += 7) {
+        const byte = payload[i++];
+        extra += (byte & 0x7f) * 2 ** shift;
+        if ((byte & 0x80) === 0) break;
+      }
+      emit(token & 0x07, 16 + extra);
+    } else {
+      emit(token & 0x07, ((token >> 3) & 0x0f) + 1);
+    }
+  }
+  return pixels;
+}
+
+/**
+ * Frame header followed by the payload
+ */
+function buildFrame(payload: Buffer, flags: number, orientation: number): Buffer {
+  const header = Buffer.alloc(FRAME_HEADER_SIZE);
+  header.write(FRAME_MAGIC, 0, 'ascii');
+  header.writeUInt8(FRAME_VERSION, 4);
+  header.writeUInt8(flags, 5);
+  header.writeUInt16LE(PANEL_WIDTH, 6);
+  header.writeUInt16LE(PANEL_HEIGHT, 8);
+  header.writeUInt8(orientation, 10);
+  header.writeUInt8(FRAME_PALETTE_VERSION, 11);
+  header.writeUInt32LE(payload.length, 12);
+  header.writeUInt32LE(crc32(payload), 16);
+
+  return Buffer.concat([header, payload]);
+}
@@ -4,6 +4,8 @@ import * as fs from 'fs';
 import sharp from 'sharp';
 import * as bmp from 'bmp-js';
 import { config } from '../config';
+import { encodeFrame } from './frame-encoder';
+import { GeneratedFrame } from '../types';
 
 export class ImageGeneratorService {
   private appUrl: string;
@@ -20,7 +22,7 @@ export class ImageGeneratorService {
     this.displayHeight = config.imageGenerator.displayHeight;
   }
 
-  async triggerImageGeneration(): Promise<void> {
+  async triggerImageGeneration(): Promise<GeneratedFrame> {
     console.log('Starting image generation...');
     console.log(`Output dimensions: ${this.displayWidth}x${this.displayHeight}`);
     console.log(`Output path: ${this.outputPath}`);
@@ -128,6 +130,17 @@ export class ImageGeneratorService {
       const stats = fs.statSync(this.outputPath);
       console.log(`  File size: ${(stats.size / 1024).toFixed(2)} KB`);
 
+      // Encode the pre-quantized panel frame next to the BMP
+      // The firmware copies it straight into the panel buffer with no dithering
+      const framePath = this.getFramePath();
+      const frameData = encodeFrame(data, info.width, info.height, info.channels);
+      fs.writeFileSync(framePath, frameData);
+
+      console.log(`✓ Panel frame encoded: ${framePath}`);
+      console.log(
+        `  File size: ${(frameData.length / 1024).toFixed(2)} KB (${(stats.size / frameData.length).toFixed(1)}x smaller than BMP)`
+      );
+
       // Clean up temp PNG file
       if (fs.existsSync(tempPngPath)) {
         fs.unlinkSync(tempPngPath);
@@ -136,8 +149,18 @@ export class ImageGeneratorService {
 
       // Upload to file store if configured
       if (this.fileStoreUrl) {
-        await this.uploadToFileStore();
+        await this.uploadToFileStore(this.outputPath);
+        await this.uploadToFileStore(framePath);
       }
+
+      // The payload CRC from the frame header identifies this frame's content
+      const version = frameData.readUInt32LE(16).toString(16).padStart(8, '0');
+      return {
+        path: framePath,
+        data: frameData,
+        version,
+        url: this.getFileStoreUrl(path.basename(framePath), version),
+      };
     } catch (error) {
       console.error('Error generating image:', error);
       throw error;
@@ -146,12 +169,31 @@ export class ImageGeneratorService {
     }
   }
 
-  private async uploadToFileStore(): Promise<void> {
+  /**
+   * Path of the panel frame (.e6f) written alongside the BMP
+   */
+  private getFramePath(): string {
+    return this.outputPath.replace(/\.(bmp|png)$/i, '') + '.e6f';
+  }
+
+  /**
+   * Public URL of an uploaded file, with the version appended so device caches
+   * keyed by URL see each new frame as a new resource
+   */
+  private getFileStoreUrl(filename: string, version: string): string | undefined {
+    if (!this.fileStoreUrl.startsWith('http://') && !this.fileStoreUrl.startsWith('https://')) {
+      return undefined;
+    }
+    const base = this.fileStoreUrl.endsWith('/') ? this.fileStoreUrl : `${this.fileStoreUrl}/`;
+    return `${base}${filename}?v=${version}`;
+  }
+
+  private async uploadToFileStore(filePath: string): Promise<void> {
     console.log(`Uploading image to file store: ${this.fileStoreUrl}`);
 
     try {
       // Get the filename from the output path
-      const filename = path.basename(this.outputPath);
+      const filename = path.basename(filePath);
 
       // If it's a file path (starts with / or drive letter or //), copy the file
       if (this.fileStoreUrl.startsWith('/') ||
@@ -166,12 +208,12 @@ export class ImageGeneratorService {
           fs.mkdirSync(destDir, { recursive: true });
         }
 
-        fs.copyFileSync(this.outputPath, destinationPath);
+        fs.copyFileSync(filePath, destinationPath);
         console.log(`✓ Image uploaded to: ${destinationPath}`);
       }
       // If it's an HTTP URL, upload via PUT
       else if (this.fileStoreUrl.startsWith('http://') || this.fileStoreUrl.startsWith('https://')) {
-        const fileBuffer = fs.readFileSync(this.outputPath);
+        const fileBuffer = fs.readFileSync(filePath);
 
         // Construct the full URL with the filename
         // e.g., http://127.0.0.1:5000/new-path/display.png
@@ -182,7 +224,9 @@ export class ImageGeneratorService {
         console.log(`Uploading to: ${uploadUrl}`);
 
         // Determine content type based on file extension
-        const contentType = filename.toLowerCase().endsWith('.bmp') ? 'image/bmp' : 'image/png';
+        const extension = path.extname(filename).toLowerCase();
+        const contentType =
+          extension === '.bmp' ? 'image/bmp' : extension === '.e6f' ? 'application/octet-stream' : 'image/png';
 
         const response = await fetch(uploadUrl, {
           method: 'PUT',
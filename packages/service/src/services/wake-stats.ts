@@ -0,0 +1,83 @@
+import { WakeTraceRecord } from '../types';
+
+// Phase order of the firmware's WakePhase enum
+export const WAKE_PHASES = [
+  'boot',
+  'wifi',
+  'ntp',
+  'generate',
+  'first_byte',
+  'download',
+  'decode',
+  'refresh',
+  'sleep',
+] as const;
+
+export interface PhaseStats {
+  phase: string;
+  count: number;
+  p50_ms: number;
+  p95_ms: number;
+}
+
+/**
+ * Parse the traces the firmware attaches to a generate request:
+ * { traces: [{ seq, wake, rssi, bytes, us: [...] }] }
+ */
+export function parseWakeTraces(body: any): WakeTraceRecord[] {
+  if (!body || !Array.isArray(body.traces)) {
+    return [];
+  }
+
+  const receivedAt = new Date();
+  return body.traces
+    .filter((trace: any) => Array.isArray(trace?.us) && trace.us.length === WAKE_PHASES.length)
+    .map((trace: any) => ({
+      sequence: Number(trace.seq) || 0,
+      wake_reason: Number(trace.wake) || 0,
+      rssi: Number(trace.rssi) || 0,
+      bytes: Number(trace.bytes) || 0,
+      phase_us: trace.us.map((value: any) => Number(value) || 0),
+      received_at: receivedAt,
+    }));
+}
+
+function percentile(sorted: number[], fraction: number): number {
+  const index = Math.min(sorted.length - 1, Math.ceil(fraction * sorted.length) - 1);
+  return sorted[Math.max(0, index)];
+}
+
+/**
+ * p50/p95 time spent in each phase, plus the whole wake ("total")
+ * A phase's duration runs from the latest phase end before its own, as in the
+ * firmware's traceEnd(): a clock restored from RTC memory is ready before WiFi
+ * comes up, so phases don't always end in enum order. Skipped phases (0) are
+ * left out, and the total is the last phase end
+ */
+export function summarizeWakeTraces(traces: WakeTraceRecord[]): PhaseStats[] {
+  const durations: number[][] = WAKE_PHASES.map(() => []);
+  const totals: number[] = [];
+
+  for (const trace of traces) {
+    const ends = trace.phase_us;
+    ends.forEach((end, phase) => {
+      if (end === 0) return;
+      const previous = ends.reduce((latest, other) => (other < end && other > latest ? other : latest), 0);
+      durations[phase].push((end - previous) / 1000);
+    });
+    const last = Math.max(0, ...ends);
+    if (last > 0) totals.push(last / 1000);
+  }
+
+  const summarize = (phase: string, values: number[]): PhaseStats => {
+    const sorted = [...values].sort((a, b) => a - b);
+    return {
+      phase,
+      count: sorted.length,
+      p50_ms: sorted.length ? Math.round(percentile(sorted, 0.5)) : 0,
+      p95_ms: sorted.length ? Math.round(percentile(sorted, 0.95)) : 0,
+    };
+  };
+
+  return [...WAKE_PHASES.map((phase, i) => summarize(phase, durations[i])), summarize('total', totals)];
+}
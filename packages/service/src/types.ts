@@ -64,3 +64,35 @@ export interface RouteRecord {
   service_status_timestamp?: string;
   fetched_at: Date;
 }
+
+export interface GeneratedFrame {
+  path: string;
+  data: Buffer;
+  version: string; // CRC-32 of the frame payload (hex)
+  url?: string; // Versioned file store URL, if the store is served over HTTP
+}
+
+// Departures for the display to draw itself (packages/firmware/src/departure_board.h)
+// Times are Unix seconds; the display formats them and counts down the minutes
+export interface BoardDeparture {
+  scheduled: number;
+  estimated?: number;
+  platform?: string;
+}
+
+export interface DepartureBoardDocument {
+  version: string; // CRC-32 of the content (hex), changes with any departure or the status
+  status: string; // Route service status
+  directions: { direction_id: number; departures: BoardDeparture[] }[];
+  validUntil: number | null; // When the first departure leaves and the board changes
+}
+
+// Wake-cycle trace uploaded by the display with its generate request
+export interface WakeTraceRecord {
+  sequence: number;
+  wake_reason: number;
+  rssi: number;
+  bytes: number;
+  phase_us: number[]; // End of each phase in microseconds since boot, 0 if skipped
+  received_at: Date;
+}